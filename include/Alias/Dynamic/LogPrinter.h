@@ -9,6 +9,9 @@ class LogPrinter: public LogProcessor<LogPrinter>
 {
 private:
 	std::ostream& os;
+	unsigned lastThreadId;
+
+	void printThread();
 public:
 	LogPrinter(const char*, std::ostream&);
 
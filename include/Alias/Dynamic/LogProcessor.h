@@ -14,6 +14,9 @@ private:
 public:
 	LogProcessor(const char* fileName): reader(fileName) {}
 
+	// The thread that logged the record being visited
+	unsigned getThreadId() const { return reader.getThreadId(); }
+
 	void process()
 	{
 		while (auto rec = reader.readLogRecord())
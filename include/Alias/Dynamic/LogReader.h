@@ -3,6 +3,7 @@
 #include "Alias/Dynamic/LogRecord.h"
 
 #include <boost/optional.hpp>
+#include <cstdint>
 #include <fstream>
 #include <vector>
 
@@ -17,14 +18,30 @@ public:
 	static std::vector<LogRecord> readLogFromFile(const char* fileName);
 };
 
+// Reads the records block by block. The records of a block are logged by one
+// thread, and the blocks of the threads are interleaved in the file.
 class LazyLogReader
 {
 private:
 	std::ifstream ifs;
+	// The log has no header and blocks, as written by the older runtime
+	bool legacy;
+
+	std::vector<unsigned char> block;
+	size_t pos;
+	unsigned threadId;
+	uintptr_t lastAddress;
+
+	bool readBlock();
+	uint64_t readVarint();
+	boost::optional<LogRecord> readBlockRecord();
 public:
 	LazyLogReader(const char* fileName);
 
 	boost::optional<LogRecord> readLogRecord();
+
+	// The thread that logged the last record read
+	unsigned getThreadId() const { return threadId; }
 };
 
 }
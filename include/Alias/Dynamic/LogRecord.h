@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 // We won't put the following structs into a namespace because of C compatibility
 
 struct AllocRecord
@@ -51,3 +53,35 @@ struct LogRecord
 		struct CallRecord callRecord;
 	};
 };
+
+// The log starts with a LogFileHeader, followed by the blocks of records each
+// thread flushes, in the order they are flushed. A block is a LogBlockHeader
+// and the records of one thread, encoded as follows and compressed with zlib
+// if the header says so:
+//   type byte, [alloc type byte,] id as a varint, [address as a varint of the
+//   zigzag-encoded delta from the previous address of the block]
+#define LOG_MAGIC "DYNALOG"
+#define LOG_VERSION 2
+
+// The maximum size of an encoded record
+#define LOG_MAX_RECORD_SIZE 32
+
+enum LogBlockFlag
+{
+	LOG_BLOCK_COMPRESSED = 1
+};
+
+struct LogFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct LogBlockHeader
+{
+	uint32_t threadId;
+	uint32_t flags;
+	uint32_t rawSize;
+	uint32_t storedSize;
+};
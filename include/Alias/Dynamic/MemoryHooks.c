@@ -2,20 +2,54 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifdef DYNAA_ZLIB
+#include <zlib.h>
+#endif
+
+// The records of a thread are buffered and written as one block when the
+// buffer is full, when the thread exits, and at exit
+#define LOG_BUFFER_SIZE (1 << 20)
+
+struct ThreadLog
+{
+	// Held by the owner thread while it appends or flushes, so that
+	// HookFinalize never packs a buffer in use
+	pthread_mutex_t lock;
+	uint32_t threadId;
+	size_t size;
+	uintptr_t lastAddress;
+	unsigned char* buffer;
+	unsigned char* compressBuffer;
+	size_t compressCapacity;
+	struct ThreadLog* prev;
+	struct ThreadLog* next;
+};
 
 static FILE* logFile = NULL;
+static int logReady = 0;
+static int compressLog = 0;
+
+// Guards the log file and the list of thread logs. It is taken after the lock
+// of a thread log, except by HookFinalize, which only tries the latter.
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ThreadLog* threadLogs = NULL;
+static uint32_t nextThreadId = 0;
+static pthread_key_t threadLogKey;
+static __thread struct ThreadLog* threadLog = NULL;
 
 static char* getLogFileName(const char* dirName)
 {
 	const char* logName = "pts.log";
 	int size = strlen(logName) + strlen(dirName) + 2;
-	char* fileNameStr = malloc(size);
+	char* fileNameStr = (char*)malloc(size);
 	strcpy(fileNameStr, dirName);
 	strcat(fileNameStr, "/");
 	strcat(fileNameStr, logName);
@@ -31,6 +65,7 @@ static void panic(const char* fmt, ...)
 
 	if (logFile != NULL)
 		fclose(logFile);
+	logFile = NULL;
 	exit(-1);
 }
 
@@ -42,49 +77,214 @@ static void openLogFile(const char* dirName)
 	if (logFile == NULL)
 		panic("Log file \'%s\' open failed.\n", logFileName);
 	free(logFileName);
+
+	struct LogFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+	header.version = LOG_VERSION;
+	if (fwrite(&header, sizeof(header), 1, logFile) != 1)
+		panic("Log write error\n");
+}
+
+// Compresses the buffer of log if asked to, and fills in the block header.
+// Returns the data to write.
+static const unsigned char* packBlock(struct ThreadLog* log, struct LogBlockHeader* header)
+{
+	header->threadId = log->threadId;
+	header->flags = 0;
+	header->rawSize = log->size;
+	header->storedSize = log->size;
+
+#ifdef DYNAA_ZLIB
+	if (compressLog)
+	{
+		uLongf compressedSize = log->compressCapacity;
+		if (compress2(log->compressBuffer, &compressedSize, log->buffer, log->size, Z_BEST_SPEED) == Z_OK &&
+		    compressedSize < log->size)
+		{
+			header->flags |= LOG_BLOCK_COMPRESSED;
+			header->storedSize = compressedSize;
+			return log->compressBuffer;
+		}
+	}
+#endif
+	return log->buffer;
 }
 
-static void writeData(void* data, size_t size)
+// Must be called with logLock held. Returns 0 on write errors.
+static int writeBlock(const struct LogBlockHeader* header, const unsigned char* data)
 {
-	size_t numBytesWritten = fwrite(data, size, 1, logFile);
-	if (numBytesWritten != 1)
+	// the records logged after HookFinalize are dropped
+	if (logFile == NULL)
+		return 1;
+	return fwrite(header, sizeof(*header), 1, logFile) == 1 &&
+		fwrite(data, header->storedSize, 1, logFile) == 1;
+}
+
+static void resetThreadLog(struct ThreadLog* log)
+{
+	// the addresses are delta-encoded from the start of each block
+	log->size = 0;
+	log->lastAddress = 0;
+}
+
+// Must be called with the lock of log held
+static void flushThreadLog(struct ThreadLog* log)
+{
+	if (log->size == 0)
+		return;
+
+	// compress outside the lock so that the threads only wait for each other's writes
+	struct LogBlockHeader header;
+	const unsigned char* data = packBlock(log, &header);
+	pthread_mutex_lock(&logLock);
+	int succ = writeBlock(&header, data);
+	pthread_mutex_unlock(&logLock);
+	if (!succ)
 		panic("Log write error\n");
+	resetThreadLog(log);
+}
+
+static void releaseThreadLog(void* p)
+{
+	struct ThreadLog* log = (struct ThreadLog*)p;
+	pthread_mutex_lock(&log->lock);
+	flushThreadLog(log);
+	pthread_mutex_unlock(&log->lock);
+
+	pthread_mutex_lock(&logLock);
+	if (log->prev != NULL)
+		log->prev->next = log->next;
+	else
+		threadLogs = log->next;
+	if (log->next != NULL)
+		log->next->prev = log->prev;
+	pthread_mutex_unlock(&logLock);
+
+	pthread_mutex_destroy(&log->lock);
+	free(log->buffer);
+	free(log->compressBuffer);
+	free(log);
+	// the hooks in later destructors of the thread start a new log
+	threadLog = NULL;
+}
+
+static struct ThreadLog* getThreadLog()
+{
+	if (threadLog != NULL)
+		return threadLog;
+
+	struct ThreadLog* log = (struct ThreadLog*)calloc(1, sizeof(struct ThreadLog));
+	if (log == NULL || (log->buffer = (unsigned char*)malloc(LOG_BUFFER_SIZE)) == NULL)
+		panic("Log buffer allocation failed\n");
+#ifdef DYNAA_ZLIB
+	if (compressLog)
+	{
+		log->compressCapacity = compressBound(LOG_BUFFER_SIZE);
+		log->compressBuffer = (unsigned char*)malloc(log->compressCapacity);
+		if (log->compressBuffer == NULL)
+			panic("Log buffer allocation failed\n");
+	}
+#endif
+	pthread_mutex_init(&log->lock, NULL);
+
+	pthread_mutex_lock(&logLock);
+	log->threadId = nextThreadId++;
+	log->next = threadLogs;
+	if (threadLogs != NULL)
+		threadLogs->prev = log;
+	threadLogs = log;
+	pthread_mutex_unlock(&logLock);
+
+	// flush the buffer when the thread exits
+	pthread_setspecific(threadLogKey, log);
+	threadLog = log;
+	return log;
+}
+
+static unsigned char* writeVarint(unsigned char* p, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+static unsigned char* writeAddress(struct ThreadLog* log, unsigned char* p, void* address)
+{
+	// the addresses logged one after another are mostly close to each other
+	uintptr_t addr = (uintptr_t)address;
+	int64_t delta = (int64_t)(addr - log->lastAddress);
+	log->lastAddress = addr;
+	return writeVarint(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
 }
 
 static void writeLogRecord(struct LogRecord* rec)
 {
-	assert(logFile != NULL && rec != NULL);
-	char type = rec->type;
-	writeData(&type, sizeof(char));
+	assert(logReady && rec != NULL);
+	struct ThreadLog* log = getThreadLog();
+	pthread_mutex_lock(&log->lock);
+	if (log->size + LOG_MAX_RECORD_SIZE > LOG_BUFFER_SIZE)
+		flushThreadLog(log);
+
+	unsigned char* p = log->buffer + log->size;
+	*p++ = (unsigned char)rec->type;
 	switch (rec->type)
 	{
 		case TAllocRec:
-			writeData(&rec->allocRecord.type, sizeof(char));
-			writeData(&rec->allocRecord.id, sizeof(unsigned));
-			writeData(&rec->allocRecord.address, sizeof(void*));
+			*p++ = (unsigned char)rec->allocRecord.type;
+			p = writeVarint(p, rec->allocRecord.id);
+			p = writeAddress(log, p, rec->allocRecord.address);
 			break;
 		case TPointerRec:
-			writeData(&rec->ptrRecord.id, sizeof(unsigned));
-			writeData(&rec->ptrRecord.address, sizeof(void*));
+			p = writeVarint(p, rec->ptrRecord.id);
+			p = writeAddress(log, p, rec->ptrRecord.address);
 			break;
 		case TEnterRec:
-			writeData(&rec->enterRecord.id, sizeof(unsigned));
+			p = writeVarint(p, rec->enterRecord.id);
 			break;
 		case TExitRec:
-			writeData(&rec->exitRecord.id, sizeof(unsigned));
+			p = writeVarint(p, rec->exitRecord.id);
 			break;
 		case TCallRec:
-			writeData(&rec->callRecord.id, sizeof(unsigned));
+			p = writeVarint(p, rec->callRecord.id);
 			break;
 		default:
 			panic("Illegal record type\n");
 	}
+	log->size = p - log->buffer;
+	pthread_mutex_unlock(&log->lock);
 }
 
 extern void HookFinalize()
 {
-	assert(logFile != NULL);
-	fclose(logFile);
+	// The threads still running at exit lose the records they log later, and
+	// the buffers of the threads busy logging now are skipped: waiting for
+	// them could deadlock, as a flushing thread waits for logLock
+	pthread_mutex_lock(&logLock);
+	int succ = 1;
+	for (struct ThreadLog* log = threadLogs; log != NULL; log = log->next)
+	{
+		if (pthread_mutex_trylock(&log->lock) != 0)
+			continue;
+		if (log->size != 0)
+		{
+			struct LogBlockHeader header;
+			const unsigned char* data = packBlock(log, &header);
+			succ &= writeBlock(&header, data);
+			resetThreadLog(log);
+		}
+		pthread_mutex_unlock(&log->lock);
+	}
+	if (logFile != NULL)
+		fclose(logFile);
+	logFile = NULL;
+	pthread_mutex_unlock(&logLock);
+	if (!succ)
+		panic("Log write error\n");
 }
 
 extern void HookInit()
@@ -94,10 +294,21 @@ extern void HookInit()
 	if (logDirEnv != NULL)
 		logDirName = logDirEnv;
 
+	const char* compressEnv = getenv("LOG_COMPRESS");
+	compressLog = compressEnv != NULL && strcmp(compressEnv, "0") != 0;
+#ifndef DYNAA_ZLIB
+	if (compressLog)
+		fprintf(stderr, "The runtime is built without zlib, the log is not compressed.\n");
+	compressLog = 0;
+#endif
+
 	int r = mkdir(logDirName, 0755);
 	if (r == -1 && errno != EEXIST)
 		panic("Log directory \'%s\' creation failed.\n", logDirName);
 	openLogFile(logDirName);
+	if (pthread_key_create(&threadLogKey, releaseThreadLog) != 0)
+		panic("Thread log key creation failed.\n");
+	logReady = 1;
 	atexit(HookFinalize);
 }
 
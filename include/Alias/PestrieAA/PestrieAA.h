@@ -0,0 +1,66 @@
+#ifndef ALIAS_PESTRIEAA_PESTRIEAA_H
+#define ALIAS_PESTRIEAA_PESTRIEAA_H
+
+#include "Alias/PointerAnalysisInterface.h"
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class AndersenAAResult;
+class DyckAliasAnalysis;
+class IQuery;
+
+namespace lotus {
+
+/// Alias queries answered by a Pestrie index of the points-to relation
+/// computed by another pointer analysis.
+///
+/// The points-to sets of the pointer values of the module are exported once
+/// into an in-memory Pestrie index, so an alias query is a lookup in the index
+/// instead of an intersection of points-to sets, and the aliases of a pointer
+/// are listed without scanning all the pointers.
+class PestrieAAResult : public PointerAnalysisResult {
+public:
+  /// Fills the abstract objects pointed to by a pointer, identified by any
+  /// address. Returns false if the analysis knows nothing about the pointer.
+  using PointsToFunc =
+      std::function<bool(const Value *, std::vector<const void *> &)>;
+
+  PestrieAAResult(const Module &M, const PointsToFunc &PointsTo);
+  ~PestrieAAResult() override;
+
+  /// Index the points-to sets of Andersen's analysis
+  static std::unique_ptr<PestrieAAResult>
+  fromAndersen(const Module &M, const AndersenAAResult &AA);
+
+  /// Index the alias sets of DyckAA, each an abstract object
+  static std::unique_ptr<PestrieAAResult> fromDyckAA(const Module &M,
+                                                     DyckAliasAnalysis &AA);
+
+  AliasResult alias(const MemoryLocation &LocA,
+                    const MemoryLocation &LocB) override;
+  using PointerAnalysisResult::alias;
+
+  /// The indexed pointers that may alias \p V, including \p V. Returns false
+  /// if \p V is not indexed, i.e. it may alias anything.
+  bool getAliases(const Value *V, std::vector<const Value *> &Aliases);
+
+  unsigned getNumPointers() const { return Pointers.size(); }
+  unsigned getNumObjects() const { return NumObjects; }
+
+private:
+  /// The index of \p V, -1 if it is not indexed
+  int getPointerId(const Value *V) const;
+
+  std::vector<const Value *> Pointers;
+  DenseMap<const Value *, int> PointerIds;
+  unsigned NumObjects = 0;
+  std::unique_ptr<IQuery> Index;
+};
+
+} // namespace lotus
+
+#endif // ALIAS_PESTRIEAA_PESTRIEAA_H
@@ -5,10 +5,41 @@
 #ifndef CS_INDEXING_ABSTRACTQUERY_H
 #define CS_INDEXING_ABSTRACTQUERY_H
 
+#include <cstddef>
+#include <vector>
+
 class AbstractQuery {
 public:
+    virtual ~AbstractQuery() = default;
+
     virtual bool reach(int src, int dst) = 0;
 
+    // One-to-many: result[i] is whether dsts[i] is reachable from src
+    virtual void reachMany(int src, const std::vector<int> &dsts, std::vector<bool> &result) {
+        result.assign(dsts.size(), false);
+        for (size_t i = 0; i < dsts.size(); i++) {
+            reset();
+            result[i] = reach(src, dsts[i]);
+        }
+    }
+
+    // Set-to-set: whether a vertex of srcs reaches a vertex of dsts
+    virtual bool reachAny(const std::vector<int> &srcs, const std::vector<int> &dsts) {
+        for (int src : srcs) {
+            for (int dst : dsts) {
+                reset();
+                if (reach(src, dst))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether the queries may run concurrently on this object
+    virtual bool threadSafe() const {
+        return false;
+    }
+
     virtual const char *method() const = 0;
 
     virtual void reset() = 0;
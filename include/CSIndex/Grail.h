@@ -10,6 +10,7 @@ or their institutions liable under any circumstances.
 #include "AbstractQuery.h"
 #include "ExceptionList.h"
 #include "GraphUtil.h"
+#include "IndexFile.h"
 
 // test switch
 #define _TEST_
@@ -27,17 +28,21 @@ class Grail : public AbstractQuery {
 		int POOLSIZE;
 		unsigned int PositiveCut, NegativeCut, TotalCall, TotalDepth, CurrentDepth;
 	public:
-		Grail(Graph& graph, int dim, int labelingType, bool POOL, int POOLSIZE);
+		// the labelings are computed on threads threads, or on as many threads as cores if threads is 0,
+		// except the custom ones (labelingType >= 2) which depend on each other
+		Grail(Graph& graph, int dim, int labelingType, bool POOL, int POOLSIZE, int threads = 0);
+		// restores the labels saved by save() instead of computing them
+		Grail(Graph& graph, const IndexFile& file);
 		~Grail();
-		static int visit(Graph& tree, int vid, int& pre_post, vector<bool>& visited);
-		static int fixedreversevisit(Graph& tree, int vid, int& pre_post, vector<bool>& visited,int traversal);
-		static int customvisit(Graph& tree, int vid, int& pre_post, vector<bool>& visited, int traversal);
-		static void randomlabeling(Graph& tree);
-		static void customlabeling(Graph& tree, int traversal);
-		static void fixedreverselabeling(Graph& tree, int traversal);
-		static void setIndex(Graph& tree, int traversal); 
+		static void randomlabeling(Graph& tree, int d, unsigned seed);
+		static void customlabeling(Graph& tree, int d);
+		static void fixedreverselabeling(Graph& tree, int d, const vector<int>& index);
+		static vector<int> fixedIndex(int n, int traversal, unsigned seed);
 		static void setCustomIndex(Graph& tree, int traversal, int type); 
 
+		void save(IndexFile::Writer& file);
+		static bool canLoad(Graph& graph, int dim, const IndexFile& file);
+
 		void set_level_filter(bool lf);
 		//bool reach(int src, int trg, ExceptionList * el = nullptr);
 		bool reach_lf(int src, int trg, ExceptionList * el);
@@ -50,7 +55,9 @@ class Grail : public AbstractQuery {
 		bool go_for_reach(int src, int trg);
 		bool go_for_reach_lf(int src, int trg);
 		bool go_for_reachPP(int src, int trg);
+		// an iterative traversal with per-thread state, see threadSafe()
 		bool go_for_reachPP_lf(int src, int trg);
+		bool search(const int* srcs, size_t num_srcs, int trg);
 		bool contains(int src, int trg);
 		int containsPP(int src, int trg);
 
@@ -59,6 +66,16 @@ public:
         return reachPP_lf(src, dst, nullptr);
     }
 
+    // decides the targets from the labels of src, then searches the others, skipping those reached by a reachable target
+    void reachMany(int src, const vector<int> &dsts, vector<bool> &result) override;
+
+    // one search from all srcs for each target
+    bool reachAny(const vector<int> &srcs, const vector<int> &dsts) override;
+
+    bool threadSafe() const override {
+        return true;
+    }
+
     const char *method() const override {
         return "Grail";
     }
@@ -0,0 +1,109 @@
+#ifndef _INDEX_FILE_H_
+#define _INDEX_FILE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+
+using namespace std;
+
+// A versioned binary file of reachability indexes, e.g. GRAIL labels,
+// backbones and path-tree labels, keyed by a hash of the graph they index.
+//
+// The file is a header, a table of sections and the sections, each an array of
+// 32-bit integers. The file is memory-mapped on load: open() checks the header,
+// the key and the checksums of the sections, and the indexes are then read in
+// place from the mapping instead of being rebuilt.
+class IndexFile {
+public:
+    enum SectionKind : uint32_t {
+        GRAIL_LABELS = 1,       // Grail
+        BACKBONE_GATES,         // Query: backbone vertices
+        BACKBONE_GRAPH,         // Query: gate graph
+        PATHTREE_LABELS,        // Query: path-tree index of the gate graph
+        PATHTREE_GRAIL_LABELS,  // Query: GRAIL labels of the indexed graph
+    };
+
+    static const uint32_t VERSION = 1;
+
+    // Reads the integers of a section in order
+    class Reader {
+    private:
+        const int32_t *cur;
+        const int32_t *end;
+
+    public:
+        Reader(const int32_t *begin, const int32_t *end) : cur(begin), end(end) {}
+
+        int32_t next() {
+            assert(cur < end);
+            return *cur++;
+        }
+
+        bool done() const { return cur == end; }
+    };
+
+    // Collects the sections of a new file
+    class Writer {
+    private:
+        vector<pair<uint32_t, vector<int32_t> > > sections;
+
+    public:
+        // The integers of a new section
+        vector<int32_t> &add(uint32_t kind);
+
+        // Copies a section of an open file
+        void copy(const IndexFile &file, uint32_t kind);
+
+        // Writes a temporary file renamed to path, so a file being read is
+        // never overwritten
+        bool write(const string &path, uint64_t key) const;
+    };
+
+    IndexFile();
+
+    ~IndexFile();
+
+    IndexFile(const IndexFile &) = delete;
+
+    IndexFile &operator=(const IndexFile &) = delete;
+
+    // Maps the file. Fails if it is not a valid file of this version and key.
+    bool open(const string &path, uint64_t key);
+
+    bool has(uint32_t kind) const;
+
+    Reader section(uint32_t kind) const;
+
+    size_t sectionBytes(uint32_t kind) const;
+
+    // The hash of the vertices and edges of g
+    static uint64_t hashGraph(Graph &g);
+
+    static uint64_t combine(uint64_t h, uint64_t v);
+
+private:
+    struct SectionEntry {
+        uint32_t kind;
+        uint32_t reserved;
+        uint64_t offset;    // in bytes, from the start of the file
+        uint64_t count;     // of integers
+        uint64_t checksum;
+    };
+
+    void close();
+
+    const SectionEntry *find(uint32_t kind) const;
+
+    void *base;
+    size_t length;
+    const SectionEntry *entries;
+    uint32_t num_entries;
+};
+
+#endif
@@ -148,6 +148,38 @@ class PathtreeQuery: public Query {
 		outvisit = 0;
 	}
 		
+	// restores the backbone, the path-tree index and the GRAIL labels from file, see Query::saveIndex()
+	PathtreeQuery(const IndexFile& file, Graph& ig, int _r, double _ps, bool mat, double *grail_label_duration):
+			Query(file, ig, _r, _ps, mat) {
+		dim=grail_dim;
+		method_name = "PATHTREE";
+		GraphUtil::topological_sort(g,topoid);
+		struct timeval after_time, before_time;
+		float query_time = 0;
+		gettimeofday(&before_time, NULL);
+		if (graillabels.empty())
+			computeMultiLabelsQuickRej(dim); // actually call mutipleLabeling()
+		else
+			useGlobalMultiLabels = true;
+		if (mat) {
+			initMaterialization();
+		}
+		gettimeofday(&after_time, NULL);
+		query_time = (after_time.tv_sec - before_time.tv_sec)*1000.0 +
+					 (after_time.tv_usec - before_time.tv_usec)*1.0/1000.0;
+		*grail_label_duration = query_time;
+		sortLoutDFSorder();
+		labelconversion();
+
+		// for statistics
+		qnum = 0;
+		totalingates = 0;
+		checkoutgates = 0;
+		comparenum = 0;
+		invisit = 0;
+		outvisit = 0;
+	}
+
 		~PathtreeQuery() {
 			delete out_uncover;
 			cout << "average ingates size=" << (1.0*totalingates)/(qnum*1.0) << endl;
@@ -3,6 +3,7 @@
 
 #include "AbstractQuery.h"
 #include "GraphUtil.h"
+#include "IndexFile.h"
 
 #define COMPACTVECTOR
 
@@ -49,6 +50,9 @@ public:
 
     Query(const char *filestem, Graph &ig, int _r, double _ps, bool mat);
 
+    // restores the gates, the gate graph and the index saved by saveIndex() instead of reading the files of filestem
+    Query(const IndexFile &file, Graph &ig, int _r, double _ps, bool mat);
+
     Query(const char *gatefile, const char *ggfile, const char *indexfile, const char *grafile);
 
     virtual ~Query();
@@ -63,6 +67,19 @@ public:
 
     virtual void initIndex(const char *indexfile);
 
+    void loadGates(IndexFile::Reader in);
+
+    void loadGateGraph(IndexFile::Reader in);
+
+    void loadIndex(IndexFile::Reader in);
+
+    void loadMultiLabels(IndexFile::Reader in);
+
+    // stores the gates, the gate graph, the index and the GRAIL labels into sections of file
+    virtual void saveIndex(IndexFile::Writer &file);
+
+    static bool canLoad(const IndexFile &file);
+
     void outIndex(const char *out_index_file);
 
     void setMethodName(string _method_name);
@@ -14,43 +14,85 @@
 #ifndef _TABULATION_H
 #define _TABULATION_H
 
-#include <map>
-#include <set>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "AbstractQuery.h"
 #include "Graph.h"
 
+/// Context-sensitive reachability on a value-flow graph whose call edges are
+/// labeled by positive and return edges by negative call-site ids.
+///
+/// A query traverses the graph in two phases: before any unmatched call,
+/// returns can be taken; after it, only the returns matched by a call. Matched
+/// calls are crossed by summary edges from an actual-in to an actual-out
+/// vertex, computed on demand by an IFDS-style tabulation of the same-level
+/// paths of the callee and cached across queries, so repeated queries on the
+/// same graph only pay for the functions they have not reached yet.
 class Tabulation : public AbstractQuery {
 private:
     Graph &vfg;
-    std::set<int> visited;
-    std::set<int> func_visited;
+    std::vector<std::vector<int>> labels;   // of the out edges of each vertex
+
+    // per-query state: a vertex was visited in a phase iff its stamp is the current one
+    std::vector<unsigned> visited;      // 2 * vertex + phase
+    unsigned stamp = 0;
+    std::vector<std::pair<int, int>> stack;
+
+    // the same-level tabulation, persistent across queries
+    struct Incoming {
+        int entry;      // of the caller
+        int call;       // the actual-in vertex
+        int label;
+    };
+    struct Exit {
+        int ret;        // the actual-out vertex
+        int label;
+    };
+    std::unordered_set<uint64_t> path_edges;    // entry -> vertex by a same-level path
+    std::vector<std::pair<int, int>> work_list;
+    std::vector<std::vector<Incoming>> incoming;    // by entry
+    std::vector<std::vector<Exit>> exits;           // by entry
+
+    // the summary edges of an actual-in vertex, cached once computed
+    std::vector<std::vector<int>> summaries;
+    std::vector<bool> summarized;
+
+    void begin_query();
+
+    bool visit(int v, int phase);
+
+    void propagate(int entry, int v);
+
+    void tabulate();
+
+    const std::vector<int> &summary_edges(int v);
 
 public:
     explicit Tabulation(Graph &g);
 
     bool reach(int s, int t) override;
 
-    bool reach_func(int s, int t);
-
     bool is_call(int s, int t);
 
     bool is_return(int s, int t);
 
     double tc();
 
-    void traverse(int s, std::set<int> &tc);
+    /// The vertices reachable from s
+    void traverse(int s, std::vector<int> &tc);
 
-    void traverse_func(int s, std::set<int> &tc);
+    /// The number of summary edges computed so far
+    size_t summary_edge_size() const;
 
     const char *method() const override {
         return "Tabulate";
     }
 
-    void reset() override {
-        visited.clear();
-        func_visited.clear();
-    }
+    /// Queries do not share their visited vertices, only the summary edges
+    void reset() override {}
 };
 
 #endif //_TABULATION_H
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+#include <mutex>
+#include "Analyzer.h"
+#include "EHBlockDetector.h"
+
+using namespace std;
+using namespace llvm;
+
+// Persistent cache of the error specification inference, stored in a versioned binary file.
+//
+// Modules are identified by their path and the hash of their contents. The cache holds:
+//  - the targets of the indirect calls found by MLTA,
+//  - the error handling blocks (stage 0 of the EHBlockDetector) of every module,
+//  - the inferred error return intervals and their confidences.
+// MLTA and the specification are whole-program results: they are only reused if no module and no option changed.
+// The error handling blocks of a module are reused if the module didn't change, and neither did the callees of its
+// calls or the set of functions that are analysed, which are the only facts stage 0 takes from the other modules.
+// Note that the call graph keeps one copy of functions defined in several modules, chosen by the order the modules are
+// visited in, so modules with such definitions may be analysed again.
+class AnalysisCache {
+public:
+    AnalysisCache(GlobalContext& Ctx, const StringMap<uint64_t>& moduleHashes);
+
+    bool load(StringRef path);
+    bool save(StringRef path);
+
+    // Whether all modules and options are the same as in the cached run.
+    bool isProgramUnchanged() const;
+
+    bool restoreIndirectCallees(const CallInst* call, FuncSet& callees) const;
+    bool restoreErrorHandlingBlocks(const Module* M, map<const AbstractComparison*, SafetyCheckData>& safetyChecks, map<const Function*, InErrorNotInErrorPair>& inErrorNotInErrorCounts);
+    void recordErrorHandlingBlocks(const Module* M, const map<const AbstractComparison*, SafetyCheckData>& safetyChecks, const map<const Function*, InErrorNotInErrorPair>& inErrorNotInErrorCounts);
+    bool restoreErrorHandlingRules();
+
+    static constexpr uint32_t version = 1;
+
+private:
+    struct FunctionRef {
+        string modulePath;
+        string name;
+    };
+
+    struct IndirectCallRecord {
+        uint32_t functionIndex, instructionIndex;
+        vector<FunctionRef> callees;
+    };
+
+    struct SafetyCheckRecord {
+        uint32_t functionIndex, conditionIndex, blockIndex;
+        SafetyCheckData data;
+    };
+
+    struct CountRecord {
+        FunctionRef function;
+        InErrorNotInErrorPair counts;
+    };
+
+    struct ModuleRecord {
+        uint64_t contentHash {}, fingerprint {};
+        bool hasIndirectCalls = false;
+        vector<IndirectCallRecord> indirectCalls;
+        bool hasErrorHandlingBlocks = false;
+        vector<SafetyCheckRecord> safetyChecks;
+        vector<CountRecord> counts;
+    };
+
+    struct IntervalRecord {
+        FunctionRef function;
+        uint32_t index;
+        Interval interval;
+    };
+
+    struct ConfidenceRecord {
+        FunctionRef function;
+        uint32_t index;
+        float confidence;
+    };
+
+    llvm::Optional<FunctionRef> refFor(const Function* F) const;
+    Function* resolve(const FunctionRef& ref) const;
+    uint64_t fingerprint(const Module* M) const;
+    void resolveIndirectCallees();
+
+    GlobalContext& Ctx;
+    const StringMap<uint64_t>& moduleHashes;
+    uint64_t optionsHash, programHash;
+    StringMap<Module*> modulesByPath;
+
+    bool loaded = false;
+    uint64_t loadedProgramHash = 0;
+    StringMap<ModuleRecord> cachedModules;
+    bool hasErrorHandlingRules = false;
+    vector<IntervalRecord> cachedIntervals;
+    vector<ConfidenceRecord> cachedConfidences;
+    bool indirectCalleesResolved = false;
+    DenseMap<const CallInst*, vector<Function*>> indirectCallees;
+
+    // Error handling blocks of this run, stored on save. Stage 0 runs concurrently on the modules.
+    mutex recordsMutex;
+    StringMap<ModuleRecord> records;
+};
@@ -75,6 +75,9 @@ struct GlobalContext {
 
     map<const Module*, AAResultsWrapperPass*> AAPass;
 
+    // Results of a previous run, if a cache file is given.
+    class AnalysisCache* Cache = nullptr;
+
     // Error handling rules
     struct ErrorHandlingRules {
         map<const Function*, vector<pair<pair<const Value*, unsigned int>, const class AbstractCondition*>>> functionToSanityValuesAndConditions;
@@ -3,6 +3,8 @@
 #include "Analyzer.h"
 #include "Common.h"
 #include "PathSpan.h"
+#include <llvm/ADT/DenseSet.h>
+#include <deque>
 
 
 enum class OperationType : unsigned char {
@@ -71,6 +73,53 @@ struct SafetyCheckData {
     unsigned short sumOfCondBrCount {numeric_limits<unsigned short>::max()};
 };
 
+// Collects the paths from a block to the end(s) of a function, in the same order as a depth-first enumeration.
+// The suffixes of the paths that start in a block outside of any loop don't depend on the path that led there,
+// so they are computed once per (block, last conditional fork) over the DAG of SCCs and shared between all the
+// collect calls on the same function. Suffixes are stored as linked lists that share their tails.
+//
+// A block keeps at most maxSuffixesPerBlock suffixes, so that the work is linear in the size of the acyclic
+// regions. Beyond that, the suffixes are abstracted by the facts that the detector reads from a path: the
+// blocks that have operations to summarise or values to resolve. Of the suffixes with the same facts, only the
+// shortest is kept, and if there are still too many, the shortest ones are kept.
+class PathCollector {
+public:
+    PathCollector(const Function& function, const set<const BasicBlock*>& basicBlocksOfNonInterest);
+
+    void collect(const BasicBlock* currentBlock, vector<Path*>& allPaths, Path* myCurrentPath);
+
+    static constexpr size_t maxSuffixesPerBlock = 1024;
+
+private:
+    struct SuffixNode {
+        const BasicBlock* block;
+        const SuffixNode* next;
+        unsigned int length;
+        // Number and hash of the blocks with facts in the suffix
+        unsigned int factLength;
+        size_t factHash;
+    };
+    // The first suffix continues the current path, the others fork new paths. A null suffix is an empty one.
+    using Suffixes = vector<const SuffixNode*>;
+
+    const Suffixes* suffixes(const BasicBlock* currentBlock, const BasicBlock* lastBr, bool isFirst);
+    const SuffixNode* prepend(const BasicBlock* block, const SuffixNode* suffix);
+    static void append(Path* path, const SuffixNode* suffix);
+    void abstract(Suffixes& result);
+    bool sameFacts(const SuffixNode* a, const SuffixNode* b) const;
+
+    const set<const BasicBlock*>& basicBlocksOfNonInterest;
+    DenseSet<const BasicBlock*> acyclicBlocks;
+    // Blocks whose presence on a path can change a summary or a resolved value
+    DenseSet<const BasicBlock*> factBlocks;
+    set<const BasicBlock*> visited;
+    DenseMap<pair<const BasicBlock*, const BasicBlock*>, const Suffixes*> memo;
+    deque<SuffixNode> nodes;
+    deque<Suffixes> lists;
+    // Set when suffixes were dropped since the last collect call
+    bool abstracted = false;
+};
+
 class EHBlockDetectorPass : public IterativeModulePass {
 
 public:
@@ -97,7 +146,6 @@ private:
 
     Summary summarizeBlock(const BasicBlock* currentBlock) const;
     void identifyPotentialSanityChecks(const Function& function);
-    static void collectPathsAux(const BasicBlock* currentBlock, vector<Path*>& allPaths, Path* myCurrentPath, set<const BasicBlock*>& visited, set<const BasicBlock*>& basicBlocksOfNonInterest, const BasicBlock* lastBr);
     const BasicBlock* determineSuccessorOfAbstractComparisonWhichHandlesErrors(const AbstractComparison* abstractComparison) const;
     const BasicBlock* determineSuccessorOfAbstractComparisonWhichHandlesErrors(const BasicBlock* abstractComparisonBlock) const;
     llvm::Optional<Interval> addForSpanAndReturnInstruction(PathSpan pathSpan, const ReturnInst* returnInstruction);
@@ -106,6 +154,8 @@ private:
     FunctionToIntervalCounts functionToIntervalCounts;
     map<const Module*, map<const AbstractComparison*, SafetyCheckData>> moduleToSafetyChecks;
     map<const AbstractComparison*, pair<const Value*, unsigned int>> conditionalToAction;
+    // Guards the results above when stage 0 runs concurrently on the modules.
+    mutex resultsMutex;
     set<const Function*> associatedErrorHandlerFunctions;
     int stage = 0;
 };
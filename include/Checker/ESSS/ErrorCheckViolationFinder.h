@@ -2,6 +2,8 @@
 
 #include "Analyzer.h"
 #include "Common.h"
+#include "FunctionErrorReturnIntervals.h"
+#include <functional>
 
 class ErrorCheckViolationFinderPass : public IterativeModulePass {
 public:
@@ -16,8 +18,7 @@ public:
     void stage0(Module*);
     void stage1(Module*);
 
-    void determineMissingChecksAndPropagationRules(const Function& function, const FunctionErrorReturnIntervals& inputErrorIntervals, FunctionErrorReturnIntervals& outputErrorIntervals, set<const Function*>& functionsToInspectNext, unordered_set<uintptr_t>& handledFunctionPairs, map<pair<const Function*, unsigned int>, Interval>& replaceMap);
-    void determineIncorrectChecks(const Function& function);
+    void determineMissingChecksAndPropagationRules(const vector<const Function*>& functions, FunctionErrorReturnIntervals& outputErrorIntervals, set<const Function*>& functionsToInspectNext, unordered_set<uintptr_t>& handledFunctionPairs, map<pair<const Function*, unsigned int>, Interval>& replaceMap);
     void determineTruncationBugs() const;
     void determineSignednessBugs() const;
     void performReplaces(map<pair<const Function*, unsigned int>, Interval>& replaceMap);
@@ -29,6 +30,28 @@ private:
         const CallInst* call;
     };
 
+    // What the inspection of a single function found. Functions are inspected in parallel on the ThreadPool,
+    // each into its own report, and the reports are merged in the order of the functions afterwards.
+    struct FunctionReport {
+        // Stage 0
+        FunctionErrorReturnIntervals outputErrorIntervals;
+        map<pair<const Function*, unsigned int>, Interval> replaceMap;
+        map<pair<const Function*, unsigned int>, float> confidences;
+        vector<const Function*> callers;
+        vector<pair<const CallInst*, bool>> uncheckedCalls; // Whether the call flows into a check elsewhere
+        unsigned int unknownConfidences = 0;
+        bool hasUnhandledErrorChecks = false;
+        // Stage 1
+        vector<IncorrectCheckErrorReport> incorrectChecks;
+        vector<const CallInst*> correctChecks;
+    };
+
+    void inspectFunctions(const vector<const Function*>& functions, vector<FunctionReport>& reports, const function<void(const Function&, FunctionReport&)>& inspect) const;
+    void determineMissingChecksAndPropagationRules(const Function& function, const FunctionErrorReturnIntervals& inputErrorIntervals, FunctionReport& report) const;
+    void determineIncorrectChecks(const Function& function, FunctionReport& report) const;
+    void recordUncheckedCall(const CallInst* call, bool flowsIntoCheck);
+    void recordIncorrectCheck(IncorrectCheckErrorReport&& incorrectCheck);
+
     struct CountPair {
         float incorrect = 0, total = 0;
 
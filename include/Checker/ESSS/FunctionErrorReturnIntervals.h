@@ -29,6 +29,7 @@ public:
         return intervalIt->second;
     }
 
+    // Lookups don't take a lock. They may run concurrently as long as no thread modifies the intervals.
     inline llvm::Optional<const Interval*> maybeIntervalFor(pair<const Function*, unsigned int> function) const {
         auto intervalIt = intervals.find(function);
         if (intervalIt == intervals.end())
@@ -75,6 +75,7 @@ public:
     std::string toString() const;
     Interval complement() const;
     int signedness() const;
+    const llvm::SmallVectorImpl<Range>& getRanges() const { return ranges; }
 
     bool operator==(const Interval& other) const;
 
@@ -11,6 +11,7 @@
 #include <llvm/ADT/SmallPtrSet.h>
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <string>
@@ -89,6 +90,41 @@ public:
     bool operator!=(const TaintState& other) const { return !(*this == other); }
 };
 
+// Sparse taint state of a function. Only the values that get tainted have
+// an entry, listing the taints they receive ordered by the position (in the
+// layout of the function) of the instruction that taints them. The state
+// at a program point is never copied; it is read on demand instead.
+class SparseTaintState {
+public:
+    struct TaintEvent {
+        unsigned position;          // Instruction that added the taint
+        unsigned removed;           // Instruction that removed it, or ~0U
+        TaintValue* taint;
+    };
+
+    // Positions start from 1; position 0 is the entry of the function
+    void setPosition(const llvm::Instruction* inst, unsigned position);
+    unsigned getPosition(const llvm::Instruction* inst) const;
+
+    void addTaint(llvm::Value* val, unsigned position, TaintValue* taint);
+    void removeTaint(llvm::Value* val, unsigned position);
+
+    // Taints of val once the instruction at position has added (or
+    // removed) its own. While that instruction is being analyzed, these are
+    // the taints it has seen so far.
+    bool isTainted(llvm::Value* val, unsigned position) const;
+    std::set<TaintValue*> getTaints(llvm::Value* val, unsigned position) const;
+
+    // Materialize the state right after the instruction at position
+    TaintState getState(unsigned position) const;
+
+    size_t getNumTaintedValues() const { return events.size(); }
+
+private:
+    llvm::DenseMap<const llvm::Instruction*, unsigned> positions;
+    llvm::DenseMap<llvm::Value*, std::vector<TaintEvent>> events;
+};
+
 // Configuration for taint analysis
 struct TaintConfig {
     // Source functions (function name -> source type)
@@ -106,6 +142,9 @@ struct TaintConfig {
     // Whether to track through function calls
     bool trackThroughCalls = true;
     
+    // Whether to apply the summaries of defined functions at call sites
+    bool interprocedural = false;
+    
     // Maximum depth for interprocedural analysis
     int maxCallDepth = 5;
     
@@ -130,12 +169,12 @@ struct TaintFlow {
 class TaintAnalysisResult {
 public:
     std::vector<TaintFlow> flows;
-    std::map<llvm::Function*, std::map<llvm::Instruction*, TaintState>> functionStates;
+    std::map<llvm::Function*, SparseTaintState> functionStates;
     std::set<TaintValue*> allTaints;
     
     void addFlow(const TaintFlow& flow);
     void addTaint(TaintValue* taint);
-    void setState(llvm::Function* func, llvm::Instruction* inst, const TaintState& state);
+    SparseTaintState& getFunctionState(llvm::Function* func);
     TaintState getState(llvm::Function* func, llvm::Instruction* inst) const;
     
     void printResults(llvm::raw_ostream& OS) const;
@@ -143,11 +182,46 @@ public:
     void printStatistics(llvm::raw_ostream& OS) const;
 };
 
+// Source-to-sink summary of a defined function, in terms of its parameters
+struct TaintSummary {
+    // Sinks reached by each parameter (possibly through callees)
+    std::map<unsigned, std::set<std::pair<llvm::Instruction*, TaintSinkType>>> paramToSinks;
+    
+    // Parameters that reach the return value
+    std::set<unsigned> paramToReturn;
+    
+    // Taints of sources in the function (or its callees) that are returned
+    std::set<TaintValue*> returnedTaints;
+    
+    // Taints created while computing the summary, freed with it
+    std::vector<std::unique_ptr<TaintValue>> taints;
+};
+
 // Main taint analysis engine
+//
+// The engine is sparse: starting from the source calls (and the arguments of
+// main), it only visits the users of tainted values, through def-use and
+// store/load edges. Instructions are visited in layout order through a
+// priority worklist, so each one is analyzed at most once, after all the
+// taints that can reach it are known.
 class TaintAnalysis {
 private:
     TaintConfig config;
     TaintAnalysisResult result;
+    std::map<llvm::Function*, TaintSummary> summaries;
+    
+    // Per-function analysis context
+    struct FunctionContext {
+        llvm::Function* func;
+        SparseTaintState& state;
+        std::vector<llvm::Instruction*> instructions;  // By position - 1
+        std::set<unsigned> worklist;                   // Positions
+        unsigned position = 0;                         // Current position
+        TaintSummary* summary = nullptr;               // Summary mode
+        std::map<TaintValue*, unsigned> paramTaints;   // Summary mode
+        
+        FunctionContext(llvm::Function* f, SparseTaintState& s) : func(f), state(s) {}
+    };
     
     // Helper methods
     bool isSourceFunction(const llvm::Function* func) const;
@@ -159,13 +233,18 @@ private:
     SanitizerType getSanitizerType(const llvm::Function* func) const;
     
     void analyzeFunction(llvm::Function* func);
-    void analyzeInstruction(llvm::Instruction* inst, TaintState& state);
-    void analyzeCallInstruction(llvm::CallInst* call, TaintState& state);
+    void computeSummaries(llvm::Module* M);
+    void runFunction(FunctionContext& ctx);
+    void analyzeInstruction(llvm::Instruction* inst, FunctionContext& ctx);
+    void analyzeCallInstruction(llvm::CallInst* call, FunctionContext& ctx);
+    void applySummary(llvm::CallInst* call, const TaintSummary& summary, FunctionContext& ctx);
     
-    void propagateTaint(llvm::Value* from, llvm::Value* to, TaintState& state);
-    void checkForTaintFlow(llvm::Instruction* inst, const TaintState& state);
+    void addTaint(llvm::Value* val, TaintValue* taint, FunctionContext& ctx);
+    void propagateTaint(llvm::Value* from, llvm::Value* to, FunctionContext& ctx);
+    void reportFlow(TaintValue* taint, llvm::Instruction* sink, TaintSinkType type, FunctionContext& ctx);
     
     TaintValue* createTaintValue(llvm::Value* val, TaintSourceType type, llvm::Instruction* loc, const std::string& desc);
+    void recordTaint(TaintValue* taint, FunctionContext& ctx);
     
 public:
     TaintAnalysis(const TaintConfig& cfg = TaintConfig()) : config(cfg) {
@@ -0,0 +1,106 @@
+#ifndef DATAFLOW_BITVECTORDATAFLOWRESULT_H_
+#define DATAFLOW_BITVECTORDATAFLOWRESULT_H_
+
+#include "Support/SystemHeaders.h"
+#include "Dataflow/Mono/DataFlowDomain.h"
+
+/*
+ * Meet operator of a dense data-flow analysis.
+ */
+enum class DataFlowMeet { Union, Intersection };
+
+/*
+ * Result of a data-flow analysis run in dense-ID mode.
+ *
+ * Values of the domain are numbered once through a DataFlowDomain, sets are
+ * word-packed bitvectors, and IN/OUT sets are stored per basic block only.
+ * The sets of single instructions are materialized lazily, on request, by
+ * replaying the GEN/KILL of the instructions of the block.
+ *
+ * IN/OUT always follow the program order (IN is before the instruction or
+ * block, OUT is after), regardless of the direction of the analysis.
+ */
+class BitVectorDataFlowResult {
+public:
+  /*
+   * Methods
+   */
+  BitVectorDataFlowResult(bool isForward);
+
+  DataFlowDomain &getDomain();
+
+  /*
+   * GEN/KILL of single instructions. They are meant to be used by the
+   * computeGEN and computeKILL callbacks of the engine.
+   */
+  void addGEN(Instruction *inst, Value *v);
+  void addKILL(Instruction *inst, Value *v);
+
+  std::set<Value *> GEN(Instruction *inst) const;
+  std::set<Value *> KILL(Instruction *inst) const;
+
+  /*
+   * Block-level sets computed by the engine.
+   */
+  BitVector &IN(BasicBlock *bb);
+  BitVector &OUT(BasicBlock *bb);
+
+  /*
+   * Instruction-level sets, materialized on demand.
+   */
+  std::set<Value *> IN(Instruction *inst) const;
+  std::set<Value *> OUT(Instruction *inst) const;
+
+  BitVector INBits(Instruction *inst) const;
+  BitVector OUTBits(Instruction *inst) const;
+
+  /*
+   * Apply the transfer function of an instruction in place:
+   * bits = GEN[inst] | (bits & ~KILL[inst])
+   */
+  void applyTransfer(Instruction *inst, BitVector &bits) const;
+
+  /*
+   * Precompose the transfers of the instructions of every block of "f",
+   * following the direction of the analysis, into a single block transfer.
+   * It must be called once all GEN/KILL have been recorded.
+   */
+  void computeBlockTransfers(Function *f);
+
+  /*
+   * Apply the precomposed transfer of a block in place:
+   * bits = GEN[bb] | (bits & ~KILL[bb])
+   */
+  void applyBlockTransfer(BasicBlock *bb, BitVector &bits) const;
+
+  bool isForward() const;
+
+  /*
+   * Number of basic blocks fetched from the working list by the engine.
+   */
+  unsigned getNumberOfIterations() const;
+  void setNumberOfIterations(unsigned n);
+
+private:
+  struct BlockTransfer {
+    BitVector gen;
+    BitVector kill;
+  };
+
+  struct InstructionTransfer {
+    SmallVector<unsigned, 2> gen;
+    SmallVector<unsigned, 2> kill;
+  };
+
+  bool forward;
+  DataFlowDomain domain;
+  std::unordered_map<Instruction *, InstructionTransfer> transfers;
+  std::unordered_map<BasicBlock *, BitVector> ins;
+  std::unordered_map<BasicBlock *, BitVector> outs;
+  std::unordered_map<BasicBlock *, BlockTransfer> blockTransfers;
+  unsigned iterations = 0;
+
+  std::set<Value *> toValueSet(const SmallVectorImpl<unsigned> &ids) const;
+};
+
+#endif // DATAFLOW_BITVECTORDATAFLOWRESULT_H_
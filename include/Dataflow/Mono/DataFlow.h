@@ -4,6 +4,8 @@
 #include "Support/SystemHeaders.h"
 
 #include "Dataflow/Mono/DataFlowResult.h"
+#include "Dataflow/Mono/DataFlowDomain.h"
+#include "Dataflow/Mono/BitVectorDataFlowResult.h"
 #include "Dataflow/Mono/DataFlowEngine.h"
 #include "Dataflow/Mono/DataFlowAnalysis.h"
 
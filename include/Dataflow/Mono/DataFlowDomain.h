@@ -0,0 +1,35 @@
+#ifndef DATAFLOW_DATAFLOWDOMAIN_H_
+#define DATAFLOW_DATAFLOWDOMAIN_H_
+
+#include "Support/SystemHeaders.h"
+
+/*
+ * Dense numbering of the values that belong to the domain of a data-flow
+ * analysis. Every value gets its ID the first time it is inserted; IDs are
+ * contiguous and start from 0 so they can index bitvectors directly.
+ */
+class DataFlowDomain {
+public:
+  /*
+   * Methods
+   */
+  DataFlowDomain();
+
+  unsigned getOrInsert(Value *v);
+
+  int getID(Value *v) const;
+
+  Value *getValue(unsigned id) const;
+
+  unsigned size() const;
+
+  std::set<Value *> toValueSet(const BitVector &bits) const;
+
+  BitVector toBitVector(const std::set<Value *> &values) const;
+
+private:
+  std::unordered_map<Value *, unsigned> ids;
+  std::vector<Value *> values;
+};
+
+#endif // DATAFLOW_DATAFLOWDOMAIN_H_
@@ -4,6 +4,7 @@
 
 #include "Support/SystemHeaders.h"
 #include "Dataflow/Mono/DataFlowResult.h"
+#include "Dataflow/Mono/BitVectorDataFlowResult.h"
 
 
 class DataFlowEngine {
@@ -67,6 +68,27 @@ public:
                          std::set<Value *> &OUT,
                          DataFlowResult *df)> computeOUT);
 
+  /*
+   * Dense-ID mode: GEN/KILL are recorded through
+   * BitVectorDataFlowResult::addGEN/addKILL, the values they mention are
+   * numbered once, and IN/OUT are word-packed bitvectors stored per basic
+   * block. The boundary (entry for forward, exits for backward) is the empty
+   * set.
+   */
+  BitVectorDataFlowResult *applyForwardDense(
+      Function *f,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)>
+          computeKILL,
+      DataFlowMeet meet);
+
+  BitVectorDataFlowResult *applyBackwardDense(
+      Function *f,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)>
+          computeKILL,
+      DataFlowMeet meet);
+
 protected:
   void computeGENAndKILL(
       Function *f,
@@ -75,6 +97,14 @@ protected:
       DataFlowResult *df);
 
 private:
+  BitVectorDataFlowResult *applyGeneralizedDenseAnalysis(
+      Function *f,
+      bool isForward,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+      std::function<void(Instruction *, BitVectorDataFlowResult *)>
+          computeKILL,
+      DataFlowMeet meet);
+
   DataFlowResult *applyGeneralizedForwardAnalysis(
       Function *f,
       std::function<void(Instruction *, DataFlowResult *)> computeGEN,
@@ -92,8 +122,7 @@ private:
       std::function<void(Instruction *inst,
                          std::set<Value *> &OUT,
                          DataFlowResult *df)> computeOUT,
-      std::function<void(std::list<BasicBlock *> &workingList, BasicBlock *bb)>
-          appendBB,
+      std::function<std::vector<BasicBlock *>(Function *f)> getBlockOrder,
       std::function<Instruction *(BasicBlock *bb)> getFirstInstruction,
       std::function<Instruction *(BasicBlock *bb)> getLastInstruction,
       std::function<std::set<Value *> &(DataFlowResult *df,
@@ -16,7 +16,14 @@ public:
   std::set<Value *> &IN(Instruction *inst);
   std::set<Value *> &OUT(Instruction *inst);
 
+  /*
+   * Number of basic blocks fetched from the working list by the engine.
+   */
+  unsigned getNumberOfIterations() const;
+  void setNumberOfIterations(unsigned n);
+
 private:
+  unsigned iterations = 0;
   std::map<Instruction *, std::set<Value *>> gens;
   std::map<Instruction *, std::set<Value *>> kills;
   std::map<Instruction *, std::set<Value *>> ins;
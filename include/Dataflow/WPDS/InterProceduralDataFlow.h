@@ -5,6 +5,7 @@
 #include "Dataflow/Mono/DataFlow.h"
 #include "Solvers/WPDS/WPDS.h"
 #include "Solvers/WPDS/CA.h"
+#include "Solvers/WPDS/MultiQuery.h"
 #include "Solvers/WPDS/semiring.h"
 #include "Solvers/WPDS/key_source.h"
 #include "Solvers/WPDS/keys.h"
@@ -13,10 +14,15 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace dataflow {
 
-// DataFlowFacts is the domain of our analysis
+// DataFlowFacts is the domain of our analysis. Facts are bitvectors over a
+// value numbering (DataFlowDomain) shared by all the facts of one analysis,
+// so set operations are word-wise instead of red-black tree merges.
+// Bitvectors are kept trimmed after their last set bit, which makes equal
+// sets have equal representations.
 class DataFlowFacts {
 public:
     DataFlowFacts();
@@ -35,8 +41,17 @@ public:
     static DataFlowFacts Diff(const DataFlowFacts& x, const DataFlowFacts& y);
     static bool Eq(const DataFlowFacts& x, const DataFlowFacts& y);
 
+    // Value numbering of the current analysis. The universe is the set of
+    // all the values numbered so far.
+    static DataFlowDomain& getDomain();
+
+    // Start a new numbering. Facts and transformers built before are
+    // meaningless afterwards, hence the transformer cache is flushed too.
+    static void resetDomain();
+
     // Get the underlying set of facts
-    const std::set<Value*>& getFacts() const;
+    std::set<Value*> getFacts() const;
+    const BitVector& getBits() const;
     void addFact(Value* val);
     void removeFact(Value* val);
     bool containsFact(Value* val) const;
@@ -47,22 +62,34 @@ public:
     std::ostream& print(std::ostream& os) const;
 
 private:
-    std::set<Value*> facts;
-    static std::set<Value*> universe;  // Used for UniverseSet
+    BitVector bits;
+
+    void trim();
 };
 
 // GenKillTransformer implements the semiring operations for gen/kill data flow problems
+//
+// Transformers built through makeGenKillTransformer are hash-consed: there
+// is a single instance per (kill, gen) pair, so equal() between two of them
+// is a pointer comparison and identical transformers are shared. The table
+// is locked, so the semiring operations can run on several threads.
 class GenKillTransformer {
 public:
     GenKillTransformer();
     GenKillTransformer(const DataFlowFacts& kill, const DataFlowFacts& gen);
     ~GenKillTransformer() = default;
 
-    // Factory method to ensure unique representatives for special values
+    // Factory method to ensure unique representatives
     static GenKillTransformer* makeGenKillTransformer(
         const DataFlowFacts& kill, 
         const DataFlowFacts& gen);
 
+    // Drop the references held by the hash-consing table
+    static void clearCache();
+
+    // Number of distinct transformers in the hash-consing table
+    static std::size_t cacheSize();
+
     // Semiring operations required by WPDS
     static GenKillTransformer* one();
     static GenKillTransformer* zero();
@@ -83,14 +110,17 @@ public:
     // Debug printing
     std::ostream& print(std::ostream& os) const;
 
-    // Reference counter for ref_ptr
-    int count;
+    // Reference counter for ref_ptr. It is atomic since transformers are
+    // shared by the queries that MultiQuery saturates concurrently.
+    AtomicRefCounter count;
 
 private:
     DataFlowFacts kill;
     DataFlowFacts gen;
-    // Special constructor for one/zero/bottom
-    GenKillTransformer(const DataFlowFacts& k, const DataFlowFacts& g, int);
+    // True for the unique representatives (hash-consed and special values)
+    bool unique = false;
+    // Special constructor for one/zero/bottom and hash-consed instances
+    GenKillTransformer(const DataFlowFacts& k, const DataFlowFacts& g, int c);
 };
 
 // InterProceduralDataFlowEngine implements inter-procedural dataflow analysis using WPDS
@@ -111,12 +141,37 @@ public:
         std::function<GenKillTransformer*(Instruction*)> createTransformer,
         const std::set<Value*>& initialFacts = {});
 
+    // Run one forward analysis per set of initial facts. The WPDS is built
+    // once and the queries are saturated on up to numThreads threads;
+    // queries with the same initial facts are answered from a cache.
+    std::vector<std::unique_ptr<DataFlowResult>> runForwardAnalyses(
+        Module& m,
+        std::function<GenKillTransformer*(Instruction*)> createTransformer,
+        const std::vector<std::set<Value*>>& initialFacts,
+        unsigned numThreads = 1);
+
+    // Backward counterpart of runForwardAnalyses
+    std::vector<std::unique_ptr<DataFlowResult>> runBackwardAnalyses(
+        Module& m,
+        std::function<GenKillTransformer*(Instruction*)> createTransformer,
+        const std::vector<std::set<Value*>>& initialFacts,
+        unsigned numThreads = 1);
+
     // Helper methods to query results
     const std::set<Value*>& getInSet(Instruction* inst) const;
     const std::set<Value*>& getOutSet(Instruction* inst) const;
 
 private:
-    // Convert LLVM Module to WPDS
+    std::vector<std::unique_ptr<DataFlowResult>> runAnalyses(
+        Module& m,
+        std::function<GenKillTransformer*(Instruction*)> createTransformer,
+        const std::vector<std::set<Value*>>& initialFacts,
+        unsigned numThreads,
+        bool isForward);
+
+    // Convert LLVM Module to WPDS. Rules are generated per basic block
+    // segment (a block is split after every call to a defined function),
+    // carrying the pre-composed transformer of the instructions of the segment.
     void buildWPDS(
         Module& m, 
         wpds::WPDS<GenKillTransformer>& wpds,
@@ -129,9 +184,11 @@ private:
         const std::set<Value*>& initialFacts,
         bool isForward);
 
+    // Next WPDS key of the build, from an integer ID (no string formatting)
+    wpds::wpds_key_t newKey();
+
     // Map WPDS keys to LLVM values for easy lookup
     wpds::wpds_key_t getKeyForFunction(Function* f);
-    wpds::wpds_key_t getKeyForInstruction(Instruction* inst);
     wpds::wpds_key_t getKeyForBasicBlock(BasicBlock* bb);
     wpds::wpds_key_t getKeyForCallSite(CallInst* callInst);
     wpds::wpds_key_t getKeyForReturnSite(CallInst* callInst);
@@ -141,13 +198,28 @@ private:
         Module& m,
         wpds::CA<GenKillTransformer>& resultCA,
         std::unique_ptr<DataFlowResult>& result,
+        const std::set<Value*>& initialFacts,
         bool isForward);
 
-    // Map program elements to WPDS keys and vice versa
-    std::map<Function*, wpds::wpds_key_t> functionToKey;
-    std::map<Instruction*, wpds::wpds_key_t> instToKey;
-    std::map<BasicBlock*, wpds::wpds_key_t> bbToKey;
-    std::map<wpds::wpds_key_t, Instruction*> keyToInst;
+    // Map program elements to WPDS keys
+    std::unordered_map<Function*, wpds::wpds_key_t> functionToKey;
+    std::unordered_map<Function*, wpds::wpds_key_t> functionToExitKey;
+    std::unordered_map<BasicBlock*, wpds::wpds_key_t> bbToKey;
+    std::unordered_map<CallInst*, wpds::wpds_key_t> callSiteToKey;
+    std::unordered_map<CallInst*, wpds::wpds_key_t> returnSiteToKey;
+
+    // Transformer of every instruction, kept to materialize the
+    // per-instruction results from the block-level ones
+    std::unordered_map<Instruction*, wpds::Traits<GenKillTransformer>::sem_elem_t>
+        instToTransformer;
+
+    // Control state, initial and accepting states of the automata
+    wpds::wpds_key_t controlState = wpds::WPDS_EPSILON;
+    wpds::wpds_key_t initialState = wpds::WPDS_EPSILON;
+    wpds::wpds_key_t acceptingState = wpds::WPDS_EPSILON;
+
+    // Next integer ID used by newKey(), from 0 in every build
+    int nextKeyID = 0;
 
     // Maintain the dataflow result for the most recent analysis
     mutable std::unique_ptr<DataFlowResult> currentResult;
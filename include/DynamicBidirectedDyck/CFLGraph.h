@@ -382,6 +382,15 @@ class CFLHashMap{
 
   }
 
+  // the edges of a node without copying them
+  const unordered_map<unsigned, Matrix1>& GetOutEdges(unsigned i) const {
+    return *outvec[i];
+  }
+
+  const unordered_map<unsigned, Matrix1>& GetInEdges(unsigned i) const {
+    return *invec[i];
+  }
+
   void CheckInColor(unsigned j, unsigned i, unordered_map<unsigned, char>& c){
     c = (*invec[i])[j].colors;
   }
@@ -0,0 +1,118 @@
+#ifndef DYCKREACH_H
+#define DYCKREACH_H
+
+#include "CFLGraph.h"
+#include "FastDLL.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Bidirected Dyck reachability on a graph whose edges are inserted and
+// deleted over time.
+//
+// An edge u -> v labeled l stands for the parenthesis l between u and v, so
+// u and w are reachable from each other whenever u -> v and w -> v are both
+// labeled l, and the relation is closed under this rule. The reachable nodes
+// form equivalence classes, which are kept up to date under edge insertions
+// (by merging classes) and deletions (by splitting the classes that may have
+// depended on the edge and merging them again where needed). Queries can be
+// asked in between updates.
+class DyckReach {
+public:
+  explicit DyckReach(unsigned NodeNum);
+
+  unsigned GetVtxNum() const { return NodeNum; }
+
+  // Adds an edge to the graph without updating the classes. Call Solve()
+  // once the graph is built, then update it with InsertEdge/DeleteEdge.
+  void AddEdge(unsigned u, unsigned v, unsigned label);
+  void RemoveEdge(unsigned u, unsigned v, unsigned label);
+
+  // Computes the classes of the current graph from scratch
+  void Solve();
+
+  // Inserts an edge and merges the classes it connects. Returns false if the
+  // edge already exists.
+  bool InsertEdge(unsigned u, unsigned v, unsigned label);
+
+  // Deletes an edge and splits the classes that were connected by it.
+  // Returns false if there is no such edge.
+  bool DeleteEdge(unsigned u, unsigned v, unsigned label);
+
+  // The representative node of the class of u
+  unsigned Find(unsigned u);
+
+  // Whether u and v are reachable from each other
+  bool IsReachable(unsigned u, unsigned v) { return Find(u) == Find(v); }
+
+  // The nodes reachable from u, including u
+  const list<unsigned> &GetReachable(unsigned u) { return SSets[Find(u)]; }
+
+  unsigned GetClassNum() const { return SSets.size(); }
+
+private:
+  // A labeled edge between two representatives
+  struct EdgeKey {
+    unsigned From, To, Label;
+    bool operator==(const EdgeKey &Other) const {
+      return From == Other.From && To == Other.To && Label == Other.Label;
+    }
+  };
+
+  struct EdgeKeyHash {
+    size_t operator()(const EdgeKey &K) const {
+      uint64_t H = ((uint64_t)K.From << 32 | K.To) * 0x9e3779b97f4a7c15ULL;
+      return H ^ (K.Label + (H >> 29));
+    }
+  };
+
+  // A (node, label) pair, keying the nodes with an edge of the label to node
+  static uint64_t ColorKey(unsigned Node, unsigned Label) {
+    return (uint64_t)Node << 32 | Label;
+  }
+
+  unsigned FindResp(unsigned u);
+
+  // The weights are kept on the edges between representatives i and j
+  void IncWeight(unsigned i, unsigned j, unsigned eid);
+  void DecWeight(unsigned i, unsigned j, unsigned eid);
+  void MoveWeight(const EdgeKey &From, const EdgeKey &To);
+  void AddColorInNode(uint64_t Key, unsigned Node);
+  void RemoveColorInNode(uint64_t Key, unsigned Node);
+
+  // Merges the classes until no two classes have an edge of the same label
+  // to the same class
+  void Merge();
+  // Splits the class of OrigResp into Groups, moving the weights of the
+  // edges of its members in one pass
+  void Split(unsigned OrigResp, vector<list<unsigned>> &Groups);
+  // Splits the class of ToSplit and the classes with a path to it into the
+  // groups of nodes with an edge of the same label to the same node, or to
+  // the same class without a path to it
+  void SplitAffected(unsigned ToSplit);
+
+  unsigned NodeNum;
+  bool Solved;
+
+  // The input graph
+  CFLHashMap Graph;
+  // The graph between the representatives of the classes
+  unique_ptr<CFLHashMap> Merged;
+  // The representative of each node, as a disjoint set forest
+  vector<unsigned> Resp;
+  // The nodes of each class, indexed by its representative
+  unordered_map<unsigned, list<unsigned>> SSets;
+  // The number of input edges behind an edge of the merged graph
+  unordered_map<EdgeKey, unsigned, EdgeKeyHash> Weight;
+  // The representatives with an edge of a label to a representative
+  unordered_map<uint64_t, In_FastDLL<unsigned>> ColorInNodes;
+  // The (node, label) pairs whose in-nodes are to be merged
+  In_FastDLL<uint64_t> Worklist;
+};
+
+#endif
@@ -178,6 +178,10 @@ extern bool bitmap_set_bit_p(bitmap, int);
 /* Return true if a register is set in a register set.  */
 extern int bitmap_bit_p (bitmap, int);
 
+/* As bitmap_bit_p, but the cached position is not moved, so that threads
+   can test the bits of a shared bitmap concurrently.  */
+extern int bitmap_bit_test (bitmap, int);
+
 /* Debug functions to print a bitmap linked list.  */
 extern void debug_bitmap (bitmap);
 extern void debug_bitmap_file (FILE *, bitmap);
@@ -19,6 +19,8 @@
 #define PESTRIE_SE_1 "SEP1"
 #define BITMAP_PT_1 "PTB1"
 #define BITMAP_SE_1 "SEB1"
+#define PESTRIE_PT_IMG_1 "PTM1"
+#define PESTRIE_SE_IMG_1 "SEM1"
 
 // Categories of the input matrix
 #define UNDEFINED_MATRIX -1
@@ -0,0 +1,52 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/*
+ * The layout of the memory-mapped Pestrie image.
+ *
+ * The persistence file of Pestrie stores the figures, which are decoded into a
+ * segment tree at loading. The image stores the decoded querying structure
+ * itself as flat arrays of integers, each aligned to 8 bytes and located by the
+ * header, so that it can be mapped read-only and queried in place. Processes
+ * mapping the same image share one page-cached copy of it.
+ */
+
+#ifndef PES_IMAGE_H
+#define PES_IMAGE_H
+
+#include "constants.hh"
+
+#define PES_IMAGE_VERSION 1
+
+// The sections of the image, in file order
+enum PesImageSection
+{
+  IMG_PREV,            // pre-order stamp of the pointers and objects
+  IMG_TREE,            // tree of the pointers and objects
+  IMG_ROOT_PREVS,      // pre-order stamps of the roots, with a sentinel
+  IMG_ROOT_TREE,       // tree of a pre-order stamp, -1 if it is not a root
+  IMG_PTRS_BEGIN,      // CSR offsets of the pointers of an equivalent set
+  IMG_PTRS,
+  IMG_OBJS_BEGIN,      // CSR offsets of the objects of an equivalent set
+  IMG_OBJS,
+  IMG_UNIT_NODE,       // segment tree node of a X coordinate
+  IMG_NODE_PARENT,     // parent link of a segment tree node, -1 for none
+  IMG_RECTS_BEGIN,     // CSR offsets of the figures of a node
+  IMG_RECTS,           // (y1, y2) pairs sorted by y1
+  IMG_PT_BEGIN,        // CSR offsets of the root stamps covered by a node
+  IMG_PT,
+  N_IMG_SECTIONS
+};
+
+struct PesImageHeader
+{
+  char magic[4];
+  int version;
+  int index_type;
+  int n, m, vertex_num, n_trees, n_nodes;
+  // Offset in bytes and length in integers of the sections
+  long long offset[N_IMG_SECTIONS];
+  long long length[N_IMG_SECTIONS];
+};
+
+#endif
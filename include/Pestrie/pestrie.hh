@@ -34,6 +34,8 @@ struct PesOpts
   bool pestrie_draw;
   //
   bool llvm_input;
+  // Print the statistics of the persisted index
+  bool verbose;
 
   PesOpts()
   {
@@ -44,6 +46,7 @@ struct PesOpts
     profile_in_detail = false;
     pestrie_draw = false;
     llvm_input = false;
+    verbose = true;
   }
 };
 
@@ -219,6 +222,8 @@ extern void init_pestrie();
 //
 extern PesTrie* self_parse_input( FILE*, const PesOpts* );
 extern PesTrie* dual_parse_input( FILE*, const PesOpts* );
+// rows[i] lists the objects pointed to by pointer i
+extern PesTrie* self_make_input( int n, int m, const std::vector<int>* rows, const PesOpts* );
 extern void build_index_with_pestrie( PesTrie* );
 
 #endif
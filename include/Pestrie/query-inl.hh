@@ -15,12 +15,15 @@
 static int
 iterate_equivalent_set( VECTOR(int) &es_set, IFilter* filter )
 {
-  int ans = 0;
   int size = es_set.size();
-  
+
+  // Without a filter, the answers are only counted
+  if ( filter == NULL ) return size;
+
+  int ans = 0;
   for ( int i = 0; i < size; ++i ) {
     int q = es_set[i];
-    //    if ( filter->validate(q) )
+    if ( filter->validate(q) )
       ans++;
   }
   
@@ -14,6 +14,7 @@
 #define QUERY_H
 
 #include <cstdio>
+#include <vector>
 #include "constants.hh"
 
 // Query Types
@@ -27,7 +28,8 @@
 #define LIST_CONFLICTS  6
 
 
-// Querying result filter
+// Querying result filter, which visits every answer of a list query.
+// A NULL filter keeps all the answers.
 class IFilter
 {
 public:
@@ -75,7 +77,21 @@ public:
 extern IQuery* 
 load_bitmap_index( std::FILE* fp, int index_type, bool t_mode );
 
+// The statistics of the index are printed to stderr if verbose is set
 extern IQuery* 
-load_pestrie_index( std::FILE* fp, int index_type, bool d_mering );
+load_pestrie_index( std::FILE* fp, int index_type, bool d_mering, bool verbose = true );
+
+// Decode a Pestrie index and write its querying structure as an image
+extern bool
+write_pestrie_image( std::FILE* fp, int index_type, const char* image_file );
+
+// Build the Pestrie index of a points-to matrix in memory, pts[i] lists the
+// objects pointed to by pointer i
+extern IQuery*
+build_pestrie_index( int n_ptrs, int n_objs, const std::vector<int>* pts );
+
+// Query a Pestrie image in place
+extern IQuery*
+map_pestrie_image( const char* image_file );
 
 #endif
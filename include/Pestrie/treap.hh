@@ -13,7 +13,9 @@
 #ifndef TREAP_H
 #define TREAP_H
 
+#ifndef INDEX_UTILITY
 #define INDEX_UTILITY
+#endif
 #include "shapes.hh"
 #include "options.hh"
 
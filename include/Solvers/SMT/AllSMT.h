@@ -1,23 +1,66 @@
 #pragma once
 
+#include <functional>
 
 #include "z3++.h"
 
 
+/// Enumerates the models of a formula projected on a set of variables.
+///
+/// The enumeration uses one incremental solver. The assignment of the
+/// projection variables in each model is generalized to a cube, i.e. a
+/// conjunction of literals on these variables, every assignment of which
+/// extends to a model. Only the cube is blocked, so one check covers all the
+/// models of the cube. A cube is generalized by dropping the literals that are
+/// not in the unsat core of the cube, the negated formula and the values of
+/// the other variables in the model.
 class AllSMTSolver {
+public:
+    /// Receives a model and the cube generalized from it. Returns false to
+    /// stop the enumeration.
+    typedef std::function<bool(const z3::model&, const z3::expr_vector&)> ModelCallback;
+
 private:
 
     unsigned num_vars;
     unsigned num_clauses;
+    unsigned num_checks;
+
+    bool minimize_cubes;
+    bool bit_level;
+
+    z3::expr_vector getCube(z3::model& m, const z3::expr_vector& projection);
+
+    z3::expr_vector generalize(z3::solver& negated, z3::model& m, const z3::expr_vector& cube,
+                               const z3::expr_vector& others);
 
 public:
 	AllSMTSolver();
 
     virtual ~AllSMTSolver();
 
-
+    /// Counts the models of expr, up to k, over all its variables.
 	int getModels(z3::expr& expr, int k);
 
+    /// Streams the cubes of the models of expr projected on projection to the
+    /// callback, up to limit cubes if limit is not negative. Every projected
+    /// model is in a cube, but the cubes may overlap. Returns the number of
+    /// cubes.
+    int getModels(const z3::expr& expr, const z3::expr_vector& projection,
+                  const ModelCallback& callback, int limit = -1);
+
+    /// Whether cubes are generalized. Otherwise every cube is one projected
+    /// model. Enabled by default.
+    void setMinimizeCubes(bool minimize) { minimize_cubes = minimize; }
+
+    /// Whether the literals of a bit-vector variable are its single bits
+    /// rather than its value. Enabled by default.
+    void setBitLevel(bool bits) { bit_level = bits; }
+
+    /// The number of satisfiability checks of the last enumeration.
+    unsigned getNumChecks() const { return num_checks; }
 
+    /// The number of cubes blocked by the last enumeration.
+    unsigned getNumClauses() const { return num_clauses; }
 
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "SMTSolver.h"
+#include "z3++.h"
+
+/// A cache of the answers of satisfiability checks, shared by all the
+/// SMTFactory instances of the process.
+///
+/// A query is keyed by a digest of the structure of its assertions, in which
+/// the uninterpreted symbols are numbered in the order they first occur.
+/// Queries that only differ in the names of their symbols, e.g. constraints
+/// renamed by SMTFactory::rename, thus have the same key. Only sat and unsat
+/// answers are cached: unknown answers depend on the timeout.
+///
+/// The cache is enabled by -smt-query-cache-mb, which bounds its memory; the
+/// least recently used answers are evicted first. With -smt-query-cache-file,
+/// the answers are loaded from the file on first use and saved to it on exit.
+class SMTQueryCache {
+public:
+  struct Key {
+    uint64_t High;
+    uint64_t Low;
+
+    bool operator==(const Key &Other) const {
+      return High == Other.High && Low == Other.Low;
+    }
+  };
+
+  static const uint32_t Version = 1;
+
+private:
+  struct KeyHash {
+    size_t operator()(const Key &K) const { return K.Low; }
+  };
+
+  struct Entry {
+    Key K;
+    SMTSolver::SMTResultType Result;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  mutable std::mutex CacheLock;
+
+  // Most recently used first
+  EntryList Entries;
+
+  std::unordered_map<Key, EntryList::iterator, KeyHash> Index;
+
+  size_t MaxEntries;
+
+  std::string Path;
+
+  uint64_t Hits;
+
+  uint64_t Misses;
+
+  void insertLocked(const Key &K, SMTSolver::SMTResultType Result);
+
+public:
+  SMTQueryCache(size_t MaxBytes, const std::string &Path = "");
+
+  ~SMTQueryCache();
+
+  /// The cache configured by the command line options, or nullptr if the
+  /// cache is disabled.
+  static SMTQueryCache *get();
+
+  /// Computes the key of the conjunction of the assertions.
+  static Key computeKey(const z3::expr_vector &Assertions);
+
+  bool lookup(const Key &K, SMTSolver::SMTResultType &Result);
+
+  /// Only sat and unsat answers are recorded.
+  void insert(const Key &K, SMTSolver::SMTResultType Result);
+
+  bool load(const std::string &FilePath);
+
+  bool save(const std::string &FilePath) const;
+
+  size_t size() const;
+
+  uint64_t getNumHits() const;
+
+  uint64_t getNumMisses() const;
+
+  /// The approximate memory used by one cached answer.
+  static size_t bytesPerEntry();
+};
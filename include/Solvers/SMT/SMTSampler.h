@@ -2,15 +2,20 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <set>
 #include <sstream>
 //#include <string.h>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -28,4 +33,93 @@ using namespace z3;
 
 class quicksampler;
 
+// A set of strings that several threads update. The strings are distributed
+// over shards by their hash, and every shard has its own lock.
+class concurrent_string_set {
+  static const unsigned num_shards = 64;
+
+  struct shard {
+    std::mutex lock;
+    std::unordered_set<std::string> strings;
+  };
+
+  shard shards[num_shards];
+
+public:
+  // Returns whether s was not in the set
+  bool insert(const std::string &s) {
+    shard &sh = shards[std::hash<std::string>()(s) % num_shards];
+    std::lock_guard<std::mutex> guard(sh.lock);
+    return sh.strings.insert(s).second;
+  }
+
+  size_t size() {
+    size_t n = 0;
+    for (auto &sh : shards) {
+      std::lock_guard<std::mutex> guard(sh.lock);
+      n += sh.strings.size();
+    }
+    return n;
+  }
+};
+
+// The sample/mutate/solve loop of quick_sampler on several threads. It
+// samples the models of a DIMACS CNF (restricted to the "c ind" variables if
+// any) into input + ".samples", until max_samples samples are written or
+// max_time seconds are spent.
+//
+// Every worker owns a z3 context with its own copy of the formula, and a
+// random number generator seeded by the seed and the index of the worker.
+// The samples a worker produces thus only depend on the seed: the scheduling
+// only changes how the workers interleave in the output, and where they stop.
+// The samples of all workers are deduplicated through a concurrent set, and
+// every worker buffers its output.
+class parallel_quick_sampler {
+  class worker;
+
+  std::string input_file;
+  int max_samples;
+  double max_time;
+  unsigned num_threads;
+  unsigned seed;
+
+  std::vector<std::vector<int>> clauses;
+  std::vector<int> ind;
+
+  std::chrono::steady_clock::time_point start_time;
+  double run_time = 0.0;
+  std::atomic<bool> stop{false};
+  std::atomic<int> samples{0};
+  std::atomic<int> duplicates{0};
+  std::atomic<int> epochs{0};
+  std::atomic<int> solver_calls{0};
+
+  // Variables that are the same in all the models. Flipping them is unsat
+  // whichever worker tries, so they are shared.
+  std::unique_ptr<std::atomic<bool>[]> unsat_vars;
+
+  concurrent_string_set seen;
+
+  std::mutex results_lock;
+  std::ofstream results_file;
+
+  static const size_t buffer_size = 1 << 16;
+
+  double elapsed() const;
+  void parse_cnf();
+
+public:
+  parallel_quick_sampler(std::string input, int max_samples, double max_time,
+                         unsigned num_threads, unsigned seed);
+
+  // Samples the formula and prints the statistics. Runs once.
+  void run();
+
+  void print_stats();
+
+  // The number of samples written and the seconds spent by run()
+  int num_samples() const;
+  double time() const { return run_time; }
+};
+
 class regionsampler;
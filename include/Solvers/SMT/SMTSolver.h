@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "SMTObject.h"
@@ -26,8 +27,23 @@ private:
   unsigned checkCount;
   // unsigned missCount;
 
+  // The answer of the last check came from the SMTQueryCache, so Z3 has to
+  // solve the query before a model is available
+  bool ModelPending;
+
+  // The model of the last check if it was found by another solver of the
+  // portfolio, translated to the context of this solver
+  std::shared_ptr<z3::model> PortfolioModel;
+
   SMTSolver(SMTFactory *F, z3::solver &Z3Solver, z3::model &Z3Model);
 
+  SMTResultType checkWithZ3(unsigned Timeout);
+
+  // Solves the query with the solver alone first. If it is not solved within
+  // -smt-portfolio-threshold, copies of the query are solved in parallel by
+  // the default solver and the tactics of -smt-portfolio.
+  z3::check_result checkWithPortfolio(unsigned Timeout);
+
 public:
   virtual ~SMTSolver();
 
@@ -44,6 +60,7 @@ public:
   // set a specific Timeout for current query.
   // in some cases, we may want to spent more/less time than the default timeout
   // on a query
+  // The answer is looked up in the SMTQueryCache first, if it is enabled.
   virtual SMTResultType check(unsigned Timeout = 0);
 
   // check sat/unsat with fast, incomplete theory-level decision procedures
@@ -33,7 +33,7 @@
 using namespace z3;
 using namespace std;
 
-bool get_expr_vars(expr &exp, expr_vector &vars) {
+inline bool get_expr_vars(expr &exp, expr_vector &vars) {
   /*
    * get the variables in `exp` and put them in `vars`
    */
@@ -73,7 +73,8 @@ bool get_expr_vars(expr &exp, expr_vector &vars) {
   return true;
 }
 
-expr_vector get_vars_difference(expr_vector &vars_a, expr_vector &vars_b) {
+inline expr_vector get_vars_difference(expr_vector &vars_a,
+                                       expr_vector &vars_b) {
   /*
    * Compute the set difference of vars_a and vars_b?
    * note that we assume vars_a and vars_b consist of purely variables.
@@ -99,7 +100,7 @@ expr_vector get_vars_difference(expr_vector &vars_a, expr_vector &vars_b) {
   return ret;
 }
 
-void get_k_models(z3::expr &exp, int k) {
+inline void get_k_models(z3::expr &exp, int k) {
   /*
    * Compute k models of exp
    * TODO: store the models
@@ -134,8 +135,8 @@ void get_k_models(z3::expr &exp, int k) {
   }
 }
 
-std::pair<int, int> get_abstract_interval(expr &pre_cond, expr &query,
-                                          int timeout) {
+inline std::pair<int, int> get_abstract_interval(expr &pre_cond, expr &query,
+                                                 int timeout) {
   /*
    * Compute the interval abstraction of And(pre_cond, query)
    *
@@ -175,8 +176,8 @@ std::pair<int, int> get_abstract_interval(expr &pre_cond, expr &query,
   return ret;
 }
 
-void get_abstract_interval_as_expr(expr &pre_cond, expr &query,
-                                   expr_vector &res, int timeout) {
+inline void get_abstract_interval_as_expr(expr &pre_cond, expr &query,
+                                          expr_vector &res, int timeout) {
   /*
    *
    * Compute the interval abstraction of And(pre_cond, query)
@@ -214,7 +215,7 @@ void get_abstract_interval_as_expr(expr &pre_cond, expr &query,
   }
 }
 
-expr do_constant_propagation(expr &to_simp) {
+inline expr do_constant_propagation(expr &to_simp) {
   /*
    * Perform constant propagation on to_simp
    */
@@ -224,8 +225,8 @@ expr do_constant_propagation(expr &to_simp) {
   return cp.apply(gg)[0].as_expr();
 }
 
-bool check_model_misc(expr &exp, context &ctx, vector<func_decl> &decls,
-                      vector<int> &candidate) {
+inline bool check_model_misc(expr &exp, context &ctx, vector<func_decl> &decls,
+                             vector<int> &candidate) {
   model cur_model(ctx);
 
   // initialize the model with candidate
@@ -242,7 +243,7 @@ bool check_model_misc(expr &exp, context &ctx, vector<func_decl> &decls,
   }
 }
 
-bool check_model_with_mutate(expr &exp) {
+inline bool check_model_with_mutate(expr &exp) {
   expr_vector vars(exp.ctx());
 
   // get vars
@@ -268,8 +269,8 @@ bool check_model_with_mutate(expr &exp) {
   return res;
 }
 
-bool sat_under_partial_model(expr &exp, model &m,
-                             expr_vector &donot_cared_vars) {
+inline bool sat_under_partial_model(expr &exp, model &m,
+                                    expr_vector &donot_cared_vars) {
   model partial_model(exp.ctx());
 
   unsigned num_constants = m.num_consts();
@@ -304,8 +305,8 @@ inline uint64_t snoob(uint64_t sub, uint64_t set) {
   return rip;
 }
 
-bool check_model(expr &exp, context &ctx, vector<func_decl> &decls, uint64_t x,
-                 unsigned num) {
+inline bool check_model(expr &exp, context &ctx, vector<func_decl> &decls,
+                        uint64_t x, unsigned num) {
   // std::cout << "current x is : " << x << std::endl;
   model m(ctx);
   expr bfalse = ctx.bool_val(false);
@@ -325,7 +326,7 @@ bool check_model(expr &exp, context &ctx, vector<func_decl> &decls, uint64_t x,
   }
 }
 
-int solve_with_truth_table(expr &exp, int bound) {
+inline int solve_with_truth_table(expr &exp, int bound) {
   /*
    * Solve expr with truth table based brute forth enumeration
    */
@@ -291,6 +291,17 @@ namespace wpds {
                 return numBuckets;
             }
 
+            // Grow the buckets so that n values fit without rehashing
+            void reserve( size_type n )
+            {
+                while( n >= growthFactor ) {
+                    size_type oldBuckets = numBuckets;
+                    resize( n );
+                    if( numBuckets == oldBuckets )
+                        break;
+                }
+            }
+
             inline std::pair<iterator,bool> insert( const Key& k, const Data& d )
             {
                 return insert( pair_type(k,d) );
@@ -0,0 +1,302 @@
+#ifndef wpds_MULTI_QUERY_H_
+#define wpds_MULTI_QUERY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "semiring.h"
+#include "CA.h"
+#include "WPDS.h"
+#include "SaturationProcess.h"
+#include "TransActionFunctor.h"
+
+/* class MultiQuery
+ *
+ * Answers many prestar or poststar queries (one initial automaton each)
+ * over a single WPDS.
+ *
+ *  - Independent queries are saturated concurrently. The WPDS is only read
+ *    by the saturation, so all the threads share it. This requires the
+ *    weights to be safe to share between threads: T::count must be an
+ *    AtomicRefCounter (see ref_ptr.h) and extend/combine must not mutate
+ *    shared state without synchronization. A WPDS with a rule extender
+ *    is always solved sequentially, since the extender adds rules.
+ *
+ *  - Saturated automata are cached together with their initial automaton.
+ *    If the initial automaton A of a query contains the initial automaton
+ *    B of a cached entry (same initial and final states, every transition
+ *    of B is in A with the same weight), saturation starts from the cached
+ *    post*(B) (or pre*(B)) plus the transitions of A. As B <= A, that
+ *    automaton lies between A and the answer of the query, so chaotic
+ *    iteration converges to the same fixpoint, and every transition already
+ *    saturated is popped once without changes. If A and B are equal the
+ *    cached automaton is returned as is.
+ *
+ * Usage:
+ *      MultiQuery<T> mq( wpds,s,Query::poststar() );
+ *      mq.solve( ca_in,ca_out );
+ *      std::vector< std::unique_ptr< CA<T> > > out = mq.solve( queries,4 );
+ */
+
+namespace wpds {
+
+    template< typename T > class MultiQuery {
+
+        public:     // typedefs
+            GEN_WPDS_TYPEDEFS(T);
+
+        public:     // Constructor/De
+
+            MultiQuery(
+                    WPDS<T>& wpds_,
+                    Semiring<T>& s_,
+                    Query q,
+                    size_t max_cached_ = 16 )
+                : wpds(wpds_),s(s_),query(q),max_cached(max_cached_)
+                  ,hits(0),partial_hits(0)
+                {
+                    assert( q.is_prestar() || q.is_poststar() );
+                }
+
+            ~MultiQuery() {}
+
+        public:     // Methods
+
+            /* Saturate ca_in into ca_out, reusing the cache */
+            void solve( const CA<T>& ca_in,CA<T>& ca_out )
+            {
+                bool exact = false;
+                if( !lookup( ca_in,ca_out,exact ) )
+                    ca_out.operator=( ca_in );
+                if( exact )
+                    return;
+
+                SaturationProcess<T> prcs( wpds,ca_out,s,query );
+                if( query.is_prestar() )
+                    prcs.prestar();
+                else
+                    prcs.poststar();
+
+                store( ca_in,ca_out );
+            }
+
+            /* Saturate every automaton of queries on up to nthreads
+             * threads. The i-th result answers the i-th query.
+             */
+            std::vector< std::unique_ptr< CA<T> > > solve(
+                    const std::vector< const CA<T>* >& queries,
+                    unsigned nthreads )
+            {
+                std::vector< std::unique_ptr< CA<T> > > results;
+                results.reserve( queries.size() );
+                for( size_t i = 0; i < queries.size(); i++ )
+                    results.emplace_back( new CA<T>( s ) );
+
+                if( nthreads <= 1 || queries.size() <= 1 || wpds.has_extender() ) {
+                    for( size_t i = 0; i < queries.size(); i++ )
+                        solve( *queries[i],*results[i] );
+                    return results;
+                }
+
+                // Threads fetch the next unsolved query
+                std::atomic<size_t> next(0);
+                auto worker = [&]() {
+                    for( size_t i = next++; i < queries.size(); i = next++ )
+                        solve( *queries[i],*results[i] );
+                };
+
+                size_t nworkers = std::min( (size_t)nthreads,queries.size() );
+                std::vector< std::thread > workers;
+                for( size_t k = 1; k < nworkers; k++ )
+                    workers.emplace_back( worker );
+                worker();
+                for( auto& w : workers )
+                    w.join();
+
+                return results;
+            }
+
+            void clear_cache()
+            {
+                std::lock_guard< std::mutex > lock( cache_mutex );
+                cache.clear();
+                index.clear();
+            }
+
+            /* Statistics */
+            size_t num_hits() const { return hits; }
+            size_t num_partial_hits() const { return partial_hits; }
+
+        protected:  // helper types
+
+            /* Initial and final states of an automaton */
+            typedef std::pair< wpds_key_t,std::vector< wpds_key_t > > StatesKey;
+
+            struct Entry {
+                Entry( const CA<T>& in,const CA<T>& out )
+                    : initial(in),saturated(out),states(states_key(in))
+                      ,size(count_transitions(in)) {}
+                CA<T> initial;
+                CA<T> saturated;
+                StatesKey states;
+                size_t size;
+            };
+
+            /* Entries with the same states, largest initial automaton first */
+            typedef std::multimap< size_t,std::shared_ptr< const Entry >,
+                    std::greater< size_t > > Bucket;
+
+            /* Checks that every transition it is applied to is in ca with
+             * the same weight */
+            struct ContainedTransActionFunctor : TransActionFunctor<T>
+            {
+                CA<T>& ca;
+                Semiring<T>& s;
+                bool contained;
+
+                ContainedTransActionFunctor( CA<T>& ca_,Semiring<T>& s_ )
+                    : ca(ca_),s(s_),contained(true) {}
+
+                virtual ~ContainedTransActionFunctor() {}
+
+                virtual void operator()( const catrans_t& t )
+                {
+                    if( !contained )
+                        return;
+                    catrans_t u;
+                    contained = ca.find( t->from_state(),t->stack(),t->to_state(),u )
+                        && s.equal( t->semiring_element(),u->semiring_element() );
+                }
+            };
+
+            struct CountTransActionFunctor : TransActionFunctor<T>
+            {
+                size_t n;
+                CountTransActionFunctor() : n(0) {}
+                virtual ~CountTransActionFunctor() {}
+                virtual void operator()( const catrans_t& ) { n++; }
+            };
+
+        protected:  // helper functions
+
+            static size_t count_transitions( const CA<T>& ca )
+            {
+                CountTransActionFunctor counter;
+                ca.for_each( counter );
+                return counter.n;
+            }
+
+            static StatesKey states_key( const CA<T>& ca )
+            {
+                const auto& finals = ca.final_states();
+                return StatesKey( ca.initial_state(),
+                        std::vector< wpds_key_t >( finals.begin(),finals.end() ) );
+            }
+
+            /* Initialize ca_out from the largest cached entry whose initial
+             * automaton is contained in ca_in. exact is set if the entry
+             * answers the query as is.
+             */
+            bool lookup( const CA<T>& ca_in,CA<T>& ca_out,bool& exact )
+            {
+                if( 0 == max_cached )
+                    return false;
+
+                // The queried automaton is only read, but CA::find is not
+                // const
+                CA<T>& in = const_cast< CA<T>& >( ca_in );
+                size_t in_size = count_transitions( ca_in );
+
+                // Entries with the same states that are not larger than
+                // ca_in, largest first. The containment checks run without
+                // the lock, the candidates are kept alive if evicted.
+                std::vector< std::shared_ptr< const Entry > > candidates;
+                {
+                    std::lock_guard< std::mutex > lock( cache_mutex );
+                    auto bucket = index.find( states_key( ca_in ) );
+                    if( bucket != index.end() ) {
+                        for( auto it = bucket->second.lower_bound( in_size );
+                                it != bucket->second.end(); ++it )
+                            candidates.push_back( it->second );
+                    }
+                }
+
+                const Entry* best = 0;
+                for( auto& e : candidates ) {
+                    ContainedTransActionFunctor contained( in,s );
+                    e->initial.for_each( contained );
+                    if( contained.contained ) {
+                        best = e.get();
+                        break;
+                    }
+                }
+                if( !best )
+                    return false;
+
+                ca_out.operator=( best->saturated );
+                exact = (best->size == in_size);
+                if( exact ) {
+                    hits++;
+                } else {
+                    partial_hits++;
+                    util::InsertTransActionFunctor<T> copier( &ca_out );
+                    ca_in.for_each( copier );
+                    for( wpds_key_t q : ca_in.states() )
+                        ca_out.make_state( q );
+                }
+                return true;
+            }
+
+            void store( const CA<T>& ca_in,const CA<T>& ca_out )
+            {
+                if( 0 == max_cached )
+                    return;
+
+                std::shared_ptr< const Entry > e( new Entry( ca_in,ca_out ) );
+                std::lock_guard< std::mutex > lock( cache_mutex );
+                cache.push_back( e );
+                index[e->states].emplace( e->size,e );
+                if( cache.size() > max_cached ) {
+                    const auto& oldest = cache.front();
+                    auto bucket = index.find( oldest->states );
+                    auto range = bucket->second.equal_range( oldest->size );
+                    for( auto it = range.first; it != range.second; ++it ) {
+                        if( it->second == oldest ) {
+                            bucket->second.erase( it );
+                            break;
+                        }
+                    }
+                    if( bucket->second.empty() )
+                        index.erase( bucket );
+                    cache.pop_front();
+                }
+            }
+
+        protected:  // Vars
+            WPDS<T>& wpds;
+            Semiring<T>& s;
+            Query query;
+            size_t max_cached;
+            std::atomic<size_t> hits;
+            std::atomic<size_t> partial_hits;
+            std::mutex cache_mutex;
+            std::list< std::shared_ptr< const Entry > > cache;    // oldest first
+            std::map< StatesKey,Bucket > index;
+
+    };  // class
+
+}   // wpds
+
+#endif  // wpds_MULTI_QUERY_H_
+/* Yo, Emacs!
+;;; Local Variables: ***
+;;; tab-width: 4 ***
+;;; End: ***
+*/
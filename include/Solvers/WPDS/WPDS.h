@@ -41,6 +41,7 @@
 #ifndef wpds_WPDS_
 #define wpds_WPDS_ 1
 
+#include <iterator>
 #include <map>
 #include <set>
 #include <list>
@@ -187,12 +188,63 @@ namespace wpds
             }
 
 
+            /* Rule description for bulk insertion. Unused stack symbols are
+               WPDS_EPSILON, following the add_rule calling convention:
+               <p,y> -> <q,eps>     { p,y,q,WPDS_EPSILON,WPDS_EPSILON,t }
+               <p,y> -> <q,g1>      { p,y,q,g1,WPDS_EPSILON,t }
+               <p,y> -> <q,g1 g2>   { p,y,q,g1,g2,t }
+             */
+            struct RuleSpec {
+                wpds_key_t p, y, q, g1, g2;
+                T *t;
+            };
+
+            /* Bulk rule insertion. The rule hashes are grown once up front
+               instead of rehashing while the rules trickle in. If the caller
+               guarantees that no rule of the batch is already present
+               (unique == true), the linear duplicate scan done for every
+               inserted rule is skipped as well.
+             */
+            template< typename InputIter >
+            void add_rules( InputIter begin, InputIter end, bool unique = false )
+            {
+                wpds_size_t n = std::distance( begin,end );
+                rules0Hash.reserve( rules0Hash.size() + n );
+                if( query.is_prestar() )
+                    delta_pre.reserve( delta_pre.size() + n );
+                if( query.is_poststar() )
+                    delta_post.reserve( delta_post.size() + n );
+
+                for( ; begin != end ; begin++ ) {
+                    const RuleSpec& rs = *begin;
+                    if( rs.g2 != WPDS_EPSILON ) {
+                        rule_t r = new Rule<T>(rs.t,rs.p,rs.y,rs.q,rs.g1,rs.g2);
+                        p_insert_rule( r,Rule<T>::RULE2,!unique );
+                    }
+                    else if( rs.g1 != WPDS_EPSILON ) {
+                        rule_t r = new Rule<T>(rs.t,rs.p,rs.y,rs.q,rs.g1);
+                        p_insert_rule( r,Rule<T>::RULE1,!unique );
+                    }
+                    else {
+                        rule_t r = new Rule<T>(rs.t,rs.p,rs.y,rs.q);
+                        p_insert_rule( r,Rule<T>::RULE0,!unique );
+                    }
+                }
+            }
+
             // check to see if state q is element of P
             bool is_element_of_P( const wpds_key_t q ) const
             {
                 return (P.find(q) != P.end());
             }
 
+            // A rule extender adds rules during saturation, so the WPDS
+            // cannot be shared by concurrent queries
+            bool has_extender() const
+            {
+                return (extender != NULL);
+            }
+
             // Getting statistics
             wpds_size_t count_rules () const {
                 if( query.is_prestar() )
@@ -203,15 +255,18 @@ namespace wpds
 
         protected:  // methods
 
-            int p_insert_rule_set( rule_t r, RuleList& rs );
+            int p_insert_rule_set( rule_t r, RuleList& rs,
+                    bool checkDuplicates = true );
 
-            int p_insert_rule0_hash( rule_t r );
+            int p_insert_rule0_hash( rule_t r, bool checkDuplicates = true );
 
             int p_insert_rule12_hash( rule_t r,
                     GPP_IMP_TYPENAME__ Rule<T>::type index,
-                    KeyPair& kp,Rules12SetHash& hash );
+                    KeyPair& kp,Rules12SetHash& hash,
+                    bool checkDuplicates = true );
 
-            int p_insert_rule( rule_t r,GPP_IMP_TYPENAME__ Rule<T>::type );
+            int p_insert_rule( rule_t r,GPP_IMP_TYPENAME__ Rule<T>::type,
+                    bool checkDuplicates = true );
 
 
         public:
@@ -451,7 +506,8 @@ namespace wpds
     template< typename T >
     int WPDS<T>::p_insert_rule_set(
             rule_t r,
-            GPP_IMP_TYPENAME__ WPDS<T>::RuleList& rs )
+            GPP_IMP_TYPENAME__ WPDS<T>::RuleList& rs,
+            bool checkDuplicates )
     {
         int retval = 3;
         rule_t rchk;
@@ -459,7 +515,7 @@ namespace wpds
         // If you know that you will never add a rule
         // twice, then you can turn this off.  It might
         // be wise to just have this on for Schemas
-        RuleListIter rsi = rs.begin();
+        RuleListIter rsi = checkDuplicates ? rs.begin() : rs.end();
         for( ; rsi != rs.end() ; rsi++ ) {
             rchk = *rsi;
             if( r->equal( rchk ) ) {
@@ -488,7 +544,7 @@ namespace wpds
     }
 
     template< typename T >
-    int WPDS<T>::p_insert_rule0_hash( rule_t r )
+    int WPDS<T>::p_insert_rule0_hash( rule_t r, bool checkDuplicates )
     {
         KeyPair kp( r->from_state(),r->from_stack() );
         Rule0SetHashIter r0shi = rules0Hash.find( kp );
@@ -501,7 +557,7 @@ namespace wpds
             retval = 3;
         }
         else {
-            retval = p_insert_rule_set( r,r0shi->second );
+            retval = p_insert_rule_set( r,r0shi->second,checkDuplicates );
         }
         return retval;
 
@@ -512,7 +568,8 @@ namespace wpds
             rule_t r, 
             GPP_IMP_TYPENAME__ Rule<T>::type index,
             KeyPair& kp,
-            GPP_IMP_TYPENAME__ WPDS<T>::Rules12SetHash& hash )
+            GPP_IMP_TYPENAME__ WPDS<T>::Rules12SetHash& hash,
+            bool checkDuplicates )
     {
         Rules12SetHashIter r12shi = hash.find( kp );
         int retval = 3;
@@ -535,10 +592,10 @@ namespace wpds
 #endif
              */
             if( index == Rule<T>::RULE1 ) {
-                retval = p_insert_rule_set( r,r12shi->second.first );
+                retval = p_insert_rule_set( r,r12shi->second.first,checkDuplicates );
             }
             else {
-                retval = p_insert_rule_set( r,r12shi->second.second );
+                retval = p_insert_rule_set( r,r12shi->second.second,checkDuplicates );
             }
         }
         return retval;
@@ -547,7 +604,8 @@ namespace wpds
 
     template< typename T >
     int WPDS<T>::p_insert_rule(
-            rule_t r, GPP_IMP_TYPENAME__ Rule<T>::type index )
+            rule_t r, GPP_IMP_TYPENAME__ Rule<T>::type index,
+            bool checkDuplicates )
     {
         int preval = 0,postval = 0,retval;
         /*
@@ -561,12 +619,12 @@ namespace wpds
 
             if( query.is_prestar() ) {
                 KeyPair kp( r->to_state(),r->to_stack1() );
-                preval = p_insert_rule12_hash( r,index,kp,delta_pre );
+                preval = p_insert_rule12_hash( r,index,kp,delta_pre,checkDuplicates );
             }
 
             if( query.is_poststar() ) {
                 KeyPair kp( r->from_state(),r->from_stack() );
-                postval = p_insert_rule12_hash( r,index,kp,delta_post );
+                postval = p_insert_rule12_hash( r,index,kp,delta_post,checkDuplicates );
             }
 
             if( query.is_both() && preval == 3 ) {
@@ -579,7 +637,7 @@ namespace wpds
             retval = preval | postval;
         }
         else {
-            retval = p_insert_rule0_hash( r );
+            retval = p_insert_rule0_hash( r,checkDuplicates );
         }
         if( retval != 3 ) {
             // We delete the rule if it existed b/c it is
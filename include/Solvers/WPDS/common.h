@@ -41,6 +41,7 @@
 #ifndef WPDS_COMMON_H_
 #define WPDS_COMMON_H_ 1
 
+#include <atomic>
 #include <cstdio>
 #include <iostream>
 #include <string>
@@ -168,10 +169,11 @@ namespace wpds {
     // DO NOT CHANGE WPDS_EPSILON.  This is corresponds to the location
     // of the what represents empty in wpds::Dictionary wpds::_str_dict
     static const wpds_key_t WPDS_EPSILON = 0;
-    extern int rulesCount;
-    extern int transCount;
-    extern int bktsCount;
-    extern int mhCount    ;
+    // Atomic, since concurrent saturations (see MultiQuery.h) update them
+    extern std::atomic<int> rulesCount;
+    extern std::atomic<int> transCount;
+    extern std::atomic<int> bktsCount;
+    extern std::atomic<int> mhCount    ;
 
     // inc
     static inline void incRuleCount() { rulesCount++; }
@@ -187,10 +189,10 @@ namespace wpds {
 
     static inline void dumpCounts()
     {
-        printf("Rule Count\t: %d\n",rulesCount);
-        printf("Trans Count\t: %d\n",transCount);
-        printf("Bucket Count\t: %d\n",bktsCount);
-        printf("Mh Count\t: %d\n",mhCount);
+        printf("Rule Count\t: %d\n",rulesCount.load());
+        printf("Trans Count\t: %d\n",transCount.load());
+        printf("Bucket Count\t: %d\n",bktsCount.load());
+        printf("Mh Count\t: %d\n",mhCount.load());
     }
 
 }
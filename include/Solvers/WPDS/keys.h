@@ -56,6 +56,12 @@ extern wpds_key_t WPDS_CALL new_str2key( const char * );
 
 extern wpds_key_t WPDS_CALL int2key( int );
 
+/*!
+ * Like new_str2key, new_int2key skips the Dictionary lookup. Use it
+ * only for integers that have not been turned into keys before.
+ */
+extern wpds_key_t WPDS_CALL new_int2key( int );
+
 extern wpds_key_t WPDS_CALL create_key(key_source *);
 
 extern wpds_size_t WPDS_CALL num_keys(void);
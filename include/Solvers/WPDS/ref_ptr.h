@@ -46,6 +46,7 @@
 #include <limits.h>
 #include <iostream>
 #include <vector>
+#include <atomic>
 
 /* A reference counting pointer class
  *
@@ -132,8 +133,9 @@
  * required to store delayed deletions. I think it is roughly twice as slow,
  * but still pretty speedy (45 sec for 16M objects created and deleted?).
  *
- * Another problem with delayed deletes is that it is not thread-safe
- * (though it is unclear whether the rest of ref_ptr is thread safe).
+ * Death row is kept per thread, so delayed deletes are thread-safe. The
+ * rest of ref_ptr is thread-safe as long as objects shared between threads
+ * use an AtomicRefCounter as their count.
  * 
  * NOTE: This mechanism has been set to be on by default (it is controlled
  * by the second template parameter of ref_ptr).
@@ -171,6 +173,35 @@ class RefCounter
 
 inline bool operator==(unsigned i, const RefCounter &rc) { return rc == i; }
 
+/* AtomicRefCounter is a RefCounter that can be shared between threads,
+   e.g. by the semiring elements of a WPDS that is saturated by several
+   threads at once (see MultiQuery.h). Decrements return the new count so
+   that ref_ptr decrements and tests the count in a single atomic step. */
+class AtomicRefCounter
+{
+    friend std::ostream &
+    operator<<( std::ostream& o, const AtomicRefCounter& rc )
+    {
+        return (o << rc.cnt.load());
+    }
+
+ public:
+    AtomicRefCounter(unsigned _cnt = 0) : cnt(_cnt) { }
+
+    AtomicRefCounter(const AtomicRefCounter &that) : cnt(0) { }
+
+    unsigned operator++() { return ++cnt; }
+    unsigned operator--() { return --cnt; }
+
+    AtomicRefCounter & operator=(const AtomicRefCounter &that) { return *this; }
+
+    bool operator==(unsigned i) const { return i == cnt.load(); }
+ private:
+    std::atomic<unsigned> cnt;
+};
+
+inline bool operator==(unsigned i, const AtomicRefCounter &rc) { return rc == i; }
+
 // DelayedDeleter contains one static function: delete_it. This
 // function keeps a stack of "delayed" deletes, which it then empties
 // (as described above under GRAMMATECH_NONRECURSIVE_DELETE). 
@@ -196,15 +227,15 @@ struct DelayedDeleter
     {
         // The stack that we use to store delayed deletes (leaked 
         // memory)
-        static std::vector<DelayedDel_t>* 
+        static thread_local std::vector<DelayedDel_t>* 
             pDeathRow = new std::vector<DelayedDel_t>;
 
         // A bound on the size of the stack when not in use
-        static unsigned int DfltCapacity = 
+        static thread_local unsigned int DfltCapacity = 
             (pDeathRow->capacity() > 1024) ? pDeathRow->capacity() : 1024;
 
         // A flag that tells us if we're the first in a chain of deletes
-        static bool b_first(true);
+        static thread_local bool b_first(true);
 
         // Push this "delete action" to be triggered later.
         // "delete actions" are processed in LIFO order.
@@ -398,12 +429,14 @@ private:
     release(T * old_ptr)
     {
         if( old_ptr ) {
-            --old_ptr->count;
+            // Decrement and test at once: another thread may release
+            // its last reference in between.
+            const bool last = ( --old_ptr->count == 0 );
 #ifdef DBGREFPTR
             std::cout << "Released " << *old_ptr << " with count = "
                       << old_ptr->count << std::endl;
 #endif
-            if( old_ptr->count == 0 ) {
+            if( last ) {
 #ifdef DBGREFPTR
                 std::cout << "Deleting ptr: " << *old_ptr << std::endl;
 #endif
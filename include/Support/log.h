@@ -8,6 +8,7 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <type_traits>
 
@@ -51,7 +52,8 @@ public:
         return m_config; 
     }
     
-    // Get the appropriate output stream based on current config
+    // Get the appropriate output stream based on current config (or the
+    // buffer of the LogCapture of the calling thread)
     std::ostream& getStream();
 
 private:
@@ -64,6 +66,24 @@ private:
     bool m_streamInitialized = false;
 };
 
+// Buffers the log output of the calling thread while alive, so that tasks
+// running in parallel can emit their logs in a deterministic order.
+class LogCapture {
+public:
+    LogCapture();
+    ~LogCapture();
+
+    // No copy or move
+    LogCapture(const LogCapture&) = delete;
+    LogCapture& operator=(const LogCapture&) = delete;
+
+    std::string str() const { return m_buffer.str(); }
+
+private:
+    std::ostringstream m_buffer;
+    std::ostream* m_previous;
+};
+
 namespace detail {
     // C++14 compatible void_t implementation
     template <typename...> struct make_void { typedef void type; };
@@ -26,8 +26,10 @@ private:
         DynamicPointer func;
         LocalMap localMap;
     };
-    std::vector<Frame> stackFrames;
+    // The records of the threads are interleaved, each has its own stack
+    DenseMap<unsigned, std::vector<Frame>> threadFrames;
 
+    std::vector<Frame>& stackFrames() { return threadFrames[getThreadId()]; }
     static bool intersects(const PtsSet&, const PtsSet&);
     void findAliasPairs();
 
@@ -51,9 +53,10 @@ bool AnalysisImpl::intersects(const PtsSet& lhs, const PtsSet& rhs) {
 }
 
 void AnalysisImpl::findAliasPairs() {
-    auto func = stackFrames.back().func;
+    auto& frames = stackFrames();
+    auto func = frames.back().func;
     auto& summary = aliasPairMap[func];
-    auto const& localMap = stackFrames.back().localMap;
+    auto const& localMap = frames.back().localMap;
 
     for (auto itr = localMap.begin(), ite = localMap.end(); itr != ite; ++itr) {
         auto itr2 = itr;
@@ -76,23 +79,24 @@ void AnalysisImpl::visitAllocRecord(const AllocRecord& allocRecord) {
     if (allocRecord.type == AllocType::Global) {
         globalMap[allocRecord.id] = allocRecord.address;
     } else {
-        stackFrames.back().localMap[allocRecord.id].insert(allocRecord.address);
+        stackFrames().back().localMap[allocRecord.id].insert(allocRecord.address);
     }
 }
 
 void AnalysisImpl::visitPointerRecord(const PointerRecord& ptrRecord) {
-    stackFrames.back().localMap[ptrRecord.id].insert(ptrRecord.address);
+    stackFrames().back().localMap[ptrRecord.id].insert(ptrRecord.address);
 }
 
 void AnalysisImpl::visitEnterRecord(const EnterRecord& enterRecord) {
-    stackFrames.push_back(Frame{enterRecord.id, LocalMap()});
+    stackFrames().push_back(Frame{enterRecord.id, LocalMap()});
 }
 
 void AnalysisImpl::visitExitRecord(const ExitRecord& exitRecord) {
-    if (stackFrames.back().func != exitRecord.id)
+    auto& frames = stackFrames();
+    if (frames.back().func != exitRecord.id)
         throw std::logic_error("Function entry/exit do not match");
     findAliasPairs();
-    stackFrames.pop_back();
+    frames.pop_back();
 }
 
 void AnalysisImpl::visitCallRecord(const CallRecord& callRecord) {
@@ -6,10 +6,21 @@
 namespace dynamic
 {
 
-LogPrinter::LogPrinter(const char* fileName, std::ostream& o): LogProcessor(fileName), os(o) {}
+LogPrinter::LogPrinter(const char* fileName, std::ostream& o): LogProcessor(fileName), os(o), lastThreadId(0) {}
+
+void LogPrinter::printThread()
+{
+	// the records of a single-threaded program are printed as they were
+	if (getThreadId() != lastThreadId)
+	{
+		lastThreadId = getThreadId();
+		os << "[THREAD] Thread# " << lastThreadId << '\n';
+	}
+}
 
 void LogPrinter::visitAllocRecord(const AllocRecord& allocRecord)
 {
+	printThread();
 	os << "[ALLOC] ";
 	switch (allocRecord.type)
 	{
@@ -31,21 +42,25 @@ void LogPrinter::visitAllocRecord(const AllocRecord& allocRecord)
 
 void LogPrinter::visitPointerRecord(const PointerRecord& ptrRecord)
 {
+	printThread();
 	os << "[POINTER] Ptr# " << ptrRecord.id << " = " << ptrRecord.address << '\n';
 }
 
 void LogPrinter::visitEnterRecord(const EnterRecord& enterRecord)
 {
+	printThread();
 	os << "[ENTER] Function# " << enterRecord.id << '\n';
 }
 
 void LogPrinter::visitExitRecord(const ExitRecord& exitRecord)
 {
+	printThread();
 	os << "[EXIT] Function# " << exitRecord.id << '\n';
 }
 
 void LogPrinter::visitCallRecord(const CallRecord& callRecord)
 {
+	printThread();
 	os << "[CALL] Inst# " << callRecord.id << '\n';
 }
 
@@ -1,7 +1,11 @@
 #include "Alias/Dynamic/LogReader.h"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#ifdef DYNAA_ZLIB
+#include <zlib.h>
+#endif
 
 namespace dynamic
 {
@@ -56,41 +60,148 @@ static boost::optional<LogRecord> readRecord(std::istream& is)
 		return boost::make_optional(std::move(rec));
 }
 
+static void brokenLog(const char* reason)
+{
+	std::cerr << reason << ". Log file must be broken.\n";
+	std::exit(-1);
+}
+
 std::vector<LogRecord> EagerLogReader::readLogFromFile(const char* fileName)
 {
 	std::vector<LogRecord> ret;
 
-	std::ifstream file(fileName, std::ios::in|std::ios::binary|std::ios::ate);
-	if (file.is_open())
-	{
-		auto size = file.tellg();
-		auto numEntry = size / sizeof(LogRecord);
-		ret.reserve(numEntry);
-
-		file.seekg(0, std::ios::beg);
-		for (auto i = 0u; i < static_cast<size_t>(numEntry); ++i)
-		{
-			auto rec = readRecord(file);
-			assert(rec && "Log read failure");
-			ret.emplace_back(std::move(*rec));
-		}
-	}
+	LazyLogReader reader(fileName);
+	while (auto rec = reader.readLogRecord())
+		ret.emplace_back(std::move(*rec));
 
 	return ret;
 }
 
-LazyLogReader::LazyLogReader(const char* fileName): ifs(fileName, std::ios::in|std::ios::binary)
+LazyLogReader::LazyLogReader(const char* fileName): ifs(fileName, std::ios::in|std::ios::binary), legacy(false), pos(0), threadId(0), lastAddress(0)
 {
 	if (!ifs.is_open())
 	{
 		std::cerr << "Open log file " << fileName << " failed\n";
 		std::exit(-1);
 	}
+
+	LogFileHeader header;
+	if (!readData(ifs, &header) || std::memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0)
+	{
+		legacy = true;
+		ifs.clear();
+		ifs.seekg(0, std::ios::beg);
+	}
+	else if (header.version != LOG_VERSION)
+	{
+		std::cerr << "Log file version " << header.version << " is not supported\n";
+		std::exit(-1);
+	}
+}
+
+bool LazyLogReader::readBlock()
+{
+	LogBlockHeader header;
+	if (!readData(ifs, &header))
+		return false;
+
+	std::vector<unsigned char> stored(header.storedSize);
+	if (!ifs.read(reinterpret_cast<char*>(stored.data()), stored.size()))
+		brokenLog("Truncated log block");
+
+	if (header.flags & LOG_BLOCK_COMPRESSED)
+	{
+#ifdef DYNAA_ZLIB
+		block.resize(header.rawSize);
+		uLongf rawSize = header.rawSize;
+		if (uncompress(block.data(), &rawSize, stored.data(), stored.size()) != Z_OK || rawSize != header.rawSize)
+			brokenLog("Log block decompression failed");
+#else
+		std::cerr << "The log is compressed, but the reader is built without zlib\n";
+		std::exit(-1);
+#endif
+	}
+	else
+	{
+		if (header.rawSize != header.storedSize)
+			brokenLog("Illegal log block size");
+		block = std::move(stored);
+	}
+
+	pos = 0;
+	threadId = header.threadId;
+	lastAddress = 0;
+	return true;
+}
+
+uint64_t LazyLogReader::readVarint()
+{
+	uint64_t ret = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		if (pos >= block.size())
+			brokenLog("Truncated log record");
+		auto byte = block[pos++];
+		ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return ret;
+	}
+	brokenLog("Illegal varint");
+	return 0;
+}
+
+boost::optional<LogRecord> LazyLogReader::readBlockRecord()
+{
+	auto readAddress = [this]
+	{
+		auto zigzag = readVarint();
+		auto delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+		lastAddress += delta;
+		return reinterpret_cast<void*>(lastAddress);
+	};
+
+	while (pos >= block.size())
+	{
+		if (!readBlock())
+			return boost::optional<LogRecord>();
+	}
+
+	LogRecord rec;
+	char type = block[pos++];
+	switch (type)
+	{
+		case TAllocRec:
+			if (pos >= block.size())
+				brokenLog("Truncated log record");
+			rec.allocRecord.type = block[pos++];
+			rec.allocRecord.id = readVarint();
+			rec.allocRecord.address = readAddress();
+			break;
+		case TPointerRec:
+			rec.ptrRecord.id = readVarint();
+			rec.ptrRecord.address = readAddress();
+			break;
+		case TEnterRec:
+			rec.enterRecord.id = readVarint();
+			break;
+		case TExitRec:
+			rec.exitRecord.id = readVarint();
+			break;
+		case TCallRec:
+			rec.callRecord.id = readVarint();
+			break;
+		default:
+			brokenLog("Illegal record type");
+	}
+	rec.type = static_cast<LogRecordType>(type);
+	return boost::make_optional(std::move(rec));
 }
 
 boost::optional<LogRecord> LazyLogReader::readLogRecord()
 {
-	return readRecord(ifs);
+	if (legacy)
+		return readRecord(ifs);
+	return readBlockRecord();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "Alias/PestrieAA/PestrieAA.h"
+#include "Alias/Andersen/AndersenAA.h"
+#include "Alias/DyckAA/DyckAliasAnalysis.h"
+#include "Pestrie/query.hh"
+
+#include <llvm/IR/InstIterator.h>
+
+using namespace llvm;
+using namespace lotus;
+
+namespace {
+
+// Collects the pointers of the listed equivalent sets
+class CollectFilter : public IFilter {
+public:
+  explicit CollectFilter(std::vector<int> &Out) : Out(Out) {}
+
+  bool validate(int X) override {
+    Out.push_back(X);
+    return true;
+  }
+
+private:
+  std::vector<int> &Out;
+};
+
+} // namespace
+
+PestrieAAResult::PestrieAAResult(const Module &M, const PointsToFunc &PointsTo) {
+  // The pointer values of the module
+  auto AddPointer = [this](const Value *V) {
+    if (V->getType()->isPointerTy() && PointerIds.try_emplace(V, Pointers.size()).second)
+      Pointers.push_back(V);
+  };
+  for (auto &G : M.globals())
+    AddPointer(&G);
+  for (auto &F : M) {
+    AddPointer(&F);
+    for (auto &Arg : F.args())
+      AddPointer(&Arg);
+    for (auto &I : instructions(F))
+      AddPointer(&I);
+  }
+
+  // Number the objects and fill the points-to matrix. A pointer the analysis
+  // knows nothing about is left out of the index.
+  DenseMap<const void *, int> ObjectIds;
+  std::vector<std::vector<int>> Rows(Pointers.size());
+  std::vector<const Value *> Indexed;
+  std::vector<const void *> Objects;
+  for (unsigned I = 0; I < Pointers.size(); ++I) {
+    Objects.clear();
+    if (!PointsTo(Pointers[I], Objects)) {
+      PointerIds.erase(Pointers[I]);
+      continue;
+    }
+    std::vector<int> &Row = Rows[Indexed.size()];
+    for (const void *Obj : Objects)
+      Row.push_back(ObjectIds.try_emplace(Obj, ObjectIds.size()).first->second);
+    std::sort(Row.begin(), Row.end());
+    Row.erase(std::unique(Row.begin(), Row.end()), Row.end());
+    PointerIds[Pointers[I]] = Indexed.size();
+    Indexed.push_back(Pointers[I]);
+  }
+  Pointers.swap(Indexed);
+  Rows.resize(Pointers.size());
+  NumObjects = ObjectIds.size();
+
+  if (!Pointers.empty() && NumObjects != 0)
+    Index.reset(build_pestrie_index(Pointers.size(), NumObjects, Rows.data()));
+}
+
+PestrieAAResult::~PestrieAAResult() = default;
+
+std::unique_ptr<PestrieAAResult>
+PestrieAAResult::fromAndersen(const Module &M, const AndersenAAResult &AA) {
+  return std::make_unique<PestrieAAResult>(
+      M, [&AA](const Value *V, std::vector<const void *> &Objects) {
+        // An empty set may be a pointer missing from the points-to graph,
+        // which Andersen's analysis treats as unknown
+        std::vector<const Value *> PtsSet;
+        if (!AA.getPointsToSet(V, PtsSet) || PtsSet.empty())
+          return false;
+        Objects.assign(PtsSet.begin(), PtsSet.end());
+        return true;
+      });
+}
+
+std::unique_ptr<PestrieAAResult>
+PestrieAAResult::fromDyckAA(const Module &M, DyckAliasAnalysis &AA) {
+  DyckGraph *DG = AA.getDyckGraph();
+  return std::make_unique<PestrieAAResult>(
+      M, [DG](const Value *V, std::vector<const void *> &Objects) {
+        // The pointers of a vertex are exactly the aliases of each other, and
+        // a pointer without a vertex aliases nothing else
+        DyckGraphNode *Node = DG->findDyckVertex(const_cast<Value *>(V));
+        Objects.push_back(Node ? (const void *)Node : V);
+        return true;
+      });
+}
+
+int PestrieAAResult::getPointerId(const Value *V) const {
+  // A constant cast or GEP is not indexed, but may be its base pointer
+  auto It = PointerIds.find(V);
+  if (It == PointerIds.end())
+    It = PointerIds.find(V->stripPointerCasts());
+  return It == PointerIds.end() ? -1 : It->second;
+}
+
+AliasResult PestrieAAResult::alias(const MemoryLocation &LocA,
+                                   const MemoryLocation &LocB) {
+  if (LocA.Size == 0 || LocB.Size == 0)
+    return AliasResult::NoAlias;
+
+  if (LocA.Ptr->stripPointerCasts() == LocB.Ptr->stripPointerCasts())
+    return AliasResult::MustAlias;
+
+  // The casts are indexed themselves, as an analysis may tell them apart
+  // from their operands, e.g. a field of a struct from the struct
+  int X = getPointerId(LocA.Ptr);
+  int Y = getPointerId(LocB.Ptr);
+  if (X == -1 || Y == -1 || !Index)
+    return AliasResult::MayAlias;
+  return Index->IsAlias(X, Y) ? AliasResult::MayAlias : AliasResult::NoAlias;
+}
+
+bool PestrieAAResult::getAliases(const Value *V,
+                                 std::vector<const Value *> &Aliases) {
+  int X = getPointerId(V);
+  if (X == -1)
+    return false;
+  if (!Index)
+    return true;
+
+  std::vector<int> Ids;
+  CollectFilter Filter(Ids);
+  Index->ListAliases(X, &Filter);
+  for (int Id : Ids)
+    Aliases.push_back(Pointers[Id]);
+  return true;
+}
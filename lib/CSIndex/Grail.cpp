@@ -4,12 +4,13 @@ The software is provided on an as is basis for research purposes.
 There is no additional support offered, nor are the author(s) 
 or their institutions liable under any circumstances.
 */
+#include <atomic>
 #include <queue>
 #include <random>
+#include <thread>
 #include "CSIndex/Grail.h"
 #include "CSIndex/TCSEstimator.h"
 
-vector<int> _index;
 vector<double> customIndex;
 
 template<class T> struct index_cmp {
@@ -39,63 +40,121 @@ GRAIL LABELING :
 		8- mingapvisit - used by min gap labeling
 *******************************************************************************************/
 
-Grail::Grail(Graph& graph, int Dim, int labelingType, bool pool, int poolsize): g(graph),dim(Dim), POOL(pool), POOLSIZE(poolsize) {
+Grail::Grail(Graph& graph, int Dim, int labelingType, bool pool, int poolsize, int threads): g(graph),dim(Dim), POOL(pool), POOLSIZE(poolsize) {
 	int i, maxid = g.num_vertices();
 	visited = new int[maxid];
 	QueryCnt = 0;
 	if(labelingType >=2){
 		TCSEstimator tcse(graph,100);
 	}
-	for(i = 0 ; i< maxid; i++){
-		graph[i].pre = new vector<int>();
-		graph[i].post = new vector<int>();
-		graph[i].middle = new vector<int>();
-		visited[i]=-1;
-	}
 	if(!POOL){
 		POOLSIZE = dim;
 	}
-	for(i=0;i<POOLSIZE;i++){
-		switch(labelingType){
-			case 0 : Grail::randomlabeling(graph);
-							 break;
-			case 1 : Grail::setIndex(graph,i);
-							 Grail::fixedreverselabeling(graph,i);
-							 break;
-			default : 
-							 Grail::setCustomIndex(graph,i,labelingType);
-							 Grail::customlabeling(graph,i);
-							 break;
-		}
-		cout << "Labeling " << i << " is completed" << endl;
-/*		for( int k = 0 ; k < maxid; k++){
-			cout << k << "["<<(graph[k].pre)->at(i) << ","<<(graph[k].post)->at(i) << "] ";
+	for(i = 0 ; i< maxid; i++){
+		graph[i].pre = new vector<int>(POOLSIZE);
+		graph[i].post = new vector<int>(POOLSIZE);
+		graph[i].middle = new vector<int>(POOLSIZE);
+		visited[i]=-1;
+	}
+	if(labelingType >= 2){
+		// a custom labeling is ordered by the previous one
+		for(i=0;i<POOLSIZE;i++){
+			Grail::setCustomIndex(graph,i,labelingType);
+			Grail::customlabeling(graph,i);
+			cout << "Labeling " << i << " is completed" << endl;
 		}
-		cout << endl;
-*/
+	}else{
+		// the other labelings are independent: each thread computes whole labelings
+		unsigned seed = std::random_device()();
+		if(threads <= 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = min(threads, POOLSIZE);
+		std::atomic<int> next(0);
+		auto worker = [&]() {
+			for(int d = next++; d < POOLSIZE; d = next++){
+				if(labelingType == 0)
+					Grail::randomlabeling(graph, d, seed);
+				else
+					Grail::fixedreverselabeling(graph, d, Grail::fixedIndex(maxid, d, seed));
+			}
+		};
+		vector<std::thread> workers;
+		for(i=1;i<threads;i++)
+			workers.emplace_back(worker);
+		worker();
+		for(auto& w : workers)
+			w.join();
+		cout << "Labeling 0-" << POOLSIZE-1 << " is completed" << endl;
 	}
 	PositiveCut = NegativeCut = TotalCall = TotalDepth = CurrentDepth = 0;
 }
 
+// GRAIL_LABELS: dim, #vertices, then the pre, middle and post labels of every vertex
+Grail::Grail(Graph& graph, const IndexFile& file): g(graph), POOL(false) {
+	IndexFile::Reader labels = file.section(IndexFile::GRAIL_LABELS);
+	dim = labels.next();
+	int i, j, maxid = labels.next();
+	assert(maxid == g.num_vertices());
+	visited = new int[maxid];
+	QueryCnt = 0;
+	POOLSIZE = dim;
+	for(i = 0 ; i< maxid; i++){
+		graph[i].pre = new vector<int>(dim);
+		graph[i].post = new vector<int>(dim);
+		graph[i].middle = new vector<int>(dim);
+		for(j = 0; j < dim; j++)
+			(*graph[i].pre)[j] = labels.next();
+		for(j = 0; j < dim; j++)
+			(*graph[i].middle)[j] = labels.next();
+		for(j = 0; j < dim; j++)
+			(*graph[i].post)[j] = labels.next();
+		visited[i]=-1;
+	}
+	assert(labels.done());
+	PositiveCut = NegativeCut = TotalCall = TotalDepth = CurrentDepth = 0;
+}
+
 Grail::~Grail() {
 }
 
+void Grail::save(IndexFile::Writer& file) {
+	vector<int32_t>& labels = file.add(IndexFile::GRAIL_LABELS);
+	int maxid = g.num_vertices();
+	labels.reserve(2 + (size_t)maxid * dim * 3);
+	labels.push_back(dim);
+	labels.push_back(maxid);
+	for(int i = 0; i < maxid; i++){
+		labels.insert(labels.end(), g[i].pre->begin(), g[i].pre->begin() + dim);
+		labels.insert(labels.end(), g[i].middle->begin(), g[i].middle->begin() + dim);
+		labels.insert(labels.end(), g[i].post->begin(), g[i].post->begin() + dim);
+	}
+}
+
+bool Grail::canLoad(Graph& graph, int dim, const IndexFile& file) {
+	if(!file.has(IndexFile::GRAIL_LABELS))
+		return false;
+	IndexFile::Reader labels = file.section(IndexFile::GRAIL_LABELS);
+	return file.sectionBytes(IndexFile::GRAIL_LABELS) >= 2 * sizeof(int32_t) &&
+		labels.next() == dim && labels.next() == graph.num_vertices();
+}
+
 void Grail::set_level_filter(bool lf){
 	LEVEL_FILTER = lf;
 }
 
 
-void Grail::setIndex(Graph& g, int traversal){
-	if(traversal==0){
-		int cnt = g.num_vertices();
-		for(int i=0; i<cnt; i++){
-			_index.push_back(i);
-		}
-	}else if(traversal%2==0){
-		std::random_device rd;
-		std::mt19937 g(rd());
-		std::shuffle(_index.begin(),_index.end(), g);
-	}	
+// the ranks of the vertices for the fixed reverse traversal: traversals 2k and 2k+1 visit the
+// vertices in the order of the same random permutation, the latter in reverse
+vector<int> Grail::fixedIndex(int n, int traversal, unsigned seed){
+	vector<int> index(n);
+	for(int i=0; i<n; i++){
+		index[i] = i;
+	}
+	if(traversal >= 2){
+		std::mt19937 g(seed + traversal/2);
+		std::shuffle(index.begin(),index.end(), g);
+	}
+	return index;
 }
 
 void Grail::setCustomIndex(Graph& g, int traversal, int type){
@@ -144,162 +203,87 @@ void Grail::setCustomIndex(Graph& g, int traversal, int type){
 */
 }
 
-// compute interval label for each node of tree (pre_order, post_order)
-void Grail::fixedreverselabeling(Graph& tree, int traversal) {
-	vector<int> roots = tree.getRoots();
-	vector<int>::iterator sit;
+// compute interval label d of each node of tree (pre_order, post_order) with an iterative DFS,
+// visiting the roots and the children of each node in the order given by order(begin, end)
+template<typename Order>
+static void intervalLabeling(Graph& tree, int d, Order order, bool mingap) {
+	struct Frame {
+		int vid;
+		int begin;	// the children of vid are children[begin, end)
+		int next;
+		int end;
+		int pre_order;
+	};
+	int n = tree.num_vertices();
+	vector<bool> visited(n, false);
+	vector<int> children;	// children of the nodes on the stack
+	vector<Frame> stack;
 	int pre_post = 0;
-	vector<bool> visited(tree.num_vertices(), false);
-	sort(roots.begin(),roots.end(),index_cmp<vector<int>&>(_index));
-	if(traversal %2 )
-		reverse(roots.begin(),roots.end());
-		
-	for (sit = roots.begin(); sit != roots.end(); sit++) {
-		pre_post++;
-		fixedreversevisit(tree, *sit, pre_post, visited, traversal);
-	}
-}
-
-// compute interval label for each node of tree (pre_order, post_order)
-void Grail::customlabeling(Graph& graph, int traversal) {
-	vector<int> roots = graph.getRoots();
-	vector<int>::iterator sit;
-	int pre_post = 0;
-	vector<bool> visited(graph.num_vertices(), false);
-
-	
-/*	cout << " Sorting roots - before " ;
-	for (sit = roots.begin(); sit != roots.end(); sit++) {
-		cout << " customIndex[" << *sit<<"]=" << customIndex[*sit] << " " ;   
-	} cout << endl;
-*/
-	
-	sort(roots.begin(),roots.end(),custom_cmp<vector<double>&>(customIndex));
-
-/*	cout << " Sorting roots - before " ;
-	for (sit = roots.begin(); sit != roots.end(); sit++) {
-		cout << " customIndex[" << *sit<<"]=" << customIndex[*sit] << " " ;   
-	} cout << endl;
-*/
-
-	for (sit = roots.begin(); sit != roots.end(); sit++) {
-		pre_post++;
-		customvisit(graph, *sit, pre_post, visited, traversal);
-	}
-}
 
-// traverse tree to label node with pre and post order by giving a start node
-int Grail::customvisit(Graph& tree, int vid, int& pre_post, vector<bool>& visited, int traversal) {
-	visited[vid] = true;
-	EdgeList el = tree.out_edges(vid);
-	EdgeList::iterator eit;
-	
-/*	cout << " Sorting children of " << vid << "  - before " ;
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		cout << " customIndex[" << *eit<<"]=" << customIndex[*eit] << " " ;   
-	} cout << endl;
-*/
-	sort(el.begin(),el.end(),custom_cmp<vector<double>&>(customIndex));
-	
-/*
-	cout << " Sorting children of " << vid << "  - after " ;
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		cout << " customIndex[" << *eit<<"]=" << customIndex[*eit] << " " ;   
-	} cout << endl;
-*/
-	int pre_order = tree.num_vertices()+1;
-	tree[vid].middle->push_back(pre_post);
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		if (!visited[*eit]){
-			pre_order=min(pre_order,customvisit(tree, *eit, pre_post, visited,traversal));
-		}else
-			pre_order=min(pre_order,tree[*eit].pre->back());
-	}
-	
-	pre_order=min(pre_order,pre_post);
-	tree[vid].pre->push_back(pre_order);
-	tree[vid].post->push_back(pre_post);
-	if(pre_post - pre_order < tree[vid].mingap){
-		tree[vid].mingap = pre_post - pre_order;
-	}	
-	pre_post++;
-//	cout << "exiting " << vid << endl;
-	return pre_order;
-}
+	auto enter = [&](int vid) {
+		visited[vid] = true;
+		(*tree[vid].middle)[d] = pre_post;
+		int begin = children.size();
+		EdgeList& el = tree.out_edges(vid);
+		children.insert(children.end(), el.begin(), el.end());
+		order(children.begin() + begin, children.end());
+		stack.push_back(Frame{vid, begin, begin, (int)children.size(), n+1});
+	};
 
-// compute interval label for each node of tree (pre_order, post_order)
-void Grail::randomlabeling(Graph& tree) {
 	vector<int> roots = tree.getRoots();
-	vector<int>::iterator sit;
-	int pre_post = 0;
-	vector<bool> visited(tree.num_vertices(), false);
-	std::random_device rd;
-	std::mt19937 g(rd());
-	std::shuffle(roots.begin(),roots.end(), g);	
-	for (sit = roots.begin(); sit != roots.end(); sit++) {
+	order(roots.begin(), roots.end());
+	for (int root : roots) {
 		pre_post++;
-		visit(tree, *sit, pre_post, visited);
+		enter(root);
+		while (!stack.empty()) {
+			Frame& f = stack.back();
+			if (f.next < f.end) {
+				int child = children[f.next++];
+				if (!visited[child])
+					enter(child);
+				else
+					f.pre_order = min(f.pre_order, (*tree[child].pre)[d]);
+				continue;
+			}
+			int vid = f.vid;
+			int pre_order = min(f.pre_order, pre_post);
+			(*tree[vid].pre)[d] = pre_order;
+			(*tree[vid].post)[d] = pre_post;
+			if(mingap && pre_post - pre_order < tree[vid].mingap){
+				tree[vid].mingap = pre_post - pre_order;
+			}
+			pre_post++;
+			children.resize(f.begin);
+			stack.pop_back();
+			if (!stack.empty())
+				stack.back().pre_order = min(stack.back().pre_order, pre_order);
+		}
 	}
 }
 
-// traverse tree to label node with pre and post order by giving a start node
-int Grail::visit(Graph& tree, int vid, int& pre_post, vector<bool>& visited) {
-//	cout << "entering " << vid << endl;
-	visited[vid] = true;
-	EdgeList el = tree.out_edges(vid);
-	std::random_device rd;
-	std::mt19937 g(rd());
-	std::shuffle(el.begin(),el.end(), g);
-	EdgeList::iterator eit;
-	int pre_order = tree.num_vertices()+1;
-	tree[vid].middle->push_back(pre_post);
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		if (!visited[*eit]){
-			pre_order=min(pre_order,visit(tree, *eit, pre_post, visited));
-		}else
-			pre_order=min(pre_order,tree[*eit].pre->back());
-			//pre_order=min(pre_order,tree[*eit].pre->at(tree[*eit].pre->size()-1));
-	}
-	
-	pre_order=min(pre_order,pre_post);
-	tree[vid].pre->push_back(pre_order);
-	tree[vid].post->push_back(pre_post);
-	pre_post++;
-	return pre_order;
+// compute interval label d for each node of tree with fixed reverse ordering
+void Grail::fixedreverselabeling(Graph& tree, int d, const vector<int>& index) {
+	intervalLabeling(tree, d, [&](vector<int>::iterator begin, vector<int>::iterator end) {
+		sort(begin, end, index_cmp<const vector<int>&>(index));
+		if(d %2 )
+			reverse(begin, end);
+	}, false);
 }
 
-// traverse tree to label node with pre and post order by giving a start node
-int Grail::fixedreversevisit(Graph& tree, int vid, int& pre_post, vector<bool>& visited, int traversal) {
-//	cout << "entering " << vid << endl;
-	visited[vid] = true;
-	EdgeList el = tree.out_edges(vid);
-	sort(el.begin(),el.end(),index_cmp<vector<int>&>(_index));	
-	if(traversal %2 )
-		reverse(el.begin(),el.end());
-	EdgeList::iterator eit;
-	int pre_order = tree.num_vertices()+1;
-	tree[vid].middle->push_back(pre_post);
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		if (!visited[*eit]){
-			pre_order=min(pre_order,fixedreversevisit(tree, *eit, pre_post, visited,traversal));
-		}else
-			pre_order=min(pre_order,tree[*eit].pre->back());
-			//pre_order=min(pre_order,tree[*eit].pre->at(tree[*eit].pre->size()-1));
-	}
-	
-	pre_order=min(pre_order,pre_post);
-	tree[vid].pre->push_back(pre_order);
-	tree[vid].post->push_back(pre_post);
-	pre_post++;
-//	cout << "exiting " << vid << endl;
-	return pre_order;
+// compute interval label d for each node of tree with the ordering of customIndex
+void Grail::customlabeling(Graph& tree, int d) {
+	intervalLabeling(tree, d, [&](vector<int>::iterator begin, vector<int>::iterator end) {
+		sort(begin, end, custom_cmp<vector<double>&>(customIndex));
+	}, true);
 }
 
-
-
-
-
-
+// compute interval label d for each node of tree with random ordering
+void Grail::randomlabeling(Graph& tree, int d, unsigned seed) {
+	std::mt19937 g(seed + d);
+	intervalLabeling(tree, d, [&](vector<int>::iterator begin, vector<int>::iterator end) {
+		std::shuffle(begin, end, g);
+	}, false);
+}
 
 /*************************************************************************************
 GRAIL Query Functions
@@ -440,46 +424,134 @@ bool Grail::go_for_reach_lf(int src, int trg) {
 	return false;
 }
 
+// Per-thread state of the traversals of the queries, so that queries can run concurrently:
+// a vertex was visited by the current traversal iff visited[v] == stamp
+namespace {
+struct TraversalScratch {
+	vector<unsigned> visited;
+	unsigned stamp = 0;
+	vector<int> stack;
+};
+
+thread_local TraversalScratch scratch;
+
+TraversalScratch& beginTraversal(int n) {
+	if(scratch.visited.size() < (size_t)n)
+		scratch.visited.resize(n, 0);
+	if(++scratch.stamp == 0){
+		std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+		scratch.stamp = 1;
+	}
+	scratch.stack.clear();
+	return scratch;
+}
+}
+
 bool Grail::go_for_reachPP_lf(int src, int trg) {
-	int res;
-#ifdef DEBUG
-	TotalCall++;
-	CurrentDepth++;
-#endif
 	if(src==trg)
 		return true;
-	
-	if(g[src].top_level >= g[trg].top_level)		// if using level filter, reject if in a higher topological level
-		return false;
-
-	visited[src] = QueryCnt;
-	EdgeList el = g.out_edges(src);
-   	EdgeList::iterator eit;   
+	return search(&src, 1, trg);
+}
 
-	for (eit = el.begin(); eit != el.end(); eit++) {
-		if(visited[*eit]!=QueryCnt){
-			res = containsPP(*eit,trg);
-			switch(res){
-				case 1 : 	
-#ifdef DEBUG
-									TotalDepth+= CurrentDepth;
-									PositiveCut++; 
-#endif
-									return true;
-				case 0 : if (go_for_reachPP_lf(*eit,trg))
-										return true; 
-									break;
-				case -1 :	
-#ifdef DEBUG
-									NegativeCut++;
-#endif
+// a DFS from all the sources that prunes the vertices whose labels exclude trg
+bool Grail::search(const int* srcs, size_t num_srcs, int trg) {
+	TraversalScratch& sc = beginTraversal(g.num_vertices());
+	for(size_t i = 0; i < num_srcs; i++){
+		if(sc.visited[srcs[i]] != sc.stamp){
+			sc.visited[srcs[i]] = sc.stamp;
+			sc.stack.push_back(srcs[i]);
+		}
+	}
+	while(!sc.stack.empty()){
+		int v = sc.stack.back();
+		sc.stack.pop_back();
+		if(g[v].top_level >= g[trg].top_level)		// if using level filter, reject if in a higher topological level
+			continue;
+		for(int w : g.out_edges(v)){
+			if(sc.visited[w] == sc.stamp)
+				continue;
+			sc.visited[w] = sc.stamp;	// containsPP(w, trg) does not change
+			if(w == trg)
+				return true;
+			switch(containsPP(w,trg)){
+				case 1 : return true;
+				case 0 : sc.stack.push_back(w);
 									break;
+				case -1 : break;
 			}
 		}
 	}
-#ifdef DEBUG
-	CurrentDepth--;
-#endif
+	return false;
+}
+
+// The targets a vertex may reach are among those whose first post label is in its first interval:
+// pending is sorted by that label, so the candidates of a target are found by binary search
+static void sortByPost(Graph& g, const vector<int>& dsts, vector<int>& pending, vector<int>& keys) {
+	sort(pending.begin(), pending.end(), [&](int a, int b) {
+		return (*g[dsts[a]].post)[0] < (*g[dsts[b]].post)[0];
+	});
+	keys.clear();
+	for(int i : pending)
+		keys.push_back((*g[dsts[i]].post)[0]);
+}
+
+void Grail::reachMany(int src, const vector<int>& dsts, vector<bool>& result) {
+	result.assign(dsts.size(), false);
+	// decide the targets from the labels of src first
+	vector<int> pending;
+	for(size_t i = 0; i < dsts.size(); i++){
+		int trg = dsts[i];
+		if(src == trg)
+			result[i] = true;
+		else if(g[src].top_level >= g[trg].top_level)
+			continue;
+		else if(int res = containsPP(src,trg))
+			result[i] = res > 0;
+		else
+			pending.push_back(i);
+	}
+	if(pending.empty())
+		return;
+	vector<int> keys;
+	sortByPost(g, dsts, pending, keys);
+
+	// the targets reached by a reachable target are reachable: search the targets with the largest labels first
+	for(size_t k = pending.size(); k-- > 0;){
+		int i = pending[k];
+		if(result[i])
+			continue;
+		int trg = dsts[i];
+		if(!search(&src, 1, trg))
+			continue;
+		result[i] = true;
+		auto lo = lower_bound(keys.begin(), keys.end(), (*g[trg].pre)[0]);
+		auto hi = upper_bound(lo, keys.end(), (*g[trg].post)[0]);
+		for(auto it = lo; it != hi; it++){
+			int j = pending[it - keys.begin()];
+			if(!result[j] && (dsts[j] == trg || containsPP(trg,dsts[j]) > 0))
+				result[j] = true;
+		}
+	}
+}
+
+bool Grail::reachAny(const vector<int>& srcs, const vector<int>& dsts) {
+	// one search from all the sources for each target
+	for(int trg : dsts){
+		vector<int> candidates;
+		for(int src : srcs){
+			if(src == trg)
+				return true;
+			if(g[src].top_level >= g[trg].top_level)
+				continue;
+			int res = containsPP(src,trg);
+			if(res > 0)
+				return true;
+			if(res == 0)
+				candidates.push_back(src);
+		}
+		if(!candidates.empty() && search(candidates.data(), candidates.size(), trg))
+			return true;
+	}
 	return false;
 }
 
@@ -933,13 +1005,11 @@ bool Grail::reachPP_lf(int src,int trg, ExceptionList* el){
 								return true;
 		}
 	}
-	CurrentDepth = 0;
 	if(el!=NULL){									// if using exception lists
 			if(el->isAnException(src,trg))	// if it is an exception, reject
 				return false;
 			else
 				return true;
 	}
-	visited[src]=++QueryCnt;
 	return go_for_reachPP_lf(src,trg);
 }
@@ -0,0 +1,195 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CSIndex/IndexFile.h"
+
+namespace {
+
+const char MAGIC[8] = {'C', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_sections;
+    uint64_t key;
+};
+
+uint64_t checksum(const int32_t *data, uint64_t count) {
+    uint64_t h = count;
+    for (uint64_t i = 0; i < count; i++)
+        h = IndexFile::combine(h, (uint32_t) data[i]);
+    return h;
+}
+
+} // namespace
+
+vector<int32_t> &IndexFile::Writer::add(uint32_t kind) {
+    sections.emplace_back(kind, vector<int32_t>());
+    return sections.back().second;
+}
+
+void IndexFile::Writer::copy(const IndexFile &file, uint32_t kind) {
+    const SectionEntry *e = file.find(kind);
+    assert(e);
+    const auto *data = (const int32_t *) ((const char *) file.base + e->offset);
+    add(kind).assign(data, data + e->count);
+}
+
+bool IndexFile::Writer::write(const string &path, uint64_t key) const {
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.num_sections = sections.size();
+    header.key = key;
+
+    vector<SectionEntry> table;
+    uint64_t offset = sizeof(Header) + sections.size() * sizeof(SectionEntry);
+    for (const auto &s : sections) {
+        SectionEntry e;
+        e.kind = s.first;
+        e.reserved = 0;
+        e.offset = offset;
+        e.count = s.second.size();
+        e.checksum = checksum(s.second.data(), s.second.size());
+        table.push_back(e);
+        // keep the sections 8-byte aligned
+        offset += (e.count * sizeof(int32_t) + 7) & ~(uint64_t) 7;
+    }
+
+    string tmp = path + ".tmp";
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Cannot write index file " << tmp << endl;
+        return false;
+    }
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) table.data(), table.size() * sizeof(SectionEntry));
+    const char padding[8] = {0};
+    for (const auto &s : sections) {
+        size_t bytes = s.second.size() * sizeof(int32_t);
+        out.write((const char *) s.second.data(), bytes);
+        out.write(padding, ((bytes + 7) & ~(size_t) 7) - bytes);
+    }
+    out.close();
+    if (!out || rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "Cannot write index file " << path << endl;
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+IndexFile::IndexFile() : base(nullptr), length(0), entries(nullptr), num_entries(0) {}
+
+IndexFile::~IndexFile() {
+    close();
+}
+
+void IndexFile::close() {
+    if (base)
+        munmap(base, length);
+    base = nullptr;
+    length = 0;
+    entries = nullptr;
+    num_entries = 0;
+}
+
+bool IndexFile::open(const string &path, uint64_t key) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+    base = mapping;
+    length = st.st_size;
+
+    const auto *header = (const Header *) base;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION) {
+        cerr << "Ignoring index file " << path << ": not an index file of version " << VERSION << endl;
+        close();
+        return false;
+    }
+    if (header->key != key) {
+        cerr << "Ignoring index file " << path << ": built for another graph" << endl;
+        close();
+        return false;
+    }
+    if (header->num_sections > (length - sizeof(Header)) / sizeof(SectionEntry)) {
+        cerr << "Ignoring index file " << path << ": truncated" << endl;
+        close();
+        return false;
+    }
+    const auto *table = (const SectionEntry *) ((const char *) base + sizeof(Header));
+    for (uint32_t i = 0; i < header->num_sections; i++) {
+        const SectionEntry &e = table[i];
+        if (e.offset % sizeof(int32_t) || e.offset > length ||
+            e.count > (length - e.offset) / sizeof(int32_t)) {
+            cerr << "Ignoring index file " << path << ": truncated" << endl;
+            close();
+            return false;
+        }
+        if (checksum((const int32_t *) ((const char *) base + e.offset), e.count) != e.checksum) {
+            cerr << "Ignoring index file " << path << ": corrupted" << endl;
+            close();
+            return false;
+        }
+    }
+    entries = table;
+    num_entries = header->num_sections;
+    return true;
+}
+
+const IndexFile::SectionEntry *IndexFile::find(uint32_t kind) const {
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (entries[i].kind == kind)
+            return &entries[i];
+    }
+    return nullptr;
+}
+
+bool IndexFile::has(uint32_t kind) const {
+    return find(kind) != nullptr;
+}
+
+IndexFile::Reader IndexFile::section(uint32_t kind) const {
+    const SectionEntry *e = find(kind);
+    assert(e);
+    const auto *data = (const int32_t *) ((const char *) base + e->offset);
+    return Reader(data, data + e->count);
+}
+
+size_t IndexFile::sectionBytes(uint32_t kind) const {
+    const SectionEntry *e = find(kind);
+    return e ? e->count * sizeof(int32_t) : 0;
+}
+
+uint64_t IndexFile::hashGraph(Graph &g) {
+    uint64_t h = combine(0, g.num_vertices());
+    for (int i = 0; i < g.num_vertices(); i++) {
+        EdgeList &succs = g.out_edges(i);
+        h = combine(h, succs.size());
+        for (int t : succs)
+            h = combine(h, t);
+    }
+    return h;
+}
+
+uint64_t IndexFile::combine(uint64_t h, uint64_t v) {
+    // splitmix64 finalizer
+    uint64_t x = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
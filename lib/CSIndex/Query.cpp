@@ -21,6 +21,20 @@ Query::Query(const char* filestem, Graph& ig, int _r, double _ps, bool mat) : g(
 	initQueue();
 }
 
+Query::Query(const IndexFile& file, Graph& ig, int _r, double _ps, bool mat) : g(ig) {
+	initFlags();
+	epsilon = _r;
+	preselectratio = _ps;
+	ismaterialized = mat;
+	gsize = g.num_vertices();
+	loadGates(file.section(IndexFile::BACKBONE_GATES));
+	loadGateGraph(file.section(IndexFile::BACKBONE_GRAPH));
+	loadIndex(file.section(IndexFile::PATHTREE_LABELS));
+	if (file.has(IndexFile::PATHTREE_GRAIL_LABELS))
+		loadMultiLabels(file.section(IndexFile::PATHTREE_GRAIL_LABELS));
+	initQueue();
+}
+
 //Query::Query(const char* filestem, const char* grafile, int _r) {
 //	epsilon = _r;
 //	initFlags();
@@ -357,6 +371,122 @@ void Query::initIndex(const char* indexfile) {
 	in.close();
 }
 
+bool Query::canLoad(const IndexFile& file) {
+	return file.has(IndexFile::BACKBONE_GATES) && file.has(IndexFile::BACKBONE_GRAPH)
+		&& file.has(IndexFile::PATHTREE_LABELS);
+}
+
+// BACKBONE_GATES: radius, #gates, then the gates in increasing order
+void Query::loadGates(IndexFile::Reader in) {
+	gates = new bit_vector(gsize);
+	radius = in.next();
+	gatesize = in.next();
+	num_bits = (int)ceil(log(radius+1)/log(2));
+	for (int i = 0; i < gatesize; i++) {
+		int vid = in.next();
+		gates->set_one(vid);
+		gatemap[vid] = i;
+	}
+	assert(in.done());
+}
+
+// BACKBONE_GRAPH: #vertices, then the out-degree and the successors of every vertex
+void Query::loadGateGraph(IndexFile::Reader in) {
+	int n = in.next();
+	gategraph = Graph(n);
+	for (int i = 0; i < n; i++)
+		gategraph.addVertex(i);
+	for (int i = 0; i < n; i++) {
+		int degree = in.next();
+		for (int j = 0; j < degree; j++)
+			gategraph.addEdge(i, in.next());
+	}
+	assert(in.done());
+	gateedgesize = gategraph.num_edges();
+}
+
+// PATHTREE_LABELS: labeltype, indextype, then lin, lout and labels of every gate, each prefixed by its size
+void Query::loadIndex(IndexFile::Reader in) {
+	labeltype = in.next();
+	indextype = in.next();
+	if (indextype==0 || indextype==2)
+		lin = vector<vector<int> >(gsize,vector<int>());
+	if (indextype==1 || indextype==2)
+		lout = vector<vector<int> >(gsize,vector<int>());
+	if (labeltype!=0)
+		labels = vector<vector<int> >(gsize,vector<int>());
+	for (int i = 0; i < gsize; i++) {
+		if (!gates->get(i)) continue;
+		for (auto *l : {&lin, &lout, &labels}) {
+			int size = in.next();
+			assert(size == 0 || !l->empty());
+			for (int j = 0; j < size; j++)
+				(*l)[i].push_back(in.next());
+		}
+	}
+	assert(in.done());
+}
+
+// PATHTREE_GRAIL_LABELS: #labels, then the intervals of every vertex
+void Query::loadMultiLabels(IndexFile::Reader in) {
+	int num_labels = in.next();
+	graillabels = vector<vector<pair<int,int> > >(gsize,vector<pair<int,int> >());
+	for (int i = 0; i < gsize; i++) {
+		int size = in.next();
+		assert(size <= num_labels);
+		for (int j = 0; j < size; j++) {
+			int first = in.next();
+			graillabels[i].emplace_back(first, in.next());
+		}
+	}
+	assert(in.done());
+}
+
+void Query::saveIndex(IndexFile::Writer& file) {
+	vector<int32_t>& gs = file.add(IndexFile::BACKBONE_GATES);
+	gs.push_back(radius);
+	gs.push_back(gatesize);
+	for (int i = 0; i < gsize; i++) {
+		if (gates->get(i))
+			gs.push_back(i);
+	}
+
+	vector<int32_t>& gg = file.add(IndexFile::BACKBONE_GRAPH);
+	gg.push_back(gategraph.num_vertices());
+	for (int i = 0; i < gategraph.num_vertices(); i++) {
+		EdgeList& succs = gategraph.out_edges(i);
+		gg.push_back(succs.size());
+		gg.insert(gg.end(), succs.begin(), succs.end());
+	}
+
+	vector<int32_t>& index = file.add(IndexFile::PATHTREE_LABELS);
+	index.push_back(labeltype);
+	index.push_back(indextype);
+	for (int i = 0; i < gsize; i++) {
+		if (!gates->get(i)) continue;
+		for (auto *l : {&lin, &lout, &labels}) {
+			if (l->empty()) {
+				index.push_back(0);
+				continue;
+			}
+			index.push_back((*l)[i].size());
+			index.insert(index.end(), (*l)[i].begin(), (*l)[i].end());
+		}
+	}
+
+	if (graillabels.empty())
+		return;
+	vector<int32_t>& gl = file.add(IndexFile::PATHTREE_GRAIL_LABELS);
+	gl.push_back(graillabels[0].size());
+	for (int i = 0; i < gsize; i++) {
+		gl.push_back(graillabels[i].size());
+		for (auto& interval : graillabels[i]) {
+			gl.push_back(interval.first);
+			gl.push_back(interval.second);
+		}
+	}
+}
+
 //void Query::outIndex(const char* out_index_file){
 //	ofstream outer(out_index_file);
 //	for
@@ -12,6 +12,7 @@
  * Modification History:
 **/
 
+#include <algorithm>
 #include <csignal>
 #include <unistd.h>
 
@@ -26,47 +27,70 @@ static void alarm_handler(int param) {
 }
 
 Tabulation::Tabulation(Graph &g) : vfg(g) {
+    int n = vfg.num_vertices();
+    visited.resize(2 * (size_t) n, 0);
+    incoming.resize(n);
+    exits.resize(n);
+    summaries.resize(n);
+    summarized.resize(n, false);
+
+    // the labels of the out edges, in the order of the edges
+    labels.resize(n);
+    for (int v = 0; v < n; ++v) {
+        for (auto successor : vfg.out_edges(v))
+            labels[v].push_back(vfg.label(v, successor));
+    }
 }
 
-bool Tabulation::reach(int s, int t) {
-    if (visited.count(s))
-        return false;
-
-    if (s == t)
-        return true;
-
-    visited.insert(s);
-    auto& edges = vfg.out_edges(s);
-    for (auto successor : edges) {
-        if (is_call(s, successor)) {
-            // visit the func body
-            if (reach_func(successor, t))
-                return true;
-        } else {
-            if (reach(successor, t))
-                return true;
-        }
+void Tabulation::begin_query() {
+    if (++stamp == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        stamp = 1;
     }
-
-    return false;
+    stack.clear();
 }
 
-bool Tabulation::reach_func(int s, int t) {
-    if (func_visited.count(s))
+// phase 0: no unmatched call taken yet, so returns can be taken; phase 1: only matched returns
+bool Tabulation::visit(int v, int phase) {
+    unsigned &mark = visited[2 * (size_t) v + phase];
+    if (mark == stamp)
         return false;
+    mark = stamp;
+    stack.emplace_back(v, phase);
+    return true;
+}
+
+bool Tabulation::reach(int s, int t) {
     if (s == t)
         return true;
-    func_visited.insert(s);
-    auto& edges = vfg.out_edges(s);
-    for (auto successor : edges) {
-        if (is_return(s, successor)) {
-            continue;
-        } else {
-            if (reach_func(successor, t))
+
+    begin_query();
+    visit(s, 0);
+    while (!stack.empty()) {
+        int v = stack.back().first;
+        int phase = stack.back().second;
+        stack.pop_back();
+
+        bool has_call = false;
+        auto &edges = vfg.out_edges(v);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            int successor = edges[i];
+            int label = labels[v][i];
+            if (label < 0 && phase == 1)
+                continue;
+            if (label > 0)
+                has_call = true;
+            // visit the func body without returning
+            if (visit(successor, label > 0 ? 1 : phase) && successor == t)
                 return true;
         }
+        if (has_call) {
+            for (auto successor : summary_edges(v)) {
+                if (visit(successor, phase) && successor == t)
+                    return true;
+            }
+        }
     }
-
     return false;
 }
 
@@ -78,41 +102,106 @@ bool Tabulation::is_return(int s, int t) {
     return vfg.label(s, t) < 0;
 }
 
-void Tabulation::traverse(int s, std::set<int>& tc) {
-    if (visited.count(s))
-        return;
-    if (timeout)
-        return;
-
-    visited.insert(s);
-    tc.insert(s);
-
-    auto& edges = vfg.out_edges(s);
-    for (auto successor : edges) {
-        if (is_call(s, successor)) {
-            // visit the func body
-            traverse_func(successor, tc);
-        } else {
-            traverse(successor, tc);
+void Tabulation::propagate(int entry, int v) {
+    if (path_edges.insert(((uint64_t) entry << 32) | (uint32_t) v).second)
+        work_list.emplace_back(entry, v);
+}
+
+// Extends the same-level paths from the entries to a fixpoint: a call from a vertex
+// reached from an entry continues after the matching returns of the callee
+void Tabulation::tabulate() {
+    while (!work_list.empty()) {
+        int entry = work_list.back().first;
+        int v = work_list.back().second;
+        work_list.pop_back();
+
+        auto &edges = vfg.out_edges(v);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            int successor = edges[i];
+            int label = labels[v][i];
+            if (label == 0) {
+                propagate(entry, successor);
+            } else if (label > 0) {
+                incoming[successor].push_back({entry, v, label});
+                propagate(successor, successor);
+                for (auto &exit : exits[successor]) {
+                    if (exit.label + label == 0)
+                        propagate(entry, exit.ret);
+                }
+            } else {
+                exits[entry].push_back({successor, label});
+                for (auto &caller : incoming[entry]) {
+                    if (caller.label + label == 0)
+                        propagate(caller.entry, successor);
+                }
+            }
         }
     }
 }
 
-void Tabulation::traverse_func(int s, std::set<int>& tc) {
-    if (func_visited.count(s))
-        return;
-    if (timeout)
-        return;
+const std::vector<int> &Tabulation::summary_edges(int v) {
+    if (summarized[v])
+        return summaries[v];
 
-    func_visited.insert(s);
-    tc.insert(s);
+    auto &edges = vfg.out_edges(v);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (labels[v][i] > 0)
+            propagate(edges[i], edges[i]);
+    }
+    tabulate();
 
-    auto& edges = vfg.out_edges(s);
-    for (auto successor : edges) {
-        if (is_return(s, successor)) {
+    auto &summary = summaries[v];
+    for (size_t i = 0; i < edges.size(); ++i) {
+        int callee = edges[i];
+        int label = labels[v][i];
+        if (label <= 0)
             continue;
-        } else {
-            traverse_func(successor, tc);
+        for (auto &exit : exits[callee]) {
+            if (exit.label + label == 0)
+                summary.push_back(exit.ret);
+        }
+    }
+    std::sort(summary.begin(), summary.end());
+    summary.erase(std::unique(summary.begin(), summary.end()), summary.end());
+    summarized[v] = true;
+    return summary;
+}
+
+size_t Tabulation::summary_edge_size() const {
+    size_t ret = 0;
+    for (auto &summary : summaries)
+        ret += summary.size();
+    return ret;
+}
+
+void Tabulation::traverse(int s, std::vector<int> &tc) {
+    begin_query();
+    visit(s, 0);
+    tc.push_back(s);
+    while (!stack.empty() && !timeout) {
+        int v = stack.back().first;
+        int phase = stack.back().second;
+        stack.pop_back();
+
+        bool has_call = false;
+        auto add = [this, &tc](int successor, int successor_phase) {
+            // count the vertices reached in both phases once
+            if (visit(successor, successor_phase) && visited[2 * (size_t) successor + 1 - successor_phase] != stamp)
+                tc.push_back(successor);
+        };
+        auto &edges = vfg.out_edges(v);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            int successor = edges[i];
+            int label = labels[v][i];
+            if (label < 0 && phase == 1)
+                continue;
+            if (label > 0)
+                has_call = true;
+            add(successor, label > 0 ? 1 : phase);
+        }
+        if (has_call) {
+            for (auto successor : summary_edges(v))
+                add(successor, phase);
         }
     }
 }
@@ -124,12 +213,11 @@ double Tabulation::tc() {
     CSProgressBar bar(vfg.num_vertices());
 
     double ret = 0;
-    std::map<int, std::set<int>> tc;
+    std::vector<int> tc;
     for (int i = 0; i < vfg.num_vertices(); ++i) {
-        visited.clear();
-        func_visited.clear();
-        traverse(i, tc[i]);
-        ret += (tc[i].size()) * sizeof(int);
+        tc.clear();
+        traverse(i, tc);
+        ret += (tc.size()) * sizeof(int);
         bar.update();
     }
     return ret / 1024.0 / 1024.0;
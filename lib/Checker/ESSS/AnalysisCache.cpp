@@ -0,0 +1,639 @@
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/xxhash.h>
+
+#include "Checker/ESSS/AnalysisCache.h"
+#include "Checker/ESSS/ClOptForward.h"
+#include "Checker/ESSS/DataFlowAnalysis.h"
+
+static const char cacheMagic[8] = {'E', 'S', 'S', 'S', 'C', 'A', 'C', 'H'};
+
+namespace {
+
+class CacheWriter {
+public:
+    explicit CacheWriter(raw_ostream& OS) : OS(OS), W(OS, support::little) {}
+
+    void writeU8(uint8_t value) { W.write<uint8_t>(value); }
+    void writeU16(uint16_t value) { W.write<uint16_t>(value); }
+    void writeU32(uint32_t value) { W.write<uint32_t>(value); }
+    void writeU64(uint64_t value) { W.write<uint64_t>(value); }
+    void writeI32(int32_t value) { W.write<int32_t>(value); }
+    void writeFloat(float value) { W.write<uint32_t>(FloatToBits(value)); }
+
+    void writeString(StringRef value) {
+        writeU32(static_cast<uint32_t>(value.size()));
+        OS << value;
+    }
+
+private:
+    raw_ostream& OS;
+    support::endian::Writer W;
+};
+
+// Reads values until the data runs out. Once a read fails, all the following ones fail as well.
+class CacheReader {
+public:
+    explicit CacheReader(StringRef data) : data(data) {}
+
+    template<typename T>
+    T read() {
+        if (failed || offset + sizeof(T) > data.size()) {
+            failed = true;
+            return T{};
+        }
+        auto value = support::endian::read<T, support::little, support::unaligned>(data.data() + offset);
+        offset += sizeof(T);
+        return value;
+    }
+
+    float readFloat() { return BitsToFloat(read<uint32_t>()); }
+
+    string readString() {
+        auto size = read<uint32_t>();
+        if (failed || offset + size > data.size()) {
+            failed = true;
+            return {};
+        }
+        string value = data.substr(offset, size).str();
+        offset += size;
+        return value;
+    }
+
+    bool hasFailed() const { return failed; }
+
+private:
+    StringRef data;
+    size_t offset = 0;
+    bool failed = false;
+};
+
+uint64_t hashAnalysisOptions() {
+    string options;
+    raw_string_ostream OS(options);
+    OS << static_cast<unsigned int>(MLTA.getValue()) << ';'
+       << FloatToBits(AssociationConfidence) << ';'
+       << FloatToBits(IntervalConfidenceThreshold) << ';'
+       << RefineWithVSA << ';'
+       << FunctionTestCasesToAnalyze;
+    return xxHash64(OS.str());
+}
+
+}
+
+AnalysisCache::AnalysisCache(GlobalContext& Ctx, const StringMap<uint64_t>& moduleHashes)
+        : Ctx(Ctx), moduleHashes(moduleHashes), optionsHash(hashAnalysisOptions()) {
+    for (const auto& module_pair : Ctx.Modules)
+        modulesByPath[module_pair.second] = module_pair.first;
+
+    vector<StringRef> paths;
+    for (const auto& entry : moduleHashes)
+        paths.push_back(entry.first());
+    std::sort(paths.begin(), paths.end());
+
+    string program;
+    raw_string_ostream OS(program);
+    CacheWriter writer(OS);
+    writer.writeU64(optionsHash);
+    for (const auto& path : paths) {
+        writer.writeString(path);
+        writer.writeU64(moduleHashes.lookup(path));
+    }
+    programHash = xxHash64(OS.str());
+}
+
+bool AnalysisCache::isProgramUnchanged() const {
+    return loaded && loadedProgramHash == programHash;
+}
+
+llvm::Optional<AnalysisCache::FunctionRef> AnalysisCache::refFor(const Function* F) const {
+    if (!F->hasName())
+        return llvm::None;
+    auto path = Ctx.Modules.lookup(const_cast<Module*>(F->getParent()));
+    if (path.empty())
+        return llvm::None;
+    return FunctionRef{path.str(), F->getName().str()};
+}
+
+Function* AnalysisCache::resolve(const FunctionRef& ref) const {
+    auto M = modulesByPath.lookup(ref.modulePath);
+    if (!M)
+        return nullptr;
+    auto F = M->getFunction(ref.name);
+    if (!F)
+        return nullptr;
+
+    // Declarations and duplicate definitions are linked to one copy in the call graph, which copy depends on the order
+    // the modules are visited in. Use the one of this run.
+    if (F->empty()) {
+        if (auto linkedFunction = Ctx.GlobalFuncs.find(F->getName()))
+            F = linkedFunction;
+    }
+    if (!F->isDeclaration()) {
+        if (auto unifiedFunction = Ctx.UnifiedFuncMap.lookup(funcHash(F)))
+            F = unifiedFunction;
+    }
+    return F;
+}
+
+uint64_t AnalysisCache::fingerprint(const Module* M) const {
+    // The facts stage 0 of the EHBlockDetector uses from outside of the module.
+    string facts;
+    raw_string_ostream OS(facts);
+    CacheWriter writer(OS);
+    for (const auto& F : *M) {
+        writer.writeU8(Ctx.shouldSkipFunction(&F));
+        uint32_t instructionIndex = 0;
+        for (const auto& instruction : instructions(F)) {
+            auto call = dyn_cast<CallInst>(&instruction);
+            auto calleesIt = call ? Ctx.Callees.find(const_cast<CallInst*>(call)) : Ctx.Callees.end();
+            if (calleesIt != Ctx.Callees.end()) {
+                // Callees are identified like the call graph links them, by name and signature.
+                vector<pair<bool, uint64_t>> callees;
+                for (const auto* callee : calleesIt->second)
+                    callees.emplace_back(callee->isDeclaration(), funcHash(callee));
+                std::sort(callees.begin(), callees.end());
+                writer.writeU32(instructionIndex);
+                for (const auto& callee : callees) {
+                    writer.writeU8(callee.first);
+                    writer.writeU64(callee.second);
+                }
+            }
+            ++instructionIndex;
+        }
+    }
+    return xxHash64(OS.str());
+}
+
+bool AnalysisCache::load(StringRef path) {
+    auto bufferOrError = MemoryBuffer::getFile(path);
+    if (!bufferOrError) {
+        LOG(LOG_INFO, "No analysis cache at " << path << "\n");
+        return false;
+    }
+
+    CacheReader reader((*bufferOrError)->getBuffer());
+    char magic[sizeof(cacheMagic)];
+    for (auto& c : magic)
+        c = static_cast<char>(reader.read<uint8_t>());
+    if (reader.hasFailed() || !equal(begin(magic), end(magic), begin(cacheMagic))) {
+        LOG(LOG_INFO, "Ignoring " << path << ": not an analysis cache\n");
+        return false;
+    }
+    if (reader.read<uint32_t>() != version || reader.read<uint64_t>() != optionsHash) {
+        LOG(LOG_INFO, "Ignoring the analysis cache " << path << ": created by another version or with other options\n");
+        return false;
+    }
+    loadedProgramHash = reader.read<uint64_t>();
+
+    auto readFunctionRef = [&]() {
+        FunctionRef ref;
+        ref.modulePath = reader.readString();
+        ref.name = reader.readString();
+        return ref;
+    };
+
+    auto numberOfModules = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numberOfModules && !reader.hasFailed(); ++i) {
+        auto modulePath = reader.readString();
+        auto& record = cachedModules[modulePath];
+        record.contentHash = reader.read<uint64_t>();
+        record.fingerprint = reader.read<uint64_t>();
+
+        record.hasIndirectCalls = reader.read<uint8_t>();
+        auto numberOfIndirectCalls = reader.read<uint32_t>();
+        for (uint32_t j = 0; j < numberOfIndirectCalls && !reader.hasFailed(); ++j) {
+            IndirectCallRecord call;
+            call.functionIndex = reader.read<uint32_t>();
+            call.instructionIndex = reader.read<uint32_t>();
+            auto numberOfCallees = reader.read<uint32_t>();
+            for (uint32_t k = 0; k < numberOfCallees && !reader.hasFailed(); ++k)
+                call.callees.push_back(readFunctionRef());
+            record.indirectCalls.push_back(std::move(call));
+        }
+
+        record.hasErrorHandlingBlocks = reader.read<uint8_t>();
+        auto numberOfSafetyChecks = reader.read<uint32_t>();
+        for (uint32_t j = 0; j < numberOfSafetyChecks && !reader.hasFailed(); ++j) {
+            SafetyCheckRecord safetyCheck;
+            safetyCheck.functionIndex = reader.read<uint32_t>();
+            safetyCheck.conditionIndex = reader.read<uint32_t>();
+            safetyCheck.blockIndex = reader.read<uint32_t>();
+            safetyCheck.data.lcs = reader.read<uint16_t>();
+            safetyCheck.data.pathLength = reader.read<uint16_t>();
+            safetyCheck.data.ratio = reader.readFloat();
+            safetyCheck.data.sumOfCondBrCount = reader.read<uint16_t>();
+            record.safetyChecks.push_back(safetyCheck);
+        }
+        auto numberOfCounts = reader.read<uint32_t>();
+        for (uint32_t j = 0; j < numberOfCounts && !reader.hasFailed(); ++j) {
+            CountRecord count;
+            count.function = readFunctionRef();
+            count.counts.inError = reader.read<uint32_t>();
+            count.counts.notInError = reader.read<uint32_t>();
+            record.counts.push_back(std::move(count));
+        }
+    }
+
+    hasErrorHandlingRules = reader.read<uint8_t>();
+    auto numberOfIntervals = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numberOfIntervals && !reader.hasFailed(); ++i) {
+        IntervalRecord interval;
+        interval.function = readFunctionRef();
+        interval.index = reader.read<uint32_t>();
+        interval.interval.clear();
+        auto numberOfRanges = reader.read<uint32_t>();
+        for (uint32_t j = 0; j < numberOfRanges && !reader.hasFailed(); ++j) {
+            auto low = reader.read<int32_t>();
+            auto high = reader.read<int32_t>();
+            if (low > high) {
+                LOG(LOG_INFO, "Ignoring the analysis cache " << path << ": it is corrupt\n");
+                cachedModules.clear();
+                cachedIntervals.clear();
+                return false;
+            }
+            interval.interval.appendUnsafeBecauseExpectsSortMaintained(Range(low, high));
+        }
+        cachedIntervals.push_back(std::move(interval));
+    }
+    auto numberOfConfidences = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numberOfConfidences && !reader.hasFailed(); ++i) {
+        ConfidenceRecord confidence;
+        confidence.function = readFunctionRef();
+        confidence.index = reader.read<uint32_t>();
+        confidence.confidence = reader.readFloat();
+        cachedConfidences.push_back(std::move(confidence));
+    }
+
+    if (reader.hasFailed()) {
+        LOG(LOG_INFO, "Ignoring the analysis cache " << path << ": it is corrupt\n");
+        cachedModules.clear();
+        cachedIntervals.clear();
+        cachedConfidences.clear();
+        return false;
+    }
+
+    loaded = true;
+    if (isProgramUnchanged())
+        resolveIndirectCallees();
+
+    unsigned int unchangedModules = 0;
+    for (const auto& entry : moduleHashes) {
+        auto it = cachedModules.find(entry.first());
+        if (it != cachedModules.end() && it->second.contentHash == entry.second)
+            ++unchangedModules;
+    }
+    LOG(LOG_INFO, "Loaded the analysis cache " << path << ": " << unchangedModules << "/" << moduleHashes.size() << " modules unchanged\n");
+    return true;
+}
+
+void AnalysisCache::resolveIndirectCallees() {
+    for (const auto& module_pair : Ctx.Modules) {
+        auto it = cachedModules.find(module_pair.second);
+        if (it == cachedModules.end() || !it->second.hasIndirectCalls) {
+            indirectCallees.clear();
+            return;
+        }
+
+        vector<const Function*> functions;
+        for (const auto& F : *module_pair.first)
+            functions.push_back(&F);
+
+        // Records are sorted by function and instruction.
+        const Function* currentFunction = nullptr;
+        vector<const Instruction*> currentInstructions;
+        for (const auto& call : it->second.indirectCalls) {
+            if (call.functionIndex >= functions.size()) {
+                indirectCallees.clear();
+                return;
+            }
+            if (functions[call.functionIndex] != currentFunction) {
+                currentFunction = functions[call.functionIndex];
+                currentInstructions.clear();
+                for (const auto& instruction : instructions(currentFunction))
+                    currentInstructions.push_back(&instruction);
+            }
+            auto CI = call.instructionIndex < currentInstructions.size() ? dyn_cast<CallInst>(currentInstructions[call.instructionIndex]) : nullptr;
+            if (!CI) {
+                indirectCallees.clear();
+                return;
+            }
+            auto& callees = indirectCallees[CI];
+            for (const auto& ref : call.callees) {
+                auto callee = resolve(ref);
+                if (!callee) {
+                    indirectCallees.clear();
+                    return;
+                }
+                callees.push_back(callee);
+            }
+        }
+    }
+    indirectCalleesResolved = true;
+}
+
+bool AnalysisCache::restoreIndirectCallees(const CallInst* call, FuncSet& callees) const {
+    if (!indirectCalleesResolved)
+        return false;
+    auto it = indirectCallees.find(call);
+    if (it == indirectCallees.end())
+        return false;
+    callees.insert(it->second.begin(), it->second.end());
+    return true;
+}
+
+bool AnalysisCache::restoreErrorHandlingBlocks(const Module* M, map<const AbstractComparison*, SafetyCheckData>& safetyChecks, map<const Function*, InErrorNotInErrorPair>& inErrorNotInErrorCounts) {
+    if (!loaded)
+        return false;
+    auto path = Ctx.Modules.lookup(const_cast<Module*>(M));
+    auto it = cachedModules.find(path);
+    if (it == cachedModules.end() || !it->second.hasErrorHandlingBlocks)
+        return false;
+    const auto& record = it->second;
+    auto hashIt = moduleHashes.find(path);
+    if (hashIt == moduleHashes.end() || hashIt->second != record.contentHash || fingerprint(M) != record.fingerprint)
+        return false;
+
+    vector<const Function*> functions;
+    for (const auto& F : *M)
+        functions.push_back(&F);
+
+    map<const AbstractComparison*, SafetyCheckData> restoredSafetyChecks;
+    for (const auto& safetyCheck : record.safetyChecks) {
+        if (safetyCheck.functionIndex >= functions.size())
+            return false;
+        const auto* F = functions[safetyCheck.functionIndex];
+        auto conditionsIt = Ctx.errorHandlingRules.functionToSanityValuesAndConditions.find(F);
+        if (conditionsIt == Ctx.errorHandlingRules.functionToSanityValuesAndConditions.end() || safetyCheck.conditionIndex >= conditionsIt->second.size())
+            return false;
+        auto abstractComparison = dyn_cast<AbstractComparison>(conditionsIt->second[safetyCheck.conditionIndex].second);
+        if (!abstractComparison || safetyCheck.blockIndex >= F->size())
+            return false;
+        auto data = safetyCheck.data;
+        data.errorHandlingBlock = &*next(F->begin(), safetyCheck.blockIndex);
+        restoredSafetyChecks.emplace(abstractComparison, data);
+    }
+
+    map<const Function*, InErrorNotInErrorPair> restoredCounts;
+    for (const auto& count : record.counts) {
+        auto F = resolve(count.function);
+        if (!F)
+            return false;
+        auto& counts = restoredCounts[F];
+        counts.inError += count.counts.inError;
+        counts.notInError += count.counts.notInError;
+    }
+
+    safetyChecks.insert(restoredSafetyChecks.begin(), restoredSafetyChecks.end());
+    for (const auto& entry : restoredCounts) {
+        auto& counts = inErrorNotInErrorCounts[entry.first];
+        counts.inError += entry.second.inError;
+        counts.notInError += entry.second.notInError;
+    }
+
+    LOG(LOG_VERBOSE, "Reused the error handling blocks of " << path << " from the analysis cache\n");
+    lock_guard<mutex> lock(recordsMutex);
+    records[path] = record;
+    return true;
+}
+
+void AnalysisCache::recordErrorHandlingBlocks(const Module* M, const map<const AbstractComparison*, SafetyCheckData>& safetyChecks, const map<const Function*, InErrorNotInErrorPair>& inErrorNotInErrorCounts) {
+    auto path = Ctx.Modules.lookup(const_cast<Module*>(M));
+    auto hashIt = moduleHashes.find(path);
+    if (hashIt == moduleHashes.end())
+        return;
+
+    ModuleRecord record;
+    record.contentHash = hashIt->second;
+    record.fingerprint = fingerprint(M);
+    record.hasErrorHandlingBlocks = true;
+
+    DenseMap<const Function*, uint32_t> functionIndices;
+    for (const auto& F : *M)
+        functionIndices.try_emplace(&F, functionIndices.size());
+
+    for (const auto& entry : safetyChecks) {
+        const auto* abstractComparison = entry.first;
+        const auto& data = entry.second;
+        const auto* F = abstractComparison->getParent()->getParent();
+        auto conditionsIt = Ctx.errorHandlingRules.functionToSanityValuesAndConditions.find(F);
+        if (conditionsIt == Ctx.errorHandlingRules.functionToSanityValuesAndConditions.end())
+            return;
+        const auto& conditions = conditionsIt->second;
+        auto conditionIt = find_if(conditions, [&](const pair<pair<const Value*, unsigned int>, const AbstractCondition*>& condition) {
+            return condition.second == abstractComparison;
+        });
+        auto blockIt = find_if(*F, [&](const BasicBlock& BB) {
+            return &BB == data.errorHandlingBlock;
+        });
+        if (conditionIt == conditions.end() || blockIt == F->end())
+            return;
+
+        SafetyCheckRecord safetyCheck;
+        safetyCheck.functionIndex = functionIndices.lookup(F);
+        safetyCheck.conditionIndex = static_cast<uint32_t>(conditionIt - conditions.begin());
+        safetyCheck.blockIndex = static_cast<uint32_t>(distance(F->begin(), blockIt));
+        safetyCheck.data = data;
+        safetyCheck.data.errorHandlingBlock = nullptr;
+        record.safetyChecks.push_back(safetyCheck);
+    }
+    std::sort(record.safetyChecks.begin(), record.safetyChecks.end(), [](const SafetyCheckRecord& a, const SafetyCheckRecord& b) {
+        return make_pair(a.functionIndex, a.conditionIndex) < make_pair(b.functionIndex, b.conditionIndex);
+    });
+
+    for (const auto& entry : inErrorNotInErrorCounts) {
+        auto ref = refFor(entry.first);
+        if (!ref.hasValue())
+            return;
+        record.counts.push_back(CountRecord{std::move(ref.getValue()), entry.second});
+    }
+
+    lock_guard<mutex> lock(recordsMutex);
+    records[path] = std::move(record);
+}
+
+bool AnalysisCache::restoreErrorHandlingRules() {
+    if (!isProgramUnchanged() || !hasErrorHandlingRules)
+        return false;
+
+    vector<pair<pair<const Function*, unsigned int>, const Interval*>> intervals;
+    for (const auto& interval : cachedIntervals) {
+        auto F = resolve(interval.function);
+        if (!F)
+            return false;
+        intervals.emplace_back(make_pair(F, interval.index), &interval.interval);
+    }
+    vector<pair<pair<const Function*, unsigned int>, float>> confidences;
+    for (const auto& confidence : cachedConfidences) {
+        auto F = resolve(confidence.function);
+        if (!F)
+            return false;
+        confidences.emplace_back(make_pair(F, confidence.index), confidence.confidence);
+    }
+
+    for (const auto& entry : intervals)
+        Ctx.errorHandlingRules.functionErrorReturnIntervals.replaceIntervalFor(entry.first, Interval(*entry.second));
+    for (const auto& entry : confidences)
+        Ctx.errorHandlingRules.functionToConfidence[entry.first] = entry.second;
+
+    LOG(LOG_INFO, "Restored " << intervals.size() << " error return intervals from the analysis cache\n");
+    return true;
+}
+
+bool AnalysisCache::save(StringRef path) {
+    vector<pair<StringRef, const Module*>> modules;
+    for (const auto& module_pair : Ctx.Modules)
+        modules.emplace_back(module_pair.second, module_pair.first);
+    std::sort(modules.begin(), modules.end());
+
+    string temporaryPath = (path + ".tmp").str();
+    error_code EC;
+    raw_fd_ostream OS(temporaryPath, EC, sys::fs::OF_None);
+    if (EC) {
+        LOG(LOG_INFO, "Can't write the analysis cache " << path << ": " << EC.message() << "\n");
+        return false;
+    }
+    CacheWriter writer(OS);
+
+    auto writeFunctionRef = [&](const FunctionRef& ref) {
+        writer.writeString(ref.modulePath);
+        writer.writeString(ref.name);
+    };
+
+    for (auto c : cacheMagic)
+        writer.writeU8(static_cast<uint8_t>(c));
+    writer.writeU32(version);
+    writer.writeU64(optionsHash);
+    writer.writeU64(programHash);
+
+    writer.writeU32(static_cast<uint32_t>(modules.size()));
+    for (const auto& entry : modules) {
+        const auto& modulePath = entry.first;
+        const auto* M = entry.second;
+
+        // The error handling blocks come from this run, the callees are collected now.
+        ModuleRecord record;
+        {
+            lock_guard<mutex> lock(recordsMutex);
+            auto it = records.find(modulePath);
+            if (it != records.end())
+                record = it->second;
+        }
+        record.contentHash = moduleHashes.lookup(modulePath);
+        record.fingerprint = fingerprint(M);
+        record.hasIndirectCalls = true;
+        uint32_t functionIndex = 0;
+        for (const auto& F : *M) {
+            uint32_t instructionIndex = 0;
+            for (const auto& instruction : instructions(F)) {
+                auto call = dyn_cast<CallInst>(&instruction);
+                auto calleesIt = call && call->isIndirectCall() ? Ctx.Callees.find(const_cast<CallInst*>(call)) : Ctx.Callees.end();
+                if (calleesIt != Ctx.Callees.end()) {
+                    IndirectCallRecord indirectCall{functionIndex, instructionIndex, {}};
+                    for (const auto* callee : calleesIt->second) {
+                        auto ref = refFor(callee);
+                        if (!ref.hasValue())
+                            record.hasIndirectCalls = false;
+                        else
+                            indirectCall.callees.push_back(std::move(ref.getValue()));
+                    }
+                    record.indirectCalls.push_back(std::move(indirectCall));
+                }
+                ++instructionIndex;
+            }
+            ++functionIndex;
+        }
+        if (!record.hasIndirectCalls)
+            record.indirectCalls.clear();
+
+        writer.writeString(modulePath);
+        writer.writeU64(record.contentHash);
+        writer.writeU64(record.fingerprint);
+
+        writer.writeU8(record.hasIndirectCalls);
+        writer.writeU32(static_cast<uint32_t>(record.indirectCalls.size()));
+        for (const auto& indirectCall : record.indirectCalls) {
+            writer.writeU32(indirectCall.functionIndex);
+            writer.writeU32(indirectCall.instructionIndex);
+            writer.writeU32(static_cast<uint32_t>(indirectCall.callees.size()));
+            for (const auto& callee : indirectCall.callees)
+                writeFunctionRef(callee);
+        }
+
+        writer.writeU8(record.hasErrorHandlingBlocks);
+        writer.writeU32(static_cast<uint32_t>(record.safetyChecks.size()));
+        for (const auto& safetyCheck : record.safetyChecks) {
+            writer.writeU32(safetyCheck.functionIndex);
+            writer.writeU32(safetyCheck.conditionIndex);
+            writer.writeU32(safetyCheck.blockIndex);
+            writer.writeU16(safetyCheck.data.lcs);
+            writer.writeU16(safetyCheck.data.pathLength);
+            writer.writeFloat(safetyCheck.data.ratio);
+            writer.writeU16(safetyCheck.data.sumOfCondBrCount);
+        }
+        writer.writeU32(static_cast<uint32_t>(record.counts.size()));
+        for (const auto& count : record.counts) {
+            writeFunctionRef(count.function);
+            writer.writeU32(count.counts.inError);
+            writer.writeU32(count.counts.notInError);
+        }
+    }
+
+    // The inferred specification, only usable if every function can be referred to.
+    vector<IntervalRecord> intervals;
+    vector<ConfidenceRecord> confidences;
+    bool canStoreErrorHandlingRules = true;
+    for (const auto& entry : Ctx.errorHandlingRules.functionErrorReturnIntervals) {
+        auto ref = refFor(entry.first.first);
+        if (!ref.hasValue()) {
+            canStoreErrorHandlingRules = false;
+            break;
+        }
+        intervals.push_back(IntervalRecord{std::move(ref.getValue()), entry.first.second, entry.second});
+    }
+    for (const auto& entry : Ctx.errorHandlingRules.functionToConfidence) {
+        auto ref = refFor(entry.first.first);
+        if (!ref.hasValue()) {
+            canStoreErrorHandlingRules = false;
+            break;
+        }
+        confidences.push_back(ConfidenceRecord{std::move(ref.getValue()), entry.first.second, entry.second});
+    }
+    if (!canStoreErrorHandlingRules) {
+        intervals.clear();
+        confidences.clear();
+    }
+
+    writer.writeU8(canStoreErrorHandlingRules);
+    writer.writeU32(static_cast<uint32_t>(intervals.size()));
+    for (const auto& interval : intervals) {
+        writeFunctionRef(interval.function);
+        writer.writeU32(interval.index);
+        const auto& ranges = interval.interval.getRanges();
+        writer.writeU32(static_cast<uint32_t>(ranges.size()));
+        for (const auto& range : ranges) {
+            writer.writeI32(range.low);
+            writer.writeI32(range.high);
+        }
+    }
+    writer.writeU32(static_cast<uint32_t>(confidences.size()));
+    for (const auto& confidence : confidences) {
+        writeFunctionRef(confidence.function);
+        writer.writeU32(confidence.index);
+        writer.writeFloat(confidence.confidence);
+    }
+
+    OS.close();
+    if (OS.has_error() || sys::fs::rename(temporaryPath, path)) {
+        OS.clear_error();
+        sys::fs::remove(temporaryPath);
+        LOG(LOG_INFO, "Can't write the analysis cache " << path << "\n");
+        return false;
+    }
+
+    LOG(LOG_INFO, "Saved the analysis cache to " << path << "\n");
+    return true;
+}
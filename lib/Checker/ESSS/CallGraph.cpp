@@ -31,6 +31,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Metadata.h"
 
+#include "Checker/ESSS/AnalysisCache.h"
 #include "Checker/ESSS/CallGraph.h"
 #include "Checker/ESSS/Common.h"
 #include "Checker/ESSS/Helpers.h"
@@ -862,7 +863,9 @@ void CallGraphPass::doModulePass(Module *M) {
 
 				if (CI->isIndirectCall()) {
                     auto& FS = Ctx->Callees[CI];
-                    if (MLTA == FullMLTA)
+                    if (Ctx->Cache && Ctx->Cache->restoreIndirectCallees(CI, FS)) {
+                        // Same program and options as the cached run.
+                    } else if (MLTA == FullMLTA)
 					    findCalleesWithMLTA(CI, FS);
                     else if (MLTA == MatchSignatures)
 					    findCalleesWithType(CI, FS);
@@ -6,8 +6,12 @@
 #include <llvm/IR/Value.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/Analysis/CallGraph.h>
+#include <llvm/ADT/SCCIterator.h>
+#include <numeric>
 #include <stack>
+#include <unordered_map>
 
+#include "Checker/ESSS/AnalysisCache.h"
 #include "Checker/ESSS/EHBlockDetector.h"
 #include "Checker/ESSS/Common.h"
 #include "Checker/ESSS/Helpers.h"
@@ -352,64 +356,212 @@ Summary EHBlockDetectorPass::summarizeBlock(const BasicBlock* currentBlock) cons
 }
 
 void EHBlockDetectorPass::collectPaths(const BasicBlock* currentBlock, vector<Path*>& allPaths, Path* myCurrentPath, set<const BasicBlock*>& basicBlocksOfNonInterest) {
-    set<const BasicBlock*> visited;
-    collectPathsAux(currentBlock, allPaths, myCurrentPath, visited, basicBlocksOfNonInterest, nullptr);
+    PathCollector collector(*currentBlock->getParent(), basicBlocksOfNonInterest);
+    collector.collect(currentBlock, allPaths, myCurrentPath);
 }
 
-void EHBlockDetectorPass::collectPathsAux(const BasicBlock* currentBlock, vector<Path*>& allPaths, Path* myCurrentPath, set<const BasicBlock*>& visited, set<const BasicBlock*>& basicBlocksOfNonInterest, const BasicBlock* lastBr) {
-    if (!visited.insert(currentBlock).second)
+PathCollector::PathCollector(const Function& function, const set<const BasicBlock*>& basicBlocksOfNonInterest)
+        : basicBlocksOfNonInterest(basicBlocksOfNonInterest) {
+    // Blocks that are unreachable from the entry are not visited, and are handled as if they were in a loop.
+    for (auto it = scc_begin(&function); !it.isAtEnd(); ++it) {
+        if (!it.hasCycle())
+            acyclicBlocks.insert(it->front());
+    }
+
+    // Only the blocks that just jump to their successor can't change what is read from a path, unless a phi
+    // depends on them.
+    for (const auto& BB : function) {
+        auto br = dyn_cast<BranchInst>(BB.getTerminator());
+        if (!br || br->isConditional() || BB.getFirstNonPHIOrDbg() != br)
+            factBlocks.insert(&BB);
+        for (const auto& phi : BB.phis()) {
+            for (const auto* incoming : phi.blocks())
+                factBlocks.insert(incoming);
+        }
+    }
+}
+
+void PathCollector::collect(const BasicBlock* currentBlock, vector<Path*>& allPaths, Path* myCurrentPath) {
+    const auto* list = suffixes(currentBlock, nullptr, myCurrentPath->blocks.empty());
+    if (abstracted) {
+        abstracted = false;
+        LOG(LOG_VERBOSE, "Too many paths from " << currentBlock->getParent()->getName()
+                         << ", keeping the shortest paths of each sequence of facts\n");
+    }
+    auto prefixLength = myCurrentPath->blocks.size();
+
+    // Forked paths are created before the current path gets extended, they share its prefix.
+    for (size_t i = 1; i < list->size(); ++i) {
+        auto newCurrentPath = new Path();
+        newCurrentPath->reason = myCurrentPath->reason;
+        newCurrentPath->blocks.reserve(prefixLength + ((*list)[i] ? (*list)[i]->length : 0));
+        newCurrentPath->blocks.insert(newCurrentPath->blocks.end(), myCurrentPath->blocks.begin(), myCurrentPath->blocks.end());
+        append(newCurrentPath, (*list)[i]);
+        allPaths.push_back(newCurrentPath);
+    }
+    append(myCurrentPath, list->front());
+}
+
+void PathCollector::append(Path* path, const SuffixNode* suffix) {
+    if (!suffix)
         return;
+    path->blocks.reserve(path->blocks.size() + suffix->length);
+    for (; suffix; suffix = suffix->next)
+        path->blocks.push_back(suffix->block);
+}
 
-    myCurrentPath->blocks.push_back(currentBlock);
+const PathCollector::SuffixNode* PathCollector::prepend(const BasicBlock* block, const PathCollector::SuffixNode* suffix) {
+    unsigned int factLength = suffix ? suffix->factLength : 0;
+    size_t factHash = suffix ? suffix->factHash : 0;
+    if (factBlocks.find(block) != factBlocks.end()) {
+        ++factLength;
+        factHash = hash_combine(block, factHash);
+    }
+    nodes.push_back(SuffixNode{block, suffix, suffix ? suffix->length + 1 : 1, factLength, factHash});
+    return &nodes.back();
+}
 
-    if (myCurrentPath->blocks.size() > 1 && basicBlocksOfNonInterest.find(currentBlock) != basicBlocksOfNonInterest.end())
+bool PathCollector::sameFacts(const SuffixNode* a, const SuffixNode* b) const {
+    auto skip = [this](const SuffixNode* node) {
+        while (node && factBlocks.find(node->block) == factBlocks.end())
+            node = node->next;
+        return node;
+    };
+    if ((a ? a->factLength : 0) != (b ? b->factLength : 0) || (a ? a->factHash : 0) != (b ? b->factHash : 0))
+        return false;
+    for (a = skip(a), b = skip(b); a && b; a = skip(a->next), b = skip(b->next)) {
+        if (a->block != b->block)
+            return false;
+    }
+    return a == b;
+}
+
+void PathCollector::abstract(Suffixes& result) {
+    if (result.size() <= maxSuffixesPerBlock)
         return;
+    abstracted = true;
+    auto length = [](const SuffixNode* suffix) { return suffix ? suffix->length : 0; };
+
+    // The shortest suffix of each sequence of facts takes the place of the first one.
+    Suffixes kept;
+    unordered_multimap<size_t, size_t> keptByFactHash;
+    for (const auto* suffix : result) {
+        auto range = keptByFactHash.equal_range(suffix ? suffix->factHash : 0);
+        auto it = find_if(range.first, range.second, [&](const pair<const size_t, size_t>& entry) {
+            return sameFacts(kept[entry.second], suffix);
+        });
+        if (it == range.second) {
+            keptByFactHash.emplace(suffix ? suffix->factHash : 0, kept.size());
+            kept.push_back(suffix);
+        } else if (length(suffix) < length(kept[it->second])) {
+            kept[it->second] = suffix;
+        }
+    }
+
+    // Then the shortest suffixes, in their order.
+    if (kept.size() > maxSuffixesPerBlock) {
+        vector<size_t> indices(kept.size());
+        iota(indices.begin(), indices.end(), 0);
+        stable_sort(indices.begin(), indices.end(), [&](size_t i, size_t j) {
+            return length(kept[i]) < length(kept[j]);
+        });
+        indices.resize(maxSuffixesPerBlock);
+        std::sort(indices.begin(), indices.end());
+        Suffixes shortest;
+        shortest.reserve(maxSuffixesPerBlock);
+        for (auto i : indices)
+            shortest.push_back(kept[i]);
+        kept.swap(shortest);
+    }
+    result.swap(kept);
+}
+
+const PathCollector::Suffixes* PathCollector::suffixes(const BasicBlock* currentBlock, const BasicBlock* lastBr, bool isFirst) {
+    // The blocks reachable from a block outside of any loop can't be on the path leading to it,
+    // so its suffixes only depend on the last conditional fork.
+    bool memoisable = !isFirst && acyclicBlocks.find(currentBlock) != acyclicBlocks.end();
+    auto key = make_pair(currentBlock, lastBr);
+    if (memoisable) {
+        auto it = memo.find(key);
+        if (it != memo.end())
+            return it->second;
+    }
+
+    lists.emplace_back();
+    auto& result = lists.back();
+
+    if (!visited.insert(currentBlock).second) {
+        result.push_back(nullptr);
+        return &result;
+    }
+
+    auto finish = [&]() {
+        visited.erase(currentBlock);
+        if (memoisable)
+            memo.try_emplace(key, &result);
+        return &result;
+    };
+
+    auto stop = [&]() {
+        result.push_back(prepend(currentBlock, nullptr));
+        return finish();
+    };
+
+    if (!isFirst && basicBlocksOfNonInterest.find(currentBlock) != basicBlocksOfNonInterest.end())
+        return stop();
 
     // Current block stops function, stop here
     if (isa<ReturnInst>(currentBlock->getTerminator()) || isa<UnreachableInst>(currentBlock->getTerminator()))
-        return;
+        return stop();
 
     // Continue path
     if (auto uniqueSuccessor = currentBlock->getUniqueSuccessor()) {
-        collectPathsAux(uniqueSuccessor, allPaths, myCurrentPath, visited, basicBlocksOfNonInterest, lastBr);
+        const auto* successorSuffixes = suffixes(uniqueSuccessor, lastBr, false);
+        result.reserve(successorSuffixes->size());
+        for (const auto* suffix : *successorSuffixes)
+            result.push_back(prepend(currentBlock, suffix));
+        return finish();
     }
+
     // Fork paths
-    else {
-        auto numberOfSuccessors = succ_size(currentBlock);
-
-        // We don't want to consider double conditions that could stray away from the error path.
-        // However, we want to be able to handle the case of AND/OR checks.
-        // We should thus only do this if we are not in an "AND case" / "OR case".
-        if (numberOfSuccessors > 1) {
-            if (!lastBr)
-                lastBr = currentBlock;
-            else {
-                // Common successor is a sign of such cases.
-                if (!any_of(successors(currentBlock), [lastBr](const BasicBlock* BB) {
-                    return find(successors(lastBr), BB) != succ_end(lastBr);
-                })) {
-                    return;
-                }
+    auto numberOfSuccessors = succ_size(currentBlock);
+    if (numberOfSuccessors == 0)
+        return stop();
+
+    // We don't want to consider double conditions that could stray away from the error path.
+    // However, we want to be able to handle the case of AND/OR checks.
+    // We should thus only do this if we are not in an "AND case" / "OR case".
+    if (numberOfSuccessors > 1) {
+        if (!lastBr)
+            lastBr = currentBlock;
+        else {
+            // Common successor is a sign of such cases.
+            if (!any_of(successors(currentBlock), [lastBr](const BasicBlock* BB) {
+                return find(successors(lastBr), BB) != succ_end(lastBr);
+            })) {
+                return stop();
             }
         }
+    }
 
-        unsigned int currentSuccessor = 0;
-        for (const auto *successor : successors(currentBlock)) {
-            set<const BasicBlock*> visitedClone{visited};
-            if (currentSuccessor == numberOfSuccessors - 1) {
-                // Last one can reuse the memory
-                collectPathsAux(successor, allPaths, myCurrentPath, visitedClone, basicBlocksOfNonInterest, lastBr);
-            } else {
-                auto newCurrentPath = new Path();
-                newCurrentPath->reason = myCurrentPath->reason;
-                newCurrentPath->blocks.reserve(myCurrentPath->blocks.size());
-                newCurrentPath->blocks.insert(newCurrentPath->blocks.end(), myCurrentPath->blocks.begin(), myCurrentPath->blocks.end());
-                allPaths.push_back(newCurrentPath);
-                collectPathsAux(successor, allPaths, newCurrentPath, visitedClone, basicBlocksOfNonInterest, lastBr);
-            }
-            ++currentSuccessor;
-        }
+    vector<const Suffixes*> successorSuffixes;
+    successorSuffixes.reserve(numberOfSuccessors);
+    for (const auto* successor : successors(currentBlock))
+        successorSuffixes.push_back(suffixes(successor, lastBr, false));
+
+    // The last successor continues the current path. The other successors fork new paths in order, and the
+    // paths forked while exploring a successor come right after the path that was forked for it.
+    const auto* last = successorSuffixes.back();
+    result.push_back(prepend(currentBlock, last->front()));
+    for (size_t i = 0; i + 1 < successorSuffixes.size(); ++i) {
+        for (const auto* suffix : *successorSuffixes[i])
+            result.push_back(prepend(currentBlock, suffix));
     }
+    for (size_t i = 1; i < last->size(); ++i)
+        result.push_back(prepend(currentBlock, (*last)[i]));
+    abstract(result);
+
+    return finish();
 }
 
 void EHBlockDetectorPass::identifyPotentialSanityChecks(const Function& function) {
@@ -651,6 +803,13 @@ void EHBlockDetectorPass::stage0(Module* M) {
 
     auto testCases = getListOfTestCases();
 
+    // Results of this module, merged into the ones of the pass at the end as modules are processed concurrently.
+    map<const AbstractComparison*, pair<const Value*, unsigned int>> moduleConditionalToAction;
+    map<const Function*, InErrorNotInErrorPair> inErrorNotInErrorCounts;
+
+    // The error handling blocks only depend on the module itself, the callees and the analysed functions.
+    bool restored = Ctx->Cache && Ctx->Cache->restoreErrorHandlingBlocks(M, safetyChecks, inErrorNotInErrorCounts);
+
     for (const auto& F : *M) {
         if (Ctx->shouldSkipFunction(&F))
             continue;
@@ -680,11 +839,15 @@ void EHBlockDetectorPass::stage0(Module* M) {
                 if (!abstractComparison->isFromConditionalBranch()) continue;
                 basicBlocksOfNonInterest.insert(conditional->getParent());
                 assert(value.first);
-                conditionalToAction.emplace(abstractComparison, value);
+                moduleConditionalToAction.emplace(abstractComparison, value);
                 //LOG(LOG_INFO, "Basic block of non interest: " << getBasicBlockName(conditional->getParent()) << "\n");
             }
         }
+        if (restored)
+            continue;
+
         vector<Path*> paths;
+        PathCollector collector(F, basicBlocksOfNonInterest);
         for (const auto& entry : functionToSanityCheckCallAndCmpInstructionsIt->second) {
             const auto& conditional = entry.second;
             if (!conditional->isFromConditionalBranch()) continue;
@@ -702,16 +865,16 @@ void EHBlockDetectorPass::stage0(Module* M) {
                     // We therefore start on the successors and prepend the paths with the current block.
                     auto caseSuccessor = _switch->findCaseValue(dyn_cast<ConstantInt>(abstractComparison->getRhs()))->getCaseSuccessor();
                     currentPath->blocks.push_back(conditional->getParent());
-                    collectPaths(caseSuccessor, paths, currentPath, basicBlocksOfNonInterest);
+                    collector.collect(caseSuccessor, paths, currentPath);
                 }
                 // Default case is a fallback
                 else {
                     currentPath->blocks.push_back(conditional->getParent());
-                    collectPaths(_switch->getDefaultDest(), paths, currentPath, basicBlocksOfNonInterest);
+                    collector.collect(_switch->getDefaultDest(), paths, currentPath);
                 }
             } else {
                 // There are only two paths possible: either the branch is taken, or it is not taken.
-                collectPaths(conditional->getParent(), paths, currentPath, basicBlocksOfNonInterest);
+                collector.collect(conditional->getParent(), paths, currentPath);
             }
         }
 
@@ -891,7 +1054,7 @@ void EHBlockDetectorPass::stage0(Module* M) {
                         for (const auto *target: calleesIt.getValue()->second) {
                             if (target->isIntrinsic())
                                 continue;
-                            auto &counts = functionToInErrorNotInErrorPair[target];
+                            auto &counts = inErrorNotInErrorCounts[target];
                             if (isErrorBlock) {
                                 ++counts.inError;
                             } else {
@@ -908,7 +1071,19 @@ void EHBlockDetectorPass::stage0(Module* M) {
             delete path;
     }
 
-    processSafetyCheckMapping(safetyChecks);
+    if (!restored && Ctx->Cache)
+        Ctx->Cache->recordErrorHandlingBlocks(M, safetyChecks, inErrorNotInErrorCounts);
+
+    {
+        lock_guard<mutex> lock(resultsMutex);
+        conditionalToAction.insert(moduleConditionalToAction.begin(), moduleConditionalToAction.end());
+        for (const auto& entry : inErrorNotInErrorCounts) {
+            auto& counts = functionToInErrorNotInErrorPair[entry.first];
+            counts.inError += entry.second.inError;
+            counts.notInError += entry.second.notInError;
+        }
+        processSafetyCheckMapping(safetyChecks);
+    }
 
     if (ShowSafetyChecks) {
         LOG(LOG_INFO, "Safety checks found using similarities:\n");
@@ -6,6 +6,7 @@
 #include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <sys/wait.h>
+#include <atomic>
 
 #include "Checker/ESSS/EHBlockDetector.h"
 #include "Checker/ESSS/ErrorCheckViolationFinder.h"
@@ -15,6 +16,7 @@
 #include "Checker/ESSS/ClOptForward.h"
 #include "Checker/ESSS/Helpers.h"
 #include "Checker/ESSS/DebugHelpers.h"
+#include "Support/ThreadPool.h"
 
 //#define NO_INLINE_COUNTING_INCORRECT
 #define NO_INLINE_COUNTING_MISSING
@@ -36,7 +38,7 @@ void ErrorCheckViolationFinderPass::finish() {
     report();
 }
 
-void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(const Function& function, const FunctionErrorReturnIntervals& inputErrorIntervals, FunctionErrorReturnIntervals& outputErrorIntervals, set<const Function*>& functionsToInspectNext, unordered_set<uintptr_t>& handledFunctionPairs, map<pair<const Function*, unsigned int>, Interval>& replaceMap) {
+void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(const Function& function, const FunctionErrorReturnIntervals& inputErrorIntervals, FunctionReport& report) const {
     LOG(LOG_VERBOSE, "determineMissingChecksAndPropagationRules: " << function.getName() << "\n");
 
     // 1) collect all call instructions into a set "instSet"
@@ -84,6 +86,11 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
 
         set<const Function*> learnedFromSet;
 
+        // Collect paths starting from the roots to the end(s) of the function, there are no blocks of non-interest.
+        // The collector shares the path suffixes between the roots.
+        set<const BasicBlock*> emptySet;
+        PathCollector collector(function, emptySet);
+
         for (const auto* root : roots) {
             // Go back early enough such that we get as much of this path.
             // If a block has a unique predecessor, then its unique predecessor must be executed if the block is
@@ -97,13 +104,10 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
                 }
             }
 
-            // Collect paths starting from this call instruction to the end(s) of the function.
-            // We can use collectPaths for this with basicBlocksOfNonInterest == {}
-            set<const BasicBlock*> emptySet;
             Path* myCurrentPath = new Path();
             vector<Path*> allPaths;
             allPaths.push_back(myCurrentPath);
-            EHBlockDetectorPass::collectPaths(root, allPaths, myCurrentPath, emptySet);
+            collector.collect(root, allPaths, myCurrentPath);
 
             for (auto* path : allPaths) {
                 auto lastBB = path->blocks.back();
@@ -196,11 +200,11 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
 
             // Replace the interval if we have better results for this proposed interval than what we had before.
             // Otherwise, insert it.
-            auto getConfidence = [this](const Function* function, bool& notFound) -> float {
+            auto getConfidence = [&](const Function* function, bool& notFound) -> float {
                 notFound = false;
                 auto it = Ctx->errorHandlingRules.functionToConfidence.find(make_pair(function, 0 /* Only return values supported right now */));
                 if (it == Ctx->errorHandlingRules.functionToConfidence.end()) {
-                    LOG(LOG_INFO, "Not found in totalFunctionToIntervalCounts\n");
+                    ++report.unknownConfidences;
                     notFound = true;
                     return 0;
                 }
@@ -243,22 +247,19 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
 
                 if (edit) {
                     /*if (intersection.empty() || oldInterval.getValue()->size() > thisFunctionInterval.size()) */{
-                        Ctx->errorHandlingRules.functionToConfidence[functionPair] = avgNewConfidence;
-                        replaceMap.emplace(functionPair, std::move(thisFunctionInterval));
+                        report.confidences.emplace(functionPair, avgNewConfidence);
+                        report.replaceMap.emplace(functionPair, std::move(thisFunctionInterval));
                     }
                 }
             } else {
-                outputErrorIntervals.insertIntervalFor(functionPair, std::move(thisFunctionInterval));
+                report.outputErrorIntervals.insertIntervalFor(functionPair, std::move(thisFunctionInterval));
             }
 
             // The functions that must be inspected are the callers.
             auto callersIt = Ctx->Callers.find(&function);
             if (callersIt != Ctx->Callers.end()) {
-                for (const auto* caller : callersIt->second) {
-                    auto key = reinterpret_cast<uintptr_t>(caller->getFunction()) ^ reinterpret_cast<uintptr_t>(&function);
-                    if (handledFunctionPairs.insert(key).second)
-                        functionsToInspectNext.insert(caller->getFunction());
-                }
+                for (const auto* caller : callersIt->second)
+                    report.callers.push_back(caller->getFunction());
             }
         }
     }
@@ -275,7 +276,7 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
     // Report unhandled errors (which are also not propagated)
     if (!instSet.empty()) {
 #ifdef REPORT
-        LOG(LOG_INFO, "Unhandled error checks:\n");
+        report.hasUnhandledErrorChecks = true;
         set<const Value*> result;
         for (const auto& instruction : instructions(function)) {
             set<const Value*> visited;
@@ -305,46 +306,14 @@ void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(co
                 continue;
             }
 
-            if (!visited.insert(value).second)
-                continue;
-
-            auto call = dyn_cast<CallInst>(value);
-
-#ifdef NO_INLINE_COUNTING_MISSING
-            if (call->getDebugLoc().get() && call->getDebugLoc().getInlinedAt()) {
-                // The set contains both the instruction and the debug locations.
-                // This is because although it may be inlined, the original may not be in the source code anymore.
-                // Therefore we can't just unconditionally skip the inlined cases.
-                if (!visited.insert(call->getDebugLoc().get()).second)
-                    continue;
-            }
-#endif
-            if (result.find(value) != result.end()) {
-                if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
-                    auto &counts = errorFunctionToCountPairsFor(CountPairType::Missing);
-                    for (const auto* callee : callees.getValue()->second) {
-                        counts[callee].total++;
-                    }
-                }
-            } else {
-                if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
-                    incorrectErrorReports[SourceLocation{call, false}].emplace_back(IncorrectCheckErrorReport {
-                            .intervals = {},
-                            .call = call,
-                    });
-                    auto &counts = errorFunctionToCountPairsFor(CountPairType::Missing);
-                    for (const auto* callee : callees.getValue()->second) {
-                        counts[callee].incorrect++;
-                        counts[callee].total++;
-                    }
-                }
-            }
+            // Deduplication happens when merging, it depends on the other functions.
+            report.uncheckedCalls.emplace_back(dyn_cast<CallInst>(value), result.find(value) != result.end());
         }
 #endif
     }
 }
 
-void ErrorCheckViolationFinderPass::determineIncorrectChecks(const Function& function) {
+void ErrorCheckViolationFinderPass::determineIncorrectChecks(const Function& function, FunctionReport& report) const {
 #ifndef REPORT
     return;
 #endif
@@ -407,12 +376,7 @@ void ErrorCheckViolationFinderPass::determineIncorrectChecks(const Function& fun
         }
 
         if (isCheckedCorrectly) {
-            if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
-                auto &counts = errorFunctionToCountPairsFor(CountPairType::Incorrect);
-                for (const auto* callee : callees.getValue()->second) {
-                    counts[callee].total++;
-                }
-            }
+            report.correctChecks.push_back(call);
         } else {
 #ifdef DEBUG_STORING_REPORT_DATA
             if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
@@ -425,33 +389,128 @@ void ErrorCheckViolationFinderPass::determineIncorrectChecks(const Function& fun
                 }
             }
 #endif
-            incorrectErrorReports[SourceLocation{call, false}].emplace_back(IncorrectCheckErrorReport {
+            report.incorrectChecks.emplace_back(IncorrectCheckErrorReport {
                 .intervals = std::move(intervals),
                 .call = call,
             });
+        }
+    }
+}
+
+void ErrorCheckViolationFinderPass::recordUncheckedCall(const CallInst* call, bool flowsIntoCheck) {
+    if (!visited.insert(call).second)
+        return;
+
+#ifdef NO_INLINE_COUNTING_MISSING
+    if (call->getDebugLoc().get() && call->getDebugLoc().getInlinedAt()) {
+        // The set contains both the instruction and the debug locations.
+        // This is because although it may be inlined, the original may not be in the source code anymore.
+        // Therefore we can't just unconditionally skip the inlined cases.
+        if (!visited.insert(call->getDebugLoc().get()).second)
+            return;
+    }
+#endif
+    if (flowsIntoCheck) {
+        if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
+            auto &counts = errorFunctionToCountPairsFor(CountPairType::Missing);
+            for (const auto* callee : callees.getValue()->second) {
+                counts[callee].total++;
+            }
+        }
+    } else {
+        if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
+            incorrectErrorReports[SourceLocation{call, false}].emplace_back(IncorrectCheckErrorReport {
+                    .intervals = {},
+                    .call = call,
+            });
+            auto &counts = errorFunctionToCountPairsFor(CountPairType::Missing);
+            for (const auto* callee : callees.getValue()->second) {
+                counts[callee].incorrect++;
+                counts[callee].total++;
+            }
+        }
+    }
+}
+
+void ErrorCheckViolationFinderPass::recordIncorrectCheck(IncorrectCheckErrorReport&& incorrectCheck) {
+    auto call = incorrectCheck.call;
+    incorrectErrorReports[SourceLocation{call, false}].emplace_back(std::move(incorrectCheck));
 
 #ifdef NO_INLINE_COUNTING_INCORRECT
-            if (!(call->getDebugLoc().get() && call->getDebugLoc().getInlinedAt())) {
+    if (!(call->getDebugLoc().get() && call->getDebugLoc().getInlinedAt())) {
 #else
-            if(true) {
+    if(true) {
 #endif
-                auto &counts = errorFunctionToCountPairsFor(CountPairType::Incorrect);
-                if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
-                    for (const auto *callee: callees.getValue()->second) {
-                        auto &data = counts[callee];
-                        data.total++;
-                        data.incorrect++;
+        auto &counts = errorFunctionToCountPairsFor(CountPairType::Incorrect);
+        if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
+            for (const auto *callee: callees.getValue()->second) {
+                auto &data = counts[callee];
+                data.total++;
+                data.incorrect++;
 #ifdef DEBUG_STORING_REPORT_DATA
-                        LOG(LOG_INFO, "Total++, Incorrect++ for " << callee->getName() << "\n");
-                        call->dump();
+                LOG(LOG_INFO, "Total++, Incorrect++ for " << callee->getName() << "\n");
+                call->dump();
 #endif
-                    }
-                }
             }
         }
     }
 }
 
+void ErrorCheckViolationFinderPass::inspectFunctions(const vector<const Function*>& functions, vector<FunctionReport>& reports, const function<void(const Function&, FunctionReport&)>& inspect) const {
+    reports.clear();
+    reports.resize(functions.size());
+
+    // Workers take the next function until there are none left. The reports of the functions are
+    // separate, so the workers only share read-only data.
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < functions.size(); i = next++)
+            inspect(*functions[i], reports[i]);
+    };
+    auto pool = ::ThreadPool::get();
+    size_t numberOfTasks = max<size_t>(1, min(pool->Workers.size(), functions.size()));
+    for (size_t i = 0; i < numberOfTasks; ++i)
+        pool->enqueue(worker);
+    pool->wait();
+}
+
+void ErrorCheckViolationFinderPass::determineMissingChecksAndPropagationRules(const vector<const Function*>& functions, FunctionErrorReturnIntervals& outputErrorIntervals, set<const Function*>& functionsToInspectNext, unordered_set<uintptr_t>& handledFunctionPairs, map<pair<const Function*, unsigned int>, Interval>& replaceMap) {
+    // The error return intervals are only read while inspecting, all updates are merged afterwards.
+    const auto& inputErrorIntervals = Ctx->errorHandlingRules.functionErrorReturnIntervals;
+    vector<FunctionReport> reports;
+    inspectFunctions(functions, reports, [&](const Function& function, FunctionReport& report) {
+        determineMissingChecksAndPropagationRules(function, inputErrorIntervals, report);
+    });
+
+    // Merge in the order of the functions, so that the results don't depend on the scheduling.
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const auto* function = functions[i];
+        auto& report = reports[i];
+
+        for (unsigned int j = 0; j < report.unknownConfidences; ++j)
+            LOG(LOG_INFO, "Not found in totalFunctionToIntervalCounts\n");
+        for (const auto& entry : report.confidences)
+            Ctx->errorHandlingRules.functionToConfidence[entry.first] = entry.second;
+        for (auto& entry : report.replaceMap)
+            replaceMap.emplace(entry.first, std::move(entry.second));
+        outputErrorIntervals.mergeDestructivelyForOther(report.outputErrorIntervals);
+
+        // The functions that must be inspected are the callers.
+        for (const auto* caller : report.callers) {
+            auto key = reinterpret_cast<uintptr_t>(caller) ^ reinterpret_cast<uintptr_t>(function);
+            if (handledFunctionPairs.insert(key).second)
+                functionsToInspectNext.insert(caller);
+        }
+
+#ifdef REPORT
+        if (report.hasUnhandledErrorChecks)
+            LOG(LOG_INFO, "Unhandled error checks:\n");
+#endif
+        for (const auto& entry : report.uncheckedCalls)
+            recordUncheckedCall(entry.first, entry.second);
+    }
+}
+
 void ErrorCheckViolationFinderPass::report() const {
     for (const auto& pair : incorrectErrorReports) {
         const auto& baseLocation = pair.first;
@@ -579,11 +638,12 @@ void ErrorCheckViolationFinderPass::stage0(Module *M) {
         FunctionErrorReturnIntervals outputErrorIntervals;
         set<const Function *> functionsToInspectNext;
         map<pair<const Function*, unsigned int>, Interval> replaceMap;
+        vector<const Function*> functions;
         for (const auto &function: *M) {
             if (!Ctx->shouldSkipFunction(&function))
-                determineMissingChecksAndPropagationRules(function, Ctx->errorHandlingRules.functionErrorReturnIntervals,
-                                                          outputErrorIntervals, functionsToInspectNext, handledFunctionPairs, replaceMap);
+                functions.push_back(&function);
         }
+        determineMissingChecksAndPropagationRules(functions, outputErrorIntervals, functionsToInspectNext, handledFunctionPairs, replaceMap);
         {
             performReplaces(replaceMap);
             Ctx->errorHandlingRules.functionErrorReturnIntervals.mergeDestructivelyForOther(outputErrorIntervals);
@@ -598,10 +658,8 @@ void ErrorCheckViolationFinderPass::stage0(Module *M) {
             FunctionErrorReturnIntervals outputErrorIntervalsInNext;
             set<const Function *> functionsToInspectNextInNext;
             replaceMap.clear();
-            for (const auto *functionToInspectNext: functionsToInspectNext) {
-                determineMissingChecksAndPropagationRules(*functionToInspectNext, Ctx->errorHandlingRules.functionErrorReturnIntervals,
-                                                          outputErrorIntervalsInNext, functionsToInspectNextInNext, handledFunctionPairs, replaceMap);
-            }
+            functions.assign(functionsToInspectNext.begin(), functionsToInspectNext.end());
+            determineMissingChecksAndPropagationRules(functions, outputErrorIntervalsInNext, functionsToInspectNextInNext, handledFunctionPairs, replaceMap);
 
             {
                 performReplaces(replaceMap);
@@ -729,10 +787,27 @@ void ErrorCheckViolationFinderPass::determineSignednessBugs() const {
 }
 
 void ErrorCheckViolationFinderPass::stage1(Module* M) {
+    vector<const Function*> functions;
     for (const auto& function : *M) {
-        if (Ctx->shouldSkipFunction(&function))
-            continue;
+        if (!Ctx->shouldSkipFunction(&function))
+            functions.push_back(&function);
+    }
 
-        determineIncorrectChecks(function);
+    vector<FunctionReport> reports;
+    inspectFunctions(functions, reports, [&](const Function& function, FunctionReport& report) {
+        determineIncorrectChecks(function, report);
+    });
+
+    for (auto& report : reports) {
+        for (const auto* call : report.correctChecks) {
+            if (auto callees = getCalleeIteratorForPotentialCallInstruction(GlobalCtx, *call)) {
+                auto &counts = errorFunctionToCountPairsFor(CountPairType::Incorrect);
+                for (const auto* callee : callees.getValue()->second) {
+                    counts[callee].total++;
+                }
+            }
+        }
+        for (auto& incorrectCheck : report.incorrectChecks)
+            recordIncorrectCheck(std::move(incorrectCheck));
     }
 }
@@ -3,7 +3,7 @@
 #include <llvm/IR/InstIterator.h>
 #include <llvm/Support/Debug.h>
 #include <llvm/Support/raw_ostream.h>
-// #include <algorithm>
+#include <algorithm>
 // #include <iostream>
 
 using namespace llvm;
@@ -52,6 +52,63 @@ bool TaintState::operator==(const TaintState& other) const {
     return valueTaints == other.valueTaints;
 }
 
+// SparseTaintState implementation
+void SparseTaintState::setPosition(const llvm::Instruction* inst, unsigned position) {
+    positions[inst] = position;
+}
+
+unsigned SparseTaintState::getPosition(const llvm::Instruction* inst) const {
+    auto it = positions.find(inst);
+    return it != positions.end() ? it->second : 0;
+}
+
+void SparseTaintState::addTaint(llvm::Value* val, unsigned position, TaintValue* taint) {
+    events[val].push_back({position, ~0U, taint});
+}
+
+void SparseTaintState::removeTaint(llvm::Value* val, unsigned position) {
+    auto it = events.find(val);
+    if (it == events.end()) return;
+    for (auto& event : it->second) {
+        if (event.removed == ~0U) {
+            event.removed = position;
+        }
+    }
+}
+
+bool SparseTaintState::isTainted(llvm::Value* val, unsigned position) const {
+    auto it = events.find(val);
+    if (it == events.end()) return false;
+    for (const auto& event : it->second) {
+        if (event.position <= position && event.removed > position) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::set<TaintValue*> SparseTaintState::getTaints(llvm::Value* val, unsigned position) const {
+    std::set<TaintValue*> taints;
+    auto it = events.find(val);
+    if (it == events.end()) return taints;
+    for (const auto& event : it->second) {
+        if (event.position <= position && event.removed > position) {
+            taints.insert(event.taint);
+        }
+    }
+    return taints;
+}
+
+TaintState SparseTaintState::getState(unsigned position) const {
+    TaintState state;
+    for (const auto& pair : events) {
+        for (auto* taint : getTaints(pair.first, position)) {
+            state.addTaint(pair.first, taint);
+        }
+    }
+    return state;
+}
+
 // TaintConfig implementation
 TaintConfig::TaintConfig() {
     loadDefaultConfig();
@@ -92,16 +149,16 @@ void TaintAnalysisResult::addTaint(TaintValue* taint) {
     allTaints.insert(taint);
 }
 
-void TaintAnalysisResult::setState(llvm::Function* func, llvm::Instruction* inst, const TaintState& state) {
-    functionStates[func][inst] = state;
+SparseTaintState& TaintAnalysisResult::getFunctionState(llvm::Function* func) {
+    return functionStates[func];
 }
 
 TaintState TaintAnalysisResult::getState(llvm::Function* func, llvm::Instruction* inst) const {
     auto funcIt = functionStates.find(func);
     if (funcIt != functionStates.end()) {
-        auto instIt = funcIt->second.find(inst);
-        if (instIt != funcIt->second.end()) {
-            return instIt->second;
+        auto position = funcIt->second.getPosition(inst);
+        if (position != 0) {
+            return funcIt->second.getState(position);
         }
     }
     return TaintState();
@@ -129,6 +186,8 @@ void TaintAnalysisResult::printStatistics(llvm::raw_ostream& OS) const {
 
 // TaintAnalysis implementation
 void TaintAnalysis::analyzeModule(llvm::Module* M) {
+    computeSummaries(M);
+    
     for (auto& F : *M) {
         if (!F.isDeclaration() && !F.empty()) {
             analyzeFunction(&F);
@@ -167,49 +226,140 @@ SanitizerType TaintAnalysis::getSanitizerType(const llvm::Function* func) const
 }
 
 void TaintAnalysis::analyzeFunction(llvm::Function* func) {
-    TaintState state;
+    FunctionContext ctx(func, result.getFunctionState(func));
+    runFunction(ctx);
+}
+
+void TaintAnalysis::computeSummaries(llvm::Module* M) {
+    if (!config.interprocedural) return;
     
-    // Taint main function arguments
-    if (func->getName() == "main") {
-        for (auto& arg : func->args()) {
-            auto* taint = createTaintValue(&arg, TaintSourceType::USER_INPUT, 
-                                         &*func->begin()->begin(), "Command line argument");
-            state.addTaint(&arg, taint);
-            result.addTaint(taint);
+    // Each round applies the summaries of the previous one at call sites,
+    // so round k sees sinks up to k - 1 calls deep.
+    for (int round = 0; round < std::max(config.maxCallDepth, 1); ++round) {
+        std::map<llvm::Function*, TaintSummary> next;
+        bool changed = false;
+        
+        for (auto& F : *M) {
+            if (F.isDeclaration() || F.empty()) continue;
+            
+            SparseTaintState state;
+            FunctionContext ctx(&F, state);
+            ctx.summary = &next[&F];
+            runFunction(ctx);
+            
+            // Returned taints are created anew in every round, only their
+            // number tells whether the summary changed. The taints of the
+            // previous round are freed with its summaries below.
+            auto& old = summaries[&F];
+            if (old.paramToSinks != ctx.summary->paramToSinks ||
+                old.paramToReturn != ctx.summary->paramToReturn ||
+                old.returnedTaints.size() != ctx.summary->returnedTaints.size()) {
+                changed = true;
+            }
         }
+        
+        summaries = std::move(next);
+        if (!changed) break;
     }
+}
+
+void TaintAnalysis::runFunction(FunctionContext& ctx) {
+    llvm::Function* func = ctx.func;
     
-    // Analyze instructions
+    // Number the instructions in layout order, and seed the worklist with
+    // the instructions that create taints on their own
     for (auto& BB : *func) {
         for (auto& I : BB) {
-            analyzeInstruction(&I, state);
-            result.setState(func, &I, state);
+            ctx.instructions.push_back(&I);
+            unsigned position = ctx.instructions.size();
+            ctx.state.setPosition(&I, position);
+            
+            auto* call = dyn_cast<CallInst>(&I);
+            if (!call) continue;
+            llvm::Function* callee = call->getCalledFunction();
+            if (isSourceFunction(callee)) {
+                ctx.worklist.insert(position);
+            } else if (config.interprocedural && callee) {
+                auto it = summaries.find(callee);
+                if (it != summaries.end() && !it->second.returnedTaints.empty()) {
+                    ctx.worklist.insert(position);
+                }
+            }
         }
     }
+    
+    // Taints of the arguments hold from the entry (position 0)
+    if (ctx.summary) {
+        unsigned i = 0;
+        for (auto& arg : func->args()) {
+            auto* taint = createTaintValue(&arg, TaintSourceType::CUSTOM, 
+                                         &*func->begin()->begin(), "Parameter " + std::to_string(i));
+            ctx.paramTaints[taint] = i++;
+            addTaint(&arg, taint, ctx);
+            recordTaint(taint, ctx);
+        }
+    } else if (func->getName() == "main") {
+        for (auto& arg : func->args()) {
+            auto* taint = createTaintValue(&arg, TaintSourceType::USER_INPUT, 
+                                         &*func->begin()->begin(), "Command line argument");
+            addTaint(&arg, taint, ctx);
+            recordTaint(taint, ctx);
+        }
+    }
+    
+    // Visit the users of tainted values in layout order: when an instruction
+    // is visited, every taint added before it is already known
+    while (!ctx.worklist.empty()) {
+        ctx.position = *ctx.worklist.begin();
+        ctx.worklist.erase(ctx.worklist.begin());
+        analyzeInstruction(ctx.instructions[ctx.position - 1], ctx);
+    }
 }
 
-void TaintAnalysis::analyzeInstruction(llvm::Instruction* inst, TaintState& state) {
+void TaintAnalysis::analyzeInstruction(llvm::Instruction* inst, FunctionContext& ctx) {
+    auto& state = ctx.state;
+    auto position = ctx.position;
+    
     if (auto* call = dyn_cast<CallInst>(inst)) {
-        analyzeCallInstruction(call, state);
+        analyzeCallInstruction(call, ctx);
     } else if (auto* load = dyn_cast<LoadInst>(inst)) {
-        if (config.trackThroughMemory && state.isTainted(load->getPointerOperand())) {
-            propagateTaint(load->getPointerOperand(), load, state);
+        if (config.trackThroughMemory && state.isTainted(load->getPointerOperand(), position)) {
+            propagateTaint(load->getPointerOperand(), load, ctx);
         }
     } else if (auto* store = dyn_cast<StoreInst>(inst)) {
-        if (config.trackThroughMemory && state.isTainted(store->getValueOperand())) {
-            propagateTaint(store->getValueOperand(), store->getPointerOperand(), state);
+        if (config.trackThroughMemory && state.isTainted(store->getValueOperand(), position)) {
+            propagateTaint(store->getValueOperand(), store->getPointerOperand(), ctx);
         }
     } else if (auto* binOp = dyn_cast<BinaryOperator>(inst)) {
-        if (state.isTainted(binOp->getOperand(0)) || state.isTainted(binOp->getOperand(1))) {
-            propagateTaint(state.isTainted(binOp->getOperand(0)) ? binOp->getOperand(0) : binOp->getOperand(1), binOp, state);
+        bool lhsTainted = state.isTainted(binOp->getOperand(0), position);
+        if (lhsTainted || state.isTainted(binOp->getOperand(1), position)) {
+            propagateTaint(lhsTainted ? binOp->getOperand(0) : binOp->getOperand(1), binOp, ctx);
+        }
+    } else if (auto* ret = dyn_cast<ReturnInst>(inst)) {
+        // Only summaries care about returned values
+        if (ctx.summary && ret->getReturnValue()) {
+            for (auto* taint : state.getTaints(ret->getReturnValue(), position)) {
+                auto* root = taint;
+                while (!root->derivedFrom.empty()) {
+                    root = *root->derivedFrom.begin();
+                }
+                auto it = ctx.paramTaints.find(root);
+                if (it != ctx.paramTaints.end()) {
+                    ctx.summary->paramToReturn.insert(it->second);
+                } else {
+                    ctx.summary->returnedTaints.insert(taint);
+                }
+            }
         }
     }
 }
 
-void TaintAnalysis::analyzeCallInstruction(llvm::CallInst* call, TaintState& state) {
+void TaintAnalysis::analyzeCallInstruction(llvm::CallInst* call, FunctionContext& ctx) {
     llvm::Function* func = call->getCalledFunction();
     if (!func) return;
     
+    auto& state = ctx.state;
+    auto position = ctx.position;
     std::string name = func->getName().str();
     
     // Handle source functions
@@ -217,20 +367,20 @@ void TaintAnalysis::analyzeCallInstruction(llvm::CallInst* call, TaintState& sta
         auto* taint = createTaintValue(call, getSourceType(func), call, "Call to " + name);
         if (name == "gets" || name == "fgets" || name == "scanf") {
             if (call->arg_size() > 0) {
-                state.addTaint(call->getArgOperand(0), taint);
+                addTaint(call->getArgOperand(0), taint, ctx);
             }
         }
-        state.addTaint(call, taint);
-        result.addTaint(taint);
+        addTaint(call, taint, ctx);
+        recordTaint(taint, ctx);
     }
     
     // Handle sink functions
     if (isSinkFunction(func)) {
         for (unsigned i = 0; i < call->arg_size(); ++i) {
-            if (state.isTainted(call->getArgOperand(i))) {
-                auto taints = state.getTaints(call->getArgOperand(i));
+            if (state.isTainted(call->getArgOperand(i), position)) {
+                auto taints = state.getTaints(call->getArgOperand(i), position);
                 for (auto* taint : taints) {
-                    result.addFlow(TaintFlow(taint, call, getSinkType(func)));
+                    reportFlow(taint, call, getSinkType(func), ctx);
                 }
             }
         }
@@ -238,35 +388,111 @@ void TaintAnalysis::analyzeCallInstruction(llvm::CallInst* call, TaintState& sta
     
     // Handle sanitizers
     if (isSanitizerFunction(func) && call->arg_size() > 0) {
-        state.removeTaint(call);
+        state.removeTaint(call, position);
+    }
+    
+    // Apply the summary of defined functions
+    if (config.interprocedural && !func->isDeclaration()) {
+        auto it = summaries.find(func);
+        if (it != summaries.end()) {
+            applySummary(call, it->second, ctx);
+        }
+        return;
     }
     
     // Propagate taint through calls
     if (config.trackThroughCalls && !call->getType()->isVoidTy()) {
         for (unsigned i = 0; i < call->arg_size(); ++i) {
-            if (state.isTainted(call->getArgOperand(i))) {
+            if (state.isTainted(call->getArgOperand(i), position)) {
                 auto* taint = createTaintValue(call, TaintSourceType::EXTERNAL_CALL, call, "Propagated through " + name);
-                state.addTaint(call, taint);
-                result.addTaint(taint);
+                addTaint(call, taint, ctx);
+                recordTaint(taint, ctx);
                 break;
             }
         }
     }
 }
 
-void TaintAnalysis::propagateTaint(llvm::Value* from, llvm::Value* to, TaintState& state) {
-    auto taints = state.getTaints(from);
+void TaintAnalysis::applySummary(llvm::CallInst* call, const TaintSummary& summary, FunctionContext& ctx) {
+    auto& state = ctx.state;
+    auto position = ctx.position;
+    
+    for (unsigned i = 0; i < call->arg_size(); ++i) {
+        llvm::Value* arg = call->getArgOperand(i);
+        if (!state.isTainted(arg, position)) continue;
+        
+        auto sinksIt = summary.paramToSinks.find(i);
+        if (sinksIt != summary.paramToSinks.end()) {
+            for (auto* taint : state.getTaints(arg, position)) {
+                for (const auto& sink : sinksIt->second) {
+                    reportFlow(taint, sink.first, sink.second, ctx);
+                }
+            }
+        }
+        
+        if (config.trackThroughCalls && summary.paramToReturn.count(i)) {
+            propagateTaint(arg, call, ctx);
+        }
+    }
+    
+    for (auto* returned : summary.returnedTaints) {
+        auto* taint = createTaintValue(call, returned->sourceType, returned->sourceLocation,
+                                     returned->sourceDescription + " (returned)");
+        addTaint(call, taint, ctx);
+        recordTaint(taint, ctx);
+    }
+}
+
+void TaintAnalysis::addTaint(llvm::Value* val, TaintValue* taint, FunctionContext& ctx) {
+    ctx.state.addTaint(val, ctx.position, taint);
+    
+    // Schedule the users that come later in the layout; the ones before
+    // cannot see the new taint
+    for (auto* user : val->users()) {
+        auto* inst = dyn_cast<Instruction>(user);
+        if (!inst || inst->getFunction() != ctx.func) continue;
+        auto position = ctx.state.getPosition(inst);
+        if (position > ctx.position) {
+            ctx.worklist.insert(position);
+        }
+    }
+}
+
+void TaintAnalysis::propagateTaint(llvm::Value* from, llvm::Value* to, FunctionContext& ctx) {
+    auto taints = ctx.state.getTaints(from, ctx.position);
     for (auto* taint : taints) {
         auto* newTaint = createTaintValue(to, taint->sourceType, taint->sourceLocation, 
                                         taint->sourceDescription + " (propagated)");
         newTaint->derivedFrom.insert(taint);
-        state.addTaint(to, newTaint);
-        result.addTaint(newTaint);
+        addTaint(to, newTaint, ctx);
+        recordTaint(newTaint, ctx);
     }
 }
 
-void TaintAnalysis::checkForTaintFlow(llvm::Instruction* inst, const TaintState& state) {
-    // Simplified - main logic is in analyzeCallInstruction
+void TaintAnalysis::reportFlow(TaintValue* taint, llvm::Instruction* sink, TaintSinkType type, FunctionContext& ctx) {
+    if (!ctx.summary) {
+        result.addFlow(TaintFlow(taint, sink, type));
+        return;
+    }
+    
+    // In a summary, only flows from the parameters matter: flows from the
+    // sources of the function are reported when the function is analyzed
+    auto* root = taint;
+    while (!root->derivedFrom.empty()) {
+        root = *root->derivedFrom.begin();
+    }
+    auto it = ctx.paramTaints.find(root);
+    if (it != ctx.paramTaints.end()) {
+        ctx.summary->paramToSinks[it->second].insert({sink, type});
+    }
+}
+
+void TaintAnalysis::recordTaint(TaintValue* taint, FunctionContext& ctx) {
+    if (ctx.summary) {
+        ctx.summary->taints.emplace_back(taint);
+    } else {
+        result.addTaint(taint);
+    }
 }
 
 TaintValue* TaintAnalysis::createTaintValue(llvm::Value* val, TaintSourceType type, 
@@ -0,0 +1,220 @@
+#include "Dataflow/Mono/BitVectorDataFlowResult.h"
+
+BitVectorDataFlowResult::BitVectorDataFlowResult(bool isForward)
+    : forward{isForward} {
+  return;
+}
+
+DataFlowDomain &BitVectorDataFlowResult::getDomain() {
+  return this->domain;
+}
+
+bool BitVectorDataFlowResult::isForward() const {
+  return this->forward;
+}
+
+void BitVectorDataFlowResult::addGEN(Instruction *inst, Value *v) {
+  auto id = this->domain.getOrInsert(v);
+  this->transfers[inst].gen.push_back(id);
+
+  return;
+}
+
+void BitVectorDataFlowResult::addKILL(Instruction *inst, Value *v) {
+  auto id = this->domain.getOrInsert(v);
+  this->transfers[inst].kill.push_back(id);
+
+  return;
+}
+
+std::set<Value *> BitVectorDataFlowResult::toValueSet(
+    const SmallVectorImpl<unsigned> &ids) const {
+  std::set<Value *> s;
+  for (auto id : ids) {
+    s.insert(this->domain.getValue(id));
+  }
+
+  return s;
+}
+
+std::set<Value *> BitVectorDataFlowResult::GEN(Instruction *inst) const {
+  auto it = this->transfers.find(inst);
+  if (it == this->transfers.end()) {
+    return {};
+  }
+
+  return this->toValueSet(it->second.gen);
+}
+
+std::set<Value *> BitVectorDataFlowResult::KILL(Instruction *inst) const {
+  auto it = this->transfers.find(inst);
+  if (it == this->transfers.end()) {
+    return {};
+  }
+
+  return this->toValueSet(it->second.kill);
+}
+
+BitVector &BitVectorDataFlowResult::IN(BasicBlock *bb) {
+  auto &bits = this->ins[bb];
+  if (bits.size() < this->domain.size()) {
+    bits.resize(this->domain.size());
+  }
+
+  return bits;
+}
+
+BitVector &BitVectorDataFlowResult::OUT(BasicBlock *bb) {
+  auto &bits = this->outs[bb];
+  if (bits.size() < this->domain.size()) {
+    bits.resize(this->domain.size());
+  }
+
+  return bits;
+}
+
+void BitVectorDataFlowResult::applyTransfer(Instruction *inst,
+                                            BitVector &bits) const {
+  auto it = this->transfers.find(inst);
+  if (it == this->transfers.end()) {
+    return;
+  }
+
+  /*
+   * bits = GEN[inst] | (bits & ~KILL[inst])
+   */
+  for (auto id : it->second.kill) {
+    bits.reset(id);
+  }
+  for (auto id : it->second.gen) {
+    bits.set(id);
+  }
+
+  return;
+}
+
+void BitVectorDataFlowResult::computeBlockTransfers(Function *f) {
+  auto domainSize = this->domain.size();
+
+  for (auto &bb : *f) {
+    auto &blockTransfer = this->blockTransfers[&bb];
+    blockTransfer.gen = BitVector(domainSize);
+    blockTransfer.kill = BitVector(domainSize);
+
+    /*
+     * Compose f_i after the transfer of the instructions already visited:
+     * GEN = gen_i | (GEN & ~kill_i), KILL = KILL | kill_i
+     */
+    auto compose = [this, &blockTransfer](Instruction *inst) {
+      auto it = this->transfers.find(inst);
+      if (it == this->transfers.end()) {
+        return;
+      }
+      for (auto id : it->second.kill) {
+        blockTransfer.gen.reset(id);
+        blockTransfer.kill.set(id);
+      }
+      for (auto id : it->second.gen) {
+        blockTransfer.gen.set(id);
+      }
+    };
+
+    if (this->forward) {
+      for (auto &i : bb) {
+        compose(&i);
+      }
+    } else {
+      for (auto iter = bb.rbegin(); iter != bb.rend(); ++iter) {
+        compose(&*iter);
+      }
+    }
+  }
+
+  return;
+}
+
+void BitVectorDataFlowResult::applyBlockTransfer(BasicBlock *bb,
+                                                 BitVector &bits) const {
+  auto it = this->blockTransfers.find(bb);
+  if (it == this->blockTransfers.end()) {
+    return;
+  }
+
+  bits.reset(it->second.kill);
+  bits |= it->second.gen;
+
+  return;
+}
+
+unsigned BitVectorDataFlowResult::getNumberOfIterations() const {
+  return this->iterations;
+}
+
+void BitVectorDataFlowResult::setNumberOfIterations(unsigned n) {
+  this->iterations = n;
+
+  return;
+}
+
+BitVector BitVectorDataFlowResult::INBits(Instruction *inst) const {
+  auto bb = inst->getParent();
+
+  if (this->forward) {
+    /*
+     * Replay the transfers from the entry of the block up to "inst".
+     */
+    auto it = this->ins.find(bb);
+    BitVector bits = (it != this->ins.end()) ? it->second : BitVector{};
+    bits.resize(this->domain.size());
+    for (auto &i : *bb) {
+      if (&i == inst) {
+        break;
+      }
+      this->applyTransfer(&i, bits);
+    }
+
+    return bits;
+  }
+
+  /*
+   * Backward: IN[inst] is the result of the transfer of "inst" itself.
+   */
+  auto bits = this->OUTBits(inst);
+  this->applyTransfer(inst, bits);
+
+  return bits;
+}
+
+BitVector BitVectorDataFlowResult::OUTBits(Instruction *inst) const {
+  auto bb = inst->getParent();
+
+  if (this->forward) {
+    auto bits = this->INBits(inst);
+    this->applyTransfer(inst, bits);
+
+    return bits;
+  }
+
+  /*
+   * Replay the transfers from the exit of the block back to "inst".
+   */
+  auto it = this->outs.find(bb);
+  BitVector bits = (it != this->outs.end()) ? it->second : BitVector{};
+  bits.resize(this->domain.size());
+  for (auto iter = bb->rbegin(); iter != bb->rend(); ++iter) {
+    if (&*iter == inst) {
+      break;
+    }
+    this->applyTransfer(&*iter, bits);
+  }
+
+  return bits;
+}
+
+std::set<Value *> BitVectorDataFlowResult::IN(Instruction *inst) const {
+  return this->domain.toValueSet(this->INBits(inst));
+}
+
+std::set<Value *> BitVectorDataFlowResult::OUT(Instruction *inst) const {
+  return this->domain.toValueSet(this->OUTBits(inst));
+}
@@ -0,0 +1,61 @@
+#include "Dataflow/Mono/DataFlowDomain.h"
+
+DataFlowDomain::DataFlowDomain() {
+  return;
+}
+
+unsigned DataFlowDomain::getOrInsert(Value *v) {
+  auto it = this->ids.find(v);
+  if (it != this->ids.end()) {
+    return it->second;
+  }
+
+  /*
+   * Assign the next free ID to the new value.
+   */
+  auto id = static_cast<unsigned>(this->values.size());
+  this->ids[v] = id;
+  this->values.push_back(v);
+
+  return id;
+}
+
+int DataFlowDomain::getID(Value *v) const {
+  auto it = this->ids.find(v);
+  if (it == this->ids.end()) {
+    return -1;
+  }
+
+  return static_cast<int>(it->second);
+}
+
+Value *DataFlowDomain::getValue(unsigned id) const {
+  assert(id < this->values.size() && "ID out of the data-flow domain");
+
+  return this->values[id];
+}
+
+unsigned DataFlowDomain::size() const {
+  return static_cast<unsigned>(this->values.size());
+}
+
+std::set<Value *> DataFlowDomain::toValueSet(const BitVector &bits) const {
+  std::set<Value *> s;
+  for (auto id : bits.set_bits()) {
+    s.insert(this->values[id]);
+  }
+
+  return s;
+}
+
+BitVector DataFlowDomain::toBitVector(const std::set<Value *> &values) const {
+  BitVector bits(this->size());
+  for (auto v : values) {
+    auto id = this->getID(v);
+    if (id >= 0) {
+      bits.set(id);
+    }
+  }
+
+  return bits;
+}
@@ -1,5 +1,85 @@
 #include "Dataflow/Mono/DataFlowEngine.h"
 
+#include "llvm/ADT/PostOrderIterator.h"
+
+namespace {
+
+/*
+ * Blocks in reverse post-order of the CFG, followed by the blocks that are
+ * not reachable from the entry. This is the visiting order that makes
+ * forward analyses converge in the fewest iterations.
+ */
+std::vector<BasicBlock *> computeReversePostOrder(Function *f) {
+  ReversePostOrderTraversal<Function *> rpot(f);
+  std::vector<BasicBlock *> order(rpot.begin(), rpot.end());
+
+  std::unordered_set<BasicBlock *> reachable(order.begin(), order.end());
+  for (auto &bb : *f) {
+    if (reachable.find(&bb) == reachable.end()) {
+      order.push_back(&bb);
+    }
+  }
+
+  return order;
+}
+
+/*
+ * Blocks in post-order of the CFG, followed by the unreachable ones. This is
+ * the visiting order of choice for backward analyses.
+ */
+std::vector<BasicBlock *> computePostOrder(Function *f) {
+  std::vector<BasicBlock *> order;
+  for (auto bb : post_order(&f->getEntryBlock())) {
+    order.push_back(bb);
+  }
+
+  std::unordered_set<BasicBlock *> reachable(order.begin(), order.end());
+  for (auto &bb : *f) {
+    if (reachable.find(&bb) == reachable.end()) {
+      order.push_back(&bb);
+    }
+  }
+
+  return order;
+}
+
+/*
+ * Working list that always returns the pending block with the smallest
+ * position in a given order. A block is pending at most once.
+ */
+class PriorityWorkingList {
+public:
+  PriorityWorkingList(const std::vector<BasicBlock *> &order) : order{order} {
+    for (unsigned i = 0; i < order.size(); i++) {
+      this->priorities[order[i]] = i;
+      this->pending.insert(i);
+    }
+  }
+
+  bool empty() const {
+    return this->pending.empty();
+  }
+
+  BasicBlock *pop() {
+    auto it = this->pending.begin();
+    auto bb = this->order[*it];
+    this->pending.erase(it);
+
+    return bb;
+  }
+
+  void push(BasicBlock *bb) {
+    this->pending.insert(this->priorities[bb]);
+  }
+
+private:
+  std::vector<BasicBlock *> order;
+  std::unordered_map<BasicBlock *, unsigned> priorities;
+  std::set<unsigned> pending;
+};
+
+} // namespace
+
 DataFlowEngine::DataFlowEngine() {
   return;
 }
@@ -55,8 +135,8 @@ DataFlowResult *DataFlowEngine::applyForward(
   /*
    * Define the customization.
    */
-  auto appendBB = [](std::list<BasicBlock *> &workingList, BasicBlock *bb) {
-    workingList.push_back(bb);
+  auto getBlockOrder = [](Function *f) -> std::vector<BasicBlock *> {
+    return computeReversePostOrder(f);
   };
 
   auto getFirstInst = [](BasicBlock *bb) -> Instruction * {
@@ -112,7 +192,7 @@ DataFlowResult *DataFlowEngine::applyForward(
                                                    getSuccessors,
                                                    computeIN,
                                                    computeOUT,
-                                                   appendBB,
+                                                   getBlockOrder,
                                                    getFirstInst,
                                                    getLastInst,
                                                    inSetOfInst,
@@ -162,8 +242,8 @@ DataFlowResult *DataFlowEngine::applyBackward(
   /*
    * Define the customization
    */
-  auto appendBB = [](std::list<BasicBlock *> &workingList, BasicBlock *bb) {
-    workingList.push_front(bb);
+  auto getBlockOrder = [](Function *f) -> std::vector<BasicBlock *> {
+    return computePostOrder(f);
   };
 
   auto getPredecessors = [](BasicBlock *bb) -> std::list<BasicBlock *> {
@@ -221,7 +301,7 @@ DataFlowResult *DataFlowEngine::applyBackward(
                                                    getSuccessors,
                                                    computeOUT,
                                                    computeIN,
-                                                   appendBB,
+                                                   getBlockOrder,
                                                    getFirstInst,
                                                    getLastInst,
                                                    inSetOfInst,
@@ -267,8 +347,7 @@ DataFlowResult *DataFlowEngine::applyGeneralizedForwardAnalysis(
     std::function<void(Instruction *inst,
                        std::set<Value *> &OUT,
                        DataFlowResult *df)> computeOUT,
-    std::function<void(std::list<BasicBlock *> &workingList, BasicBlock *bb)>
-        appendBB,
+    std::function<std::vector<BasicBlock *>(Function *f)> getBlockOrder,
     std::function<Instruction *(BasicBlock *bb)> getFirstInstruction,
     std::function<Instruction *(BasicBlock *bb)> getLastInstruction,
     std::function<std::set<Value *> &(DataFlowResult *df,
@@ -300,29 +379,24 @@ DataFlowResult *DataFlowEngine::applyGeneralizedForwardAnalysis(
   /*
    * Compute the IN and OUT
    *
-   * Create the working list by adding all basic blocks to it.
+   * Create the working list by adding all basic blocks to it, prioritized by
+   * the visiting order of the direction of the analysis.
    */
-  std::list<BasicBlock *> workingList;
-  for (auto &bb : *f) {
-    appendBB(workingList, &bb);
-  }
+  PriorityWorkingList workingList(getBlockOrder(f));
 
   /*
    * Compute the INs and OUTs iteratively until the working list is empty.
    */
   std::unordered_set<BasicBlock *> computedOnce;
+  unsigned iterations = 0;
 
   while (!workingList.empty()) {
 
     /*
-     * Fetch a basic block that needs to be processed.
-     */
-    auto bb = workingList.front();
-
-    /*
-     * Remove the basic block from the workingList.
+     * Fetch and remove the basic block that needs to be processed.
      */
-    workingList.pop_front();
+    auto bb = workingList.pop();
+    iterations++;
 
     /*
      * Fetch the first instruction of the basic block.
@@ -405,11 +479,159 @@ DataFlowResult *DataFlowEngine::applyGeneralizedForwardAnalysis(
        * Add successors of the current basic block to the working list.
        */
       for (auto succBB : getSuccessors(bb)) {
-        workingList.push_back(succBB);
+        workingList.push(succBB);
       }
     }
   }
+  df->setNumberOfIterations(iterations);
 
   return df;
 }
 
+
+BitVectorDataFlowResult *DataFlowEngine::applyForwardDense(
+    Function *f,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeKILL,
+    DataFlowMeet meet) {
+  return this->applyGeneralizedDenseAnalysis(f,
+                                             true,
+                                             computeGEN,
+                                             computeKILL,
+                                             meet);
+}
+
+BitVectorDataFlowResult *DataFlowEngine::applyBackwardDense(
+    Function *f,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeKILL,
+    DataFlowMeet meet) {
+  return this->applyGeneralizedDenseAnalysis(f,
+                                             false,
+                                             computeGEN,
+                                             computeKILL,
+                                             meet);
+}
+
+BitVectorDataFlowResult *DataFlowEngine::applyGeneralizedDenseAnalysis(
+    Function *f,
+    bool isForward,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeGEN,
+    std::function<void(Instruction *, BitVectorDataFlowResult *)> computeKILL,
+    DataFlowMeet meet) {
+
+  /*
+   * Compute the GENs and KILLs. This numbers every value of the domain.
+   */
+  auto df = new BitVectorDataFlowResult{isForward};
+  for (auto &bb : *f) {
+    for (auto &i : bb) {
+      computeGEN(&i, df);
+      computeKILL(&i, df);
+    }
+  }
+
+  /*
+   * Precompose the transfers of the instructions of every block into a
+   * single block transfer, so a visit costs a couple of word-wise operations
+   * no matter how long the block is.
+   */
+  df->computeBlockTransfers(f);
+
+  /*
+   * Initialize the block-level sets now that the size of the domain is known.
+   * Intersection starts from the full set so that the meet can only shrink it.
+   */
+  auto domainSize = df->getDomain().size();
+  auto top = (meet == DataFlowMeet::Intersection);
+  for (auto &bb : *f) {
+    df->IN(&bb) = BitVector(domainSize, top);
+    df->OUT(&bb) = BitVector(domainSize, top);
+  }
+
+  /*
+   * Create the working list by adding all basic blocks to it: reverse
+   * post-order for forward analyses, post-order for backward ones.
+   */
+  PriorityWorkingList workingList(isForward ? computeReversePostOrder(f)
+                                            : computePostOrder(f));
+
+  /*
+   * Compute the block-level INs and OUTs until the working list is empty.
+   */
+  std::unordered_set<BasicBlock *> computedOnce;
+  unsigned iterations = 0;
+  while (!workingList.empty()) {
+    auto bb = workingList.pop();
+    iterations++;
+
+    /*
+     * Fetch the set at the entry and at the exit of the block, following the
+     * direction of the analysis.
+     */
+    auto &entrySet = isForward ? df->IN(bb) : df->OUT(bb);
+    auto &exitSet = isForward ? df->OUT(bb) : df->IN(bb);
+
+    /*
+     * Apply the meet operator over the exit sets of the predecessors (in the
+     * direction of the analysis). Blocks without any of them are boundaries.
+     */
+    auto first = true;
+    auto meetWith = [&](BasicBlock *other) {
+      auto &otherExit = isForward ? df->OUT(other) : df->IN(other);
+      if (first) {
+        entrySet = otherExit;
+        first = false;
+      } else if (meet == DataFlowMeet::Union) {
+        entrySet |= otherExit;
+      } else {
+        entrySet &= otherExit;
+      }
+    };
+    if (isForward) {
+      for (auto predecessorBB : predecessors(bb)) {
+        meetWith(predecessorBB);
+      }
+    } else {
+      for (auto successorBB : successors(bb)) {
+        meetWith(successorBB);
+      }
+    }
+    if (first) {
+      entrySet.reset();
+    }
+
+    /*
+     * Apply the transfer of the whole block.
+     */
+    auto newExitSet = entrySet;
+    df->applyBlockTransfer(bb, newExitSet);
+
+    /*
+     * Check if the exit set of the current basic block changed.
+     */
+    if ((computedOnce.find(bb) != computedOnce.end())
+        && (newExitSet == exitSet)) {
+      continue;
+    }
+    computedOnce.insert(bb);
+    exitSet = std::move(newExitSet);
+
+    /*
+     * Add the successors (in the direction of the analysis) of the current
+     * basic block to the working list.
+     */
+    if (isForward) {
+      for (auto successorBB : successors(bb)) {
+        workingList.push(successorBB);
+      }
+    } else {
+      for (auto predecessorBB : predecessors(bb)) {
+        workingList.push(predecessorBB);
+      }
+    }
+  }
+  df->setNumberOfIterations(iterations);
+
+  return df;
+}
@@ -28,3 +28,13 @@ std::set<Value *> &DataFlowResult::OUT(Instruction *inst) {
 
   return s;
 }
+
+unsigned DataFlowResult::getNumberOfIterations() const {
+  return this->iterations;
+}
+
+void DataFlowResult::setNumberOfIterations(unsigned n) {
+  this->iterations = n;
+
+  return;
+}
@@ -1,30 +1,43 @@
 #include "Dataflow/WPDS/InterProceduralDataFlow.h"
-#include <algorithm>
 
 namespace dataflow {
 
-// Initialize the static universe set
-std::set<Value*> DataFlowFacts::universe;
-
 DataFlowFacts::DataFlowFacts() = default;
 
-DataFlowFacts::DataFlowFacts(const std::set<Value*>& facts)
-    : facts(facts) {
+DataFlowFacts::DataFlowFacts(const std::set<Value*>& facts) {
+    for (auto* val : facts) {
+        addFact(val);
+    }
 }
 
 DataFlowFacts::DataFlowFacts(const DataFlowFacts& other)
-    : facts(other.facts) {
+    : bits(other.bits) {
 }
 
 DataFlowFacts& DataFlowFacts::operator=(const DataFlowFacts& other) {
     if (this != &other) {
-        facts = other.facts;
+        bits = other.bits;
     }
     return *this;
 }
 
 bool DataFlowFacts::operator==(const DataFlowFacts& other) const {
-    return facts == other.facts;
+    return bits == other.bits;
+}
+
+DataFlowDomain& DataFlowFacts::getDomain() {
+    static DataFlowDomain domain;
+    return domain;
+}
+
+void DataFlowFacts::resetDomain() {
+    GenKillTransformer::clearCache();
+    getDomain() = DataFlowDomain();
+}
+
+void DataFlowFacts::trim() {
+    // Drop the trailing zero words so that equal sets compare equal
+    bits.resize(bits.find_last() + 1);
 }
 
 DataFlowFacts DataFlowFacts::EmptySet() {
@@ -32,69 +45,81 @@ DataFlowFacts DataFlowFacts::EmptySet() {
 }
 
 DataFlowFacts DataFlowFacts::UniverseSet() {
-    return DataFlowFacts(universe);
+    DataFlowFacts result;
+    result.bits.resize(getDomain().size(), true);
+    return result;
 }
 
 DataFlowFacts DataFlowFacts::Union(const DataFlowFacts& x, const DataFlowFacts& y) {
-    DataFlowFacts result = x;
-    result.facts.insert(y.facts.begin(), y.facts.end());
+    DataFlowFacts result = x.bits.size() >= y.bits.size() ? x : y;
+    const DataFlowFacts& other = x.bits.size() >= y.bits.size() ? y : x;
+    // BitVector::operator|= grows the left-hand side only; it is the
+    // longest here, so nothing is lost and no trimming is needed.
+    result.bits |= other.bits;
     return result;
 }
 
 DataFlowFacts DataFlowFacts::Intersect(const DataFlowFacts& x, const DataFlowFacts& y) {
-    DataFlowFacts result;
-    std::set_intersection(
-        x.facts.begin(), x.facts.end(),
-        y.facts.begin(), y.facts.end(),
-        std::inserter(result.facts, result.facts.begin())
-    );
+    DataFlowFacts result = x;
+    result.bits &= y.bits;
+    result.trim();
     return result;
 }
 
 DataFlowFacts DataFlowFacts::Diff(const DataFlowFacts& x, const DataFlowFacts& y) {
-    DataFlowFacts result;
-    std::set_difference(
-        x.facts.begin(), x.facts.end(),
-        y.facts.begin(), y.facts.end(),
-        std::inserter(result.facts, result.facts.begin())
-    );
+    DataFlowFacts result = x;
+    result.bits.reset(y.bits);
+    result.trim();
     return result;
 }
 
 bool DataFlowFacts::Eq(const DataFlowFacts& x, const DataFlowFacts& y) {
-    return x.facts == y.facts;
+    return x.bits == y.bits;
 }
 
-const std::set<Value*>& DataFlowFacts::getFacts() const {
-    return facts;
+std::set<Value*> DataFlowFacts::getFacts() const {
+    return getDomain().toValueSet(bits);
+}
+
+const BitVector& DataFlowFacts::getBits() const {
+    return bits;
 }
 
 void DataFlowFacts::addFact(Value* val) {
-    facts.insert(val);
-    // Also add to universe set
-    universe.insert(val);
+    // Numbering the value also adds it to the universe set
+    auto id = getDomain().getOrInsert(val);
+    if (id >= bits.size()) {
+        bits.resize(id + 1);
+    }
+    bits.set(id);
 }
 
 void DataFlowFacts::removeFact(Value* val) {
-    facts.erase(val);
+    auto id = getDomain().getID(val);
+    if (id < 0 || static_cast<unsigned>(id) >= bits.size()) {
+        return;
+    }
+    bits.reset(id);
+    trim();
 }
 
 bool DataFlowFacts::containsFact(Value* val) const {
-    return facts.find(val) != facts.end();
+    auto id = getDomain().getID(val);
+    return id >= 0 && static_cast<unsigned>(id) < bits.size() && bits.test(id);
 }
 
 std::size_t DataFlowFacts::size() const {
-    return facts.size();
+    return bits.count();
 }
 
 bool DataFlowFacts::isEmpty() const {
-    return facts.empty();
+    return bits.none();
 }
 
 std::ostream& DataFlowFacts::print(std::ostream& os) const {
     os << "DataFlowFacts{";
     bool first = true;
-    for (auto* val : facts) {
+    for (auto* val : getFacts()) {
         if (!first) {
             os << ", ";
         }
@@ -1,4 +1,6 @@
 #include "Dataflow/WPDS/InterProceduralDataFlow.h"
+#include <array>
+#include <mutex>
 
 namespace dataflow {
 
@@ -10,27 +12,94 @@ GenKillTransformer::GenKillTransformer(const DataFlowFacts& kill, const DataFlow
     : count(0), kill(DataFlowFacts::Diff(kill, gen)), gen(gen) {
 }
 
-GenKillTransformer::GenKillTransformer(const DataFlowFacts& k, const DataFlowFacts& g, int) 
-    : count(0), kill(k), gen(g) {
+GenKillTransformer::GenKillTransformer(const DataFlowFacts& k, const DataFlowFacts& g, int c) 
+    : count(c), kill(k), gen(g), unique(true) {
 }
 
+namespace {
+
+// Hash-consing table. Every entry holds one reference to its transformer.
+using TransformerKey = std::pair<BitVector, BitVector>;
+
+struct TransformerKeyHash {
+    // BitVector::getData() cannot be used on empty bitvectors
+    static hash_code hashBits(const BitVector& bits) {
+        if (bits.empty()) {
+            return hash_value(0);
+        }
+        auto words = bits.getData();
+        return hash_combine_range(words.begin(), words.end());
+    }
+
+    std::size_t operator()(const TransformerKey& key) const {
+        return hash_combine(hashBits(key.first), hashBits(key.second));
+    }
+};
+
+using TransformerCache =
+    std::unordered_map<TransformerKey, GenKillTransformer*, TransformerKeyHash>;
+
+// The table is split in shards picked by the key hash, so that threads
+// interning different transformers rarely wait on the same lock.
+struct TransformerCacheShard {
+    std::mutex lock;
+    TransformerCache cache;
+};
+
+constexpr std::size_t NumTransformerCacheShards = 64;
+
+std::array<TransformerCacheShard, NumTransformerCacheShards>& getTransformerCacheShards() {
+    static std::array<TransformerCacheShard, NumTransformerCacheShards> shards;
+    return shards;
+}
+
+} // anonymous namespace
+
 GenKillTransformer* GenKillTransformer::makeGenKillTransformer(
     const DataFlowFacts& kill, 
     const DataFlowFacts& gen) {
     
     DataFlowFacts k_normalized = DataFlowFacts::Diff(kill, gen);
     
-    if (DataFlowFacts::Eq(k_normalized, DataFlowFacts::EmptySet()) && 
-        DataFlowFacts::Eq(gen, DataFlowFacts::UniverseSet())) {
-        return GenKillTransformer::bottom();
-    }
-    else if (DataFlowFacts::Eq(k_normalized, DataFlowFacts::EmptySet()) && 
-             DataFlowFacts::Eq(gen, DataFlowFacts::EmptySet())) {
+    if (k_normalized.isEmpty() && gen.isEmpty()) {
         return GenKillTransformer::one();
     }
-    else {
-        return new GenKillTransformer(k_normalized, gen);
+
+    // The universe grows while the analysis numbers new values, so a
+    // transformer whose gen set is the current universe is not bottom:
+    // it must not be replaced by the (older) bottom instance.
+    TransformerKey key{k_normalized.getBits(), gen.getBits()};
+    std::size_t hash = TransformerKeyHash()(key);
+    auto& shard = getTransformerCacheShards()[hash % NumTransformerCacheShards];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto& entry = shard.cache[std::move(key)];
+    if (entry == nullptr) {
+        entry = new GenKillTransformer(k_normalized, gen, 1);
+    }
+    return entry;
+}
+
+void GenKillTransformer::clearCache() {
+    for (auto& shard : getTransformerCacheShards()) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for (auto& entry : shard.cache) {
+            auto* transformer = entry.second;
+            // Transformers still referenced by a ref_ptr are freed by it
+            if (--transformer->count == 0) {
+                delete transformer;
+            }
+        }
+        shard.cache.clear();
+    }
+}
+
+std::size_t GenKillTransformer::cacheSize() {
+    std::size_t size = 0;
+    for (auto& shard : getTransformerCacheShards()) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        size += shard.cache.size();
     }
+    return size;
 }
 
 GenKillTransformer* GenKillTransformer::one() {
@@ -123,14 +192,14 @@ GenKillTransformer* GenKillTransformer::quasiOne() const {
 }
 
 bool GenKillTransformer::equal(GenKillTransformer* y) const {
-    // Handle special values
-    if (this == one() && y == one()) return true;
-    if (this == zero() && y == zero()) return true;
-    if (this == bottom() && y == bottom()) return true;
+    if (this == y) return true;
+
+    // Unique representatives (one/zero/bottom and hash-consed transformers)
+    // are equal only to themselves
+    if (unique && y->unique) return false;
     
-    if ((this == one() && y != one()) ||
-        (this == zero() && y != zero()) ||
-        (this == bottom() && y != bottom())) {
+    // Handle special values
+    if (this == zero() || y == zero() || this == bottom() || y == bottom()) {
         return false;
     }
     
@@ -139,6 +208,12 @@ bool GenKillTransformer::equal(GenKillTransformer* y) const {
 }
 
 DataFlowFacts GenKillTransformer::apply(const DataFlowFacts& input) {
+    // zero() kills the universe it was created with, which may be smaller
+    // than the current one
+    if (this == zero()) {
+        return DataFlowFacts::EmptySet();
+    }
+
     // Apply kill and gen operation: (input - kill) ∪ gen
     DataFlowFacts result = DataFlowFacts::Diff(input, kill);
     return DataFlowFacts::Union(result, gen);
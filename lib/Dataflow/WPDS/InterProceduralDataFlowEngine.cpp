@@ -2,6 +2,9 @@
 #include "Solvers/WPDS/CA.h"
 #include "Solvers/WPDS/SaturationProcess.h"
 
+#include <mutex>
+#include <vector>
+
 namespace dataflow {
 
 using namespace wpds;
@@ -13,6 +16,9 @@ std::unique_ptr<DataFlowResult> InterProceduralDataFlowEngine::runForwardAnalysi
     std::function<GenKillTransformer*(Instruction*)> createTransformer,
     const std::set<Value*>& initialFacts) {
     
+    // Facts of a previous analysis are numbered in a different domain
+    DataFlowFacts::resetDomain();
+    
     // Create semiring and WPDS
     Semiring<GenKillTransformer> semiring(GenKillTransformer::one());
     WPDS<GenKillTransformer> wpds(semiring);
@@ -29,7 +35,7 @@ std::unique_ptr<DataFlowResult> InterProceduralDataFlowEngine::runForwardAnalysi
     
     // Extract results
     currentResult = std::make_unique<DataFlowResult>();
-    extractResults(m, resultCA, currentResult, true);
+    extractResults(m, resultCA, currentResult, initialFacts, true);
     
     return std::move(currentResult);
 }
@@ -39,6 +45,9 @@ std::unique_ptr<DataFlowResult> InterProceduralDataFlowEngine::runBackwardAnalys
     std::function<GenKillTransformer*(Instruction*)> createTransformer,
     const std::set<Value*>& initialFacts) {
     
+    // Facts of a previous analysis are numbered in a different domain
+    DataFlowFacts::resetDomain();
+    
     // Create semiring and WPDS
     Semiring<GenKillTransformer> semiring(GenKillTransformer::one());
     WPDS<GenKillTransformer> wpds(semiring);
@@ -55,11 +64,67 @@ std::unique_ptr<DataFlowResult> InterProceduralDataFlowEngine::runBackwardAnalys
     
     // Extract results
     currentResult = std::make_unique<DataFlowResult>();
-    extractResults(m, resultCA, currentResult, false);
+    extractResults(m, resultCA, currentResult, initialFacts, false);
     
     return std::move(currentResult);
 }
 
+std::vector<std::unique_ptr<DataFlowResult>> InterProceduralDataFlowEngine::runForwardAnalyses(
+    Module& m,
+    std::function<GenKillTransformer*(Instruction*)> createTransformer,
+    const std::vector<std::set<Value*>>& initialFacts,
+    unsigned numThreads) {
+    return runAnalyses(m, createTransformer, initialFacts, numThreads, true);
+}
+
+std::vector<std::unique_ptr<DataFlowResult>> InterProceduralDataFlowEngine::runBackwardAnalyses(
+    Module& m,
+    std::function<GenKillTransformer*(Instruction*)> createTransformer,
+    const std::vector<std::set<Value*>>& initialFacts,
+    unsigned numThreads) {
+    return runAnalyses(m, createTransformer, initialFacts, numThreads, false);
+}
+
+std::vector<std::unique_ptr<DataFlowResult>> InterProceduralDataFlowEngine::runAnalyses(
+    Module& m,
+    std::function<GenKillTransformer*(Instruction*)> createTransformer,
+    const std::vector<std::set<Value*>>& initialFacts,
+    unsigned numThreads,
+    bool isForward) {
+    
+    // Facts of a previous analysis are numbered in a different domain
+    DataFlowFacts::resetDomain();
+    
+    // Create semiring and WPDS, shared by all the queries
+    Semiring<GenKillTransformer> semiring(GenKillTransformer::one());
+    WPDS<GenKillTransformer> wpds(semiring);
+    buildWPDS(m, wpds, createTransformer);
+    
+    // Initial automata are built upfront: numbering the initial facts
+    // updates the domain, which is only read during saturation
+    std::vector<std::unique_ptr<CA<GenKillTransformer>>> initialCAs;
+    std::vector<const CA<GenKillTransformer>*> queries;
+    for (auto& facts : initialFacts) {
+        initialCAs.emplace_back(new CA<GenKillTransformer>(semiring));
+        buildInitialAutomaton(m, *initialCAs.back(), facts, isForward);
+        queries.push_back(initialCAs.back().get());
+    }
+    
+    MultiQuery<GenKillTransformer> solver(
+        wpds, semiring, isForward ? Query::poststar() : Query::prestar());
+    auto resultCAs = solver.solve(queries, numThreads);
+    
+    // Extract results
+    std::vector<std::unique_ptr<DataFlowResult>> results;
+    for (std::size_t i = 0; i < resultCAs.size(); ++i) {
+        auto result = std::make_unique<DataFlowResult>();
+        extractResults(m, *resultCAs[i], result, initialFacts[i], isForward);
+        results.push_back(std::move(result));
+    }
+    
+    return results;
+}
+
 const std::set<Value*>& InterProceduralDataFlowEngine::getInSet(Instruction* inst) const {
     if (!currentResult) {
         static std::set<Value*> emptySet;
@@ -81,130 +146,101 @@ void InterProceduralDataFlowEngine::buildWPDS(
     WPDS<GenKillTransformer>& wpds,
     std::function<GenKillTransformer*(Instruction*)> createTransformer) {
     
+    typedef Traits<GenKillTransformer>::sem_elem_t sem_elem_t;
+    typedef WPDS<GenKillTransformer>::RuleSpec RuleSpec;
+
     // Clear previous mappings
     functionToKey.clear();
-    instToKey.clear();
+    functionToExitKey.clear();
     bbToKey.clear();
-    keyToInst.clear();
+    callSiteToKey.clear();
+    returnSiteToKey.clear();
+    instToTransformer.clear();
+    nextKeyID = 0;
 
     // Create a control state for PDS
-    wpds_key_t controlState = str2key("q");
+    controlState = str2key("q");
     
     // Create a stack bottom symbol
     wpds_key_t stackBottom = str2key("stack_bottom");
     
-    // For each function in the module
+    // Allocate the keys of all blocks and function exits up front, so that
+    // calls can refer to callees defined later in the module. The entry of a
+    // function is the key of its entry block. The transformers of all
+    // instructions are created here as well, so the whole domain is known
+    // before any of them gets composed.
     for (auto& F : m) {
         if (F.isDeclaration()) continue;
-        
-        // Create function entry and exit keys
-        std::string fname = F.getName().str();
-        wpds_key_t funcEntry = new_str2key(("entry_" + fname).c_str());
-        wpds_key_t funcExit = new_str2key(("exit_" + fname).c_str());
-        functionToKey[&F] = funcEntry;
-        
-        // For each basic block in the function
         for (auto& BB : F) {
-            // Create basic block key
-            std::string bbName = BB.getName().str();
-            if (bbName.empty()) {
-                bbName = "bb_" + std::to_string(bbToKey.size());
+            bbToKey[&BB] = newKey();
+            for (auto& I : BB) {
+                instToTransformer[&I] = sem_elem_t(createTransformer(&I));
             }
-            wpds_key_t bbKey = new_str2key(bbName.c_str());
-            bbToKey[&BB] = bbKey;
+        }
+        functionToKey[&F] = bbToKey[&F.getEntryBlock()];
+        functionToExitKey[&F] = newKey();
+    }
+
+    // Rules are collected first and inserted in bulk. The weights are kept
+    // alive here until the rules take their own references.
+    std::vector<RuleSpec> rules;
+    std::vector<sem_elem_t> weights;
+    auto addRule = [&](wpds_key_t y, wpds_key_t g1, wpds_key_t g2,
+                       const sem_elem_t& weight) {
+        rules.push_back({controlState, y, controlState, g1, g2, weight.get_ptr()});
+        weights.push_back(weight);
+    };
+
+    for (auto& F : m) {
+        if (F.isDeclaration()) continue;
+        
+        for (auto& BB : F) {
+            // The block is split after every call to a defined function.
+            // Each segment gets one rule whose weight is the composition of
+            // the transformers of its instructions.
+            wpds_key_t segmentKey = bbToKey[&BB];
+            sem_elem_t segmentWeight(GenKillTransformer::one());
             
-            // For each instruction in the basic block
             for (auto& I : BB) {
-                // Create instruction key
-                std::string instName = I.getName().str();
-                if (instName.empty()) {
-                    instName = "inst_" + std::to_string(instToKey.size());
-                }
-                wpds_key_t instKey = new_str2key(instName.c_str());
-                instToKey[&I] = instKey;
-                keyToInst[instKey] = &I;
-                
-                // Create the gen/kill transformer for this instruction
-                GenKillTransformer* transformer = createTransformer(&I);
-                
-                // Add intraprocedural edges
-                if (&I == &BB.front()) {
-                    // First instruction of BB, connect from BB
-                    wpds.add_rule(controlState, bbKey, controlState, instKey, transformer);
-                } else {
-                    // Connect from previous instruction
-                    auto prevIt = I.getIterator();
-                    prevIt--;
-                    Instruction* prevInst = &(*prevIt);
-                    wpds_key_t prevInstKey = instToKey[prevInst];
-                    wpds.add_rule(controlState, prevInstKey, controlState, instKey, transformer);
-                }
+                segmentWeight =
+                    segmentWeight->extend(instToTransformer[&I].get_ptr());
                 
                 // Handle call instructions
-                if (auto* callInst = dyn_cast<CallInst>(&I)) {
-                    Function* calledFunc = callInst->getCalledFunction();
-                    if (calledFunc && !calledFunc->isDeclaration()) {
-                        // Create call site key
-                        wpds_key_t callSiteKey = new_str2key(("callsite_" + instName).c_str());
-                        
-                        // Add interprocedural edges for the call
-                        wpds_key_t calledFuncEntry = functionToKey[calledFunc];
-                        wpds.add_rule(
-                            controlState, instKey, 
-                            controlState, calledFuncEntry, callSiteKey, 
-                            GenKillTransformer::one()
-                        );
-                        
-                        // Create return site key
-                        wpds_key_t returnSiteKey = new_str2key(("returnsite_" + instName).c_str());
-                        
-                        // If there's a next instruction, connect to it on return
-                        auto nextIt = I.getIterator();
-                        nextIt++;
-                        if (nextIt != BB.end()) {
-                            Instruction* nextInst = &(*nextIt);
-                            wpds_key_t nextInstKey = instToKey[nextInst];
-                            
-                            // Add rule for function return
-                            wpds.add_rule(
-                                controlState, funcExit, 
-                                controlState, 
-                                GenKillTransformer::one()
-                            );
-                            
-                            // Connect return site to next instruction
-                            wpds.add_rule(
-                                controlState, returnSiteKey, 
-                                controlState, nextInstKey, 
-                                GenKillTransformer::one()
-                            );
-                        }
-                    }
-                }
-                
-                // Handle return instructions
-                if (isa<ReturnInst>(&I)) {
-                    wpds.add_rule(
-                        controlState, instKey, 
-                        controlState, funcExit, 
-                        GenKillTransformer::one()
-                    );
-                }
+                auto* callInst = dyn_cast<CallInst>(&I);
+                if (!callInst) continue;
+                Function* calledFunc = callInst->getCalledFunction();
+                if (!calledFunc || calledFunc->isDeclaration()) continue;
+
+                // <q, segment> -> <q, callee_entry return_site>
+                wpds_key_t returnSiteKey = newKey();
+                callSiteToKey[callInst] = segmentKey;
+                returnSiteToKey[callInst] = returnSiteKey;
+                addRule(segmentKey, functionToKey[calledFunc], returnSiteKey,
+                        segmentWeight);
+
+                // The rest of the block continues from the return site
+                segmentKey = returnSiteKey;
+                segmentWeight = GenKillTransformer::one();
             }
             
-            // Connect basic blocks via control flow
+            // Handle return instructions: <q, segment> -> <q, exit>
+            if (isa<ReturnInst>(BB.getTerminator())) {
+                addRule(segmentKey, functionToExitKey[&F], WPDS_EPSILON,
+                        segmentWeight);
+            }
+
+            // Connect basic blocks via control flow: <q, segment> -> <q, succ>
+            SmallPtrSet<BasicBlock*, 4> visitedSuccessors;
             for (auto* succBB : successors(&BB)) {
-                wpds_key_t succBBKey = bbToKey[succBB];
-                Instruction* lastInst = BB.getTerminator();
-                wpds_key_t lastInstKey = instToKey[lastInst];
-                
-                wpds.add_rule(
-                    controlState, lastInstKey, 
-                    controlState, succBBKey, 
-                    GenKillTransformer::one()
-                );
+                if (!visitedSuccessors.insert(succBB).second) continue;
+                addRule(segmentKey, bbToKey[succBB], WPDS_EPSILON,
+                        segmentWeight);
             }
         }
+
+        // Rule for function return: <q, exit> -> <q, eps>
+        addRule(functionToExitKey[&F], WPDS_EPSILON, WPDS_EPSILON,
+                GenKillTransformer::one());
     }
     
     // Add initial rule for program entry
@@ -213,12 +249,11 @@ void InterProceduralDataFlowEngine::buildWPDS(
         wpds_key_t mainEntry = functionToKey[mainFunc];
         
         // Rule to start execution at main
-        wpds.add_rule(
-            controlState, stackBottom, 
-            controlState, mainEntry, stackBottom, 
-            GenKillTransformer::one()
-        );
+        addRule(stackBottom, mainEntry, stackBottom, GenKillTransformer::one());
     }
+
+    // Every rule above has a distinct left-hand side/right-hand side pair
+    wpds.add_rules(rules.begin(), rules.end(), true);
 }
 
 void InterProceduralDataFlowEngine::buildInitialAutomaton(
@@ -227,9 +262,10 @@ void InterProceduralDataFlowEngine::buildInitialAutomaton(
     const std::set<Value*>& initialFacts,
     bool isForward) {
     
-    // Create states for the automaton
-    wpds_key_t initialState = str2key("p");
-    wpds_key_t acceptingState = str2key("accepting");
+    // Create states for the automaton. The initial state of the automaton
+    // must be the control state of the PDS for saturation to apply rules.
+    initialState = controlState;
+    acceptingState = str2key("accepting");
     
     // Add transitions for each program point
     DataFlowFacts facts(initialFacts);
@@ -246,18 +282,12 @@ void InterProceduralDataFlowEngine::buildInitialAutomaton(
                       DataFlowFacts::EmptySet(), facts));
         }
     } else {
-        // For backward analysis, create transitions from all program points
-        // to the accepting state with initial facts
-        for (auto& kv : instToKey) {
-            Instruction* inst = kv.first;
-            wpds_key_t instKey = kv.second;
-            
-            // We're especially interested in return instructions and call sites
-            if (isa<ReturnInst>(inst) || isa<CallInst>(inst)) {
-                ca.add(initialState, instKey, acceptingState, 
-                      GenKillTransformer::makeGenKillTransformer(
-                          DataFlowFacts::EmptySet(), facts));
-            }
+        // For backward analysis, create transitions from the exit of every
+        // function to the accepting state with initial facts
+        for (auto& kv : functionToExitKey) {
+            ca.add(initialState, kv.second, acceptingState, 
+                  GenKillTransformer::makeGenKillTransformer(
+                      DataFlowFacts::EmptySet(), facts));
         }
     }
     
@@ -267,17 +297,21 @@ void InterProceduralDataFlowEngine::buildInitialAutomaton(
     ca.add_final_state(acceptingState);
 }
 
-wpds_key_t InterProceduralDataFlowEngine::getKeyForFunction(Function* f) {
-    auto it = functionToKey.find(f);
-    if (it != functionToKey.end()) {
-        return it->second;
+wpds_key_t InterProceduralDataFlowEngine::newKey() {
+    // The keys come from one range shared by all the engines and all the
+    // builds, so that building a WPDS again does not grow the dictionary
+    static std::mutex keyPoolLock;
+    static std::vector<wpds_key_t> keyPool;
+    std::lock_guard<std::mutex> guard(keyPoolLock);
+    if (static_cast<std::size_t>(nextKeyID) == keyPool.size()) {
+        keyPool.push_back(int2key(nextKeyID));
     }
-    return WPDS_EPSILON;
+    return keyPool[nextKeyID++];
 }
 
-wpds_key_t InterProceduralDataFlowEngine::getKeyForInstruction(Instruction* inst) {
-    auto it = instToKey.find(inst);
-    if (it != instToKey.end()) {
+wpds_key_t InterProceduralDataFlowEngine::getKeyForFunction(Function* f) {
+    auto it = functionToKey.find(f);
+    if (it != functionToKey.end()) {
         return it->second;
     }
     return WPDS_EPSILON;
@@ -292,134 +326,150 @@ wpds_key_t InterProceduralDataFlowEngine::getKeyForBasicBlock(BasicBlock* bb) {
 }
 
 wpds_key_t InterProceduralDataFlowEngine::getKeyForCallSite(CallInst* callInst) {
-    std::string instName = callInst->getName().str();
-    if (instName.empty()) {
-        auto it = instToKey.find(callInst);
-        if (it != instToKey.end()) {
-            // Instead of key2str, just use a generic string
-            instName = "callsite_" + std::to_string(reinterpret_cast<std::uintptr_t>(callInst));
-        } else {
-            instName = "unknown_call";
-        }
+    auto it = callSiteToKey.find(callInst);
+    if (it != callSiteToKey.end()) {
+        return it->second;
     }
-    return str2key(("callsite_" + instName).c_str());
+    return WPDS_EPSILON;
 }
 
 wpds_key_t InterProceduralDataFlowEngine::getKeyForReturnSite(CallInst* callInst) {
-    std::string instName = callInst->getName().str();
-    if (instName.empty()) {
-        auto it = instToKey.find(callInst);
-        if (it != instToKey.end()) {
-            // Instead of key2str, just use a generic string
-            instName = "returnsite_" + std::to_string(reinterpret_cast<std::uintptr_t>(callInst));
-        } else {
-            instName = "unknown_call";
-        }
+    auto it = returnSiteToKey.find(callInst);
+    if (it != returnSiteToKey.end()) {
+        return it->second;
     }
-    return str2key(("returnsite_" + instName).c_str());
+    return WPDS_EPSILON;
 }
 
 void InterProceduralDataFlowEngine::extractResults(
-    Module& /* m */,
+    Module& m,
     CA<GenKillTransformer>& resultCA,
     std::unique_ptr<DataFlowResult>& result,
+    const std::set<Value*>& initialFacts,
     bool isForward) {
     
-    // For each instruction in the program
-    for (auto& kv : instToKey) {
-        Instruction* inst = kv.first;
-        wpds_key_t instKey = kv.second;
-        
-        // Create a query to find the data flow facts at this program point
-        wpds_key_t initialState = str2key("p");
-        wpds_key_t acceptingState = str2key("accepting");
-        
-        // Query the automaton for the instruction key
-        // Use find instead of get_trans
+    typedef Traits<GenKillTransformer>::sem_elem_t sem_elem_t;
+
+    // After post*, the points of a callee are on transitions to the state
+    // generated for its entry, and the weights of its calling contexts are
+    // on the paths from that state to the accepting state. The path summary
+    // combines the contexts into the weight of the state.
+    if (isForward) {
+        resultCA.set_query(Query::poststar());
+        resultCA.path_summary();
+    }
+
+    // Facts at the program point of a key, if the point is reachable
+    auto factsAt = [&](wpds_key_t key, DataFlowFacts& facts) -> bool {
+        if (isForward) {
+            sem_elem_t weight(GenKillTransformer::zero());
+            auto transitions = resultCA.match(initialState, key);
+            for (auto it = transitions.first; it != transitions.second; ++it) {
+                sem_elem_t context = resultCA.state_weight((*it)->to_state());
+                sem_elem_t path(context->extend((*it)->semiring_element().get_ptr()));
+                weight = weight->combine(path.get_ptr());
+            }
+            if (weight->equal(GenKillTransformer::zero())) {
+                return false;
+            }
+            facts = weight->apply(DataFlowFacts::EmptySet());
+            return true;
+        }
+
         CA<GenKillTransformer>::catrans_t transition;
-        bool found = resultCA.find(initialState, instKey, acceptingState, transition);
-        
-        if (found && transition.get_ptr() != nullptr) {
-            // Get transformer from transition
-            // We need to cast this properly from sem_elem_t
-            auto* transformer = transition->semiring_element().get_ptr();
-            
-            // Convert to DataFlowResult format
-            result->GEN(inst) = transformer->getGen().getFacts();
-            result->KILL(inst) = transformer->getKill().getFacts();
-            
-            // Initialize IN and OUT sets
+        bool found = resultCA.find(initialState, key, acceptingState, transition);
+        if (!found || transition.get_ptr() == nullptr) {
+            return false;
+        }
+        facts = transition->semiring_element()->apply(DataFlowFacts::EmptySet());
+        return true;
+    };
+
+    // Backward facts entering the callee of a call, if it returns: the
+    // summary of the callee extended by the facts at the return site. The
+    // pop rule of the callee exit leaves its summary on the transition from
+    // the control state to itself.
+    auto factsAtCalleeEntry = [&](CallInst* callInst, DataFlowFacts& facts) -> bool {
+        auto it = returnSiteToKey.find(callInst);
+        if (it == returnSiteToKey.end()) {
+            return false;
+        }
+        CA<GenKillTransformer>::catrans_t summary, afterCall;
+        wpds_key_t calleeEntry = functionToKey[callInst->getCalledFunction()];
+        if (!resultCA.find(initialState, calleeEntry, initialState, summary) ||
+            summary.get_ptr() == nullptr ||
+            !resultCA.find(initialState, it->second, acceptingState, afterCall) ||
+            afterCall.get_ptr() == nullptr) {
+            return false;
+        }
+        sem_elem_t weight(summary->semiring_element()->extend(
+            afterCall->semiring_element().get_ptr()));
+        facts = weight->apply(DataFlowFacts::EmptySet());
+        return true;
+    };
+
+    // The automaton only holds facts at block (and return site) granularity.
+    // The sets of the single instructions are materialized by replaying
+    // their transformers through the block.
+    for (auto& F : m) {
+        if (F.isDeclaration()) continue;
+
+        for (auto& BB : F) {
+            DataFlowFacts current;
+            if (!factsAt(bbToKey[&BB], current)) continue;
+
             if (isForward) {
-                // For forward analysis:
                 // OUT[inst] = GEN[inst] ∪ (IN[inst] - KILL[inst])
-                // For entry points, IN is empty or some user-specified set
-                if (auto* firstInst = dyn_cast<Instruction>(&inst->getParent()->front())) {
-                    if (inst == firstInst) {
-                        // This is a basic block entry - IN depends on predecessors
-                        if (inst->getParent()->hasNPredecessorsOrMore(1)) {
-                            // Take the union of out sets from predecessors
-                            for (auto* predBB : predecessors(inst->getParent())) {
-                                Instruction* predTerminator = predBB->getTerminator();
-                                result->IN(inst).insert(
-                                    result->OUT(predTerminator).begin(),
-                                    result->OUT(predTerminator).end()
-                                );
-                            }
+                for (auto& I : BB) {
+                    auto& transformer = instToTransformer[&I];
+                    result->GEN(&I) = transformer->getGen().getFacts();
+                    result->KILL(&I) = transformer->getKill().getFacts();
+                    result->IN(&I) = current.getFacts();
+                    current = transformer->apply(current);
+
+                    // After a call, continue from the facts at its return site
+                    if (auto* callInst = dyn_cast<CallInst>(&I)) {
+                        auto it = returnSiteToKey.find(callInst);
+                        DataFlowFacts afterCall;
+                        if (it != returnSiteToKey.end() && factsAt(it->second, afterCall)) {
+                            current = afterCall;
                         }
-                    } else {
-                        // Not a BB entry - get IN from the OUT of previous instruction
-                        auto prevIt = inst->getIterator();
-                        prevIt--;
-                        Instruction* prevInst = &(*prevIt);
-                        result->IN(inst) = result->OUT(prevInst);
                     }
+                    result->OUT(&I) = current.getFacts();
                 }
-                
-                // Apply gen/kill to compute OUT
-                std::set<Value*> outSet;
-                // OUT = (IN - KILL) ∪ GEN
-                std::set_difference(
-                    result->IN(inst).begin(), result->IN(inst).end(),
-                    result->KILL(inst).begin(), result->KILL(inst).end(),
-                    std::inserter(outSet, outSet.begin())
-                );
-                outSet.insert(result->GEN(inst).begin(), result->GEN(inst).end());
-                result->OUT(inst) = outSet;
             } else {
-                // For backward analysis:
+                // OUT of the block is the union of the INs of its successors;
+                // returns start from the initial facts
+                DataFlowFacts out;
+                if (isa<ReturnInst>(BB.getTerminator())) {
+                    out = DataFlowFacts(initialFacts);
+                }
+                for (auto* succBB : successors(&BB)) {
+                    DataFlowFacts succFacts;
+                    if (factsAt(bbToKey[succBB], succFacts)) {
+                        out = DataFlowFacts::Union(out, succFacts);
+                    }
+                }
+
                 // IN[inst] = GEN[inst] ∪ (OUT[inst] - KILL[inst])
-                // For exit points, OUT is empty or some user-specified set
-                if (inst->isTerminator()) {
-                    // This is a basic block exit - OUT depends on successors
-                    if (auto* br = dyn_cast<BranchInst>(inst)) {
-                        // Take the union of in sets from successors
-                        for (unsigned i = 0; i < br->getNumSuccessors(); i++) {
-                            BasicBlock* succBB = br->getSuccessor(i);
-                            Instruction* succInst = &succBB->front();
-                            result->OUT(inst).insert(
-                                result->IN(succInst).begin(),
-                                result->IN(succInst).end()
-                            );
+                for (auto it = BB.rbegin(); it != BB.rend(); ++it) {
+                    Instruction* I = &*it;
+                    auto& transformer = instToTransformer[I];
+                    result->GEN(I) = transformer->getGen().getFacts();
+                    result->KILL(I) = transformer->getKill().getFacts();
+
+                    // The facts after a call flow back through its callee,
+                    // not through the instructions after the call
+                    if (auto* callInst = dyn_cast<CallInst>(I)) {
+                        DataFlowFacts intoCallee;
+                        if (factsAtCalleeEntry(callInst, intoCallee)) {
+                            out = intoCallee;
                         }
                     }
-                } else {
-                    // Not a BB exit - get OUT from the IN of next instruction
-                    auto nextIt = inst->getIterator();
-                    nextIt++;
-                    Instruction* nextInst = &(*nextIt);
-                    result->OUT(inst) = result->IN(nextInst);
+                    result->OUT(I) = out.getFacts();
+                    out = transformer->apply(out);
+                    result->IN(I) = out.getFacts();
                 }
-                
-                // Apply gen/kill to compute IN
-                std::set<Value*> inSet;
-                // IN = (OUT - KILL) ∪ GEN
-                std::set_difference(
-                    result->OUT(inst).begin(), result->OUT(inst).end(),
-                    result->KILL(inst).begin(), result->KILL(inst).end(),
-                    std::inserter(inSet, inSet.begin())
-                );
-                inSet.insert(result->GEN(inst).begin(), result->GEN(inst).end());
-                result->IN(inst) = inSet;
             }
         }
     }
@@ -9,11 +9,15 @@
  * initial: 2011.9
  * enhancement: 2012.7
  * refactor: 2012.10
+ *
+ * The loaded matrices are shared by the querying threads. The rows computed
+ * on demand are built under a lock and published when complete.
  */
 
 #include <cstdio>
 #include <cstring>
 #include <set>
+#include <mutex>
 #include "Pestrie/options.hh"
 #include "Pestrie/profile_helper.h"
 #include "Pestrie/matrix-ops.hh"
@@ -91,6 +95,17 @@ private:
   int ListStores( int x, IFilter* filter );
   int ListLoads( int x, IFilter* filter );
 
+  // Read a row that may be computed on demand by another thread
+  bitmap cached_row( int i, int x )
+  {
+    return __atomic_load_n( &qmats[i]->mat[x], __ATOMIC_ACQUIRE );
+  }
+
+  void publish_row( int i, int x, bitmap row )
+  {
+    __atomic_store_n( &qmats[i]->mat[x], row, __ATOMIC_RELEASE );
+  }
+
 private:
   // Input matrices
   Cmatrix **qmats;
@@ -108,6 +123,10 @@ private:
   // Options
   int index_type;
   int trad_mode;
+
+  // Serializes the rows computed on demand, which are allocated from the
+  // shared bitmap obstack
+  std::mutex cache_lock;
 };
 
 //static int cnt_same_es = 0;
@@ -240,7 +259,7 @@ BitQS::IsAlias( int x, int y )
     // We lookup the result in alias matrix
     Cmatrix *am = qmats[I_ALIAS_MATRIX];
     bitmap amx = am->at(x);
-    ans = bitmap_bit_p( amx, y );
+    ans = bitmap_bit_test( amx, y );
   }
   
   return ans != 0;
@@ -298,20 +317,25 @@ BitQS::ListAliases( int x, IFilter* filter )
     bitmap res = NULL;
     bitmap_iterator bi;
 
-    res = qmats[I_ALIAS_MATRIX]->at(x);
+    res = cached_row( I_ALIAS_MATRIX, x );
     
     // We compute the result immediately
     if ( res == NULL ) {
-      Cmatrix *ptm = qmats[I_PT_MATRIX];
-      bitmap ptx = ptm->at(x);
-      res = BITMAP_ALLOC(NULL);
-      
-      Cmatrix *ptedm = qmats[I_PTED_MATRIX];
-      EXECUTE_IF_SET_IN_BITMAP( ptx, 0, o, bi ) {
-    	bitmap_ior_into( res, ptedm->at(o) );
+      std::lock_guard<std::mutex> guard( cache_lock );
+      res = qmats[I_ALIAS_MATRIX]->at(x);
+
+      if ( res == NULL ) {
+	Cmatrix *ptm = qmats[I_PT_MATRIX];
+	bitmap ptx = ptm->at(x);
+	res = BITMAP_ALLOC(NULL);
+
+	Cmatrix *ptedm = qmats[I_PTED_MATRIX];
+	EXECUTE_IF_SET_IN_BITMAP( ptx, 0, o, bi ) {
+	  bitmap_ior_into( res, ptedm->at(o) );
+	}
+
+	publish_row( I_ALIAS_MATRIX, x, res );
       }
-      
-      qmats[I_ALIAS_MATRIX]->set(x, res);
     }
     
     // Extract the base pointers as the answer
@@ -338,7 +362,7 @@ BitQS::ListModRefVars( int x, IFilter* filter )
     Cmatrix *mat = qmats[is_load ? I_LOAD_MATRIX : I_STORE_MATRIX];
     bitmap accx = mat->at(x);
     EXECUTE_IF_SET_IN_BITMAP( accx, 0, o, bi ) {
-      if ( filter->validate(o) )
+      if ( filter == NULL || filter->validate(o) )
 	++ans;
     }
   }
@@ -355,20 +379,25 @@ BitQS::ListLoads( int x, IFilter* filter )
   bitmap res_other = NULL;
   
   // load-store or store-load conflicts
-  res_other = qmats[I_LD_ST_MATRIX]->at(x);
+  res_other = cached_row( I_LD_ST_MATRIX, x );
 
   // Compute and cache it on demand
   if ( res_other == NULL ) {
-    bitmap ptx = qmats[I_LOAD_MATRIX]->at(x);
-    res_other = BITMAP_ALLOC(NULL);
-
-    Cmatrix* store_matrix = qmats[I_STORE_MATRIX];
-    int size = store_matrix->n_r_reps;
-    for ( int i = 0; i < size; ++i )
-      if ( bitmap_same_bit_p( ptx, store_matrix->at(i) ) != 0 )
-	bitmap_set_bit( res_other, i );
-    
-    qmats[I_LD_ST_MATRIX]->set(x, res_other);
+    std::lock_guard<std::mutex> guard( cache_lock );
+    res_other = qmats[I_LD_ST_MATRIX]->at(x);
+
+    if ( res_other == NULL ) {
+      bitmap ptx = qmats[I_LOAD_MATRIX]->at(x);
+      res_other = BITMAP_ALLOC(NULL);
+
+      Cmatrix* store_matrix = qmats[I_STORE_MATRIX];
+      int size = store_matrix->n_r_reps;
+      for ( int i = 0; i < size; ++i )
+	if ( bitmap_same_bit_p( ptx, store_matrix->at(i) ) != 0 )
+	  bitmap_set_bit( res_other, i );
+
+      publish_row( I_LD_ST_MATRIX, x, res_other );
+    }
   }
 
   // visit
@@ -389,17 +418,22 @@ BitQS::ListStores( int x, IFilter* filter )
   bitmap ptx = qmats[I_STORE_MATRIX]->at(x);
   
   // Store-load conflicts
-  res_other = qmats[I_ST_LD_MATRIX]->at(x);  
+  res_other = cached_row( I_ST_LD_MATRIX, x );
   if ( res_other == NULL ) {
-    res_other = BITMAP_ALLOC(NULL);
+    std::lock_guard<std::mutex> guard( cache_lock );
+    res_other = qmats[I_ST_LD_MATRIX]->at(x);
+
+    if ( res_other == NULL ) {
+      res_other = BITMAP_ALLOC(NULL);
 
-    Cmatrix* load_matrix = qmats[I_LOAD_MATRIX];
-    int size = load_matrix->n_r_reps;
-    for ( int i = 0; i < size; ++i )
-      if ( bitmap_same_bit_p( ptx, load_matrix->at(i) ) != 0 )
-    	bitmap_set_bit( res_other, i );
+      Cmatrix* load_matrix = qmats[I_LOAD_MATRIX];
+      int size = load_matrix->n_r_reps;
+      for ( int i = 0; i < size; ++i )
+	if ( bitmap_same_bit_p( ptx, load_matrix->at(i) ) != 0 )
+	  bitmap_set_bit( res_other, i );
 
-    qmats[I_ST_LD_MATRIX]->set(x, res_other);
+      publish_row( I_ST_LD_MATRIX, x, res_other );
+    }
   }
   
   EXECUTE_IF_SET_IN_BITMAP( res_other, 0, v, bi ) {
@@ -407,16 +441,21 @@ BitQS::ListStores( int x, IFilter* filter )
   }
 
   // Store-store conflicts
-  res_self = qmats[I_ST_ST_MATRIX]->at(x);
+  res_self = cached_row( I_ST_ST_MATRIX, x );
   if ( res_self == NULL ) {
-    res_self = BITMAP_ALLOC(NULL);
-    
-    Cmatrix *store_trans_matrix = qmats[I_STORE_TRANS_MATRIX];
-    EXECUTE_IF_SET_IN_BITMAP( ptx, 0, v, bi ) {
-      bitmap_ior_into( res_self, store_trans_matrix->at(v) );
+    std::lock_guard<std::mutex> guard( cache_lock );
+    res_self = qmats[I_ST_ST_MATRIX]->at(x);
+
+    if ( res_self == NULL ) {
+      res_self = BITMAP_ALLOC(NULL);
+
+      Cmatrix *store_trans_matrix = qmats[I_STORE_TRANS_MATRIX];
+      EXECUTE_IF_SET_IN_BITMAP( ptx, 0, v, bi ) {
+	bitmap_ior_into( res_self, store_trans_matrix->at(v) );
+      }
+
+      publish_row( I_ST_ST_MATRIX, x, res_self );
     }
-        
-    qmats[I_ST_ST_MATRIX]->set( x, res_self );
   }
   
   EXECUTE_IF_SET_IN_BITMAP( res_self, 0, v, bi ) {
@@ -513,6 +513,38 @@ bitmap_bit_p (bitmap head, int bit)
   return (ptr->bits[word_num] >> bit_num) & 1;
 }
 
+/* Return whether a bit is set in a bitmap.  The search starts from the
+   cached position as in bitmap_find_bit, which is only read.  */
+
+int
+bitmap_bit_test (bitmap head, int bit)
+{
+  bitmap_element *element = head->current;
+  unsigned int indx = bit / BITMAP_ELEMENT_ALL_BITS;
+
+  if (element == 0)
+    return 0;
+
+  if (element->indx < indx)
+    while (element->next != 0 && element->indx < indx)
+      element = element->next;
+  else if (head->indx / 2 < indx)
+    while (element->prev != 0 && element->indx > indx)
+      element = element->prev;
+  else
+    for (element = head->first;
+	 element->next != 0 && element->indx < indx;
+	 element = element->next)
+      ;
+
+  if (element->indx != indx)
+    return 0;
+
+  unsigned bit_num = bit % BITMAP_WORD_BITS;
+  unsigned word_num = bit / BITMAP_WORD_BITS % BITMAP_ELEMENT_WORDS;
+  return (element->bits[word_num] >> bit_num) & 1;
+}
+
 #if GCC_VERSION < 3400
 /* Table of number of set bits in a character, indexed by value of char.  */
 static unsigned char popcount_table[] =
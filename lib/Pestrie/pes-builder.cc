@@ -0,0 +1,63 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/*
+ * Building the Pestrie index of a points-to matrix in memory and serving
+ * queries on it, for the analyses that link Pestrie as a library.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include "Pestrie/pestrie.hh"
+#include "Pestrie/query.hh"
+
+using namespace std;
+
+IQuery*
+build_pestrie_index( int n_ptrs, int n_objs, const vector<int>* pts )
+{
+  static once_flag init_flag;
+  call_once( init_flag, init_pestrie );
+
+  // The indexer allocates from the global bitmap obstack, so the results
+  // built on different threads are indexed one at a time
+  static mutex build_lock;
+  lock_guard<mutex> guard( build_lock );
+
+  // The statistics are printed by the pes-indexer and qtester drivers only
+  PesOpts pes_opts;
+  pes_opts.verbose = false;
+  PesTrie* pestrie = self_make_input( n_ptrs, n_objs, pts, &pes_opts );
+
+  pestrie->merge_equivalent_rows();
+  pestrie->preprocess();
+  pestrie->build_pestrie_core();
+  pestrie->build_index();
+
+  // The querier decodes the persistence format, which is passed in memory
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *fp = open_memstream( &buf, &len );
+  if ( fp == NULL ) {
+    delete[] pestrie->r_count;
+    delete pestrie;
+    return NULL;
+  }
+  pestrie->externalize_index( fp, PESTRIE_PT_1 );
+  fclose( fp );
+  delete[] pestrie->r_count;
+  delete pestrie;
+
+  IQuery* qs = NULL;
+  fp = fmemopen( buf, len, "rb" );
+  if ( fp != NULL ) {
+    // Skip the magic number
+    fseek( fp, 4, SEEK_SET );
+    qs = load_pestrie_index( fp, PT_MATRIX, false, false );
+    fclose( fp );
+  }
+  free( buf );
+
+  return qs;
+}
@@ -442,6 +442,12 @@ PesTrie::externalize_index( FILE* fp, const char* magic_number)
   int n_rects = seg_tree->n_out_rects;
   int n_total_stored = n_points + n_vertis + n_horizs + n_rects;
 
+  if ( pes_opts != NULL && !pes_opts->verbose ) {
+    delete[] pre_aux;
+    delete[] obj_pos;
+    return;
+  }
+
   fprintf( stderr, "\n--------------Persistence Generation---------------\n" );
   fprintf( stderr, "We persist %d figures.\n", 
 	   n_total_stored );
@@ -0,0 +1,290 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/*
+ * Serving the queries in place on a memory-mapped Pestrie image.
+ *
+ * The image is mapped read-only and shared, so the loading time does not
+ * depend on the index size and all the processes querying the same image
+ * share its pages. The queries follow PesQS without merging on demand.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Pestrie/pes-image.hh"
+#include "Pestrie/query.hh"
+
+using namespace std;
+
+class PesImageQS : public IQuery
+{
+public:
+  // Interface functions
+  bool IsAlias( int x, int y );
+  int ListPointsTo( int x, IFilter* filter );
+  int ListAliases( int x, IFilter* filter );
+  int ListPointedBy( int o, IFilter* filter );
+  int ListModRefVars( int x, IFilter* filter );
+  int ListConflicts( int x, IFilter* filter );
+
+public:
+  int getPtrEqID(int x) { return preV[x]; }
+  int getObjEqID(int x) { return preV[x+n]; }
+  int nOfPtrs() { return n; }
+  int nOfObjs() { return m; }
+  int getIndexType() { return index_type; }
+
+public:
+  PesImageQS( void* base, size_t length )
+  {
+    this->base = base;
+    this->length = length;
+
+    const PesImageHeader* header = (const PesImageHeader*)base;
+    n = header->n; m = header->m;
+    vertex_num = header->vertex_num;
+    index_type = header->index_type;
+
+    preV = section( IMG_PREV );
+    tree = section( IMG_TREE );
+    root_prevs = section( IMG_ROOT_PREVS );
+    ptrs_begin = section( IMG_PTRS_BEGIN );
+    ptrs = section( IMG_PTRS );
+    objs_begin = section( IMG_OBJS_BEGIN );
+    objs = section( IMG_OBJS );
+    unit_node = section( IMG_UNIT_NODE );
+    node_parent = section( IMG_NODE_PARENT );
+    rects_begin = section( IMG_RECTS_BEGIN );
+    rects = section( IMG_RECTS );
+    pt_begin = section( IMG_PT_BEGIN );
+    pt = section( IMG_PT );
+  }
+
+  ~PesImageQS()
+  {
+    munmap( base, length );
+  }
+
+private:
+  const int* section( int i )
+  {
+    const PesImageHeader* header = (const PesImageHeader*)base;
+    return (const int*)((const char*)base + header->offset[i]);
+  }
+
+  // Filter the pointers/objects of the equivalent sets [es1, es2)
+  int iterate_ptrs( int es1, int es2, IFilter* filter )
+  {
+    return iterate( ptrs, ptrs_begin[es1], ptrs_begin[es2], filter );
+  }
+
+  int iterate_objs( int es, IFilter* filter )
+  {
+    return iterate( objs, objs_begin[es], objs_begin[es+1], filter );
+  }
+
+  int iterate( const int* set, int begin, int end, IFilter* filter )
+  {
+    if ( filter == NULL ) return end - begin;
+
+    int ans = 0;
+    for ( int i = begin; i < end; ++i )
+      if ( filter->validate( set[i] ) )
+	++ans;
+    return ans;
+  }
+
+  bool binary_search( int node, int y );
+
+private:
+  void* base;
+  size_t length;
+
+  int n, m, vertex_num;
+  int index_type;
+
+  // See PesImageSection
+  const int *preV, *tree, *root_prevs;
+  const int *ptrs_begin, *ptrs, *objs_begin, *objs;
+  const int *unit_node, *node_parent;
+  const int *rects_begin, *rects;
+  const int *pt_begin, *pt;
+};
+
+bool
+PesImageQS::binary_search( int node, int y )
+{
+  int s = rects_begin[node] / 2;
+  int e = rects_begin[node+1] / 2;
+
+  while ( e > s ) {
+    int mid = (s+e) / 2;
+    if ( rects[2*mid+1] >= y ) {
+      if ( rects[2*mid] <= y )
+	return true;
+      e = mid;
+    }
+    else
+      s = mid + 1;
+  }
+
+  return false;
+}
+
+bool
+PesImageQS::IsAlias( int x, int y )
+{
+  int tr_x = tree[x];
+  if ( tr_x == -1 ) return false;
+  int tr_y = tree[y];
+  if ( tr_y == -1 ) return false;
+  if ( tr_x == tr_y ) return true;
+
+  x = preV[x];
+  y = preV[y];
+
+  // We traverse the segment tree bottom up
+  for ( int p = unit_node[x]; p != -1; p = node_parent[p] ) {
+    if ( binary_search( p, y ) )
+      return true;
+  }
+
+  return false;
+}
+
+int
+PesImageQS::ListPointsTo( int x, IFilter* filter )
+{
+  int tr = tree[x];
+  if ( tr == -1 ) return 0;
+
+  // Don't forget x points-to tree[x]
+  int ans = iterate_objs( root_prevs[tr], filter );
+
+  x = preV[x];
+  for ( int p = unit_node[x]; p != -1; p = node_parent[p] ) {
+    for ( int i = pt_begin[p]; i < pt_begin[p+1]; ++i )
+      ans += iterate_objs( pt[i], filter );
+  }
+
+  return ans;
+}
+
+int
+PesImageQS::ListAliases( int x, IFilter* filter )
+{
+  int tr = tree[x];
+  if ( tr == -1 ) return 0;
+
+  // The ES groups that belong to the same subtree are consecutive
+  int ans = iterate_ptrs( root_prevs[tr], root_prevs[tr+1], filter );
+
+  x = preV[x];
+  for ( int p = unit_node[x]; p != -1; p = node_parent[p] ) {
+    for ( int i = rects_begin[p]; i < rects_begin[p+1]; i += 2 )
+      ans += iterate_ptrs( rects[i], rects[i+1]+1, filter );
+  }
+
+  return ans;
+}
+
+int
+PesImageQS::ListPointedBy( int o, IFilter* filter )
+{
+  return ListAliases( o + n, filter );
+}
+
+int
+PesImageQS::ListModRefVars( int x, IFilter* filter )
+{
+  return ListPointsTo( x, filter );
+}
+
+int
+PesImageQS::ListConflicts( int x, IFilter* filter )
+{
+  return ListAliases( x, filter );
+}
+
+// The expected length of a section
+static long long
+section_length( const PesImageHeader* header, int i )
+{
+  int n_es = header->vertex_num;
+
+  switch ( i ) {
+  case IMG_PREV:
+  case IMG_TREE:
+    return header->n + header->m;
+  case IMG_ROOT_PREVS:
+    return header->n_trees + 1;
+  case IMG_ROOT_TREE:
+  case IMG_UNIT_NODE:
+    return n_es;
+  case IMG_PTRS_BEGIN:
+  case IMG_OBJS_BEGIN:
+    return n_es + 1;
+  case IMG_NODE_PARENT:
+    return header->n_nodes;
+  case IMG_RECTS_BEGIN:
+  case IMG_PT_BEGIN:
+    return header->n_nodes + 1;
+  }
+
+  // Variable length
+  return -1;
+}
+
+IQuery*
+map_pestrie_image( const char* image_file )
+{
+  int fd = open( image_file, O_RDONLY );
+  if ( fd < 0 ) return NULL;
+
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 ||
+       (size_t)st.st_size < sizeof(PesImageHeader) ) {
+    close(fd);
+    return NULL;
+  }
+
+  // A shared mapping lets all the querying processes use the same pages
+  void* base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close(fd);
+  if ( base == MAP_FAILED ) return NULL;
+  size_t length = st.st_size;
+
+  const PesImageHeader* header = (const PesImageHeader*)base;
+  bool valid = ( header->version == PES_IMAGE_VERSION ) &&
+    ( ( header->index_type == PT_MATRIX && memcmp( header->magic, PESTRIE_PT_IMG_1, 4 ) == 0 ) ||
+      ( header->index_type == SE_MATRIX && memcmp( header->magic, PESTRIE_SE_IMG_1, 4 ) == 0 ) );
+
+  for ( int i = 0; valid && i < N_IMG_SECTIONS; ++i ) {
+    long long offset = header->offset[i];
+    long long len = header->length[i];
+    long long expected = section_length( header, i );
+
+    if ( offset % 8 != 0 || offset < (long long)sizeof(PesImageHeader) ||
+	 len < 0 || offset + len * (long long)sizeof(int) > (long long)length ||
+	 ( expected != -1 && len != expected ) )
+      valid = false;
+  }
+
+  if ( !valid ) {
+    fprintf( stderr, "%s is not a Pestrie image of version %d.\n",
+	     image_file, PES_IMAGE_VERSION );
+    munmap( base, length );
+    return NULL;
+  }
+
+  fprintf( stderr, "----------Index File Info----------\n" );
+  fprintf( stderr, "Trees = %d, ES = %d, Image nodes = %d, Figures = %lld\n",
+	   header->n_trees, header->vertex_num, header->n_nodes,
+	   header->length[IMG_RECTS] / 2 );
+
+  return new PesImageQS( base, length );
+}
@@ -11,6 +11,10 @@
  * Improved 2012.10: fix bugs and code refactoring.
  * Improved 2014.02: fix bugs and improve performance.
  * Improved 2014.05: significantly improve the decoding performance and querying memory usage
+ *
+ * The decoded index is shared by the querying threads. The structures built
+ * on demand are built under a lock and published when complete, and the
+ * figures loaded from the index are never modified.
  */
 
 #include <cstdio>
@@ -18,7 +22,13 @@
 #include <algorithm>
 #include <ctime>
 #include <cassert>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include "Pestrie/options.hh"
+#include "Pestrie/pes-image.hh"
 #include "Pestrie/shapes.hh"
 #include "Pestrie/query.hh"
 #include "Pestrie/query-inl.hh"
@@ -69,10 +79,12 @@ public:
   // This node represents the range [l, r]
   int l, r;
   SegNode *left, *right, *parent;
-  bool merged, pt_extracted;
+  std::atomic<bool> merged, pt_extracted;
   
   VECTOR(VLine*) rects;
   VECTOR(int) pointsto;
+  // The figures of this node and its ancestors, merged on demand
+  VECTOR(VLine*) merged_rects;
   
   SegNode()
   {
@@ -93,6 +105,12 @@ public:
   }
 
   int n_of_rects() { return rects.size(); }
+
+  // The figures covering this node once it is merged with its ancestors
+  VECTOR(VLine*)& merged_view()
+  {
+    return merged.load( std::memory_order_acquire ) ? merged_rects : rects;
+  }
 };
 
 class SegUnitNode : public SegNode
@@ -112,17 +130,18 @@ public:
 
 
 // The segment tree structure for querying system
-class SegTree
+// (named apart from the SegTree of the indexer, which is linked in the same library)
+class QuerySegTree
 {
 public:
-  SegTree(int n_range)
+  QuerySegTree(int n_range)
   {
     unitNodes = new SegUnitNode*[n_range];
     segRoot = build_seg_tree(0, n_range-1);
     maxN = n_range;
   }
 
-  ~SegTree()
+  ~QuerySegTree()
   {
     free(unitNodes);
     free_seg_tree( segRoot );
@@ -156,7 +175,7 @@ private:
 
 
 SegNode*
-SegTree::build_seg_tree( int l, int r )
+QuerySegTree::build_seg_tree( int l, int r )
 {
   SegNode* p;
 
@@ -184,7 +203,7 @@ SegTree::build_seg_tree( int l, int r )
 }
 
 void
-SegTree::free_seg_tree( SegNode* p )
+QuerySegTree::free_seg_tree( SegNode* p )
 {
   if ( p->left != NULL )
     free_seg_tree(p->left);
@@ -200,7 +219,7 @@ SegTree::free_seg_tree( SegNode* p )
  * The points-to information is also extracted.
  */ 
 void
-SegTree::__opt_seg_tree( SegNode* p ) 
+QuerySegTree::__opt_seg_tree( SegNode* p ) 
 {
   SegNode* q = p->parent;
   
@@ -253,7 +272,7 @@ merge_into( VECTOR(VLine*) &list1, VECTOR(VLine*) &list2 )
 }
 
 void
-SegTree::optimize_seg_tree()
+QuerySegTree::optimize_seg_tree()
 {
   // We first merge the figures in the unit nodes
   for ( int i = 0; i < maxN; ++i ) {
@@ -268,8 +287,9 @@ SegTree::optimize_seg_tree()
 }
 
 // We do merging sort
+// The figures of p are kept apart, as the list queries walk up the tree
 void
-SegTree::recursive_merge( SegNode* p )
+QuerySegTree::recursive_merge( SegNode* p )
 {
   if ( p->merged == true ||
        p->parent == NULL ) return;
@@ -277,14 +297,15 @@ SegTree::recursive_merge( SegNode* p )
   // process its parent first
   recursive_merge( p->parent );
 
-  VECTOR(VLine*) &list1 = p->rects;
-  VECTOR(VLine*) &list2 = p->parent->rects;
+  VECTOR(VLine*) &list1 = p->merged_rects;
+  VECTOR(VLine*) &list2 = p->parent->merged_view();
+  list1.add_all( p->rects );
   merge_into( list1, list2 );
-  p->merged = true;
+  p->merged.store( true, std::memory_order_release );
 }
 
 void
-SegTree::insert_point( int x, VLine* p )
+QuerySegTree::insert_point( int x, VLine* p )
 {
   unitNodes[x]->add_strip(p);
 }
@@ -294,7 +315,7 @@ SegTree::insert_point( int x, VLine* p )
  * [x1, x2]: the X range of the rectangle for insersion
  */
 void
-SegTree::__insert_rect( int x1, int x2, VLine* pr, SegNode* p )
+QuerySegTree::__insert_rect( int x1, int x2, VLine* pr, SegNode* p )
 {
   if ( x1 <= p->l && x2 >= p->r ) {
     // We only consider the full coverage
@@ -308,14 +329,14 @@ SegTree::__insert_rect( int x1, int x2, VLine* pr, SegNode* p )
 }
 
 void
-SegTree::insert_rect( int x1, int x2, VLine* pr )
+QuerySegTree::insert_rect( int x1, int x2, VLine* pr )
 {
   __insert_rect( x1, x2, pr, segRoot );
 }
 
 
 bool
-SegTree::verify()
+QuerySegTree::verify()
 {
   for ( int i = 0; i < maxN; ++i ) {
     SegNode* p = unitNodes[i];
@@ -383,7 +404,7 @@ public:
     root_prevs = new int[n_objs+1];
     root_tree = new int[n_vertex];
     es2ptrs = new VECTOR(int)[n_vertex];
-    qtree = new SegTree(n_vertex);
+    qtree = new QuerySegTree(n_vertex);
     es2objs = NULL;
 
     if ( type == PT_MATRIX ) {
@@ -403,14 +424,15 @@ public:
   }
   
 public:
-  void load_figures( FILE* );
+  void load_figures( FILE*, bool );
+  bool write_image( const char* );
   
 private:
   void rebuild_mapping_info( FILE* );
   void extract_pointsto(SegNode*);
 
 private:
-  SegTree* qtree;
+  QuerySegTree* qtree;
   
   // The maximum preorder timestamp for the store statements
   int max_store_prev;
@@ -430,6 +452,8 @@ private:
   int index_type;
   // Merging the aliasing information bottom up on demand
   bool demand_merging;
+  // Serializes the merging and the points-to extraction on demand
+  std::mutex cache_lock;
 };
 
 
@@ -502,7 +526,7 @@ PesQS::rebuild_mapping_info( FILE* fp )
 }
 
 void
-PesQS::load_figures( FILE* fp )
+PesQS::load_figures( FILE* fp, bool verbose )
 {
   int n_points = 0, n_horizs = 0, n_vertis = 0, n_rects = 0;
   int cross_pairs = 0;
@@ -608,6 +632,8 @@ PesQS::load_figures( FILE* fp )
     int sz = root_prevs[i+1] - root_prevs[i];
     internal_pairs += sz * (sz-1) / 2;
   }
+
+  if ( !verbose ) return;
   
   fprintf( stderr, "Trees = %d, ES = %d, Non-empty ES = %d\n", 
 	   n_trees, vertex_num, non_empty_nodes );
@@ -620,6 +646,117 @@ PesQS::load_figures( FILE* fp )
 	   "Alias pairs = %d\n", internal_pairs + cross_pairs );
 }
 
+// Flatten the decoded querying structure into the sections of an image
+bool
+PesQS::write_image( const char* image_file )
+{
+  std::vector<int> sec[N_IMG_SECTIONS];
+
+  sec[IMG_PREV].assign( preV, preV + n + m );
+  sec[IMG_TREE].assign( tree, tree + n + m );
+  sec[IMG_ROOT_PREVS].assign( root_prevs, root_prevs + n_trees + 1 );
+  sec[IMG_ROOT_TREE].assign( root_tree, root_tree + vertex_num );
+
+  // Equivalent sets
+  sec[IMG_PTRS_BEGIN].push_back(0);
+  sec[IMG_OBJS_BEGIN].push_back(0);
+  for ( int i = 0; i < vertex_num; ++i ) {
+    VECTOR(int) &ptrs = es2ptrs[i];
+    for ( int j = 0; j < ptrs.size(); ++j )
+      sec[IMG_PTRS].push_back( ptrs[j] );
+    sec[IMG_PTRS_BEGIN].push_back( sec[IMG_PTRS].size() );
+
+    if ( es2objs != NULL ) {
+      VECTOR(int) &objs = es2objs[i];
+      for ( int j = 0; j < objs.size(); ++j )
+	sec[IMG_OBJS].push_back( objs[j] );
+    }
+    sec[IMG_OBJS_BEGIN].push_back( sec[IMG_OBJS].size() );
+  }
+
+  // Number the segment tree nodes on the paths from the unit nodes
+  std::unordered_map<SegNode*, int> node_id;
+  std::vector<SegNode*> nodes;
+  for ( int x = 0; x < vertex_num; ++x ) {
+    SegNode* p = qtree->get_unit_node(x);
+    // The rest of the path is numbered once a numbered node is met
+    while ( p != NULL && node_id.count(p) == 0 ) {
+      node_id[p] = nodes.size();
+      nodes.push_back(p);
+      p = p->parent;
+    }
+    sec[IMG_UNIT_NODE].push_back( node_id[qtree->get_unit_node(x)] );
+  }
+
+  sec[IMG_RECTS_BEGIN].push_back(0);
+  sec[IMG_PT_BEGIN].push_back(0);
+  for ( size_t i = 0; i < nodes.size(); ++i ) {
+    SegNode* p = nodes[i];
+    sec[IMG_NODE_PARENT].push_back( p->parent != NULL ? node_id[p->parent] : -1 );
+
+    VECTOR(VLine*) &rects = p->rects;
+    for ( int j = 0; j < rects.size(); ++j ) {
+      VLine* r = rects[j];
+      sec[IMG_RECTS].push_back( r->y1 );
+      sec[IMG_RECTS].push_back( r->y2 );
+      // The points-to targets are the roots covered by the figures
+      for ( int y = r->y1; y <= r->y2; ++y )
+	if ( root_tree[y] != -1 )
+	  sec[IMG_PT].push_back(y);
+    }
+    sec[IMG_RECTS_BEGIN].push_back( sec[IMG_RECTS].size() );
+    sec[IMG_PT_BEGIN].push_back( sec[IMG_PT].size() );
+  }
+
+  // Lay out the sections
+  PesImageHeader header;
+  memset( &header, 0, sizeof(header) );
+  memcpy( header.magic, index_type == PT_MATRIX ? PESTRIE_PT_IMG_1 : PESTRIE_SE_IMG_1, 4 );
+  header.version = PES_IMAGE_VERSION;
+  header.index_type = index_type;
+  header.n = n;
+  header.m = m;
+  header.vertex_num = vertex_num;
+  header.n_trees = n_trees;
+  header.n_nodes = nodes.size();
+
+  long long offset = (sizeof(header) + 7) & ~7LL;
+  for ( int i = 0; i < N_IMG_SECTIONS; ++i ) {
+    header.offset[i] = offset;
+    header.length[i] = sec[i].size();
+    offset += (sec[i].size() * sizeof(int) + 7) & ~7LL;
+  }
+
+  // Write a temporary file and rename it, so that a mapped image is never modified
+  std::string tmp_file = std::string(image_file) + ".tmp";
+  FILE* fp = fopen( tmp_file.c_str(), "wb" );
+  if ( fp == NULL ) {
+    fprintf( stderr, "Cannot write the image file %s.\n", tmp_file.c_str() );
+    return false;
+  }
+
+  static const char padding[8] = {0};
+  fwrite( &header, sizeof(header), 1, fp );
+  fwrite( padding, 1, header.offset[0] - sizeof(header), fp );
+  for ( int i = 0; i < N_IMG_SECTIONS; ++i ) {
+    size_t bytes = sec[i].size() * sizeof(int);
+    fwrite( sec[i].data(), 1, bytes, fp );
+    fwrite( padding, 1, ((bytes + 7) & ~(size_t)7) - bytes, fp );
+  }
+
+  bool ok = ( ferror(fp) == 0 );
+  ok = ( fclose(fp) == 0 ) && ok;
+  if ( !ok || rename( tmp_file.c_str(), image_file ) != 0 ) {
+    fprintf( stderr, "Cannot write the image file %s.\n", image_file );
+    remove( tmp_file.c_str() );
+    return false;
+  }
+
+  fprintf( stderr, "Image nodes = %d, Figures = %lld, Size = %lldKb\n",
+	   header.n_nodes, header.length[IMG_RECTS] / 2, offset / 1024 );
+  return true;
+}
+
 static bool
 binary_search( VECTOR(VLine*) &rects, int y )
 {
@@ -686,8 +823,11 @@ PesQS::IsAlias( int x, int y )
     } while ( p!= NULL );
   }
   else {
-    qtree->recursive_merge(p);
-    if ( binary_search( p->rects, y ) )
+    if ( p->parent != NULL && !p->merged.load( std::memory_order_acquire ) ) {
+      std::lock_guard<std::mutex> guard( cache_lock );
+      qtree->recursive_merge(p);
+    }
+    if ( binary_search( p->merged_view(), y ) )
       return true;
   }
 
@@ -711,7 +851,7 @@ PesQS::extract_pointsto( SegNode* p )
     } while (lower <= upper);
   }
 
-  p->pt_extracted = true;
+  p->pt_extracted.store( true, std::memory_order_release );
 }
 
 // List query in real use should be passed in a handler.
@@ -730,8 +870,11 @@ PesQS::ListPointsTo( int x, IFilter* filter )
 
   // traverse the rectangles up the tree
   while ( p != NULL ) {
-    if ( p->pt_extracted == false )
-      extract_pointsto(p);
+    if ( !p->pt_extracted.load( std::memory_order_acquire ) ) {
+      std::lock_guard<std::mutex> guard( cache_lock );
+      if ( p->pt_extracted == false )
+	extract_pointsto(p);
+    }
 
     VECTOR(int) &pointsto = p->pointsto;
     int size = pointsto.size();
@@ -803,7 +946,7 @@ PesQS::ListConflicts( int x, IFilter* filter )
 }
 
 IQuery*
-load_pestrie_index(FILE* fp, int index_type, bool d_merging )
+load_pestrie_index(FILE* fp, int index_type, bool d_merging, bool verbose )
 {
   int n, m, vertex_num;
 
@@ -814,10 +957,21 @@ load_pestrie_index(FILE* fp, int index_type, bool d_merging )
   
   // Initialize the querying struture
   PesQS* pesqs = new PesQS( n, m, vertex_num, index_type, d_merging );
-  fprintf( stderr, "----------Index File Info----------\n" );
+  if ( verbose )
+    fprintf( stderr, "----------Index File Info----------\n" );
 
   // Loading and decoding the persistence file
-  pesqs->load_figures(fp);
+  pesqs->load_figures(fp, verbose);
   
   return pesqs;
 }
+
+bool
+write_pestrie_image( FILE* fp, int index_type, const char* image_file )
+{
+  // The image is written before any merging on demand
+  PesQS* pesqs = (PesQS*)load_pestrie_index( fp, index_type, false );
+  bool ok = pesqs->write_image( image_file );
+  delete pesqs;
+  return ok;
+}
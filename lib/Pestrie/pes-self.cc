@@ -288,3 +288,24 @@ self_parse_input( FILE* fp, const PesOpts* pes_opts )
   pestrie->r_count = r_count;
   return pestrie;
 }
+
+/*
+ * The points-to matrix is given in memory by an analysis instead of an input file.
+ */
+PesTrie*
+self_make_input( int n, int m, const vector<int>* rows, const PesOpts* pes_opts )
+{
+  PesTrie* pestrie = new PesTrieSelf( n, m, pes_opts );
+  int *r_count = new int[n];
+
+  for ( int i = 0; i < n; ++i ) {
+    const vector<int> &row = rows[i];
+    for ( size_t j = 0; j < row.size(); ++j )
+      pestrie->write_bit( i, row[j] );
+    r_count[i] = row.size();
+  }
+
+  pestrie->index_type = PT_MATRIX;
+  pestrie->r_count = r_count;
+  return pestrie;
+}
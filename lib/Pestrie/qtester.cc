@@ -12,7 +12,11 @@
 #include <unistd.h>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "Pestrie/options.hh"
 #include "Pestrie/query.hh"
 #include "Pestrie/profile_helper.h"
@@ -82,8 +86,10 @@ struct QueryOpts
   bool print_answers;
   bool trad_mode;
   bool demand_merging;
+  int n_threads;
   const char* input_file;
   const char* query_plan;
+  const char* image_file;
 
   QueryOpts()
   {
@@ -91,8 +97,10 @@ struct QueryOpts
     print_answers = false;
     trad_mode = false;
     demand_merging = false;
+    n_threads = 0;
     input_file = NULL;
     query_plan = NULL;
+    image_file = NULL;
   }
 }
 query_opts;
@@ -114,6 +122,9 @@ print_help( const char* prog_name )
   printf( "    6    : list store/load conflicts\n" );
   printf( "-s       : Use only points-to matrix for querying (Bitmap ONLY).\n" );
   printf( "-d       : Merging the figures up-to-root before querying (Pestrie ONLY).\n" );
+  printf( "-j num   : Share the index among num querying threads and report the throughput.\n" );
+  printf( "-w file  : Write the decoded index as an image to file and query the image in place (Pestrie ONLY).\n" );
+  printf( "           An image given as the input file is memory-mapped without decoding.\n" );
 }
 
 static bool 
@@ -121,12 +132,16 @@ parse_options( int argc, char **argv )
 {
   int c;
 
-  while ( (c = getopt( argc, argv, "dpst:h" ) ) != -1 ) {
+  while ( (c = getopt( argc, argv, "dj:pst:w:h" ) ) != -1 ) {
     switch ( c ) {
     case 'd':
       query_opts.demand_merging = true;
       break;
       
+    case 'j':
+      query_opts.n_threads = std::max( 1, std::atoi( optarg ) );
+      break;
+
     case 'p':
       query_opts.print_answers = true;
       break;
@@ -144,6 +159,10 @@ parse_options( int argc, char **argv )
       }
       break;
 
+    case 'w':
+      query_opts.image_file = optarg;
+      break;
+
     case 'h':
       print_help( argv[0] );
       return false;
@@ -239,42 +258,17 @@ execute_query_plan( IQuery *qs )
   delete ptr_filter;
 }
 
-// We generate random pointers for evaluation
-void 
-traverse_result( IQuery *qs )
+// Run the queries first, first + step, ... of the n_query queries
+static int
+run_queries( IQuery *qs, int first, int step, int n_query )
 {
   int x, y;
   int ans = 0;
 
-  int index_type = qs->getIndexType();
-
-  if ( (index_type == PT_MATRIX && query_opts.query_type >= LIST_ACC_VARS) ||
-       (index_type == SE_MATRIX && query_opts.query_type < LIST_ACC_VARS) ) {
-    fprintf( stderr, "The query command is not supported by the input index file.\n" );
-    return;
-  }
+  // The filter is per thread, the index is shared
+  AllAcceptFilter ptr_filter;
 
-  int n = qs->nOfPtrs();
-  int m = qs->nOfObjs();
-  int n_query = ( query_opts.query_type == LIST_POINTED_TO ? m : n );
-
-  // We permute the pointers/objects
-  /*
-  int *queries = new int[n_query];
-  for ( int i = 0; i < n_query; ++i ) queries[i] = i;
-
-  for ( int i = 0; i < n_query - 1; ++i ) {
-    int j = queries[i];
-    int k = rand() % ( n_query - i ) + i;
-    queries[i] = queries[k];
-    queries[k] = j;
-  }
-  */
-
-  AllAcceptFilter* ptr_filter = new AllAcceptFilter;
-
-  for ( int i = 0; i < n_query; ++i ) {
-    //x = queries[i];
+  for ( int i = first; i < n_query; i += step ) {
     x = i;
 
     switch ( query_opts.query_type ) {
@@ -284,29 +278,75 @@ traverse_result( IQuery *qs )
       break;
       
     case LIST_POINTS_TO:
-      ans += qs->ListPointsTo( x, ptr_filter );
+      ans += qs->ListPointsTo( x, &ptr_filter );
       break;
       
     case LIST_POINTED_TO:
-      ans += qs->ListPointedBy( x, ptr_filter );
+      ans += qs->ListPointedBy( x, &ptr_filter );
       break;
       
     case LIST_ALIASES:
-      ans += qs->ListAliases( x, ptr_filter );
+      ans += qs->ListAliases( x, &ptr_filter );
       break;
   
     case LIST_ACC_VARS:
-      ans += qs->ListModRefVars( x, ptr_filter );
+      ans += qs->ListModRefVars( x, &ptr_filter );
       break;
       
     case LIST_CONFLICTS:
-      ans += qs->ListConflicts( x, ptr_filter );
+      ans += qs->ListConflicts( x, &ptr_filter );
       break;
     }
   }
-  
+
+  return ans;
+}
+
+// We generate random pointers for evaluation
+void 
+traverse_result( IQuery *qs )
+{
+  int ans = 0;
+
+  int index_type = qs->getIndexType();
+
+  if ( (index_type == PT_MATRIX && query_opts.query_type >= LIST_ACC_VARS) ||
+       (index_type == SE_MATRIX && query_opts.query_type < LIST_ACC_VARS) ) {
+    fprintf( stderr, "The query command is not supported by the input index file.\n" );
+    return;
+  }
+
+  int n = qs->nOfPtrs();
+  int m = qs->nOfObjs();
+  int n_query = ( query_opts.query_type == LIST_POINTED_TO ? m : n );
+  int n_threads = query_opts.n_threads;
+
+  if ( n_threads == 0 ) {
+    ans = run_queries( qs, 0, 1, n_query );
+    fprintf( stderr, "\nReference answer = %d\n", ans );
+    return;
+  }
+
+  // The queries are interleaved among the threads to balance the load
+  std::vector<int> answers( n_threads, 0 );
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for ( int t = 0; t < n_threads; ++t )
+    threads.emplace_back( [qs, t, n_threads, n_query, &answers]() {
+	answers[t] = run_queries( qs, t, n_threads, n_query );
+      } );
+
+  for ( int t = 0; t < n_threads; ++t ) {
+    threads[t].join();
+    ans += answers[t];
+  }
+
+  double ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start ).count();
   fprintf( stderr, "\nReference answer = %d\n", ans );
-  delete ptr_filter;
+  fprintf( stderr, "Threads = %d, Wall time = %.0lfms, Throughput = %.0lf queries/s\n",
+	   n_threads, ms, n_query / ( ms / 1000 ) );
 }
 
 IQuery*
@@ -327,6 +367,16 @@ load_index()
     qs = load_bitmap_index( fp, PT_MATRIX, query_opts.trad_mode );
   else if ( strcmp( magic_code, BITMAP_SE_1 ) == 0 )
     qs = load_bitmap_index( fp, SE_MATRIX, query_opts.trad_mode );
+  else if ( strcmp( magic_code, PESTRIE_PT_IMG_1 ) == 0 ||
+	    strcmp( magic_code, PESTRIE_SE_IMG_1 ) == 0 )
+    qs = map_pestrie_image( query_opts.input_file );
+  else if ( query_opts.image_file != NULL &&
+	    ( strcmp( magic_code, PESTRIE_PT_1 ) == 0 ||
+	      strcmp( magic_code, PESTRIE_SE_1 ) == 0 ) ) {
+    index_type = ( strcmp( magic_code, PESTRIE_PT_1 ) == 0 ? PT_MATRIX : SE_MATRIX );
+    if ( write_pestrie_image( fp, index_type, query_opts.image_file ) )
+      qs = map_pestrie_image( query_opts.image_file );
+  }
   else if ( strcmp( magic_code, PESTRIE_PT_1 ) == 0)
     qs = load_pestrie_index( fp, PT_MATRIX, query_opts.demand_merging );
   else if ( strcmp( magic_code, PESTRIE_SE_1 ) == 0 )
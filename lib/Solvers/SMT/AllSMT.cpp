@@ -2,10 +2,14 @@
  * @file AllSMT.cpp
  * @brief Implementation of the AllSMTSolver class for enumerating all satisfying models
  *
- * This file implements the AllSMTSolver class, which extends basic SMT solving to 
+ * This file implements the AllSMTSolver class, which extends basic SMT solving to
  * enumerate multiple (or all) satisfying models for a given formula. It provides:
  * - Model enumeration up to a specified number
- * - Block-based approach that excludes previously found models
+ * - Projection of the models on a set of variables
+ * - Block-based approach that excludes previously found models, reusing one
+ *   incremental solver
+ * - Generalization of the blocked models to cubes with unsat cores
+ * - Streaming of the models to a callback
  *
  * The AllSMT approach is useful for applications that need to find all possible
  * satisfying assignments or multiple distinct solutions to an SMT formula.
@@ -16,44 +20,174 @@
 // #include "z3.h"
 
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// The uninterpreted constants of e
+void getConstants(const z3::expr& e, z3::expr_vector& consts) {
+	std::unordered_set<unsigned> visited;
+	std::vector<z3::expr> worklist(1, e);
+	while (!worklist.empty()) {
+		z3::expr cur = worklist.back();
+		worklist.pop_back();
+		if (!cur.is_app() || !visited.insert(cur.id()).second) {
+			continue;
+		}
+		if (cur.num_args() == 0 && cur.decl().decl_kind() == Z3_OP_UNINTERPRETED) {
+			consts.push_back(cur);
+			continue;
+		}
+		for (unsigned i = 0; i < cur.num_args(); i++) {
+			worklist.push_back(cur.arg(i));
+		}
+	}
+}
+
+} // namespace
 
 
 AllSMTSolver::AllSMTSolver() {
     num_vars = 0;
     num_clauses = 0;
+    num_checks = 0;
+    minimize_cubes = true;
+    bit_level = true;
 }
 
 AllSMTSolver::~AllSMTSolver() {}
 
 int AllSMTSolver::getModels(z3::expr& expr, int k) {
+	if (k < 1) {
+		return 0;
+	}
+	z3::expr_vector vars(expr.ctx());
+	getConstants(expr, vars);
+
+	bool minimize = minimize_cubes;
+	minimize_cubes = false;
+	int found = getModels(expr, vars, [](const z3::model&, const z3::expr_vector&) { return true; }, k);
+	minimize_cubes = minimize;
+	return found;
+}
+
+int AllSMTSolver::getModels(const z3::expr& expr, const z3::expr_vector& projection,
+                            const ModelCallback& callback, int limit) {
 	z3::context& ctx = expr.ctx();
-	z3::solver solver(ctx);
-	solver.add(expr);
+	num_vars = projection.size();
+	num_clauses = 0;
+	num_checks = 0;
+
+	// The other variables are fixed to their values in the model when a cube
+	// is generalized
+	z3::expr_vector others(ctx);
+	if (minimize_cubes) {
+		std::unordered_set<unsigned> projected;
+		for (unsigned i = 0; i < projection.size(); i++) {
+			projected.insert(projection[i].id());
+		}
+		z3::expr_vector vars(ctx);
+		getConstants(expr, vars);
+		for (unsigned i = 0; i < vars.size(); i++) {
+			if (!projected.count(vars[i].id())) {
+				others.push_back(vars[i]);
+			}
+		}
+	}
+
 	int found = 0;
-	while (solver.check() == z3::sat && k >= 1) {
-		found++;
-		std::cout << solver << std::endl;
-		// get model
-		z3::model m = solver.get_model();
-		//std::cout << m << std::endl;
-		z3::expr_vector args(ctx);
-		for (unsigned i = 0; i < m.size(); i++) {
-			// get z3 variable
-			z3::func_decl z3Variable = m[i];
-			std::string varName = z3Variable.name().str();
-			z3::expr exp = m.get_const_interp(z3Variable);
-			unsigned bvSize = exp.get_sort().bv_size();
-		    int value = m.eval(exp).get_numeral_int();
-		    // std::string svalue = Z3_get_numeral_string(ctx, exp);
-		    // uniq result
-		    if (exp.get_sort().is_bv()) {
-		    	//args.push_back(ctx.bv_const(varName.c_str(), bvSize) != ctx.bv_val(svalue.c_str(), bvSize));
-		    	args.push_back(ctx.bv_const(varName.c_str(), bvSize) != ctx.bv_val(value, bvSize));
-		    }
-		}
-		// block current model
-		solver.add(mk_or(args));
-		k--;
+	try {
+		z3::solver solver(ctx);
+		solver.add(expr);
+		z3::solver negated(ctx);
+		if (minimize_cubes) {
+			z3::params p(ctx);
+			p.set("core.minimize", true);
+			negated.set(p);
+			negated.add(!expr);
+		}
+
+		while (limit < 0 || found < limit) {
+			num_checks++;
+			if (solver.check() != z3::sat) {
+				break;
+			}
+			z3::model m = solver.get_model();
+			z3::expr_vector cube = getCube(m, projection);
+			if (minimize_cubes) {
+				cube = generalize(negated, m, cube, others);
+			}
+			found++;
+			// block the cube
+			solver.add(!z3::mk_and(cube));
+			num_clauses++;
+			if (!callback(m, cube)) {
+				break;
+			}
+		}
+	} catch (z3::exception& ex) {
+		std::cerr << __FILE__ << " : " << __LINE__ << " : " << ex << "\n";
 	}
 	return found;
 }
+
+z3::expr_vector AllSMTSolver::getCube(z3::model& m, const z3::expr_vector& projection) {
+	z3::context& ctx = m.ctx();
+	z3::expr_vector cube(ctx);
+	for (unsigned i = 0; i < projection.size(); i++) {
+		z3::expr var = projection[i];
+		z3::expr value = m.eval(var, true);
+		if (var.is_bool()) {
+			cube.push_back(value.is_true() ? var : !var);
+		} else if (bit_level && var.is_bv()) {
+			for (unsigned b = 0; b < var.get_sort().bv_size(); b++) {
+				z3::expr bit = var.extract(b, b);
+				cube.push_back(bit == m.eval(bit, true));
+			}
+		} else {
+			cube.push_back(var == value);
+		}
+	}
+	return cube;
+}
+
+z3::expr_vector AllSMTSolver::generalize(z3::solver& negated, z3::model& m, const z3::expr_vector& cube,
+                                         const z3::expr_vector& others) {
+	z3::context& ctx = m.ctx();
+	z3::expr_vector result(ctx);
+
+	// Every literal is tracked by an indicator, as assumptions must be
+	// Boolean constants. The indicators are only defined in the scope.
+	negated.push();
+	for (unsigned i = 0; i < others.size(); i++) {
+		negated.add(others[i] == m.eval(others[i], true));
+	}
+	z3::expr_vector indicators(ctx);
+	std::unordered_map<unsigned, unsigned> literals;
+	for (unsigned i = 0; i < cube.size(); i++) {
+		z3::expr indicator = ctx.bool_const(("__allsmt_lit_" + std::to_string(i)).c_str());
+		negated.add(z3::implies(indicator, cube[i]));
+		indicators.push_back(indicator);
+		literals[indicator.id()] = i;
+	}
+
+	num_checks++;
+	if (negated.check(indicators) == z3::unsat) {
+		// Only the literals of the core are needed to falsify the negation
+		z3::expr_vector core = negated.unsat_core();
+		for (unsigned i = 0; i < core.size(); i++) {
+			auto it = literals.find(core[i].id());
+			if (it != literals.end()) {
+				result.push_back(cube[it->second]);
+			}
+		}
+	} else {
+		// e.g. the formula has uninterpreted functions, which are not fixed
+		result = cube;
+	}
+	negated.pop();
+	return result;
+}
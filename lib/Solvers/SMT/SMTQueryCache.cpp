@@ -0,0 +1,358 @@
+/**
+ * @file SMTQueryCache.cpp
+ * @brief Implementation of the process-wide cache of SMT query answers
+ *
+ * The key of a query is the MD5 digest of a canonical serialization of its
+ * assertions:
+ * - The AST is visited in pre-order; a node that was already visited is
+ *   written as a reference to its position, so shared subterms are only
+ *   serialized once.
+ * - Uninterpreted symbols are written as their number in the order of first
+ *   occurrence, which makes the key invariant under renaming.
+ * - Interpreted operators are written as their kind and parameters, numerals
+ *   as their value, and all of them with their sort.
+ *
+ * The answers are kept in a LRU list bounded by -smt-query-cache-mb.
+ */
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "Solvers/SMT/SMTQueryCache.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace llvm;
+
+static llvm::cl::opt<unsigned> QueryCacheMB(
+    "smt-query-cache-mb", llvm::cl::init(0),
+    llvm::cl::desc("Memory budget (MB) of the cache of SMT query answers. The "
+                   "cache is disabled if 0."));
+
+static llvm::cl::opt<std::string> QueryCacheFile(
+    "smt-query-cache-file", llvm::cl::init(""),
+    llvm::cl::desc("Load the cache of SMT query answers from this file and "
+                   "save it on exit."));
+
+static const char QueryCacheMagic[8] = {'C', 'A', 'N', 'A',
+                                        'R', 'Y', 'Q', 'C'};
+
+namespace {
+
+/// Serializes the assertions of a query into a MD5 digest.
+class QueryKeyBuilder {
+private:
+  Z3_context Ctx;
+
+  llvm::MD5 Hash;
+
+  std::string Buffer;
+
+  // AST id -> position in the pre-order
+  std::unordered_map<unsigned, unsigned> Visited;
+
+  // func_decl AST id -> number of the uninterpreted symbol
+  std::unordered_map<unsigned, unsigned> Symbols;
+
+  void flush() {
+    Hash.update(Buffer);
+    Buffer.clear();
+  }
+
+  void write(const std::string &Token) {
+    Buffer += Token;
+    Buffer += ' ';
+    if (Buffer.size() > 65536) {
+      flush();
+    }
+  }
+
+  void write(int64_t Val) { write(std::to_string(Val)); }
+
+  void writeSort(Z3_sort Sort) { write(Z3_sort_to_string(Ctx, Sort)); }
+
+  void writeSymbol(Z3_func_decl Decl) {
+    unsigned Id = Z3_get_ast_id(Ctx, Z3_func_decl_to_ast(Ctx, Decl));
+    auto It = Symbols.emplace(Id, Symbols.size()).first;
+    write("u");
+    write(It->second);
+    for (unsigned I = 0; I < Z3_get_domain_size(Ctx, Decl); I++) {
+      writeSort(Z3_get_domain(Ctx, Decl, I));
+    }
+  }
+
+  void writeDecl(Z3_func_decl Decl) {
+    Z3_decl_kind Kind = Z3_get_decl_kind(Ctx, Decl);
+    if (Kind == Z3_OP_UNINTERPRETED) {
+      writeSymbol(Decl);
+      return;
+    }
+
+    write("f");
+    write(Kind);
+    // Parameters of indexed operators, e.g. extract and zero_extend
+    for (unsigned I = 0; I < Z3_get_decl_num_parameters(Ctx, Decl); I++) {
+      switch (Z3_get_decl_parameter_kind(Ctx, Decl, I)) {
+      case Z3_PARAMETER_INT:
+        write(Z3_get_decl_int_parameter(Ctx, Decl, I));
+        break;
+      case Z3_PARAMETER_DOUBLE:
+        write(std::to_string(Z3_get_decl_double_parameter(Ctx, Decl, I)));
+        break;
+      case Z3_PARAMETER_RATIONAL:
+        write(Z3_get_decl_rational_parameter(Ctx, Decl, I));
+        break;
+      case Z3_PARAMETER_SYMBOL:
+        write(Z3_get_symbol_string(
+            Ctx, Z3_get_decl_symbol_parameter(Ctx, Decl, I)));
+        break;
+      case Z3_PARAMETER_SORT:
+        writeSort(Z3_get_decl_sort_parameter(Ctx, Decl, I));
+        break;
+      case Z3_PARAMETER_AST:
+        write(Z3_ast_to_string(Ctx, Z3_get_decl_ast_parameter(Ctx, Decl, I)));
+        break;
+      case Z3_PARAMETER_FUNC_DECL:
+        writeDecl(Z3_get_decl_func_decl_parameter(Ctx, Decl, I));
+        break;
+      }
+    }
+  }
+
+public:
+  QueryKeyBuilder(Z3_context C) : Ctx(C) {}
+
+  void add(Z3_ast Root) {
+    // Explicit stack: the constraints of long paths are deep terms
+    std::vector<Z3_ast> Stack(1, Root);
+    while (!Stack.empty()) {
+      Z3_ast Node = Stack.back();
+      Stack.pop_back();
+
+      unsigned Id = Z3_get_ast_id(Ctx, Node);
+      auto It = Visited.find(Id);
+      if (It != Visited.end()) {
+        write("r");
+        write(It->second);
+        continue;
+      }
+      Visited.emplace(Id, Visited.size());
+
+      switch (Z3_get_ast_kind(Ctx, Node)) {
+      case Z3_NUMERAL_AST:
+        write("n");
+        write(Z3_get_numeral_string(Ctx, Node));
+        writeSort(Z3_get_sort(Ctx, Node));
+        break;
+      case Z3_APP_AST: {
+        Z3_app App = Z3_to_app(Ctx, Node);
+        unsigned NumArgs = Z3_get_app_num_args(Ctx, App);
+        write("a");
+        write(NumArgs);
+        writeDecl(Z3_get_app_decl(Ctx, App));
+        writeSort(Z3_get_sort(Ctx, Node));
+        for (unsigned I = NumArgs; I > 0; I--) {
+          Stack.push_back(Z3_get_app_arg(Ctx, App, I - 1));
+        }
+        break;
+      }
+      case Z3_VAR_AST:
+        write("v");
+        write(Z3_get_index_value(Ctx, Node));
+        writeSort(Z3_get_sort(Ctx, Node));
+        break;
+      case Z3_QUANTIFIER_AST:
+        // The names of the bound variables and the patterns do not matter
+        write("q");
+        write(Z3_is_quantifier_forall(Ctx, Node)
+                  ? "forall"
+                  : (Z3_is_quantifier_exists(Ctx, Node) ? "exists" : "lambda"));
+        write(Z3_get_quantifier_num_bound(Ctx, Node));
+        for (unsigned I = 0; I < Z3_get_quantifier_num_bound(Ctx, Node); I++) {
+          writeSort(Z3_get_quantifier_bound_sort(Ctx, Node, I));
+        }
+        Stack.push_back(Z3_get_quantifier_body(Ctx, Node));
+        break;
+      default:
+        write("x");
+        write(Z3_ast_to_string(Ctx, Node));
+        break;
+      }
+    }
+  }
+
+  SMTQueryCache::Key finish() {
+    flush();
+    llvm::MD5::MD5Result Result;
+    Hash.final(Result);
+    return SMTQueryCache::Key{Result.high(), Result.low()};
+  }
+};
+
+} // namespace
+
+SMTQueryCache::SMTQueryCache(size_t MaxBytes, const std::string &P)
+    : MaxEntries(MaxBytes / bytesPerEntry()), Path(P), Hits(0), Misses(0) {
+  if (!Path.empty()) {
+    load(Path);
+  }
+}
+
+SMTQueryCache::~SMTQueryCache() {
+  if (!Path.empty()) {
+    save(Path);
+  }
+}
+
+SMTQueryCache *SMTQueryCache::get() {
+  static std::unique_ptr<SMTQueryCache> Cache(
+      QueryCacheMB > 0 ? new SMTQueryCache((size_t)QueryCacheMB << 20,
+                                           QueryCacheFile.getValue())
+                       : nullptr);
+  return Cache.get();
+}
+
+size_t SMTQueryCache::bytesPerEntry() {
+  // The list node (two pointers and the entry) and the hash table node (the
+  // next pointer, the key, the iterator and the cached hash) plus its bucket
+  return 2 * sizeof(void *) + sizeof(Entry) + sizeof(void *) + sizeof(Key) +
+         sizeof(EntryList::iterator) + sizeof(size_t) + sizeof(void *);
+}
+
+SMTQueryCache::Key SMTQueryCache::computeKey(const z3::expr_vector &Assertions) {
+  QueryKeyBuilder Builder(Assertions.ctx());
+  for (unsigned I = 0; I < Assertions.size(); I++) {
+    Builder.add(Assertions[I]);
+  }
+  return Builder.finish();
+}
+
+bool SMTQueryCache::lookup(const Key &K, SMTSolver::SMTResultType &Result) {
+  std::lock_guard<std::mutex> L(CacheLock);
+  auto It = Index.find(K);
+  if (It == Index.end()) {
+    Misses++;
+    return false;
+  }
+  Hits++;
+  Entries.splice(Entries.begin(), Entries, It->second);
+  Result = It->second->Result;
+  return true;
+}
+
+void SMTQueryCache::insert(const Key &K, SMTSolver::SMTResultType Result) {
+  if (Result != SMTSolver::SMTRT_Sat && Result != SMTSolver::SMTRT_Unsat) {
+    return;
+  }
+  std::lock_guard<std::mutex> L(CacheLock);
+  insertLocked(K, Result);
+}
+
+void SMTQueryCache::insertLocked(const Key &K,
+                                 SMTSolver::SMTResultType Result) {
+  if (MaxEntries == 0) {
+    return;
+  }
+
+  auto It = Index.find(K);
+  if (It != Index.end()) {
+    It->second->Result = Result;
+    Entries.splice(Entries.begin(), Entries, It->second);
+    return;
+  }
+
+  Entries.push_front(Entry{K, Result});
+  Index.emplace(K, Entries.begin());
+  while (Entries.size() > MaxEntries) {
+    Index.erase(Entries.back().K);
+    Entries.pop_back();
+  }
+}
+
+bool SMTQueryCache::load(const std::string &FilePath) {
+  auto BufferOrError = MemoryBuffer::getFile(FilePath);
+  if (!BufferOrError) {
+    return false;
+  }
+  StringRef Data = (*BufferOrError)->getBuffer();
+
+  const size_t HeaderSize = sizeof(QueryCacheMagic) + sizeof(uint32_t);
+  const size_t EntrySize = 2 * sizeof(uint64_t) + sizeof(uint8_t);
+  if (Data.size() < HeaderSize ||
+      !Data.startswith(StringRef(QueryCacheMagic, sizeof(QueryCacheMagic))) ||
+      support::endian::read32le(Data.data() + sizeof(QueryCacheMagic)) !=
+          Version ||
+      (Data.size() - HeaderSize) % EntrySize != 0) {
+    errs() << "Ignoring the SMT query cache " << FilePath
+           << ": unknown format\n";
+    return false;
+  }
+
+  // The entries are saved from the most to the least recently used
+  std::lock_guard<std::mutex> L(CacheLock);
+  size_t NumEntries = (Data.size() - HeaderSize) / EntrySize;
+  for (size_t I = NumEntries; I > 0; I--) {
+    const char *P = Data.data() + HeaderSize + (I - 1) * EntrySize;
+    Key K{support::endian::read64le(P),
+          support::endian::read64le(P + sizeof(uint64_t))};
+    uint8_t Result = (uint8_t)P[2 * sizeof(uint64_t)];
+    if (Result != SMTSolver::SMTRT_Sat && Result != SMTSolver::SMTRT_Unsat) {
+      continue;
+    }
+    insertLocked(K, (SMTSolver::SMTResultType)Result);
+  }
+  return true;
+}
+
+bool SMTQueryCache::save(const std::string &FilePath) const {
+  std::string TmpPath = FilePath + ".tmp";
+  std::error_code EC;
+  raw_fd_ostream OS(TmpPath, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Cannot write the SMT query cache " << FilePath << ": "
+           << EC.message() << "\n";
+    return false;
+  }
+
+  support::endian::Writer W(OS, support::little);
+  OS.write(QueryCacheMagic, sizeof(QueryCacheMagic));
+  W.write<uint32_t>(Version);
+  {
+    std::lock_guard<std::mutex> L(CacheLock);
+    for (auto &E : Entries) {
+      W.write<uint64_t>(E.K.High);
+      W.write<uint64_t>(E.K.Low);
+      W.write<uint8_t>((uint8_t)E.Result);
+    }
+  }
+
+  OS.close();
+  if (OS.has_error() || sys::fs::rename(TmpPath, FilePath)) {
+    OS.clear_error();
+    sys::fs::remove(TmpPath);
+    errs() << "Cannot write the SMT query cache " << FilePath << "\n";
+    return false;
+  }
+  return true;
+}
+
+size_t SMTQueryCache::size() const {
+  std::lock_guard<std::mutex> L(CacheLock);
+  return Entries.size();
+}
+
+uint64_t SMTQueryCache::getNumHits() const {
+  std::lock_guard<std::mutex> L(CacheLock);
+  return Hits;
+}
+
+uint64_t SMTQueryCache::getNumMisses() const {
+  std::lock_guard<std::mutex> L(CacheLock);
+  return Misses;
+}
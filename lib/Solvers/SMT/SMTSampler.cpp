@@ -5,6 +5,7 @@
  * This file implements two approaches for sampling satisfying models from SMT formulas:
  * 1. quick_sampler: A mutation-based approach that generates diverse models by flipping 
  *    variable assignments and exploring the solution space
+ *    (parallel_quick_sampler runs it on several threads, one solver per thread)
  * 2. region_sampler: A bounds-based approach that samples models by determining variable 
  *    bounds and randomly selecting values within those bounds
  *
@@ -263,6 +264,262 @@ public:
   }
 };
 
+// The sample/mutate/solve loop of one thread, see parallel_quick_sampler.
+class parallel_quick_sampler::worker {
+  parallel_quick_sampler &sampler;
+  z3::context c;
+  z3::optimize opt;
+  std::mt19937 rng;
+  std::string buffer;
+
+public:
+  worker(parallel_quick_sampler &sampler, unsigned index)
+      : sampler(sampler), opt(c) {
+    std::seed_seq seq{sampler.seed, index};
+    rng.seed(seq);
+    z3::expr_vector exp(c);
+    for (auto &clause : sampler.clauses) {
+      z3::expr_vector lits(c);
+      for (int v : clause)
+        lits.push_back(v > 0 ? literal(v) : !literal(-v));
+      exp.push_back(mk_or(lits));
+    }
+    opt.add(mk_and(exp));
+  }
+
+  void run() {
+    while (true) {
+      opt.push();
+      for (int v : sampler.ind) {
+        if (rng() % 2)
+          opt.add(literal(v), 1);
+        else
+          opt.add(!literal(v), 1);
+      }
+      if (solve() != z3::sat)
+        break;
+      z3::model m = opt.get_model();
+      opt.pop();
+
+      if (!sample(m))
+        break;
+    }
+    flush();
+  }
+
+private:
+  // Returns false once the sampler stops
+  bool sample(z3::model m) {
+    const std::vector<int> &ind = sampler.ind;
+    std::unordered_set<std::string> initial_mutations;
+    std::string m_string = model_string(m);
+    output(m_string, 0);
+    opt.push();
+    for (unsigned i = 0; i < ind.size(); ++i) {
+      int v = ind[i];
+      if (m_string[i] == '1')
+        opt.add(literal(v), 1);
+      else
+        opt.add(!literal(v), 1);
+    }
+
+    bool stopped = false;
+    std::unordered_map<std::string, int> mutations;
+    for (unsigned i = 0; i < ind.size() && !stopped; ++i) {
+      if (sampler.unsat_vars[i])
+        continue;
+      opt.push();
+      int v = ind[i];
+      if (m_string[i] == '1')
+        opt.add(!literal(v));
+      else
+        opt.add(literal(v));
+      z3::check_result result = solve();
+      if (result == z3::sat) {
+        z3::model new_model = opt.get_model();
+        std::string new_string = model_string(new_model);
+        if (initial_mutations.insert(new_string).second) {
+          std::unordered_map<std::string, int> new_mutations;
+          new_mutations[new_string] = 1;
+          output(new_string, 1);
+          for (auto &it : mutations) {
+            if (it.second >= 6)
+              continue;
+            std::string candidate(ind.size(), '0');
+            for (unsigned j = 0; j < ind.size(); ++j) {
+              bool a = m_string[j] == '1';
+              bool b = it.first[j] == '1';
+              bool c = new_string[j] == '1';
+              if (a ^ ((a ^ b) | (a ^ c)))
+                candidate[j] = '1';
+            }
+            if (mutations.find(candidate) == mutations.end() &&
+                new_mutations.emplace(candidate, it.second + 1).second) {
+              output(candidate, it.second + 1);
+            }
+          }
+          for (auto &it : new_mutations) {
+            mutations[it.first] = it.second;
+          }
+        }
+      } else if (result == z3::unsat) {
+        sampler.unsat_vars[i] = true;
+      } else {
+        stopped = true;
+      }
+      opt.pop();
+    }
+    sampler.epochs++;
+    opt.pop();
+    return !stopped;
+  }
+
+  void output(const std::string &sample, int nmut) {
+    if (!sampler.seen.insert(sample)) {
+      sampler.duplicates++;
+      return;
+    }
+    if (sampler.samples++ >= sampler.max_samples) {
+      sampler.stop = true;
+      return;
+    }
+    buffer += std::to_string(nmut);
+    buffer += ": ";
+    buffer += sample;
+    buffer += '\n';
+    if (buffer.size() >= buffer_size)
+      flush();
+  }
+
+  void flush() {
+    std::lock_guard<std::mutex> guard(sampler.results_lock);
+    sampler.results_file << buffer;
+    buffer.clear();
+  }
+
+  // Returns unknown once the sampler stops
+  z3::check_result solve() {
+    if (sampler.stop)
+      return z3::unknown;
+    if (sampler.elapsed() > sampler.max_time) {
+      sampler.stop = true;
+      return z3::unknown;
+    }
+    sampler.solver_calls++;
+    return opt.check();
+  }
+
+  std::string model_string(z3::model model) {
+    std::string s(sampler.ind.size(), '0');
+    for (unsigned i = 0; i < sampler.ind.size(); ++i) {
+      z3::func_decl decl(literal(sampler.ind[i]).decl());
+      z3::expr b = model.get_const_interp(decl);
+      if (b.bool_value() == Z3_L_TRUE)
+        s[i] = '1';
+    }
+    return s;
+  }
+
+  z3::expr literal(int v) {
+    return c.constant(c.str_symbol(std::to_string(v).c_str()), c.bool_sort());
+  }
+};
+
+parallel_quick_sampler::parallel_quick_sampler(std::string input,
+                                               int max_samples,
+                                               double max_time,
+                                               unsigned num_threads,
+                                               unsigned seed)
+    : input_file(input), max_samples(max_samples), max_time(max_time),
+      num_threads(std::max(num_threads, 1u)), seed(seed) {}
+
+double parallel_quick_sampler::elapsed() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start_time)
+      .count();
+}
+
+void parallel_quick_sampler::run() {
+  start_time = std::chrono::steady_clock::now();
+  parse_cnf();
+  unsat_vars.reset(new std::atomic<bool>[ind.size()]);
+  for (unsigned i = 0; i < ind.size(); ++i)
+    unsat_vars[i] = false;
+  results_file.open(input_file + ".samples");
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    threads.emplace_back([this, i]() { worker(*this, i).run(); });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  results_file.close();
+  run_time = elapsed();
+  print_stats();
+}
+
+int parallel_quick_sampler::num_samples() const {
+  return std::min(samples.load(), max_samples);
+}
+
+void parallel_quick_sampler::print_stats() {
+  double time = run_time;
+  int written = num_samples();
+  std::cout << "Samples " << written << '\n';
+  std::cout << "Execution time " << time << '\n';
+  std::cout << "Samples per second " << (time > 0 ? written / time : 0)
+            << '\n';
+  std::cout << "Threads " << num_threads << ", Epochs " << epochs
+            << ", Duplicates " << duplicates << ", Calls " << solver_calls
+            << '\n';
+}
+
+void parallel_quick_sampler::parse_cnf() {
+  std::ifstream f(input_file);
+  if (!f.is_open()) {
+    std::cout << "Error opening input file\n";
+    abort();
+  }
+  std::unordered_set<int> indset;
+  bool has_ind = false;
+  int max_var = 0;
+  std::string line;
+  while (getline(f, line)) {
+    std::istringstream iss(line);
+    if (line.find("c ind ") == 0) {
+      std::string s;
+      iss >> s;
+      iss >> s;
+      int v;
+      while (iss >> v) {
+        if (v && indset.insert(v).second) {
+          ind.push_back(v);
+          has_ind = true;
+        }
+      }
+    } else if (!line.empty() && line[0] != 'c' && line[0] != 'p') {
+      std::vector<int> clause;
+      int v;
+      while (iss >> v && v != 0) {
+        clause.push_back(v);
+        if (!has_ind)
+          indset.insert(abs(v));
+        max_var = std::max(max_var, abs(v));
+      }
+      clauses.push_back(clause);
+    }
+  }
+  f.close();
+  if (!has_ind) {
+    for (int lit = 0; lit <= max_var; ++lit) {
+      if (indset.find(lit) != indset.end()) {
+        ind.push_back(lit);
+      }
+    }
+  }
+}
+
 struct region_sampler {
   std::string path;
   std::string input_file;
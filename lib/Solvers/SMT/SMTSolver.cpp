@@ -10,28 +10,43 @@
  * - N-to-N query solving with under/over approximation
  * - Model generation for satisfiable formulas
  * - Push/pop for managing solver scopes
+ * - Reuse of the answers of equivalent queries through the SMTQueryCache
+ * - A portfolio of tactics running in parallel on hard queries
  *
  * The implementation uses Z3 for the actual solving, but provides a clean abstraction
  * layer for the rest of the system.
  */
 
+#include <llvm/ADT/Statistic.h>
 #include <llvm/Support/CommandLine.h>
 
 #include "Solvers/SMT/SMTConfigure.h"
 #include "Solvers/SMT/SMTExpr.h"
 #include "Solvers/SMT/SMTFactory.h"
 #include "Solvers/SMT/SMTModel.h"
+#include "Solvers/SMT/SMTQueryCache.h"
 #include "Solvers/SMT/SMTSolver.h"
 
+#include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <time.h>
 
 #define DEBUG_TYPE "solver"
 
 using namespace llvm;
 
+STATISTIC(QueryCacheHits, "Number of SMT queries answered by the query cache");
+STATISTIC(QueryCacheMisses, "Number of SMT queries missing in the query cache");
+STATISTIC(PortfolioQueries, "Number of SMT queries solved by the portfolio");
+STATISTIC(PortfolioWins,
+          "Number of SMT queries answered first by a portfolio tactic");
+
 static llvm::cl::opt<std::string>
     UsingSimplify("solver-simplify", llvm::cl::init(""),
                   llvm::cl::desc("Using online simplification technique. "
@@ -48,6 +63,17 @@ static llvm::cl::opt<int> DumpingConstraintsTimeout(
     llvm::cl::desc("If solving time is too large (ms), the constraints will be "
                    "output to the destination that -dump-cnts-dst set."));
 
+static llvm::cl::list<std::string> PortfolioTactics(
+    "smt-portfolio", llvm::cl::CommaSeparated,
+    llvm::cl::desc("Z3 tactics (e.g. qfbv,smt) solving hard queries in "
+                   "parallel with the solver. The first sat/unsat answer "
+                   "wins and the other solvers are interrupted."));
+
+static llvm::cl::opt<unsigned> PortfolioThreshold(
+    "smt-portfolio-threshold", llvm::cl::init(100),
+    llvm::cl::desc("Time (ms) the solver works alone on a query before the "
+                   "portfolio of -smt-portfolio is started."));
+
 int SMTSolver::GlobalTimeout;
 
 static llvm::cl::opt<int> EnableLocalSimplify(
@@ -63,7 +89,7 @@ static llvm::cl::opt<int> EnableLocalSimplify(
 bool SMTSolvingTimeOut = false;
 
 SMTSolver::SMTSolver(SMTFactory *F, z3::solver &Z3Solver, z3::model &Z3Model)
-    : SMTObject(F), Solver(Z3Solver), checkCount(0) {
+    : SMTObject(F), Solver(Z3Solver), checkCount(0), ModelPending(false) {
   if (SMTSolver::GlobalTimeout > 0) {
     z3::params Z3Params(Z3Solver.ctx());
     Z3Params.set("timeout", (unsigned)SMTSolver::GlobalTimeout);
@@ -72,12 +98,16 @@ SMTSolver::SMTSolver(SMTFactory *F, z3::solver &Z3Solver, z3::model &Z3Model)
 }
 
 SMTSolver::SMTSolver(const SMTSolver &Solver)
-    : SMTObject(Solver), Solver(Solver.Solver) {}
+    : SMTObject(Solver), Solver(Solver.Solver),
+      ModelPending(Solver.ModelPending),
+      PortfolioModel(Solver.PortfolioModel) {}
 
 SMTSolver &SMTSolver::operator=(const SMTSolver &Solver) {
   SMTObject::operator=(Solver);
   if (this != &Solver) {
     this->Solver = Solver.Solver;
+    this->ModelPending = Solver.ModelPending;
+    this->PortfolioModel = Solver.PortfolioModel;
   }
   return *this;
 }
@@ -85,6 +115,29 @@ SMTSolver &SMTSolver::operator=(const SMTSolver &Solver) {
 SMTSolver::~SMTSolver() {}
 
 SMTSolver::SMTResultType SMTSolver::check(unsigned Timeout) {
+  ModelPending = false;
+  PortfolioModel.reset();
+
+  SMTQueryCache *Cache = SMTQueryCache::get();
+  if (!Cache) {
+    return checkWithZ3(Timeout);
+  }
+
+  SMTQueryCache::Key Key = SMTQueryCache::computeKey(Solver.assertions());
+  SMTResultType RetVal;
+  if (Cache->lookup(Key, RetVal)) {
+    QueryCacheHits++;
+    ModelPending = RetVal == SMTResultType::SMTRT_Sat;
+    return RetVal;
+  }
+  QueryCacheMisses++;
+
+  RetVal = checkWithZ3(Timeout);
+  Cache->insert(Key, RetVal);
+  return RetVal;
+}
+
+SMTSolver::SMTResultType SMTSolver::checkWithZ3(unsigned Timeout) {
   if (Timeout > 0) {
     this->setTimeout(Timeout);
   }
@@ -123,7 +176,9 @@ SMTSolver::SMTResultType SMTSolver::check(unsigned Timeout) {
 
       Result = Z3Solver4Sim.check();
     } else {
-      Result = Solver.check();
+      Result = checkWithPortfolio(Timeout > 0 ? Timeout
+                                              : (unsigned)std::max(
+                                                    SMTSolver::GlobalTimeout, 0));
     }
 
     if (DumpingConstraintsTimeout.getNumOccurrences()) {
@@ -181,6 +236,123 @@ SMTSolver::SMTResultType SMTSolver::check(unsigned Timeout) {
   return RetVal;
 }
 
+z3::check_result SMTSolver::checkWithPortfolio(unsigned Timeout) {
+  unsigned Threshold = PortfolioThreshold.getValue();
+  if (PortfolioTactics.empty() || (Timeout > 0 && Timeout <= Threshold)) {
+    return Solver.check();
+  }
+
+  // Most queries are easy: do not pay for the portfolio
+  this->setTimeout(Threshold);
+  z3::check_result Result = Solver.check();
+  unsigned Remaining = Timeout > 0 ? Timeout - Threshold : UINT_MAX;
+  this->setTimeout(Remaining);
+  if (Result != z3::check_result::unknown ||
+      (Solver.reason_unknown() != "timeout" &&
+       Solver.reason_unknown() != "canceled")) {
+    this->setTimeout(Timeout > 0 ? Timeout : UINT_MAX);
+    return Result;
+  }
+
+  PortfolioQueries++;
+
+  // Every member runs on its own copy of the query: an interrupted context
+  // stays canceled, so the context of the factory is never interrupted.
+  // Member 0 runs the default solver, the others the portfolio tactics.
+  struct Member {
+    std::unique_ptr<z3::context> Ctx;
+    std::unique_ptr<z3::solver> Solver;
+  };
+  std::vector<Member> Members(PortfolioTactics.size() + 1);
+  z3::expr_vector Assertions = Solver.assertions();
+  for (unsigned I = 0; I < Members.size(); I++) {
+    auto &M = Members[I];
+    M.Ctx.reset(new z3::context());
+    try {
+      M.Solver.reset(
+          I == 0 ? new z3::solver(*M.Ctx)
+                 : new z3::solver(z3::tactic(*M.Ctx,
+                                             PortfolioTactics[I - 1].c_str())
+                                      .mk_solver()));
+    } catch (z3::exception &Ex) {
+      std::cerr << __FILE__ << " : " << __LINE__ << " : " << Ex << "\n";
+      M.Solver.reset(new z3::solver(*M.Ctx));
+    }
+    z3::params Z3Params(*M.Ctx);
+    Z3Params.set("timeout", Remaining);
+    M.Solver->set(Z3Params);
+    z3::expr_vector Translated(
+        *M.Ctx, Z3_ast_vector_translate(Solver.ctx(), Assertions, *M.Ctx));
+    for (unsigned J = 0; J < Translated.size(); J++) {
+      M.Solver->add(Translated[J]);
+    }
+  }
+
+  std::mutex Lock;
+  std::condition_variable Done;
+  unsigned NumFinished = 0;
+  int Winner = -1;
+  std::vector<bool> Finished(Members.size(), false);
+  std::vector<z3::check_result> Results(Members.size(),
+                                        z3::check_result::unknown);
+
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < Members.size(); I++) {
+    Threads.emplace_back([&, I]() {
+      z3::check_result R = z3::check_result::unknown;
+      try {
+        R = Members[I].Solver->check();
+      } catch (z3::exception &) {
+        // Interrupted
+      }
+      std::lock_guard<std::mutex> L(Lock);
+      Finished[I] = true;
+      Results[I] = R;
+      if (Winner < 0 && R != z3::check_result::unknown) {
+        Winner = I;
+      }
+      NumFinished++;
+      Done.notify_one();
+    });
+  }
+
+  // A solver that has not started checking yet ignores the interrupt, so the
+  // losers are interrupted until they all stopped
+  {
+    std::unique_lock<std::mutex> L(Lock);
+    while (NumFinished < Members.size()) {
+      if (Winner < 0) {
+        Done.wait(L);
+        continue;
+      }
+      for (unsigned I = 0; I < Members.size(); I++) {
+        if (!Finished[I]) {
+          Z3_interrupt(*Members[I].Ctx);
+        }
+      }
+      Done.wait_for(L, std::chrono::milliseconds(10));
+    }
+  }
+  for (auto &T : Threads) {
+    T.join();
+  }
+
+  this->setTimeout(Timeout > 0 ? Timeout : UINT_MAX);
+  if (Winner < 0) {
+    return z3::check_result::unknown;
+  }
+  if (Winner > 0) {
+    PortfolioWins++;
+  }
+  if (Results[Winner] == z3::check_result::sat) {
+    z3::model WinnerModel = Members[Winner].Solver->get_model();
+    PortfolioModel = std::make_shared<z3::model>(
+        Solver.ctx(),
+        Z3_model_translate(*Members[Winner].Ctx, WinnerModel, Solver.ctx()));
+  }
+  return Results[Winner];
+}
+
 // This can filter very trivial cases, such as "x + y == 2"(sat), " x > 2 && x
 // <=2"(unsat);
 // TODO: currently we need to get assertions from solver, and then apply a
@@ -412,6 +584,13 @@ bool SMTSolver::operator<(const SMTSolver &Solver) const {
 
 SMTModel SMTSolver::getSMTModel() {
   try {
+    if (ModelPending) {
+      ModelPending = false;
+      checkWithZ3(0);
+    }
+    if (PortfolioModel) {
+      return SMTModel(&getSMTFactory(), *PortfolioModel);
+    }
     return SMTModel(&getSMTFactory(), Solver.get_model());
   } catch (z3::exception &e) {
     std::cerr << __FILE__ << " : " << __LINE__ << " : " << e << "\n";
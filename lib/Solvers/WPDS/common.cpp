@@ -41,10 +41,10 @@
 #include "dictionary.h"
 
 namespace wpds {
-    int rulesCount  = 0;
-    int transCount  = 0;
-    int bktsCount   = 0;
-    int mhCount     = 0;
+    std::atomic<int> rulesCount(0);
+    std::atomic<int> transCount(0);
+    std::atomic<int> bktsCount(0);
+    std::atomic<int> mhCount(0);
 
     std::ostream&
     Query::print( std::ostream& out ) const
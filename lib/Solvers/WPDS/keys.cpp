@@ -39,6 +39,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include <cassert>
+#include <mutex>
 #include "dictionary.h"
 #include "key_source.h"
 #include "keys.h"
@@ -57,18 +58,30 @@ static Dictionary& get_dict()
     return thedict;
 }
 
+// Saturation creates keys (see SaturationProcess::gen_state), so the
+// dictionary is shared by the threads that saturate concurrent queries.
+// The mutex is recursive since printing a key_pair_src prints its keys.
+static std::recursive_mutex& get_dict_mutex()
+{
+    static std::recursive_mutex themutex;
+    return themutex;
+}
+
 wpds_size_t num_keys(void)
 {
-  return get_dict().num_keys();
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
+    return get_dict().num_keys();
 }
 
 wpds_key_t create_key(key_source *x)
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     return get_dict().add_item(x);
 }
 
 wpds_key_t str2key( const char* s ) 
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     string_src *x = new string_src(s);
     return get_dict().add_item(x); 
 }
@@ -80,18 +93,28 @@ wpds_key_t str2key( const std::string & s )
 
 wpds_key_t new_str2key( const char* s ) 
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     string_src *x = new string_src(s);
     return get_dict().add_new_item(x); 
 }
 
 wpds_key_t int2key(int i)
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     int_src *item = new int_src(i);
     return get_dict().add_item(item);
 }
 
+wpds_key_t new_int2key(int i)
+{
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
+    int_src *item = new int_src(i);
+    return get_dict().add_new_item(item);
+}
+
 std::ostream& printkey(wpds_key_t key, std::ostream& o)
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     key_source *ks;
     ks = get_dict().retrieve_item(key);
     if (ks)
@@ -102,6 +125,7 @@ std::ostream& printkey(wpds_key_t key, std::ostream& o)
 
 void showkey(wpds_key_t key, std::string &s)
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     key_source *ks;
     ks = get_dict().retrieve_item(key);
     assert(ks);
@@ -110,6 +134,7 @@ void showkey(wpds_key_t key, std::string &s)
 
 key_source *retrieve_item(wpds_key_t key)
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     key_source *ks;
     ks = get_dict().retrieve_item(key);
     return ks;
@@ -118,11 +143,13 @@ key_source *retrieve_item(wpds_key_t key)
 
 void traverse_dict(void (*f)(key_source *))
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     get_dict().traverse(f);
 }
 
 void clear_dict()
 {
+    std::lock_guard<std::recursive_mutex> lock(get_dict_mutex());
     get_dict().clear();
     // readd WPDS_EPSILON
     str2key( "*" );
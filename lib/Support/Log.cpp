@@ -54,6 +54,9 @@ const nullstream& operator<<(nullstream& os, const T&)
 // Static null stream instance
 static nullstream s_null_stream;
 
+// Buffer of the active LogCapture of this thread, if any
+static thread_local std::ostream* s_thread_stream = nullptr;
+
 // Global Logger instance
 Logger& Logger::getInstance()
 {
@@ -97,6 +100,9 @@ void Logger::configure(LogConfig config)
 
 std::ostream& Logger::getStream()
 {
+    if (s_thread_stream)
+        return *s_thread_stream;
+
     std::lock_guard<std::mutex> lock(m_mutex);
     
     // Make sure we're initialized
@@ -114,6 +120,17 @@ std::ostream& Logger::getStream()
     return m_currentStream.get();
 }
 
+LogCapture::LogCapture()
+    : m_previous(s_thread_stream)
+{
+    s_thread_stream = &m_buffer;
+}
+
+LogCapture::~LogCapture()
+{
+    s_thread_stream = m_previous;
+}
+
 detail::log_wrapper::log_wrapper(log_wrapper&& wrapper)
     : m_stream(wrapper.m_stream)
     , m_last_was_newline(wrapper.m_last_was_newline)
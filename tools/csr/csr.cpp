@@ -8,6 +8,8 @@
 #include <ratio>
 #include <chrono>
 #include <iomanip>
+#include <atomic>
+#include <thread>
 #include <csignal>
 #include <unistd.h>
 
@@ -15,6 +17,7 @@
 #include "CSIndex/Grail.h"
 #include "CSIndex/Graph.h"
 #include "CSIndex/GraphUtil.h"
+#include "CSIndex/IndexFile.h"
 #include "CSIndex/PathtreeQuery.h"
 #include "CSIndex/PathTree.h"
 #include "CSIndex/Query.h"
@@ -31,6 +34,8 @@ static int bb_epsilon = 10;
 static bool transitive_closure = false;
 static bool reps_tab_alg = false;
 static string indexing;
+static string index_file;
+static int bench_threads = 0;
 
 static bool timeout = false;
 
@@ -40,7 +45,7 @@ static void alarm_handler(int param) {
 
 static void usage() {
     cout << "\nUsage:\n"
-            "	csr [-h] [-t] [-m pathtree_or_grail] [-n num_query] [-q query_file] [-g query_file] graph_file\n"
+            "	csr [-h] [-t] [-m pathtree_or_grail] [-n num_query] [-q query_file] [-g query_file] [-c index_file] [-b num_threads] graph_file\n"
             "Description:\n"
             "	-h\tPrint the help message.\n"
             "	-n\t# reachable queries and # unreachable queries to be generated, 100 for each by default.\n"
@@ -50,6 +55,8 @@ static void usage() {
             "	-r\tEvaluate rep's tabulation algorithm.\n"
             "	-m\tEvaluate what indexing approach, pathtree, grail, or pathtree+grail.\n"
             "	-d\tSet the dim of Grail, 2 by default.\n"
+            "	-b\tBenchmark the queries per second with num_threads threads, and the batched one-to-many queries.\n"
+            "	-c\tLoad the indexes from index_file if they were built for the same graph and options, save them into it otherwise.\n"
          << endl;
 }
 
@@ -90,6 +97,12 @@ static void parse_arg(int argc, char *argv[]) {
         } else if (strcmp("-m", argv[i]) == 0) {
             i++;
             indexing = argv[i++];
+        } else if (strcmp("-b", argv[i]) == 0) {
+            i++;
+            bench_threads = atoi(argv[i++]);
+        } else if (strcmp("-c", argv[i]) == 0) {
+            i++;
+            index_file = argv[i++];
         } else if (strcmp("-d", argv[i]) == 0) {
             i++;
             grail_dim = atoi(argv[i++]);
@@ -138,6 +151,81 @@ static double test_query(AbstractQuery *aq, vector<std::pair<int, int>> &queries
     return query_time;
 }
 
+template<typename Src, typename Target>
+static void bench_query(AbstractQuery *aq, vector<std::pair<int, int>> &pairs, int threads, Src src, Target trg) {
+    if (pairs.empty())
+        return;
+    if (threads > 1 && !aq->threadSafe()) {
+        cout << aq->method() << " is not thread-safe, benchmarking with 1 thread" << endl;
+        threads = 1;
+    }
+    vector<std::pair<int, int>> queries;
+    for (const auto &rs : pairs)
+        queries.emplace_back(src(rs.first), trg(rs.second));
+
+    // every thread answers every threads-th query, repeatedly for at least one second
+    std::atomic<long> answered(0);
+    auto start = std::chrono::high_resolution_clock::now();
+    auto elapsed = [&start]() {
+        chrono::duration<double, std::milli> diff = std::chrono::high_resolution_clock::now() - start;
+        return diff.count();
+    };
+    auto worker = [&](int tid) {
+        long n = 0;
+        do {
+            for (size_t i = tid; i < queries.size(); i += threads) {
+                if (threads == 1)
+                    aq->reset();
+                aq->reach(queries[i].first, queries[i].second);
+                n++;
+            }
+        } while (elapsed() < 1000);
+        answered += n;
+    };
+    vector<std::thread> workers;
+    for (int tid = 1; tid < threads; tid++)
+        workers.emplace_back(worker, tid);
+    worker(0);
+    for (auto &w : workers)
+        w.join();
+    double query_time = elapsed();
+    cout << aq->method() << " with " << threads << " threads: " << (long) (answered * 1000.0 / query_time)
+         << " queries/s." << endl;
+
+    // one-to-many: all the targets from each of the sources
+    vector<int> sources, targets;
+    for (const auto &q : queries) {
+        if (sources.size() < 100)
+            sources.push_back(q.first);
+        targets.push_back(q.second);
+    }
+    vector<vector<bool>> single(sources.size(), vector<bool>(targets.size()));
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < sources.size(); i++) {
+        for (size_t j = 0; j < targets.size(); j++) {
+            aq->reset();
+            single[i][j] = aq->reach(sources[i], targets[j]);
+        }
+    }
+    double single_time = elapsed();
+    int mismatches = 0;
+    vector<bool> batch;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < sources.size(); i++) {
+        aq->reset();
+        aq->reachMany(sources[i], targets, batch);
+        for (size_t j = 0; j < targets.size(); j++)
+            mismatches += batch[j] != single[i][j];
+    }
+    double batch_time = elapsed();
+    double num_pairs = (double) sources.size() * targets.size();
+    cout << aq->method() << " one-to-many: " << (long) (num_pairs * 1000.0 / single_time) << " pairs/s single, "
+         << (long) (num_pairs * 1000.0 / batch_time) << " pairs/s batched.";
+    if (mismatches)
+        cout << " ### Wrong: " << mismatches << " batched answers differ.";
+    cout << endl;
+}
+
 static void read_or_generate_queries(
         int orig_vfg_size, int *sccmap, AbstractQuery *indexing_method,
         vector<std::pair<int, int>> &reachable_pairs,
@@ -275,6 +363,20 @@ int main(int argc, char *argv[]) {
     cout << "Merging SCC of Indexing-Graph(IG) Duration: " << diff.count() << " ms" << endl;
     cout << "#DAG of IG: " << vfg.num_vertices() << " #DAG of IG Edges:" << vfg.num_edges() << endl;
 
+    // persistent indexes, keyed by the DAG of IG and the indexing options
+    IndexFile cache;
+    uint64_t cache_key = 0;
+    bool cache_loaded = false;
+    bool cache_dirty = false;
+    if (!index_file.empty()) {
+        cache_key = IndexFile::hashGraph(vfg);
+        cache_key = IndexFile::combine(cache_key, grail_dim);
+        cache_key = IndexFile::combine(cache_key, bb_epsilon);
+        cache_loaded = cache.open(index_file, cache_key);
+        if (cache_loaded)
+            cout << "Loaded index file " << index_file << endl;
+    }
+
     // GRAIL
     Grail *grail = nullptr;
     double grail_on_ig_duration = 0;
@@ -282,7 +384,12 @@ int main(int argc, char *argv[]) {
     if (indexing == "grail" || indexing == "pathtree+grail") {
         start = std::chrono::high_resolution_clock::now();
         GraphUtil::topo_leveler(vfg);
-        grail = new Grail(vfg, grail_dim, 1, false, 100);
+        if (cache_loaded && Grail::canLoad(vfg, grail_dim, cache)) {
+            grail = new Grail(vfg, cache);
+        } else {
+            grail = new Grail(vfg, grail_dim, 1, false, 100);
+            cache_dirty = !index_file.empty();
+        }
         end = std::chrono::high_resolution_clock::now();
         diff = end - start;
         grail_on_ig_duration = diff.count();
@@ -294,7 +401,18 @@ int main(int argc, char *argv[]) {
     Query *pathtree = nullptr;
     double pt_total_duration = 0;
     double pt_total_size = 0;
-    if (indexing == "pathtree" || indexing == "pathtree+grail") {
+    if ((indexing == "pathtree" || indexing == "pathtree+grail") && cache_loaded && Query::canLoad(cache)) {
+        double grail_on_bb_duration;
+        start = std::chrono::high_resolution_clock::now();
+        pathtree = new PathtreeQuery(cache, vfg, bb_epsilon, 0.02, true, &grail_on_bb_duration);
+        end = std::chrono::high_resolution_clock::now();
+        diff = end - start;
+        pt_total_duration = diff.count();
+        cout << "Pathtree Indexing Loading Duration: " << pt_total_duration << " ms" << endl;
+        pt_total_size = (cache.sectionBytes(IndexFile::BACKBONE_GRAPH) + cache.sectionBytes(IndexFile::PATHTREE_LABELS) +
+                         cache.sectionBytes(IndexFile::PATHTREE_GRAIL_LABELS)) / 1024.0 / 1024.0;
+    } else if (indexing == "pathtree" || indexing == "pathtree+grail") {
+        cache_dirty = !index_file.empty();
         // backbone
         int epsilon = bb_epsilon;
         double pr = 0.02;
@@ -357,6 +475,25 @@ int main(int argc, char *argv[]) {
         pt_total_size = pt_index_size(bbgg, pt, *pathtree);
     }
 
+    if (cache_dirty) {
+        IndexFile::Writer writer;
+        if (grail)
+            grail->save(writer);
+        else if (cache_loaded && cache.has(IndexFile::GRAIL_LABELS))
+            writer.copy(cache, IndexFile::GRAIL_LABELS);
+        if (pathtree) {
+            pathtree->saveIndex(writer);
+        } else if (cache_loaded && Query::canLoad(cache)) {
+            for (auto kind : {IndexFile::BACKBONE_GATES, IndexFile::BACKBONE_GRAPH, IndexFile::PATHTREE_LABELS,
+                              IndexFile::PATHTREE_GRAIL_LABELS}) {
+                if (cache.has(kind))
+                    writer.copy(cache, kind);
+            }
+        }
+        if (writer.write(index_file, cache_key))
+            cout << "Saved indexes into " << index_file << endl;
+    }
+
     // prepare queries
     vector<std::pair<int, int>> reachable_pairs;
     vector<std::pair<int, int>> unreachable_pairs;
@@ -388,6 +525,18 @@ int main(int argc, char *argv[]) {
         pt_nr_time = test_query(pathtree, unreachable_pairs, false, src_map, trg_map);
     }
 
+    if (bench_threads > 0) {
+        cout << "--------- Queries Benchmark ------------" << endl;
+        vector<std::pair<int, int>> all_pairs(reachable_pairs);
+        all_pairs.insert(all_pairs.end(), unreachable_pairs.begin(), unreachable_pairs.end());
+        auto src_map = [sccmap](int v) { return sccmap[v]; };
+        auto trg_map = [sccmap, orig_vfg_size](int v) { return sccmap[v + orig_vfg_size]; };
+        if (grail)
+            bench_query(grail, all_pairs, bench_threads, src_map, trg_map);
+        if (pathtree)
+            bench_query(pathtree, all_pairs, bench_threads, src_map, trg_map);
+    }
+
     double tab_r_query_time = 0;
     double tab_notr_query_time = 0;
     double tc_time = 0;
@@ -396,15 +545,15 @@ int main(int argc, char *argv[]) {
         ifstream orig_gf(graph_file);
         Graph orig_vfg(orig_gf);
         orig_gf.close();
-        orig_vfg.build_summary_edges();
-        orig_vfg.add_summary_edges();
 
+        // the tabulation computes the summary edges it needs
         if (reps_tab_alg) {
             cout << "--------- Tabulation Queries Test ------------" << endl;
             auto *tab = new Tabulation(orig_vfg);
             auto vertex_map = [](int v) { return v; };
             tab_r_query_time = test_query(tab, reachable_pairs, true, vertex_map, vertex_map);
             tab_notr_query_time = test_query(tab, unreachable_pairs, false, vertex_map, vertex_map);
+            cout << "Tabulation summary edges: " << tab->summary_edge_size() << endl;
             delete tab;
         }
 
@@ -0,0 +1,268 @@
+// Benchmarks the incremental bidirected Dyck reachability against solving
+// from scratch after every update.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DynamicBidirectedDyck/DyckReach.h"
+
+using namespace std;
+
+struct Update {
+  bool IsInsert;
+  unsigned From, To, Label;
+};
+
+static unsigned node_num = 1000;
+static unsigned edge_num = 2000;
+static unsigned label_num = 10;
+static unsigned update_num = 1000;
+static unsigned recompute_every = 1;
+static unsigned seed = 1;
+static bool check = false;
+static string init_file;
+static string seq_file;
+
+static void usage() {
+  cout << "\nUsage:\n"
+          "\tdyckreach [-h] [-g nodes:edges:labels] [-u num_updates] [-s seed] "
+          "[-r k] [-c] [init.dot updates.seq]\n"
+          "Description:\n"
+          "\t-h\tPrint the help message.\n"
+          "\t-g\tGenerate a random graph, 1000:2000:10 by default.\n"
+          "\t-u\t# random updates, half insertions and half deletions, 1000 "
+          "by default.\n"
+          "\t-s\tSeed of the random graph and updates.\n"
+          "\t-r\tSolve from scratch after every k-th update only, 1 by "
+          "default.\n"
+          "\t-c\tCheck the incremental classes against the ones solved from "
+          "scratch.\n"
+          "\tinit.dot updates.seq\tRead the graph from init.dot, with lines "
+          "\"a->b[label=\\\"op1\\\"]\", and the\n"
+          "\t\tupdates from updates.seq, with lines \"A|D a b op1\". An edge "
+          "labeled cpN is reversed.\n"
+       << endl;
+}
+
+static void parse_arg(int argc, char *argv[]) {
+  int i = 1;
+  vector<string> files;
+  while (i < argc) {
+    if (strcmp("-h", argv[i]) == 0) {
+      usage();
+      exit(0);
+    }
+    if (i + 1 < argc && strcmp("-g", argv[i]) == 0) {
+      if (sscanf(argv[i + 1], "%u:%u:%u", &node_num, &edge_num, &label_num) !=
+              3 ||
+          node_num == 0 || label_num == 0) {
+        usage();
+        exit(1);
+      }
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-u", argv[i]) == 0) {
+      update_num = atoi(argv[i + 1]);
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-s", argv[i]) == 0) {
+      seed = atoi(argv[i + 1]);
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-r", argv[i]) == 0) {
+      recompute_every = max(1, atoi(argv[i + 1]));
+      i += 2;
+    } else if (strcmp("-c", argv[i]) == 0) {
+      check = true;
+      i++;
+    } else {
+      files.push_back(argv[i++]);
+    }
+  }
+  if (files.size() == 2) {
+    init_file = files[0];
+    seq_file = files[1];
+  } else if (!files.empty()) {
+    usage();
+    exit(1);
+  }
+}
+
+// The node and label IDs of the files
+struct IdMap {
+  unordered_map<string, unsigned> NodeID;
+  unordered_map<string, unsigned> EdgeID;
+
+  unsigned node(const string &name) {
+    return NodeID.insert({name, (unsigned)NodeID.size()}).first->second;
+  }
+
+  // An edge labeled op1 or cp1 has the label p1, cp edges are reversed
+  Update edge(bool IsInsert, const string &from, const string &to,
+              const string &label) {
+    unsigned l =
+        EdgeID.insert({label.substr(1), (unsigned)EdgeID.size()}).first->second;
+    unsigned u = node(from), v = node(to);
+    if (label.find("cp") != string::npos)
+      swap(u, v);
+    return {IsInsert, u, v, l};
+  }
+};
+
+static bool read_files(vector<Update> &init, vector<Update> &updates,
+                       unsigned &nodes) {
+  IdMap ids;
+  ifstream dot(init_file);
+  if (!dot) {
+    cerr << "Cannot open " << init_file << endl;
+    return false;
+  }
+  string line;
+  while (getline(dot, line)) {
+    size_t arrow = line.find("->");
+    size_t bracket = line.find("[label");
+    size_t quote = line.find("=\"");
+    if (arrow == string::npos || bracket == string::npos ||
+        quote == string::npos)
+      continue;
+    string from = line.substr(0, arrow);
+    string to = line.substr(arrow + 2, bracket - arrow - 2);
+    string label = line.substr(quote + 2, line.find("\"]") - quote - 2);
+    init.push_back(ids.edge(true, from, to, label));
+  }
+
+  ifstream seq(seq_file);
+  if (!seq) {
+    cerr << "Cannot open " << seq_file << endl;
+    return false;
+  }
+  string op, from, to, label;
+  while (seq >> op >> from >> to >> label)
+    updates.push_back(ids.edge(op.find('A') != string::npos, from, to, label));
+
+  nodes = ids.NodeID.size();
+  return true;
+}
+
+// A random graph, and updates that insert new edges and delete existing ones
+static void generate(vector<Update> &init, vector<Update> &updates) {
+  mt19937 rng(seed);
+  uniform_int_distribution<unsigned> node(0, node_num - 1);
+  uniform_int_distribution<unsigned> label(0, label_num - 1);
+
+  vector<Update> edges;
+  for (unsigned i = 0; i < edge_num; i++)
+    edges.push_back({true, node(rng), node(rng), label(rng)});
+  init = edges;
+
+  for (unsigned i = 0; i < update_num; i++) {
+    if (edges.empty() || rng() % 2 == 0) {
+      Update u = {true, node(rng), node(rng), label(rng)};
+      edges.push_back(u);
+      updates.push_back(u);
+    } else {
+      size_t k = rng() % edges.size();
+      Update u = edges[k];
+      u.IsInsert = false;
+      edges[k] = edges.back();
+      edges.pop_back();
+      updates.push_back(u);
+    }
+  }
+}
+
+// The smallest node of the class of each node
+static vector<unsigned> classes(DyckReach &reach) {
+  unsigned n = reach.GetVtxNum();
+  vector<unsigned> least(n, n);
+  for (unsigned i = 0; i < n; i++) {
+    unsigned r = reach.Find(i);
+    least[r] = min(least[r], i);
+  }
+  vector<unsigned> res(n);
+  for (unsigned i = 0; i < n; i++)
+    res[i] = least[reach.Find(i)];
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+  parse_arg(argc, argv);
+
+  vector<Update> init, updates;
+  unsigned nodes = node_num;
+  if (!init_file.empty()) {
+    if (!read_files(init, updates, nodes))
+      return 1;
+  } else {
+    generate(init, updates);
+  }
+
+  typedef chrono::high_resolution_clock clock;
+  auto micros = [](clock::time_point s, clock::time_point e) {
+    return chrono::duration<double, micro>(e - s).count();
+  };
+
+  DyckReach dynamic(nodes), scratch(nodes);
+  for (const Update &u : init) {
+    dynamic.AddEdge(u.From, u.To, u.Label);
+    scratch.AddEdge(u.From, u.To, u.Label);
+  }
+  auto s = clock::now();
+  dynamic.Solve();
+  auto e = clock::now();
+  cout << "Nodes: " << nodes << " Edges: " << init.size()
+       << " Classes: " << dynamic.GetClassNum() << endl;
+  cout << "Initial solving time: " << micros(s, e) / 1000 << " ms" << endl;
+
+  double dynamic_time = 0, dynamic_max = 0, scratch_time = 0;
+  unsigned solves = 0, mismatches = 0, applied = 0;
+  for (unsigned i = 0; i < updates.size(); i++) {
+    const Update &u = updates[i];
+    s = clock::now();
+    bool changed = u.IsInsert ? dynamic.InsertEdge(u.From, u.To, u.Label)
+                              : dynamic.DeleteEdge(u.From, u.To, u.Label);
+    e = clock::now();
+    dynamic_time += micros(s, e);
+    dynamic_max = max(dynamic_max, micros(s, e));
+    applied += changed;
+
+    if (u.IsInsert)
+      scratch.AddEdge(u.From, u.To, u.Label);
+    else
+      scratch.RemoveEdge(u.From, u.To, u.Label);
+    if ((i + 1) % recompute_every != 0 && i + 1 != updates.size())
+      continue;
+
+    s = clock::now();
+    scratch.Solve();
+    e = clock::now();
+    scratch_time += micros(s, e);
+    solves++;
+
+    if (check && classes(dynamic) != classes(scratch)) {
+      if (mismatches++ == 0)
+        cout << "Mismatch after update " << i << endl;
+    }
+  }
+
+  unsigned n = max<size_t>(updates.size(), 1);
+  cout << "Updates: " << updates.size() << " (" << applied << " applied)"
+       << " Classes: " << dynamic.GetClassNum() << endl;
+  cout << "Incremental update latency: " << dynamic_time / n
+       << " us on average, " << dynamic_max << " us at most" << endl;
+  if (solves > 0) {
+    cout << "Solving from scratch: " << scratch_time / solves
+         << " us on average over " << solves << " solves" << endl;
+    cout << "Speedup: " << (scratch_time / solves) / (dynamic_time / n)
+         << "x" << endl;
+  }
+  if (check)
+    cout << "Check: " << (mismatches == 0 ? "OK" : "FAILED") << " ("
+         << mismatches << " mismatches)" << endl;
+  return mismatches == 0 ? 0 : 1;
+}
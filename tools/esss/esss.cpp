@@ -30,8 +30,11 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "Checker/ESSS/AnalysisCache.h"
 #include "Checker/ESSS/Analyzer.h"
 #include "Checker/ESSS/CallGraph.h"
 #include "Checker/ESSS/ClOptForward.h"
@@ -99,8 +102,16 @@ cl::opt<string> FunctionTestCasesToAnalyze(
         cl::desc("An allowlist (comma separated) that specifies which functions to run through the analyzer as a means of testing."),
         cl::NotHidden, cl::init(""));
 
+cl::opt<string> CacheFile(
+        "cache",
+        cl::desc("Reuse the analysis results of unchanged modules from this file, and update it. Disabled if empty."),
+        cl::NotHidden, cl::init(""));
+
 GlobalContext GlobalCtx;
 
+// Hash of the contents of every loaded module, by path.
+StringMap<uint64_t> ModuleHashes;
+
 // Add missing debug functions
 namespace llvm {
 // Implementation for ConstantRange::dump() const
@@ -163,9 +174,17 @@ void IterativeModulePass::run(ModuleMap &modules, bool multithreaded) {
 }
 
 void loadModule(const char* argv[], unsigned i, mutex* modulesVectorMutex) {
+    auto bufferOrError = MemoryBuffer::getFile(InputFilenames[i]);
+    if (!bufferOrError) {
+        OP << argv[0] << ": error loading file '"
+           << InputFilenames[i] << "'\n";
+        return;
+    }
+    auto contentHash = xxHash64((*bufferOrError)->getBuffer());
+
     SMDiagnostic Err;
     auto LLVMCtx = new LLVMContext();
-    unique_ptr<Module> M = parseIRFile(InputFilenames[i], Err, *LLVMCtx);
+    unique_ptr<Module> M = parseIR((*bufferOrError)->getMemBufferRef(), Err, *LLVMCtx);
 
     if (!M) {
         OP << argv[0] << ": error loading file '"
@@ -180,6 +199,7 @@ void loadModule(const char* argv[], unsigned i, mutex* modulesVectorMutex) {
     StringRef MName(strdup(InputFilenames[i].data()));
     lock_guard<mutex> _((*modulesVectorMutex));
     GlobalCtx.Modules.insert(std::make_pair(Module, MName));
+    ModuleHashes[MName] = contentHash;
 }
 
 int main(int argc, const char* argv[]) {
@@ -265,6 +285,13 @@ int main(int argc, const char* argv[]) {
     OP << "Total number of non-void functions: " << totalCountNonVoid << "\n";
 #endif
 
+    unique_ptr<AnalysisCache> Cache;
+    if (!CacheFile.empty()) {
+        Cache = make_unique<AnalysisCache>(GlobalCtx, ModuleHashes);
+        Cache->load(CacheFile);
+        GlobalCtx.Cache = Cache.get();
+    }
+
     {
         CallGraphPass CGPass(&GlobalCtx);
         CGPass.run(GlobalCtx.Modules);
@@ -272,13 +299,21 @@ int main(int argc, const char* argv[]) {
 
     {
         EHBlockDetectorPass EHPass(&GlobalCtx);
-        EHPass.run(GlobalCtx.Modules, true);
-        EHPass.nextStage();
-        EHPass.associationAnalysisForErrorHandlers();
-        EHPass.run(GlobalCtx.Modules, true);
-        EHPass.storeData();
-        EHPass.learnErrorsFromErrorBlocksForSelf();
-        EHPass.propagateCheckedErrors();
+        if (Cache && Cache->restoreErrorHandlingRules()) {
+            // The error specification is unchanged, only the alias analysis and conditions of the modules must be set up.
+            for (const auto& module_pair : GlobalCtx.Modules)
+                EHPass.doInitialization(module_pair.first);
+        } else {
+            EHPass.run(GlobalCtx.Modules, true);
+            EHPass.nextStage();
+            EHPass.associationAnalysisForErrorHandlers();
+            EHPass.run(GlobalCtx.Modules, true);
+            EHPass.storeData();
+            EHPass.learnErrorsFromErrorBlocksForSelf();
+            EHPass.propagateCheckedErrors();
+            if (Cache)
+                Cache->save(CacheFile);
+        }
     }
 
     {
@@ -5,12 +5,17 @@
 
 #include <llvm/ADT/APInt.h>
 #include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/PostOrderIterator.h>
 #include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/Statistic.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/IR/Argument.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/ConstantRange.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
@@ -38,22 +43,32 @@
 #include <stdexcept>
 #include <z3++.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <optional>
+#include <set>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <chrono>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "kint"
+
 // TODO: consider constraints from annotation;
 
 constexpr const char* MKINT_IR_TAINT = "mkint.taint";
@@ -104,6 +119,16 @@ static llvm::cl::opt<unsigned> FunctionTimeout("function-timeout",
                                              llvm::cl::init(10),
                                              llvm::cl::cat(PerformanceCategory));
 
+ALWAYS_ENABLED_STATISTIC(NumRangeDecided, "Number of Kint checks decided from ranges");
+ALWAYS_ENABLED_STATISTIC(NumQueryCacheHits, "Number of Kint SMT queries answered by the query cache");
+ALWAYS_ENABLED_STATISTIC(NumQueryCacheMisses, "Number of Kint SMT queries sent to the solver");
+
+// Number of functions solved in parallel, each by a thread with its own Z3 context
+static llvm::cl::opt<unsigned> SMTThreads("smt-threads",
+                                          llvm::cl::desc("Number of threads for SMT solving (0 = number of cores)"),
+                                          llvm::cl::init(0),
+                                          llvm::cl::cat(PerformanceCategory));
+
 struct crange : public ConstantRange {
     /// https://llvm.org/doxygen/classllvm_1_1ConstantRange.html
     using ConstantRange::ConstantRange;
@@ -328,12 +353,47 @@ crange compute_binary_rng(const BinaryOperator* op, crange lhs, crange rhs)
     return rhs;
 }
 
-struct MKintPass : public PassInfoMixin<MKintPass> {
-    MKintPass()
-        : m_solver(llvm::None)
+// SMT solving of a single function. A task owns its symbols and reports, so that the functions can be solved
+// on different threads; the reports are merged once all the tasks are done.
+// Answer of a solver query, with the values of the watched expressions in a model when sat.
+struct smt_query_result {
+    z3::check_result result;
+    std::vector<std::string> values;
+    std::vector<z3::expr> asts; // of the key, kept alive so that their ids are not reused.
+};
+
+// A query is keyed by the ids of its normalized (sorted, deduplicated) assertions, then of the watched
+// expressions. Z3 shares the ASTs of a context, so the ids of two live ASTs are equal iff the ASTs are.
+struct smt_query_key_hash {
+    size_t operator()(const std::vector<unsigned>& key) const
     {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (auto id : key)
+            h = (h ^ id) * 0x100000001b3ULL;
+        return static_cast<size_t>(h);
     }
+};
 
+struct smt_task {
+    Function* func = nullptr;
+    uint64_t cost = 0; // estimated, to schedule the expensive tasks first.
+
+    z3::solver* solver = nullptr; // of the worker thread solving the task.
+    DenseMap<const Value*, llvm::Optional<z3::expr>> v2sym;
+    std::map<const BasicBlock*, SmallVector<BasicBlock*, 2>> bbpaths;
+    std::chrono::time_point<std::chrono::steady_clock> start_time;
+    bool timed_out = false;
+
+    std::set<Instruction*> overflow_insts;
+    std::set<Instruction*> bad_shift_insts;
+    std::set<Instruction*> div_zero_insts;
+    std::string log; // buffered log output, when solved in parallel.
+
+    // per task, so that the answers (and counter examples) do not depend on the scheduling.
+    std::unordered_map<std::vector<unsigned>, smt_query_result, smt_query_key_hash> query_cache;
+};
+
+struct MKintPass : public PassInfoMixin<MKintPass> {
     void backedge_analysis(const Function& F)
     {
         for (const auto& bb_ref : F) {
@@ -356,17 +416,26 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         }
     }
 
-    crange get_range(const Value* var, DenseMap<const Value*, crange>& brange)
+    bool is_backedge(const BasicBlock* bb, const BasicBlock* pred) const
     {
-        if (brange.count(var)) {
-            return brange[var];
+        auto it = m_backedges.find(bb);
+        return it != m_backedges.end() && it->second.contains(pred);
+    }
+
+    crange get_range(const Value* var, const DenseMap<const Value*, crange>& brange) const
+    {
+        auto it = brange.find(var);
+        if (it != brange.end()) {
+            return it->second;
         }
 
         if (auto lconst = dyn_cast<ConstantInt>(var)) {
             return crange(lconst->getValue());
         } else {
-            if (auto gv = dyn_cast<GlobalVariable>(var))
-                return m_global2range[gv];
+            if (auto gv = dyn_cast<GlobalVariable>(var)) {
+                auto git = m_global2range.find(gv);
+                return git != m_global2range.end() ? git->second : crange();
+            }
         }
         MKINT_WARN() << "Unknown operand type: " << *var;
         return crange(var->getType()->getIntegerBitWidth(), true);
@@ -377,6 +446,22 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         return get_range(var, m_func2range_info[bb->getParent()][bb]);
     }
 
+    // Read-only counterparts of the above for the SMT solving, which may run on several threads.
+    const DenseMap<const Value*, crange>& lookup_bb_range(const BasicBlock* bb) const
+    {
+        static const DenseMap<const Value*, crange> no_range;
+        auto fit = m_func2range_info.find(bb->getParent());
+        if (fit == m_func2range_info.end())
+            return no_range;
+        auto bit = fit->second.find(bb);
+        return bit == fit->second.end() ? no_range : bit->second;
+    }
+
+    crange lookup_range_by_bb(const Value* var, const BasicBlock* bb) const
+    {
+        return get_range(var, lookup_bb_range(bb));
+    }
+
     void analyze_one_bb_range(BasicBlock* bb, DenseMap<const Value*, crange>& cur_rng)
     {
         auto& F = *bb->getParent();
@@ -386,22 +471,30 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             // Store / Call / Return
             if (const auto call = dyn_cast<CallInst>(&inst)) {
                 if (const auto f = call->getCalledFunction()) {
-                    if (m_callback_tsrc_fn.contains(f->getName())) {
+                    if (f->isDeclaration()) {
+                        // no entry block to pass the arguments to.
+                    } else if (m_callback_tsrc_fn.contains(f->getName())) {
                         const auto& argcalls = m_func2tsrc[f];
 
                         for (const auto& arg : f->args()) {
                             auto& argblock = m_func2range_info[f][&(f->getEntryBlock())];
                             const size_t arg_idx = arg.getArgNo();
                             if (arg.getType()->isIntegerTy()) {
-                                argblock[&arg] = get_rng(call->getArgOperand(arg_idx)).unionWith(argblock[&arg]);
-                                m_func2ret_range[argcalls[arg_idx]->getCalledFunction()] = argblock[&arg];
+                                if (update_range(argblock[&arg], get_rng(call->getArgOperand(arg_idx))))
+                                    schedule_range_analysis(f);
+                                const auto argcall_fn = argcalls[arg_idx]->getCalledFunction();
+                                if (m_func2ret_range[argcall_fn] != argblock[&arg]) {
+                                    m_func2ret_range[argcall_fn] = argblock[&arg];
+                                    schedule_callers(argcall_fn);
+                                }
                             }
                         }
                     } else {
                         for (const auto& arg : f->args()) {
                             auto& argblock = m_func2range_info[f][&(f->getEntryBlock())];
-                            if (arg.getType()->isIntegerTy())
-                                argblock[&arg] = get_rng(call->getArgOperand(arg.getArgNo())).unionWith(argblock[&arg]);
+                            if (arg.getType()->isIntegerTy()
+                                && update_range(argblock[&arg], get_rng(call->getArgOperand(arg.getArgNo()))))
+                                schedule_range_analysis(f);
                         }
                     }
 
@@ -421,7 +514,8 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 auto valrng = get_rng(val);
                 if (const auto gv = dyn_cast<GlobalVariable>(ptr)) {
                     // should be lazy mode. check local vars first and then check global vars.
-                    m_global2range[gv] = m_global2range[gv].unionWith(valrng);
+                    if (update_range(m_global2range[gv], valrng))
+                        schedule_readers(gv);
                 } else if (const auto gep = dyn_cast<GetElementPtrInst>(ptr)) {
                     auto gep_addr = gep->getPointerOperand();
                     if (auto garr = dyn_cast<GlobalVariable>(gep_addr)) {
@@ -433,10 +527,13 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                             if (CheckArrayOOB && idx_max >= arr_size)
                                 m_gep_oob.insert(gep);
 
+                            bool changed = false;
                             for (size_t i = idx_rng.getUnsignedMin().getLimitedValue(); i < std::min(arr_size, idx_max);
                                  ++i) {
-                                m_garr2ranges[garr][i] = m_garr2ranges[garr][i].unionWith(valrng);
+                                changed |= update_range(m_garr2ranges[garr][i], valrng);
                             }
+                            if (changed)
+                                schedule_readers(garr);
                         }
                     }
                 }
@@ -446,8 +543,8 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 continue;
             } else if (const auto ret = dyn_cast<ReturnInst>(&inst)) {
                 // low precision: just apply!
-                if (F.getReturnType()->isIntegerTy())
-                    m_func2ret_range[&F] = get_rng(ret->getReturnValue()).unionWith(m_func2ret_range[&F]);
+                if (F.getReturnType()->isIntegerTy() && update_range(m_func2ret_range[&F], get_rng(ret->getReturnValue())))
+                    schedule_callers(&F);
 
                 continue;
             }
@@ -497,8 +594,8 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             } else if (const PHINode* op = dyn_cast<PHINode>(&inst)) {
                 for (size_t i = 0; i < op->getNumIncomingValues(); ++i) {
                     auto pred = op->getIncomingBlock(i);
-                    if (m_backedges[bb].contains(pred)) {
-                        continue; // skip backedge
+                    if (is_backedge(bb, pred) && !m_analyzed_bbs.contains(pred)) {
+                        continue; // backedge not reached yet; the value is widened when it is.
                     }
                     new_range = new_range.unionWith(get_range_by_bb(op->getIncomingValue(i), pred));
                 }
@@ -556,103 +653,213 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         }
     }
 
+    // Range analysis of F given the current ranges of its arguments, callees and globals. The blocks are visited
+    // in RPO; a function with backedges is visited again until its ranges are stable, and the ranges of the blocks
+    // reached by backedges are widened so that this terminates.
     void range_analysis(Function& F)
     {
         MKINT_LOG() << "Range Analysis -> " << F.getName();
 
         auto& bb_range = m_func2range_info[&F];
+        const auto& blocks = get_rpo_blocks(F);
+        for (auto bb : blocks)
+            bb_range[bb]; // no rehash (and no dangling references) while analyzing.
+
+        constexpr size_t max_pass = 128;
+        for (size_t pass = 0;; ++pass) {
+            bool changed = false;
+            bool has_backedge = false;
+            for (auto bb : blocks) {
+                changed |= range_analysis(bb, has_backedge);
+                m_analyzed_bbs.insert(bb);
+            }
 
-        for (auto& bbref : F) {
-            auto bb = &bbref;
-
-            auto& sum_rng = bb_range[bb];
-
-            // merge all incoming bbs
-            for (const auto& pred : predecessors(bb)) {
-                // avoid backedge: pred can't be a successor of bb.
-                if (m_backedges[bb].contains(pred))
-                    continue; // skip backedge
-
-                MKINT_LOG() << "Merging: " << get_bb_label(pred) << "\t -> " << get_bb_label(bb);
-                auto branch_rng = bb_range[pred];
-                auto terminator = pred->getTerminator();
-                auto br = dyn_cast<BranchInst>(terminator);
-                if (br) {
-                    if (br->isConditional()) {
-                        if (auto cmp = dyn_cast<ICmpInst>(br->getCondition())) {
-                            // br: a op b == true or false
-                            // makeAllowedICmpRegion turning a op b into a range.
-                            auto lhs = cmp->getOperand(0);
-                            auto rhs = cmp->getOperand(1);
-
-                            if (!lhs->getType()->isIntegerTy() || !rhs->getType()->isIntegerTy()) {
-                                // This should be covered by `ICmpInst`.
-                                MKINT_WARN() << "The br operands are not both integers: " << *cmp;
-                            } else {
-                                auto lrng = get_range_by_bb(lhs, pred), rrng = get_range_by_bb(rhs, pred);
-
-                                bool is_true_br = br->getSuccessor(0) == bb;
-                                if (is_true_br) { // T branch
-                                    crange lprng = crange::cmpRegion()(cmp->getPredicate(), rrng);
-                                    crange rprng = crange::cmpRegion()(cmp->getSwappedPredicate(), lrng);
-
-                                    // Don't change constant's value.
-                                    branch_rng[lhs] = dyn_cast<ConstantInt>(lhs) ? lrng : lrng.intersectWith(lprng);
-                                    branch_rng[rhs] = dyn_cast<ConstantInt>(rhs) ? rrng : rrng.intersectWith(rprng);
-                                } else { // F branch
-                                    crange lprng = crange::cmpRegion()(cmp->getInversePredicate(), rrng);
-                                    crange rprng
-                                        = crange::cmpRegion()(CmpInst::getInversePredicate(cmp->getPredicate()), lrng);
-                                    // Don't change constant's value.
-                                    branch_rng[lhs] = dyn_cast<ConstantInt>(lhs) ? lrng : lrng.intersectWith(lprng);
-                                    branch_rng[rhs] = dyn_cast<ConstantInt>(rhs) ? rrng : rrng.intersectWith(rprng);
-                                }
+            if (!changed || !has_backedge)
+                break;
+            if (pass + 1 >= max_pass) {
+                MKINT_LOG() << "[Range Analysis] Max pass " << max_pass << " reached for " << F.getName();
+                break;
+            }
+        }
+    }
+
+    // Merge the ranges of the predecessors of bb and analyze it. Returns whether the ranges of bb changed.
+    bool range_analysis(BasicBlock* bb, bool& has_backedge)
+    {
+        auto& bb_range = m_func2range_info[bb->getParent()];
+        const auto old_rng = bb_range[bb];
+        bool widen_bb = false;
+
+        // merge all incoming bbs
+        for (const auto& pred : predecessors(bb)) {
+            // backedge: pred is a successor of bb. It is merged once analyzed, and widened.
+            if (is_backedge(bb, pred)) {
+                has_backedge = true;
+                if (!m_analyzed_bbs.contains(pred))
+                    continue; // not reached yet.
+                widen_bb = true;
+            }
+
+            MKINT_LOG() << "Merging: " << get_bb_label(pred) << "\t -> " << get_bb_label(bb);
+            auto branch_rng = bb_range[pred];
+            auto terminator = pred->getTerminator();
+            auto br = dyn_cast<BranchInst>(terminator);
+            if (br) {
+                if (br->isConditional()) {
+                    if (auto cmp = dyn_cast<ICmpInst>(br->getCondition())) {
+                        // br: a op b == true or false
+                        // makeAllowedICmpRegion turning a op b into a range.
+                        auto lhs = cmp->getOperand(0);
+                        auto rhs = cmp->getOperand(1);
 
-                                if (branch_rng[lhs].isEmptySet() || branch_rng[rhs].isEmptySet())
+                        if (!lhs->getType()->isIntegerTy() || !rhs->getType()->isIntegerTy()) {
+                            // This should be covered by `ICmpInst`.
+                            MKINT_WARN() << "The br operands are not both integers: " << *cmp;
+                        } else {
+                            auto lrng = get_range_by_bb(lhs, pred), rrng = get_range_by_bb(rhs, pred);
+
+                            bool is_true_br = br->getSuccessor(0) == bb;
+                            if (is_true_br) { // T branch
+                                crange lprng = crange::cmpRegion()(cmp->getPredicate(), rrng);
+                                crange rprng = crange::cmpRegion()(cmp->getSwappedPredicate(), lrng);
+
+                                // Don't change constant's value.
+                                branch_rng[lhs] = dyn_cast<ConstantInt>(lhs) ? lrng : lrng.intersectWith(lprng);
+                                branch_rng[rhs] = dyn_cast<ConstantInt>(rhs) ? rrng : rrng.intersectWith(rprng);
+                            } else { // F branch
+                                crange lprng = crange::cmpRegion()(cmp->getInversePredicate(), rrng);
+                                crange rprng
+                                    = crange::cmpRegion()(CmpInst::getInversePredicate(cmp->getPredicate()), lrng);
+                                // Don't change constant's value.
+                                branch_rng[lhs] = dyn_cast<ConstantInt>(lhs) ? lrng : lrng.intersectWith(lprng);
+                                branch_rng[rhs] = dyn_cast<ConstantInt>(rhs) ? rrng : rrng.intersectWith(rprng);
+                            }
+
+                            // ranges only grow: a branch found possible stays possible, while an empty range may
+                            // be due to callers or backedges not analyzed yet.
+                            if (branch_rng[lhs].isEmptySet() || branch_rng[rhs].isEmptySet()) {
+                                if (!m_possible_branches.count({ cmp, is_true_br }))
                                     m_impossible_branches[cmp] = is_true_br; // TODO: higher precision.
-                                else
-                                    branch_rng[cmp] = crange(APInt(1, is_true_br));
+                            } else {
+                                m_possible_branches.insert({ cmp, is_true_br });
+                                auto it = m_impossible_branches.find(cmp);
+                                if (it != m_impossible_branches.end() && it->second == is_true_br)
+                                    m_impossible_branches.erase(it);
+                                branch_rng[cmp] = crange(APInt(1, is_true_br));
                             }
                         }
                     }
-                } else if (auto swt = dyn_cast<SwitchInst>(terminator)) {
-                    auto cond = swt->getCondition();
-                    if (cond->getType()->isIntegerTy()) {
-                        auto cond_rng = get_range_by_bb(cond, pred);
-                        auto emp_rng = crange::getEmpty(cond->getType()->getIntegerBitWidth());
-
-                        if (swt->getDefaultDest() == bb) { // default
-                            // not (all)
-                            for (auto c : swt->cases()) {
+                }
+            } else if (auto swt = dyn_cast<SwitchInst>(terminator)) {
+                auto cond = swt->getCondition();
+                if (cond->getType()->isIntegerTy()) {
+                    auto cond_rng = get_range_by_bb(cond, pred);
+                    auto emp_rng = crange::getEmpty(cond->getType()->getIntegerBitWidth());
+
+                    if (swt->getDefaultDest() == bb) { // default
+                        // not (all)
+                        for (auto c : swt->cases()) {
+                            auto case_val = c.getCaseValue();
+                            emp_rng = emp_rng.unionWith(case_val->getValue());
+                        }
+                        emp_rng = emp_rng.inverse();
+                    } else {
+                        for (auto c : swt->cases()) {
+                            if (c.getCaseSuccessor() == bb) {
                                 auto case_val = c.getCaseValue();
                                 emp_rng = emp_rng.unionWith(case_val->getValue());
                             }
-                            emp_rng = emp_rng.inverse();
-                        } else {
-                            for (auto c : swt->cases()) {
-                                if (c.getCaseSuccessor() == bb) {
-                                    auto case_val = c.getCaseValue();
-                                    emp_rng = emp_rng.unionWith(case_val->getValue());
-                                }
-                            }
                         }
-
-                        branch_rng[cond] = cond_rng.unionWith(emp_rng);
                     }
-                } else {
-                    // try catch... (thank god, C does not have try-catch)
-                    // indirectbr... ?
-                    MKINT_CHECK_ABORT(false) << "Unknown terminator: " << *pred->getTerminator();
+
+                    branch_rng[cond] = cond_rng.unionWith(emp_rng);
                 }
+            } else {
+                // try catch... (thank god, C does not have try-catch)
+                // indirectbr... ?
+                MKINT_CHECK_ABORT(false) << "Unknown terminator: " << *pred->getTerminator();
+            }
+
+            analyze_one_bb_range(bb, branch_rng);
+        }
 
-                analyze_one_bb_range(bb, branch_rng);
+        if (bb->isEntryBlock()) {
+            MKINT_LOG() << "No predecessors: " << bb;
+            analyze_one_bb_range(bb, bb_range[bb]);
+        }
+
+        if (widen_bb) {
+            for (auto& val_rng_pair : bb_range[bb]) {
+                auto it = old_rng.find(val_rng_pair.first);
+                if (it != old_rng.end())
+                    val_rng_pair.second = widen(it->second, val_rng_pair.second);
             }
+        }
+        return old_rng != bb_range[bb];
+    }
 
-            if (bb->isEntryBlock()) {
-                MKINT_LOG() << "No predecessors: " << bb;
-                analyze_one_bb_range(bb, sum_rng);
+    // Blocks of F in reverse post-order, followed by the unreachable ones.
+    const std::vector<BasicBlock*>& get_rpo_blocks(Function& F)
+    {
+        auto& blocks = m_func2rpo[&F];
+        if (blocks.empty()) {
+            ReversePostOrderTraversal<Function*> rpot(&F);
+            blocks.assign(rpot.begin(), rpot.end());
+            SmallPtrSet<const BasicBlock*, 16> reachable(blocks.begin(), blocks.end());
+            for (auto& bb : F) {
+                if (!reachable.contains(&bb))
+                    blocks.push_back(&bb);
             }
         }
+        return blocks;
+    }
+
+    // Widen old so that it covers cur: a bound that grows is pushed to the min/max value.
+    static crange widen(const crange& old, const crange& cur)
+    {
+        if (old.isEmptySet() || old.contains(cur))
+            return cur.unionWith(old);
+
+        const uint32_t bw = old.getBitWidth();
+        const APInt lo = cur.getUnsignedMin().ult(old.getUnsignedMin()) ? APInt::getMinValue(bw) : old.getUnsignedMin();
+        const APInt hi = cur.getUnsignedMax().ugt(old.getUnsignedMax()) ? APInt::getMaxValue(bw) : old.getUnsignedMax();
+        return crange::getNonEmpty(lo, hi + 1);
+    }
+
+    // dst = dst U rng; returns whether dst changed.
+    static bool update_range(crange& dst, const crange& rng)
+    {
+        const crange new_rng = rng.unionWith(dst);
+        if (new_rng == dst)
+            return false;
+        dst = new_rng;
+        return true;
+    }
+
+    void schedule_range_analysis(Function* F)
+    {
+        if (m_range_analysis_funcs.contains(F) && m_range_pending.insert(F).second)
+            m_range_worklist.push_back(F);
+    }
+
+    // The return range of F changed.
+    void schedule_callers(const Function* F)
+    {
+        auto it = m_callers.find(F);
+        if (it == m_callers.end())
+            return;
+        for (auto caller : it->second)
+            schedule_range_analysis(caller);
+    }
+
+    // The range of gv (or of an element of gv) changed.
+    void schedule_readers(const GlobalVariable* gv)
+    {
+        auto it = m_global_readers.find(gv);
+        if (it == m_global_readers.end())
+            return;
+        for (auto reader : it->second)
+            schedule_range_analysis(reader);
     }
 
     static std::string get_bb_label(const BasicBlock* bb)
@@ -877,13 +1084,6 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
 
         MKINT_LOG() << "Running MKint pass on module " << M.getName();
         
-        // Initialize timeout from command line option
-        m_function_timeout = FunctionTimeout;
-
-        // FIXME: This is a hack.
-        auto ctx = new z3::context; // let it leak.
-        m_solver = z3::solver(*ctx);
-
         // Mark taint sources.
         for (auto& F : M) {
             auto taint_sources = get_taint_source(F);
@@ -911,7 +1111,6 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         } while (n_tfunc_before != m_taint_funcs.size());
 
         constexpr size_t max_try = 128;
-        size_t try_count = 0;
 
         for (auto& F : M) {
             if (!F.isDeclaration()) {
@@ -923,24 +1122,24 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         MKINT_LOG() << M;
 
         this->init_ranges(M);
-        while (true) { // iterative range analysis.
-            const auto old_fn_rng = m_func2range_info;
-            const auto old_glb_rng = m_global2range;
-            const auto old_glb_arrrng = m_garr2ranges;
-            const auto old_fn_ret_rng = m_func2ret_range;
-
-            for (auto F : m_range_analysis_funcs) {
-                range_analysis(*F);
-            }
 
-            if (m_func2range_info == old_fn_rng && old_glb_rng == m_global2range && old_fn_ret_rng == m_func2ret_range
-                && old_glb_arrrng == m_garr2ranges)
-                break;
-            if (++try_count > max_try) {
+        // Iterative range analysis: a function is analyzed again only when the range of one of its arguments,
+        // callees' return values or read globals changed.
+        for (auto F : m_range_analysis_funcs) {
+            schedule_range_analysis(F);
+        }
+        DenseMap<const Function*, size_t> try_count;
+        while (!m_range_worklist.empty()) {
+            auto F = m_range_worklist.front();
+            m_range_worklist.pop_front();
+            m_range_pending.erase(F);
+
+            if (++try_count[F] > max_try) {
                 MKINT_LOG() << "[Iterative Range Analysis] "
-                            << "Max try " << max_try << " reached, aborting.";
-                break;
+                            << "Max try " << max_try << " reached for " << F->getName() << ", skipping.";
+                continue;
             }
+            range_analysis(*F);
         }
         this->pring_all_ranges();
 
@@ -995,6 +1194,20 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             }
         }
 
+        // dependencies of the range analysis: callers of each function and readers of each global.
+        for (auto F : m_range_analysis_funcs) {
+            for (auto& inst : instructions(*F)) {
+                if (auto call = dyn_cast<CallInst>(&inst)) {
+                    if (auto callee = call->getCalledFunction())
+                        m_callers[callee].insert(F);
+                }
+                for (auto& op : inst.operands()) {
+                    if (auto gv = dyn_cast<GlobalVariable>(op))
+                        m_global_readers[gv].insert(F);
+                }
+            }
+        }
+
         // m_callback_tsrc_fn's highest user's input is set as full set.
         for (auto& fn : m_callback_tsrc_fn) {
             auto cbf = M.getFunction(fn);
@@ -1150,7 +1363,7 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         }
     }
 
-    bool add_range_cons(const crange rng, const z3::expr& bv)
+    bool add_range_cons(smt_task& task, const crange rng, const z3::expr& bv)
     {
         if (rng.isFullSet() || bv.is_const())
             return true;
@@ -1160,24 +1373,123 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             return false;
         }
 
-        m_solver.getValue().add(
-            z3::ule(bv, m_solver.getValue().ctx().bv_val(rng.getUnsignedMax().getZExtValue(), rng.getBitWidth())));
-        m_solver.getValue().add(
-            z3::uge(bv, m_solver.getValue().ctx().bv_val(rng.getUnsignedMin().getZExtValue(), rng.getBitWidth())));
+        task.solver->add(
+            z3::ule(bv, task.solver->ctx().bv_val(rng.getUnsignedMax().getZExtValue(), rng.getBitWidth())));
+        task.solver->add(
+            z3::uge(bv, task.solver->ctx().bv_val(rng.getUnsignedMin().getZExtValue(), rng.getBitWidth())));
         return true;
     }
 
+    // Values v may take in the solver: add_range_cons bounds compound expressions by the unsigned hull of their
+    // range and leaves symbols unconstrained.
+    crange smt_domain(smt_task& task, const Value* v)
+    {
+        const uint32_t bits = v->getType()->getIntegerBitWidth();
+        if (auto lconst = dyn_cast<ConstantInt>(v))
+            return crange(lconst->getValue());
+
+        const auto sym = v2sym(task, v);
+        uint64_t val = 0;
+        if (sym.is_numeral())
+            return sym.is_numeral_u64(val) ? crange(APInt(bits, val)) : crange(bits, true);
+
+        const auto inst = dyn_cast<Instruction>(v);
+        if (sym.is_const() || nullptr == inst)
+            return crange(bits, true);
+
+        const crange rng = lookup_range_by_bb(v, inst->getParent());
+        if (rng.isEmptySet() || rng.isFullSet())
+            return crange(bits, true);
+        return crange::getNonEmpty(rng.getUnsignedMin(), rng.getUnsignedMax() + 1);
+    }
+
+    // Tier 1 of the checks: whether the ranges of the operands show that the query of the check is unsat. Showing
+    // that a check fails also needs a feasible path (and a counter example), so that is left to the solver.
+    static bool range_refutes(const BinaryOperator* op, interr et, bool is_signed, const crange& lhs, const crange& rhs)
+    {
+        constexpr auto never = ConstantRange::OverflowResult::NeverOverflows;
+        switch (et) {
+        case interr::INT_OVERFLOW:
+            switch (op->getOpcode()) {
+            case Instruction::Add:
+                return (is_signed ? lhs.signedAddMayOverflow(rhs) : lhs.unsignedAddMayOverflow(rhs)) == never;
+            case Instruction::Sub:
+                return (is_signed ? lhs.signedSubMayOverflow(rhs) : lhs.unsignedSubMayOverflow(rhs)) == never;
+            case Instruction::Mul:
+                return !is_signed && lhs.unsignedMulMayOverflow(rhs) == never;
+            default:
+                return false;
+            }
+        case interr::DIV_BY_ZERO:
+            return !rhs.contains(APInt::getZero(rhs.getBitWidth()));
+        case interr::BAD_SHIFT:
+            return rhs.getSignedMax().slt(rhs.getBitWidth()); // the query compares signed.
+        default:
+            return false;
+        }
+    }
+
+    // Tiers 2 and 3 of the checks: the query cache of the task, keyed by the ids of the normalized (sorted,
+    // deduplicated) assertions of the solver and of the watched expressions, then the solver. On sat, values
+    // receives the values of watched in a model.
+    z3::check_result cached_check(smt_task& task, const std::vector<z3::expr>& watched, std::vector<z3::expr>& values)
+    {
+        constexpr size_t max_cached_queries = 1 << 14;
+
+        const auto assertions = task.solver->assertions();
+        std::vector<unsigned> key { 0 }; // the number of assertions, then their ids.
+        key.reserve(assertions.size() + watched.size() + 1);
+        for (unsigned i = 0; i < assertions.size(); ++i)
+            key.push_back(assertions[i].id());
+        std::sort(key.begin() + 1, key.end());
+        key.erase(std::unique(key.begin() + 1, key.end()), key.end());
+        key[0] = key.size() - 1;
+        for (const auto& w : watched)
+            key.push_back(w.id());
+
+        auto it = task.query_cache.find(key);
+        if (it != task.query_cache.end()) {
+            ++NumQueryCacheHits;
+            for (size_t i = 0; i < watched.size(); ++i)
+                values.push_back(
+                    task.solver->ctx().bv_val(it->second.values[i].c_str(), watched[i].get_sort().bv_size()));
+            return it->second.result;
+        }
+
+        ++NumQueryCacheMisses;
+        const auto result = check_sat(task);
+        if (result == z3::unknown)
+            return result; // depends on the time left.
+
+        smt_query_result cached { result, {}, {} };
+        if (result == z3::sat) {
+            z3::model m = task.solver->get_model();
+            for (const auto& w : watched) {
+                values.push_back(m.eval(w, true));
+                cached.values.push_back(Z3_get_numeral_string(values.back().ctx(), values.back()));
+            }
+        }
+        for (unsigned i = 0; i < assertions.size(); ++i)
+            cached.asts.push_back(assertions[i]);
+        cached.asts.insert(cached.asts.end(), watched.begin(), watched.end());
+
+        if (task.query_cache.size() >= max_cached_queries)
+            task.query_cache.clear();
+        task.query_cache.emplace(std::move(key), std::move(cached));
+        return result;
+    }
+
     // for general: check overflow;
     // for shl:     check shift amount;
     // for div:     check divisor != 0;
-    void binary_check(BinaryOperator* op)
+    void binary_check(smt_task& task, BinaryOperator* op)
     {
         // Skip checks if all checkers are disabled
         if (!CheckIntOverflow && !CheckDivByZero && !CheckBadShift)
             return;
             
-        const auto& lhs_bv = v2sym(op->getOperand(0));
-        const auto& rhs_bv = v2sym(op->getOperand(1));
+        const auto& lhs_bv = v2sym(task, op->getOperand(0));
+        const auto& rhs_bv = v2sym(task, op->getOperand(1));
         const auto rhs_bits = rhs_bv.get_sort().bv_size();
 
         auto is_nsw_is_nuw = [op] {
@@ -1191,14 +1503,22 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         // Just mark it as used to avoid linter warnings
         (void)is_nsw_is_nuw.second;
 
+        const crange lhs_rng = smt_domain(task, op->getOperand(0));
+        const crange rhs_rng = smt_domain(task, op->getOperand(1));
+
         const auto check = [&, this](interr et, bool is_signed) {
-            if (m_solver.getValue().check() == z3::sat) { // counter example
-                z3::model m = m_solver.getValue().get_model();
+            if (range_refutes(op, et, is_signed, lhs_rng, rhs_rng)) {
+                ++NumRangeDecided;
+                return;
+            }
+
+            std::vector<z3::expr> cex;
+            if (cached_check(task, { lhs_bv, rhs_bv }, cex) == z3::sat) { // counter example
                 MKINT_WARN() << rang::fg::yellow << rang::style::bold << mkstr(et) << rang::style::reset << " at "
                              << rang::bg::black << rang::fg::red << op->getParent()->getParent()->getName()
                              << "::" << *op << rang::style::reset;
-                auto lhs_bin = m.eval(lhs_bv, true);
-                auto rhs_bin = m.eval(rhs_bv, true);
+                const auto& lhs_bin = cex[0];
+                const auto& rhs_bin = cex[1];
                 if (is_signed) {
                     MKINT_WARN() << "Counter example: " << rang::bg::black << rang::fg::red << op->getOpcodeName()
                                  << '(' << lhs_bin << ", " << rhs_bin << ") -> " << op->getOpcodeName() << '('
@@ -1212,15 +1532,15 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 switch (et) {
                 case interr::INT_OVERFLOW:
                     if (CheckIntOverflow)
-                        m_overflow_insts.insert(op);
+                        task.overflow_insts.insert(op);
                     break;
                 case interr::BAD_SHIFT:
                     if (CheckBadShift)
-                        m_bad_shift_insts.insert(op);
+                        task.bad_shift_insts.insert(op);
                     break;
                 case interr::DIV_BY_ZERO:
                     if (CheckDivByZero)
-                        m_div_zero_insts.insert(op);
+                        task.div_zero_insts.insert(op);
                     break;
                 default:
                     break;
@@ -1228,18 +1548,18 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             }
         };
 
-        m_solver.getValue().push();
+        task.solver->push();
         switch (op->getOpcode()) {
         case Instruction::Add:
             if (!CheckIntOverflow)
                 break;
                 
             if (!is_nsw) { // unsigned
-                m_solver.getValue().add(!z3::bvadd_no_overflow(lhs_bv, rhs_bv, false));
+                task.solver->add(!z3::bvadd_no_overflow(lhs_bv, rhs_bv, false));
                 check(interr::INT_OVERFLOW, false);
             } else {
-                m_solver.getValue().add(!z3::bvadd_no_overflow(lhs_bv, rhs_bv, true));
-                m_solver.getValue().add(!z3::bvadd_no_underflow(lhs_bv, rhs_bv));
+                task.solver->add(!z3::bvadd_no_overflow(lhs_bv, rhs_bv, true));
+                task.solver->add(!z3::bvadd_no_underflow(lhs_bv, rhs_bv));
                 check(interr::INT_OVERFLOW, true);
             }
             break;
@@ -1249,11 +1569,11 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 break;
                 
             if (!is_nsw) {
-                m_solver.getValue().add(!z3::bvsub_no_underflow(lhs_bv, rhs_bv, false));
+                task.solver->add(!z3::bvsub_no_underflow(lhs_bv, rhs_bv, false));
                 check(interr::INT_OVERFLOW, false);
             } else {
-                m_solver.getValue().add(!z3::bvsub_no_underflow(lhs_bv, rhs_bv, true));
-                m_solver.getValue().add(!z3::bvsub_no_overflow(lhs_bv, rhs_bv));
+                task.solver->add(!z3::bvsub_no_underflow(lhs_bv, rhs_bv, true));
+                task.solver->add(!z3::bvsub_no_overflow(lhs_bv, rhs_bv));
                 check(interr::INT_OVERFLOW, true);
             }
             break;
@@ -1263,11 +1583,11 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 break;
                 
             if (!is_nsw) {
-                m_solver.getValue().add(!z3::bvmul_no_overflow(lhs_bv, rhs_bv, false));
+                task.solver->add(!z3::bvmul_no_overflow(lhs_bv, rhs_bv, false));
                 check(interr::INT_OVERFLOW, false);
             } else {
-                m_solver.getValue().add(!z3::bvmul_no_overflow(lhs_bv, rhs_bv, true));
-                m_solver.getValue().add(!z3::bvmul_no_underflow(lhs_bv, rhs_bv)); // INTMAX * -1
+                task.solver->add(!z3::bvmul_no_overflow(lhs_bv, rhs_bv, true));
+                task.solver->add(!z3::bvmul_no_underflow(lhs_bv, rhs_bv)); // INTMAX * -1
                 check(interr::INT_OVERFLOW, true);
             }
             break;
@@ -1277,21 +1597,21 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             if (!CheckDivByZero)
                 break;
                 
-            m_solver.getValue().add(rhs_bv == m_solver.getValue().ctx().bv_val(0, rhs_bits));
+            task.solver->add(rhs_bv == task.solver->ctx().bv_val(0, rhs_bits));
             check(interr::DIV_BY_ZERO, false);
             break;
             
         case Instruction::SRem:
         case Instruction::SDiv: // can be overflow or divisor == 0
             if (CheckDivByZero) {
-                m_solver.getValue().push();
-                m_solver.getValue().add(rhs_bv == m_solver.getValue().ctx().bv_val(0, rhs_bits)); // may 0?
+                task.solver->push();
+                task.solver->add(rhs_bv == task.solver->ctx().bv_val(0, rhs_bits)); // may 0?
                 check(interr::DIV_BY_ZERO, true);
-                m_solver.getValue().pop();
+                task.solver->pop();
             }
             
             if (CheckIntOverflow) {
-                m_solver.getValue().add(z3::bvsdiv_no_overflow(lhs_bv, rhs_bv));
+                task.solver->add(z3::bvsdiv_no_overflow(lhs_bv, rhs_bv));
                 check(interr::INT_OVERFLOW, true);
             }
             break;
@@ -1302,7 +1622,7 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             if (!CheckBadShift)
                 break;
                 
-            m_solver.getValue().add(rhs_bv >= m_solver.getValue().ctx().bv_val(rhs_bits, rhs_bits)); // sat means bug
+            task.solver->add(rhs_bv >= task.solver->ctx().bv_val(rhs_bits, rhs_bits)); // sat means bug
             check(interr::BAD_SHIFT, false);
             break;
             
@@ -1314,13 +1634,13 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         default:
             break;
         }
-        m_solver.getValue().pop();
+        task.solver->pop();
     }
 
-    z3::expr binary_op_propagate(BinaryOperator* op)
+    z3::expr binary_op_propagate(smt_task& task, BinaryOperator* op)
     {
-        const auto lhs = v2sym(op->getOperand(0));
-        const auto rhs = v2sym(op->getOperand(1));
+        const auto lhs = v2sym(task, op->getOperand(0));
+        const auto rhs = v2sym(task, op->getOperand(1));
         switch (op->getOpcode()) {
         case Instruction::Add:
             return lhs + rhs;
@@ -1356,9 +1676,9 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         return lhs; // dummy
     }
 
-    z3::expr cast_op_propagate(CastInst* op)
+    z3::expr cast_op_propagate(smt_task& task, CastInst* op)
     {
-        const auto src = v2sym(op->getOperand(0));
+        const auto src = v2sym(task, op->getOperand(0));
         const uint32_t bits = op->getType()->getIntegerBitWidth();
         switch (op->getOpcode()) {
         case CastInst::Trunc:
@@ -1372,7 +1692,7 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         }
 
         const std::string new_sym_str = "\%cast" + std::to_string(op->getValueID());
-        return m_solver.getValue().ctx().bv_const(new_sym_str.c_str(), bits); // new expr
+        return task.solver->ctx().bv_const(new_sym_str.c_str(), bits); // new expr
     }
 
     void mark_errors()
@@ -1413,77 +1733,202 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
         }
     }
 
-    z3::expr v2sym(const Value* v)
+    z3::expr v2sym(smt_task& task, const Value* v)
     {
-        auto it = m_v2sym.find(v);
-        if (it != m_v2sym.end())
+        auto it = task.v2sym.find(v);
+        if (it != task.v2sym.end())
             return it->second.getValue();
 
         auto lconst = dyn_cast<ConstantInt>(v);
         MKINT_CHECK_ABORT(nullptr != lconst) << "unsupported value -> symbol mapping: " << *v;
-        return m_solver.getValue().ctx().bv_val(lconst->getZExtValue(), lconst->getType()->getIntegerBitWidth());
+        return task.solver->ctx().bv_val(lconst->getZExtValue(), lconst->getType()->getIntegerBitWidth());
+    }
+
+    // Estimated cost of solving F: path_solving visits every block once per acyclic path from the entry and
+    // queries the solver for each of its instructions.
+    uint64_t estimate_smt_cost(Function& F) const
+    {
+        constexpr uint64_t max_cost = std::numeric_limits<uint64_t>::max() / 2;
+        DenseMap<const BasicBlock*, uint64_t> npaths;
+        std::function<uint64_t(const BasicBlock*)> count_paths = [&](const BasicBlock* bb) -> uint64_t {
+            auto it = npaths.find(bb);
+            if (it != npaths.end())
+                return it->second;
+
+            npaths[bb] = 0; // in progress.
+            uint64_t n = bb->isEntryBlock() ? 1 : 0;
+            for (const auto pred : predecessors(bb)) {
+                if (is_backedge(bb, pred) || bb == pred)
+                    continue;
+                n = std::min(max_cost, n + count_paths(pred));
+            }
+            return npaths[bb] = n;
+        };
+
+        uint64_t cost = 0;
+        for (auto& bb : F) {
+            const uint64_t n = count_paths(&bb);
+            const uint64_t ninsts = bb.size();
+            cost = (n > (max_cost - cost) / ninsts) ? max_cost : cost + n * ninsts;
+        }
+        return cost;
     }
 
     void smt_solving(Module& M)
     {
+        (void)M;
+
+        std::vector<smt_task> tasks;
         for (auto F : m_taint_funcs) {
             if (F->isDeclaration())
                 continue;
+            tasks.emplace_back();
+            tasks.back().func = F;
+        }
 
-            // Record start time for this function
-            m_function_start_time = std::chrono::steady_clock::now();
-            MKINT_LOG() << "Beginning analysis of function " << F->getName();
-
-            // Get a path tree.
-            for (auto& bb : F->getBasicBlockList()) {
-                for (const auto& pred : predecessors(&bb)) {
-                    if (m_backedges[&bb].contains(pred) || &bb == pred)
-                        continue;
+        unsigned nthreads = SMTThreads ? SMTThreads.getValue() : std::thread::hardware_concurrency();
+        nthreads = std::max(1u, std::min<unsigned>(nthreads, tasks.size()));
+
+        // With several threads, start with the most expensive functions so that they do not end up last on a
+        // single thread.
+        std::vector<size_t> order(tasks.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (nthreads > 1) {
+            for (auto& task : tasks)
+                task.cost = estimate_smt_cost(*task.func);
+            std::stable_sort(
+                order.begin(), order.end(), [&tasks](size_t a, size_t b) { return tasks[a].cost > tasks[b].cost; });
+        }
 
-                    m_bbpaths[pred].push_back(&bb);
+        // Each thread owns a Z3 context, which cannot be shared between threads. The results of the range analysis
+        // are only read from here on.
+        std::atomic<size_t> next(0);
+        auto worker = [&, this] {
+            z3::context ctx;
+            z3::solver solver(ctx);
+            for (size_t i = next++; i < order.size(); i = next++) {
+                auto& task = tasks[order[i]];
+                task.solver = &solver;
+                if (nthreads > 1) {
+                    mkint::LogCapture capture;
+                    function_solving(task);
+                    task.log = capture.str();
+                } else {
+                    function_solving(task);
                 }
+                task.solver = nullptr;
             }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned k = 1; k < nthreads; ++k)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& w : workers)
+            w.join();
+
+        // Merge the reports in the order of m_taint_funcs, whatever the thread that solved them.
+        for (auto& task : tasks) {
+            if (!task.log.empty())
+                mkint::Logger::getInstance().getStream() << task.log << std::flush;
+            m_overflow_insts.insert(task.overflow_insts.begin(), task.overflow_insts.end());
+            m_bad_shift_insts.insert(task.bad_shift_insts.begin(), task.bad_shift_insts.end());
+            m_div_zero_insts.insert(task.div_zero_insts.begin(), task.div_zero_insts.end());
+        }
+
+        MKINT_LOG() << "SMT checks: " << NumRangeDecided.getValue() << " decided from ranges, "
+                    << NumQueryCacheHits.getValue() << " query cache hits, " << NumQueryCacheMisses.getValue()
+                    << " solver calls";
+    }
 
-            m_solver.getValue().push();
-            // add function arg constraints.
-            for (auto& arg : F->args()) {
-                if (!arg.getType()->isIntegerTy())
+    void function_solving(smt_task& task)
+    {
+        Function* F = task.func;
+
+        // Record start time for this function
+        task.start_time = std::chrono::steady_clock::now();
+        MKINT_LOG() << "Beginning analysis of function " << F->getName();
+
+        // Get a path tree.
+        for (auto& bb : F->getBasicBlockList()) {
+            for (const auto& pred : predecessors(&bb)) {
+                if (is_backedge(&bb, pred) || &bb == pred)
                     continue;
-                const auto arg_name = F->getName() + "." + std::to_string(arg.getArgNo());
-                const auto argv
-                    = m_solver.getValue().ctx().bv_const(arg_name.str().c_str(), arg.getType()->getIntegerBitWidth());
-                m_v2sym[&arg] = argv;
-                add_range_cons(get_range_by_bb(&arg, &(F->getEntryBlock())), argv);
+
+                task.bbpaths[pred].push_back(&bb);
             }
+        }
 
-            path_solving(&(F->getEntryBlock()), nullptr);
-            m_solver.getValue().pop();
-            
-            // Report analysis time
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::steady_clock::now() - m_function_start_time).count();
-            MKINT_LOG() << "Completed analysis of function " << F->getName() 
-                       << " in " << elapsed << " seconds";
+        task.solver->push();
+        // add function arg constraints.
+        for (auto& arg : F->args()) {
+            if (!arg.getType()->isIntegerTy())
+                continue;
+            const auto arg_name = F->getName() + "." + std::to_string(arg.getArgNo());
+            const auto argv = task.solver->ctx().bv_const(arg_name.str().c_str(), arg.getType()->getIntegerBitWidth());
+            task.v2sym[&arg] = argv;
+            add_range_cons(task, lookup_range_by_bb(&arg, &(F->getEntryBlock())), argv);
         }
+
+        path_solving(task, &(F->getEntryBlock()), nullptr);
+        task.solver->pop();
+
+        // The symbols and the cached ASTs belong to the context of the worker.
+        task.v2sym.clear();
+        task.query_cache.clear();
+        task.bbpaths.clear();
+
+        // Report analysis time
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - task.start_time).count();
+        MKINT_LOG() << "Completed analysis of function " << F->getName()
+                   << " in " << elapsed << " seconds";
     }
 
-    void path_solving(BasicBlock* cur, BasicBlock* pred)
+    // Whether the time budget of the task is spent (warns once); otherwise remaining_ms is the time left, or 0 if
+    // there is no limit.
+    bool out_of_time(smt_task& task, int64_t& remaining_ms)
     {
-        // Check for timeout
-        if (m_function_timeout > 0) {
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::steady_clock::now() - m_function_start_time).count();
-            if (elapsed > static_cast<int64_t>(m_function_timeout)) {
-                MKINT_WARN() << "Timeout reached for function " << cur->getParent()->getName() 
-                             << " after " << elapsed << " seconds. Analysis incomplete.";
-                return;
-            }
+        remaining_ms = 0;
+        if (FunctionTimeout == 0)
+            return false;
+        if (task.timed_out)
+            return true;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - task.start_time).count();
+        remaining_ms = static_cast<int64_t>(FunctionTimeout) * 1000 - elapsed;
+        if (remaining_ms <= 0) {
+            task.timed_out = true;
+            MKINT_WARN() << "Timeout reached for function " << task.func->getName()
+                         << " after " << elapsed / 1000 << " seconds. Analysis incomplete.";
+            return true;
         }
-        
-        if (m_backedges[cur].contains(pred))
+        return false;
+    }
+
+    // Solver check bounded by the time left to the function.
+    z3::check_result check_sat(smt_task& task)
+    {
+        int64_t remaining_ms = 0;
+        if (out_of_time(task, remaining_ms))
+            return z3::unknown;
+        if (remaining_ms > 0)
+            task.solver->set("timeout", static_cast<unsigned>(remaining_ms));
+        return task.solver->check();
+    }
+
+    void path_solving(smt_task& task, BasicBlock* cur, BasicBlock* pred)
+    {
+        // Check for timeout
+        int64_t remaining_ms = 0;
+        if (out_of_time(task, remaining_ms))
+            return;
+
+        if (is_backedge(cur, pred))
             return;
 
-        auto cur_brng = m_func2range_info[cur->getParent()][cur];
+        const auto& cur_brng = lookup_bb_range(cur);
 
         if (nullptr != pred) {
             auto terminator = pred->getTerminator();
@@ -1503,41 +1948,44 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                             bool is_true_br = br->getSuccessor(0) == cur;
 
                             // Skip impossible branch check if checker is disabled
-                            if (CheckDeadBranch && m_impossible_branches.count(cmp) && m_impossible_branches[cmp] == is_true_br) {
-                                return;
+                            if (CheckDeadBranch) {
+                                auto it = m_impossible_branches.find(cmp);
+                                if (it != m_impossible_branches.end() && it->second == is_true_br)
+                                    return;
                             }
 
-                            const auto get_tbr_assert = [lhs, rhs, cmp, this]() -> z3::expr {
+                            const auto get_tbr_assert = [&task, lhs, rhs, cmp, this]() -> z3::expr {
                                 switch (cmp->getPredicate()) {
                                 case ICmpInst::ICMP_EQ: // =
-                                    return v2sym(lhs) == v2sym(rhs);
+                                    return v2sym(task, lhs) == v2sym(task, rhs);
                                 case ICmpInst::ICMP_NE: // !=
-                                    return v2sym(lhs) != v2sym(rhs);
+                                    return v2sym(task, lhs) != v2sym(task, rhs);
                                 case ICmpInst::ICMP_SGT: // singed >
-                                    return z3::sgt(v2sym(lhs), v2sym(rhs));
+                                    return z3::sgt(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_SGE: // singed >=
-                                    return z3::sge(v2sym(lhs), v2sym(rhs));
+                                    return z3::sge(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_SLT: // singed <
-                                    return z3::slt(v2sym(lhs), v2sym(rhs));
+                                    return z3::slt(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_SLE: // singed <=
-                                    return z3::sle(v2sym(lhs), v2sym(rhs));
+                                    return z3::sle(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_UGT: // unsigned >
-                                    return z3::ugt(v2sym(lhs), v2sym(rhs));
+                                    return z3::ugt(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_UGE: // unsigned >=
-                                    return z3::uge(v2sym(lhs), v2sym(rhs));
+                                    return z3::uge(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_ULT: // unsigned <
-                                    return z3::ult(v2sym(lhs), v2sym(rhs));
+                                    return z3::ult(v2sym(task, lhs), v2sym(task, rhs));
                                 case ICmpInst::ICMP_ULE: // unsigned <=
-                                    return z3::ule(v2sym(lhs), v2sym(rhs));
+                                    return z3::ule(v2sym(task, lhs), v2sym(task, rhs));
                                 default:
                                     MKINT_CHECK_ABORT(false) << "unsupported icmp predicate: " << *cmp;
                                     // Add a default return to satisfy compiler
-                                    return v2sym(lhs) == v2sym(lhs); // Always true expression as a fallback
+                                    return v2sym(task, lhs) == v2sym(task, lhs); // Always true expression as a fallback
                                 }
                             };
 
-                            const auto check = [cmp, is_true_br, this] {
-                                if (m_solver.getValue().check() == z3::unsat) { // counter example
+                            const auto check = [&task, cmp, is_true_br, this] {
+                                std::vector<z3::expr> no_values;
+                                if (cached_check(task, {}, no_values) == z3::unsat) { // counter example
                                     MKINT_WARN() << "[SMT Solving] cannot continue " << (is_true_br ? "true" : "false")
                                                  << " branch of " << *cmp;
                                     return false;
@@ -1546,15 +1994,15 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                             };
 
                             if (is_true_br) { // T branch
-                                m_solver.getValue().add(get_tbr_assert());
+                                task.solver->add(get_tbr_assert());
                                 if (!check())
                                     return;
-                                m_v2sym[cmp] = m_solver.getValue().ctx().bv_val(true, 1);
+                                task.v2sym[cmp] = task.solver->ctx().bv_val(true, 1);
                             } else { // F branch
-                                m_solver.getValue().add(!get_tbr_assert());
+                                task.solver->add(!get_tbr_assert());
                                 if (!check())
                                     return;
-                                m_v2sym[cmp] = m_solver.getValue().ctx().bv_val(false, 1);
+                                task.v2sym[cmp] = task.solver->ctx().bv_val(false, 1);
                             }
                         }
                     }
@@ -1562,23 +2010,23 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
             } else if (auto swt = dyn_cast<SwitchInst>(terminator)) {
                 auto cond = swt->getCondition();
                 if (cond->getType()->isIntegerTy()) {
-                    auto cond_rng = get_range_by_bb(cond, pred);
+                    auto cond_rng = lookup_range_by_bb(cond, pred);
                     auto emp_rng = crange::getEmpty(cond->getType()->getIntegerBitWidth());
 
                     if (swt->getDefaultDest() == cur) { // default
                         // not (all)
                         for (auto c : swt->cases()) {
                             auto case_val = c.getCaseValue();
-                            m_solver.getValue().add(v2sym(cond)
-                                != m_solver.getValue().ctx().bv_val(
+                            task.solver->add(v2sym(task, cond)
+                                != task.solver->ctx().bv_val(
                                     case_val->getZExtValue(), cond->getType()->getIntegerBitWidth()));
                         }
                     } else {
                         for (auto c : swt->cases()) {
                             if (c.getCaseSuccessor() == cur) {
                                 auto case_val = c.getCaseValue();
-                                m_solver.getValue().add(v2sym(cond)
-                                    == m_solver.getValue().ctx().bv_val(
+                                task.solver->add(v2sym(task, cond)
+                                    == task.solver->ctx().bv_val(
                                         case_val->getZExtValue(), cond->getType()->getIntegerBitWidth()));
                                 break;
                             }
@@ -1597,26 +2045,26 @@ struct MKintPass : public PassInfoMixin<MKintPass> {
                 continue;
 
             if (auto op = dyn_cast<BinaryOperator>(&inst)) {
-                binary_check(op);
-                m_v2sym[op] = binary_op_propagate(op);
-                if (!add_range_cons(get_range_by_bb(&inst, inst.getParent()), v2sym(op)))
+                binary_check(task, op);
+                task.v2sym[op] = binary_op_propagate(task, op);
+                if (!add_range_cons(task, lookup_range_by_bb(&inst, inst.getParent()), v2sym(task, op)))
                     return;
             } else if (auto op = dyn_cast<CastInst>(&inst)) {
-                m_v2sym[op] = cast_op_propagate(op);
-                if (!add_range_cons(get_range_by_bb(&inst, inst.getParent()), v2sym(op)))
+                task.v2sym[op] = cast_op_propagate(task, op);
+                if (!add_range_cons(task, lookup_range_by_bb(&inst, inst.getParent()), v2sym(task, op)))
                     return;
             } else {
                 const auto name = "\%vid" + std::to_string(inst.getValueID());
-                m_v2sym[&inst] = m_solver.getValue().ctx().bv_const(name.c_str(), inst.getType()->getIntegerBitWidth());
-                if (!add_range_cons(get_range_by_bb(&inst, inst.getParent()), v2sym(&inst)))
+                task.v2sym[&inst] = task.solver->ctx().bv_const(name.c_str(), inst.getType()->getIntegerBitWidth());
+                if (!add_range_cons(task, lookup_range_by_bb(&inst, inst.getParent()), v2sym(task, &inst)))
                     return;
             }
         }
 
-        for (auto succ : m_bbpaths[cur]) {
-            m_solver.getValue().push();
-            path_solving(succ, cur);
-            m_solver.getValue().pop();
+        for (auto succ : task.bbpaths[cur]) {
+            task.solver->push();
+            path_solving(task, succ, cur);
+            task.solver->pop();
         }
     }
 
@@ -1630,22 +2078,23 @@ private:
     std::map<const Function*, bbrange_t> m_func2range_info;
     std::map<const Function*, crange> m_func2ret_range;
     SetVector<Function*> m_range_analysis_funcs;
+    std::map<const Function*, std::vector<BasicBlock*>> m_func2rpo;
+    DenseSet<const BasicBlock*> m_analyzed_bbs;
+    std::deque<Function*> m_range_worklist;
+    DenseSet<Function*> m_range_pending;
+    DenseMap<const Function*, SetVector<Function*>> m_callers;
+    DenseMap<const GlobalVariable*, SetVector<Function*>> m_global_readers;
     std::map<const GlobalVariable*, crange> m_global2range;
     std::map<const GlobalVariable*, SmallVector<crange, 4>> m_garr2ranges;
 
     // for error checking
     std::map<ICmpInst*, bool> m_impossible_branches;
+    std::set<std::pair<ICmpInst*, bool>> m_possible_branches;
     std::set<GetElementPtrInst*> m_gep_oob;
     std::set<Instruction*> m_overflow_insts;
     std::set<Instruction*> m_bad_shift_insts;
     std::set<Instruction*> m_div_zero_insts;
 
-    // constraint solving
-    llvm::Optional<z3::solver> m_solver;
-    DenseMap<const Value*, llvm::Optional<z3::expr>> m_v2sym;
-    std::map<const BasicBlock*, SmallVector<BasicBlock*, 2>> m_bbpaths;
-    std::chrono::time_point<std::chrono::steady_clock> m_function_start_time;
-    unsigned m_function_timeout; // Timeout in seconds for function analysis
 };
 } // namespace
 
@@ -1783,6 +2232,7 @@ int main(int argc, char **argv) {
     // Add performance configuration information
     MKINT_LOG() << "Performance Configuration:";
     MKINT_LOG() << "  Function Timeout: " << (FunctionTimeout == 0 ? "No limit" : std::to_string(FunctionTimeout) + " seconds");
+    MKINT_LOG() << "  SMT Threads: " << (SMTThreads == 0 ? "Number of cores" : std::to_string(SMTThreads));
 
     // Warn if no checkers are enabled
     if (!CheckIntOverflow && !CheckDivByZero && !CheckBadShift && !CheckArrayOOB && !CheckDeadBranch) {
@@ -0,0 +1,134 @@
+// Benchmarks the samples per second of the parallel quick sampler as the
+// number of threads grows.
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Solvers/SMT/SMTSampler.h"
+
+using namespace std;
+
+static unsigned var_num = 100;
+static unsigned clause_num = 200;
+static int max_samples = 10000;
+static double max_time = 10;
+static unsigned max_threads = 0;
+static unsigned seed = 1;
+static string input_file;
+
+static void usage() {
+  cout << "\nUsage:\n"
+          "\tsmtsampler [-h] [-g vars:clauses] [-n samples] [-t seconds] "
+          "[-j threads] [-s seed] [input.cnf]\n"
+          "Description:\n"
+          "\t-h\tPrint the help message.\n"
+          "\t-g\tSample a random 3-CNF, written to random.cnf, 100:200 by "
+          "default.\n"
+          "\t-n\tStop after this many samples, 10000 by default.\n"
+          "\t-t\tStop after this many seconds, 10 by default.\n"
+          "\t-j\tRun with 1, 2, 4, ... up to this many threads, the number "
+          "of cores by default.\n"
+          "\t-s\tSeed of the random CNF and of the sampler.\n"
+          "\tinput.cnf\tSample a DIMACS CNF instead. The samples are written "
+          "to input.cnf.samples.\n"
+       << endl;
+}
+
+static void parse_arg(int argc, char *argv[]) {
+  int i = 1;
+  while (i < argc) {
+    if (strcmp("-h", argv[i]) == 0) {
+      usage();
+      exit(0);
+    }
+    if (i + 1 < argc && strcmp("-g", argv[i]) == 0) {
+      if (sscanf(argv[i + 1], "%u:%u", &var_num, &clause_num) != 2 ||
+          var_num < 3) {
+        usage();
+        exit(1);
+      }
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-n", argv[i]) == 0) {
+      max_samples = atoi(argv[i + 1]);
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-t", argv[i]) == 0) {
+      max_time = atof(argv[i + 1]);
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-j", argv[i]) == 0) {
+      max_threads = atoi(argv[i + 1]);
+      i += 2;
+    } else if (i + 1 < argc && strcmp("-s", argv[i]) == 0) {
+      seed = atoi(argv[i + 1]);
+      i += 2;
+    } else if (input_file.empty() && argv[i][0] != '-') {
+      input_file = argv[i++];
+    } else {
+      usage();
+      exit(1);
+    }
+  }
+}
+
+// A random 3-CNF over distinct variables in every clause
+static bool generate(const string &file) {
+  ofstream f(file);
+  if (!f) {
+    cerr << "Cannot open " << file << endl;
+    return false;
+  }
+  mt19937 rng(seed);
+  uniform_int_distribution<unsigned> var(1, var_num);
+  f << "p cnf " << var_num << " " << clause_num << "\n";
+  for (unsigned i = 0; i < clause_num; i++) {
+    unsigned a = var(rng), b, c;
+    do
+      b = var(rng);
+    while (b == a);
+    do
+      c = var(rng);
+    while (c == a || c == b);
+    for (unsigned v : {a, b, c})
+      f << (rng() % 2 ? "-" : "") << v << " ";
+    f << "0\n";
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  parse_arg(argc, argv);
+
+  if (input_file.empty()) {
+    input_file = "random.cnf";
+    if (!generate(input_file))
+      return 1;
+  }
+  if (max_threads == 0)
+    max_threads = max(thread::hardware_concurrency(), 1u);
+
+  vector<unsigned> thread_nums;
+  for (unsigned n = 1; n < max_threads; n *= 2)
+    thread_nums.push_back(n);
+  thread_nums.push_back(max_threads);
+
+  double base = 0;
+  for (unsigned n : thread_nums) {
+    cout << "---- " << n << " thread(s) ----" << endl;
+    parallel_quick_sampler sampler(input_file, max_samples, max_time, n, seed);
+    sampler.run();
+    double rate = sampler.time() > 0 ? sampler.num_samples() / sampler.time()
+                                     : 0;
+    if (n == 1)
+      base = rate;
+    cout << "Threads " << n << ": " << rate << " samples/s";
+    if (base > 0)
+      cout << ", speedup " << rate / base << "x";
+    cout << endl;
+  }
+  return 0;
+}
@@ -29,6 +29,10 @@ static cl::opt<std::string> OutputFile("output",
                                       cl::value_desc("filename"),
                                       cl::init(""));
 
+static cl::opt<bool> Interprocedural("interprocedural",
+                                    cl::desc("Apply per-function source-to-sink summaries at call sites"),
+                                    cl::init(false));
+
 int main(int argc, char** argv) {
     cl::ParseCommandLineOptions(argc, argv, "LLVM Taint Analysis Tool\n");
     
@@ -49,6 +53,7 @@ int main(int argc, char** argv) {
     TaintConfig config;
     config.trackThroughMemory = true;
     config.trackThroughCalls = true;
+    config.interprocedural = Interprocedural;
     config.maxCallDepth = 5;
     
     // Load custom configuration if provided